@@ -201,6 +201,8 @@ void CL_Record_f( void ) {
 // demo file
 static int demofilehandle;
 static int demofilelen, demofilelentotal;
+static snapDemoKeyframeIndex_t demokeyframes;
+static bool demokeyframesread;
 
 /*
 * CL_BeginDemoAviDump
@@ -262,6 +264,9 @@ void CL_DemoCompleted( void ) {
 	}
 	demofilelen = demofilelentotal = 0;
 
+	SNAP_FreeDemoKeyframeIndex( &demokeyframes );
+	demokeyframesread = false;
+
 	cls.demo.playing = false;
 	cls.demo.basetime = cls.demo.duration = cls.demo.time = 0;
 	Mem_ZoneFree( cls.demo.filename );
@@ -333,12 +338,37 @@ void CL_ReadDemoPackets( void ) {
 	cls.demo.play_jump = false;
 }
 
+/*
+* CL_FindDemoKeyframe
+*
+* Returns the latest keyframe at or before the given time, reading the index on first use
+*/
+static const snapDemoKeyframe_t *CL_FindDemoKeyframe( int64_t serverTime ) {
+	const char *indexofs;
+
+	if( !demokeyframesread ) {
+		demokeyframesread = true;
+
+		indexofs = SNAP_GetDemoMetaKeyValue( cls.demo.meta_data, cls.demo.meta_data_realsize, SNAP_DEMO_KEYFRAMES_META_KEY );
+		if( indexofs ) {
+			int curofs = FS_Tell( demofilehandle );
+			SNAP_ReadDemoKeyframeIndex( demofilehandle, atoi( indexofs ), &demokeyframes );
+			FS_Seek( demofilehandle, curofs, FS_SEEK_SET );
+		}
+	}
+
+	return SNAP_FindDemoKeyframe( &demokeyframes, serverTime );
+}
+
 /*
 * CL_LatchedDemoJump
 *
 * See if it's time to read a new demo packet
 */
 void CL_LatchedDemoJump( void ) {
+	int64_t receivedTime;
+	const snapDemoKeyframe_t *keyframe;
+
 	if( cls.demo.paused || !cls.demo.play_jump_latched ) {
 		return;
 	}
@@ -351,10 +381,21 @@ void CL_LatchedDemoJump( void ) {
 
 	CL_AdjustServerTime( 1 );
 
-	if( cl.serverTime < cl.snapShots[cl.receivedSnapNum & UPDATE_MASK].serverTime ) {
+	receivedTime = cl.snapShots[cl.receivedSnapNum & UPDATE_MASK].serverTime;
+	if( cl.serverTime < receivedTime ) {
+		// restart from the nearest keyframe, or from the beginning if there's none
+		keyframe = CL_FindDemoKeyframe( cl.serverTime );
 		demofilelen = demofilelentotal;
-		FS_Seek( demofilehandle, 0, FS_SEEK_SET );
+		FS_Seek( demofilehandle, keyframe ? keyframe->offset : 0, FS_SEEK_SET );
 		cl.currentSnapNum = cl.receivedSnapNum = 0;
+	} else {
+		// skip everything before the keyframe when jumping far ahead
+		keyframe = CL_FindDemoKeyframe( cl.serverTime );
+		if( keyframe && keyframe->serverTime > receivedTime ) {
+			cl.pendingSnapNum = 0;
+			FS_Seek( demofilehandle, keyframe->offset, FS_SEEK_SET );
+			cl.currentSnapNum = cl.receivedSnapNum = 0;
+		}
 	}
 
 	cls.demo.play_jump = true;
@@ -223,8 +223,10 @@ static void CL_SendConnectPacket( void ) {
 	userinfo_modified = false;
 
 	const char *ticketString = CLStatsowFacade::Instance()->GetTicketString().data();
-	Netchan_OutOfBandPrint( cls.socket, &cls.serveraddress, "connect %i %i %i \"%s\" %i %s\n",
-							APP_PROTOCOL_VERSION, Netchan_GamePort(), cls.challenge, Cvar_Userinfo(), 0, ticketString );
+	// the ticket is quoted so the compression codecs offer stays in place if it's empty
+	Netchan_OutOfBandPrint( cls.socket, &cls.serveraddress, "connect %i %i %i \"%s\" %i \"%s\" %u %u\n",
+							APP_PROTOCOL_VERSION, Netchan_GamePort(), cls.challenge, Cvar_Userinfo(), 0, ticketString,
+							Netchan_LocalCodecs(), Netchan_DictionaryChecksum() );
 }
 
 /*
@@ -1097,6 +1099,8 @@ static void CL_ConnectionlessPacket( const socket_t *socket, const netadr_t *add
 
 	// server connection
 	if( !strcmp( c, "client_connect" ) ) {
+		int codec;
+
 		if( cls.state == CA_CONNECTED ) {
 			Com_Printf( "Dup connect received.  Ignored.\n" );
 			return;
@@ -1116,8 +1120,14 @@ static void CL_ConnectionlessPacket( const socket_t *socket, const netadr_t *add
 		cls.rejected = false;
 
 		Q_strncpyz( cls.session, MSG_ReadStringLine( msg ), sizeof( cls.session ) );
+		codec = atoi( MSG_ReadStringLine( msg ) );
+		if( codec < 0 || codec >= NETCHAN_NUM_CODECS || !( Netchan_LocalCodecs() & ( 1u << codec ) ) ) {
+			codec = NETCHAN_CODEC_ZLIB;
+		}
 
 		Netchan_Setup( &cls.netchan, socket, address, Netchan_GamePort() );
+		cls.netchan.codec = codec;
+		Com_DPrintf( "Using %s compression\n", Netchan_CodecName( codec ) );
 		memset( cl.configstrings, 0, sizeof( cl.configstrings ) );
 		CL_SetClientState( CA_HANDSHAKE );
 		CL_AddReliableCommand( "new" );
@@ -1259,7 +1269,7 @@ static bool CL_ProcessPacket( netchan_t *netchan, msg_t *msg ) {
 	MSG_ReadInt32( msg ); // sequence
 	MSG_ReadInt32( msg ); // sequence_ack
 	if( msg->compressed ) {
-		zerror = Netchan_DecompressMessage( msg );
+		zerror = Netchan_DecompressMessage( msg, netchan->codec );
 		if( zerror < 0 ) {
 			// compression error. Drop the packet
 			Com_Printf( "CL_ProcessPacket: Compression error %i. Dropping packet\n", zerror );
@@ -2288,7 +2298,7 @@ void CL_Netchan_Transmit( msg_t *msg ) {
 	Netchan_PushAllFragments( &cls.netchan );
 
 	if( msg->cursize > 60 ) {
-		int zerror = Netchan_CompressMessage( msg );
+		int zerror = Netchan_CompressMessage( msg, cls.netchan.codec );
 		if( zerror < 0 ) { // it's compression error, just send uncompressed
 			Com_DPrintf( "CL_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
 		}
@@ -1108,6 +1108,11 @@ static void CL_UpdateConfigString( int idx, const char *s ) {
 		return;
 	}
 
+	// demo keyframes repeat all configstrings, don't bother the cgame with unchanged ones
+	if( cls.demo.playing && !strncmp( cl.configstrings[idx], s, sizeof( cl.configstrings[idx] ) - 1 ) ) {
+		return;
+	}
+
 	Q_strncpyz( cl.configstrings[idx], s, sizeof( cl.configstrings[idx] ) );
 
 	// allow cgame to update it too
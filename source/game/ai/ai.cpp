@@ -8,6 +8,8 @@
 const cvar_t *ai_evolution;
 const cvar_t *ai_debugOutput;
 const cvar_t *ai_shareRoutingCache;
+const cvar_t *ai_precomputedRoutesMaxAreas;
+const cvar_t *ai_precomputedRoutesFrameTime;
 
 ai_weapon_aim_type BuiltinWeaponAimType( int builtinWeapon, int fireMode ) {
 	assert( fireMode == FIRE_MODE_STRONG || fireMode == FIRE_MODE_WEAK );
@@ -166,9 +168,13 @@ void AI_InitLevel( void ) {
 	ai_debugOutput = trap_Cvar_Get( "ai_debugOutput", "0", CVAR_ARCHIVE );
 	// We think values for this var should not be archived
 	ai_shareRoutingCache = trap_Cvar_Get( "ai_shareRoutingCache", "1", 0 );
+	// Zero disables precomputing routes for all pairs of areas
+	ai_precomputedRoutesMaxAreas = trap_Cvar_Get( "ai_precomputedRoutesMaxAreas", "2048", CVAR_ARCHIVE );
+	// Milliseconds per frame spent on building the precomputed routes table
+	ai_precomputedRoutesFrameTime = trap_Cvar_Get( "ai_precomputedRoutesFrameTime", "2", CVAR_ARCHIVE );
 
 	AiAasWorld::Init( level.mapname );
-	AiAasRouteCache::Init( *AiAasWorld::Instance() );
+	AiAasRouteCache::Init( *AiAasWorld::Instance(), level.mapname );
 	AiNavMeshManager::Init( level.mapname );
 	TacticalSpotsRegistry::Init( level.mapname );
 	AiGroundTraceCache::Init();
@@ -213,6 +219,8 @@ void AI_JoinedTeam( edict_t *ent, int team ) {
 void AI_CommonFrame() {
 	AiAasWorld::Instance()->Frame();
 
+	AiAasRouteCache::Frame();
+
 	EntitiesPvsCache::Instance()->Update();
 
 	NavEntitiesRegistry::Instance()->Update();
@@ -363,5 +363,7 @@ public:
 extern const cvar_t *ai_evolution;
 extern const cvar_t *ai_debugOutput;
 extern const cvar_t *ai_shareRoutingCache;
+extern const cvar_t *ai_precomputedRoutesMaxAreas;
+extern const cvar_t *ai_precomputedRoutesFrameTime;
 
 #endif
\ No newline at end of file
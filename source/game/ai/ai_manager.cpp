@@ -544,12 +544,44 @@ void AiManager::Frame() {
 
 	if( !GS_TeamBasedGametype() ) {
 		AiBaseTeam::GetTeamForNum( TEAM_PLAYERS )->Update();
+	} else {
+		for( int team = TEAM_ALPHA; team < GS_MAX_TEAMS; ++team ) {
+			AiBaseTeam::GetTeamForNum( team )->Update();
+		}
+	}
+
+	PrepareBotsThink();
+}
+
+void AiManager::PrepareBotsThink() {
+	// Preparation is not free (some data might be left unused) and does not make sense without workers
+	if( !trap_NumWorkerThreads() ) {
 		return;
 	}
 
-	for( int team = TEAM_ALPHA; team < GS_MAX_TEAMS; ++team ) {
-		AiBaseTeam::GetTeamForNum( team )->Update();
+	botsToPrepareThink.clear();
+	for( auto *aiHandle = aiHandlesListHead; aiHandle; aiHandle = aiHandle->Next() ) {
+		if( aiHandle->type == AI_INACTIVE ) {
+			continue;
+		}
+		if( Bot *bot = aiHandle->botRef ) {
+			if( bot->ShouldPrepareThink() ) {
+				botsToPrepareThink.push_back( bot );
+			}
+		}
+	}
+
+	if( botsToPrepareThink.size() < 2 ) {
+		return;
 	}
+
+	AiAasRouteCache::SetQueriedConcurrently( true );
+	trap_RunWorkerJobs( &AiManager::PrepareBotThinkJob, (int)botsToPrepareThink.size() );
+	AiAasRouteCache::SetQueriedConcurrently( false );
+}
+
+void AiManager::PrepareBotThinkJob( int item ) {
+	instance->botsToPrepareThink[item]->PrepareThinkInParallel();
 }
 
 void AiManager::FindHubAreas() {
@@ -52,10 +52,21 @@ protected:
 	int hubAreas[16];
 	int numHubAreas { 0 };
 
+	// Bots that are going to think this frame and may have some data prepared concurrently
+	StaticVector<Bot *, MAX_CLIENTS> botsToPrepareThink;
+
 	static AiManager *instance;
 
 	void Frame() override;
 
+	/**
+	 * Lets bots that are going to think this frame prepare some data using the engine worker threads.
+	 * The world is not modified until this call returns so bots see a consistent read-only snapshot.
+	 */
+	void PrepareBotsThink();
+
+	static void PrepareBotThinkJob( int item );
+
 	bool CheckCanSpawnBots();
 	void CreateUserInfo( char *buffer, size_t bufferSize );
 	edict_t * ConnectFakeClient();
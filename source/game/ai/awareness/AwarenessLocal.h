@@ -34,6 +34,11 @@ static inline bool IsLaserBeamInPvs( const edict_t *self, const edict_t *ent ) {
 	return EntitiesPvsCache::Instance()->AreInPvs( self, ent );
 }
 
+// Should be used instead of the functions above by visibility checks that are performed concurrently
+static inline bool IsEntityInPvsUncached( const edict_t *self, const edict_t *ent ) {
+	return EntitiesPvsCache::AreInPvsUncached( self, ent );
+}
+
 struct EntAndDistance {
 	int entNum;
 	float distance;
@@ -355,13 +355,9 @@ static bool IsEnemyVisible( const edict_t *self, const edict_t *enemyEnt ) {
 	return false;
 }
 
-void BotAwarenessModule::RegisterVisibleEnemies() {
-	if( GS_MatchState() == MATCH_STATE_COUNTDOWN || GS_ShootingDisabled() ) {
-		return;
-	}
-
-	// Compute look dir before loop
-	const Vec3 lookDir( bot->EntityPhysicsState()->ForwardDir() );
+template <typename PvsFunc>
+void BotAwarenessModule::FindVisibleEnemies( const Vec3 &origin, const Vec3 &lookDir,
+											 StaticVector<uint16_t, MAX_CLIENTS> &visibleTargets, PvsFunc pvsFunc ) {
 	const float dotFactor = bot->FovDotFactor();
 
 	// Note: non-client entities also may be candidate targets.
@@ -376,7 +372,7 @@ void BotAwarenessModule::RegisterVisibleEnemies() {
 
 		// Reject targets quickly by fov
 		Vec3 toTarget( ent->s.origin );
-		toTarget -= bot->Origin();
+		toTarget -= origin;
 		float squareDistance = toTarget.SquaredLength();
 		if( squareDistance < 1 ) {
 			continue;
@@ -396,15 +392,64 @@ void BotAwarenessModule::RegisterVisibleEnemies() {
 		candidateTargets.emplace_back( EntAndDistance( ENTNUM( ent ), 1.0f / invDistance ) );
 	}
 
-	StaticVector<uint16_t, MAX_CLIENTS> visibleTargets;
 	const edict_t *self = game.edicts + bot->EntNum();
-	VisCheckRawEnts( candidateTargets, visibleTargets, self, MAX_CLIENTS, IsGenericEntityInPvs, IsEnemyVisible );
+	VisCheckRawEnts( candidateTargets, visibleTargets, self, MAX_CLIENTS, pvsFunc, IsEnemyVisible );
+}
 
-	for( auto entNum: visibleTargets ) {
+void BotAwarenessModule::RegisterVisibleEnemies() {
+	if( GS_MatchState() == MATCH_STATE_COUNTDOWN || GS_ShootingDisabled() ) {
+		return;
+	}
+
+	StaticVector<uint16_t, MAX_CLIENTS> computedVisibleTargets;
+	const StaticVector<uint16_t, MAX_CLIENTS> *visibleTargets = &preparedVisibleTargets;
+	if( !IsPreparedDataValid() ) {
+		// Compute look dir before the loop
+		const Vec3 lookDir( bot->EntityPhysicsState()->ForwardDir() );
+		FindVisibleEnemies( Vec3( bot->Origin() ), lookDir, computedVisibleTargets, IsGenericEntityInPvs );
+		visibleTargets = &computedVisibleTargets;
+	}
+
+	edict_t *const gameEdicts = game.edicts;
+	for( auto entNum: *visibleTargets ) {
 		OnEnemyViewed( gameEdicts + entNum );
 	}
 
-	alertTracker.CheckAlertSpots( visibleTargets );
+	alertTracker.CheckAlertSpots( *visibleTargets );
+}
+
+void BotAwarenessModule::PrepareThinkInParallel() {
+	const edict_t *self = game.edicts + bot->EntNum();
+
+	preparedAtFrame = -1;
+	preparedVisibleTargets.clear();
+	haveHazardsBeenPrepared = false;
+
+	if( GS_MatchState() != MATCH_STATE_COUNTDOWN && !GS_ShootingDisabled() ) {
+		// The entity physics state is updated from the entity only at the beginning of the bot frame
+		vec3_t lookDir;
+		AngleVectors( self->s.angles, lookDir, nullptr, nullptr );
+		FindVisibleEnemies( Vec3( self->s.origin ), Vec3( lookDir ), preparedVisibleTargets, IsEntityInPvsUncached );
+	}
+
+	// Check whether CheckForNewHazards() is going to detect hazards
+	if( !PrimaryHazard() ) {
+		hazardsDetector.ExecConcurrently();
+		haveHazardsBeenPrepared = true;
+	}
+
+	VectorCopy( self->s.origin, preparedForOrigin );
+	VectorCopy( self->s.angles, preparedForAngles );
+	preparedAtFrame = level.framenum;
+}
+
+bool BotAwarenessModule::IsPreparedDataValid() const {
+	if( preparedAtFrame != level.framenum ) {
+		return false;
+	}
+
+	const edict_t *self = game.edicts + bot->EntNum();
+	return VectorCompare( self->s.origin, preparedForOrigin ) && VectorCompare( self->s.angles, preparedForAngles );
 }
 
 void BotAwarenessModule::CheckForNewHazards() {
@@ -416,7 +461,10 @@ void BotAwarenessModule::CheckForNewHazards() {
 	eventsTracker.ResetTeammatesVisData();
 	hazardsSelector.BeginUpdate();
 
-	hazardsDetector.Exec();
+	// The detection might have been already performed concurrently before this think frame
+	if( !haveHazardsBeenPrepared || !IsPreparedDataValid() ) {
+		hazardsDetector.Exec();
+	}
 
 	EntNumsVector *v;
 
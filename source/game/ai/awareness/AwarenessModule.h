@@ -89,6 +89,16 @@ private:
 
 	Hazard triggeredPlanningHazard { nullptr };
 
+	// Results of visibility checks performed concurrently by PrepareThinkInParallel()
+	StaticVector<uint16_t, MAX_CLIENTS> preparedVisibleTargets;
+	bool haveHazardsBeenPrepared { false };
+	// A state of the bot the data has been prepared for
+	int64_t preparedAtFrame { -1 };
+	vec3_t preparedForOrigin;
+	vec3_t preparedForAngles;
+
+	bool IsPreparedDataValid() const;
+
 	void Frame() override;
 	void Think() override;
 
@@ -102,12 +112,23 @@ private:
 	void UpdateBlockedAreasStatus();
 	void TryTriggerPlanningForNewHazard();
 
+	template <typename PvsFunc>
+	void FindVisibleEnemies( const Vec3 &origin, const Vec3 &lookDir,
+							 StaticVector<uint16_t, MAX_CLIENTS> &visibleTargets, PvsFunc pvsFunc );
+
 	void RegisterVisibleEnemies();
 
 	void CheckForNewHazards();
 public:
 	BotAwarenessModule( Bot *bot_ );
 
+	/**
+	 * Performs visibility checks of enemies and hazards for the next think frame.
+	 * Checks do not modify the world or shared caches, so this method may be called concurrently for different bots.
+	 * Results are used by the think frame only if the bot has not been moved or turned since then.
+	 */
+	void PrepareThinkInParallel();
+
 	void OnAttachedToSquad( AiSquad *squad_ );
 	void OnDetachedFromSquad( AiSquad *squad_ );
 
@@ -9,8 +9,6 @@ class EntitiesPvsCache: public AiFrameAwareComponent {
 	// MAX_EDICTS strings per each entity
 	mutable uint32_t visStrings[MAX_EDICTS][ENTITY_DATA_STRIDE];
 
-	static bool AreInPvsUncached( const edict_t *ent1, const edict_t *ent2 );
-
 	static EntitiesPvsCache instance;
 public:
 	EntitiesPvsCache() {
@@ -31,6 +29,9 @@ public:
 	}
 
 	bool AreInPvs( const edict_t *ent1, const edict_t *ent2 ) const;
+
+	// Does not touch the cache, so it can be called concurrently
+	static bool AreInPvsUncached( const edict_t *ent1, const edict_t *ent2 );
 };
 
 #endif
@@ -31,6 +31,15 @@ void HazardsDetector::Clear() {
 }
 
 void HazardsDetector::Exec() {
+	Exec( IsGenericEntityInPvs, IsLaserBeamInPvs );
+}
+
+void HazardsDetector::ExecConcurrently() {
+	Exec( IsEntityInPvsUncached, IsEntityInPvsUncached );
+}
+
+template <typename PvsFunc>
+void HazardsDetector::Exec( PvsFunc isGenInPvs, PvsFunc isLaserInPvs ) {
 	Clear();
 
 	// Note that we always skip own rockets, plasma, etc.
@@ -66,8 +75,6 @@ void HazardsDetector::Exec() {
 		}
 	}
 
-	constexpr auto isGenInPvs = IsGenericEntityInPvs;
-	constexpr auto isLaserInPvs = IsLaserBeamInPvs;
 	constexpr auto isGenVisible = IsGenericProjectileVisible;
 	constexpr auto isLaserVisible = IsLaserBeamVisible;
 
@@ -71,7 +71,15 @@ class HazardsDetector {
 
 	explicit HazardsDetector( const Bot *bot_ ) : bot( bot_ ) {}
 
+	template <typename PvsFunc>
+	void Exec( PvsFunc isGenInPvs, PvsFunc isLaserInPvs );
+
 	void Exec();
+
+	/**
+	 * Same as {@code Exec()} but does not use the shared PVS cache, so it may be called concurrently for different bots.
+	 */
+	void ExecConcurrently();
 };
 
 #endif
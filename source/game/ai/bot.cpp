@@ -174,6 +174,22 @@ const SelectedNavEntity &Bot::GetOrUpdateSelectedNavEntity() {
 	return selectedNavEntity;
 }
 
+bool Bot::ShouldPrepareThink() {
+	if( IsGhosting() || !entityPhysicsState ) {
+		return false;
+	}
+	return !ShouldSkipThinkFrame();
+}
+
+void Bot::PrepareThinkInParallel() {
+	awarenessModule.PrepareThinkInParallel();
+
+	// Check whether GetOrUpdateSelectedNavEntity() is going to select a new nav entity
+	if( !selectedNavEntity.IsValid() || selectedNavEntity.IsEmpty() ) {
+		planningModule.PrepareGoalNavEntitySelection();
+	}
+}
+
 void Bot::ForceSetNavEntity( const SelectedNavEntity &selectedNavEntity_ ) {
 	// Use direct access to the field to skip assertion
 	this->prevSelectedNavEntity = this->selectedNavEntity.navEntity;
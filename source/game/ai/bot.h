@@ -104,6 +104,20 @@ class Bot: public Ai {
 
 	friend class CachedTravelTimesMatrix;
 
+	/**
+	 * Checks whether the bot is going to think this frame
+	 * so it is worth to prepare the think frame via {@code PrepareThinkInParallel()}.
+	 */
+	bool ShouldPrepareThink();
+
+	/**
+	 * Precomputes some data for the next think frame of this bot.
+	 * This method might be executed concurrently for different bots by the {@code AiManager}.
+	 * It must not modify the world state, call scripts or touch other bots and shared caches.
+	 * Traces are allowed as {@code G_Trace()} uses a clip context of the calling thread.
+	 */
+	void PrepareThinkInParallel();
+
 	template <typename T> friend T *Link( T *, T **, int );
 	template <typename T> friend T *Unlink( T *, T **, int );
 public:
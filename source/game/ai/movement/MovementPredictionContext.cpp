@@ -888,13 +888,6 @@ void MovementPredictionContext::BuildPlan() {
 	for( auto *movementAction: module->movementActions )
 		movementAction->BeforePlanning();
 
-	// Intercept these calls implicitly performed by PMove()
-	const auto general_PMoveTouchTriggers = module_PMoveTouchTriggers;
-	const auto general_PredictedEvent = module_PredictedEvent;
-
-	module_PMoveTouchTriggers = &Intercepted_PMoveTouchTriggers;
-	module_PredictedEvent = &Intercepted_PredictedEvent;
-
 	edict_t *const self = game.edicts + bot->EntNum();
 
 	// The entity state might be modified by Intercepted_PMoveTouchTriggers(), so we have to save it
@@ -986,9 +979,6 @@ void MovementPredictionContext::BuildPlan() {
 	Assert( VectorCompare( self->s.origin, self->ai->botRef->entityPhysicsState->Origin() ) );
 	Assert( VectorCompare( self->velocity, self->ai->botRef->entityPhysicsState->Velocity() ) );
 
-	module_PMoveTouchTriggers = general_PMoveTouchTriggers;
-	module_PredictedEvent = general_PredictedEvent;
-
 	for( auto *movementAction: module->movementActions )
 		movementAction->AfterPlanning();
 
@@ -1067,23 +1057,15 @@ void MovementPredictionContext::NextMovementStep() {
 	// Actions that involve touching trigger entities currently are never predicted ahead.
 	// If an action really needs to test against entities, a corresponding prediction step flag
 	// should be added and this interception of the module_Trace() should be skipped if the flag is set.
-
-	// Save the G_GS_Trace() pointer
-	auto oldModuleTrace = module_Trace;
-	module_Trace = Intercepted_Trace;
-
+	pm.trace = Intercepted_Trace;
 	// Do not test entities contents for same reasons
-	// Save the G_PointContents4D() pointer
-	auto oldModulePointContents = module_PointContents;
-	module_PointContents = Intercepted_PointContents;
+	pm.pointContents = Intercepted_PointContents;
+	// Intercept these calls too as the bot entity should not be affected by the prediction
+	pm.predictedEvent = Intercepted_PredictedEvent;
+	pm.touchTriggers = Intercepted_PMoveTouchTriggers;
 
 	Pmove( &pm );
 
-	// Restore the G_GS_Trace() pointer
-	module_Trace = oldModuleTrace;
-	// Restore the G_PointContents4D() pointer
-	module_PointContents = oldModulePointContents;
-
 	// Update the entity physics state that is going to be used in the next prediction frame
 	entityPhysicsState->UpdateFromPMove( &pm );
 	// Update the entire movement state that is going to be used in the next prediction frame
@@ -3,6 +3,7 @@
 #include "../static_vector.h"
 #include "../ai_local.h"
 #include "../bot.h"
+#include "../ai_precomputed_file_handler.h"
 
 #include "../../../qalgo/Links.h"
 #include "../../../qalgo/md5.h"
@@ -25,6 +26,12 @@ static inline uint16_t ToUint16CheckingRange( int value ) {
 // Static member definition
 AiAasRouteCache *AiAasRouteCache::shared = nullptr;
 AiAasRouteCache *AiAasRouteCache::instancesHead = nullptr;
+bool AiAasRouteCache::isQueriedConcurrently = false;
+AiAasRouteCache::PrecomputedRoutes *AiAasRouteCache::precomputedRoutes = nullptr;
+AiAasRouteCache::PrecomputedRoutes *AiAasRouteCache::pendingRoutes = nullptr;
+int AiAasRouteCache::pendingRoutesFlagsIndex = 0;
+int AiAasRouteCache::pendingRoutesGoalAreaNum = 0;
+char AiAasRouteCache::pendingRoutesFilePath[MAX_QPATH];
 uint64_t AiAasRouteCache::defaultBlockedAreasDigest[2];
 
 // TODO: We can and should eliminate access to this lookup table
@@ -32,7 +39,7 @@ uint64_t AiAasRouteCache::defaultBlockedAreasDigest[2];
 // if AAS file representation is decoupled from the memory one
 static int travelFlagForType[MAX_TRAVELTYPES];
 
-void AiAasRouteCache::Init( const AiAasWorld &aasWorld ) {
+void AiAasRouteCache::Init( const AiAasWorld &aasWorld, const char *mapName ) {
 	constexpr const char *tag = "AiAasRouteCache::Init()";
 	if( shared ) {
 		AI_FailWith( tag, "The shared instance is already present\n" );
@@ -52,6 +59,8 @@ void AiAasRouteCache::Init( const AiAasWorld &aasWorld ) {
 	new( shared )AiAasRouteCache( *AiAasWorld::Instance() );
 
 	instancesHead = shared;
+
+	LoadPrecomputedRoutes( mapName );
 }
 
 void AiAasRouteCache::Shutdown() {
@@ -62,6 +71,8 @@ void AiAasRouteCache::Shutdown() {
 		return;
 	}
 
+	FreePrecomputedRoutes();
+
 	shared->~AiAasRouteCache();
 	G_Free( shared );
 	// Allow the pointer to be reused, otherwise an assertion will fail on a next Init() call
@@ -149,6 +160,7 @@ AiAasRouteCache::~AiAasRouteCache() {
 
 	FreeMemory( areaPathFindingNodes );
 	FreeMemory( portalPathFindingNodes );
+	FreeMemory( clusterExits );
 
 	FreeRefCountedMemory( reachPathFindingData );
 	FreeMemory( areaPathFindingData );
@@ -982,6 +994,8 @@ void *AiAasRouteCache::AllocAreaAndPortalCacheMemory( size_t size ) {
 }
 
 void AiAasRouteCache::FreeAreaAndPortalCacheMemory( void *ptr ) {
+	// Invalidate cache tables saved by bulk routing queries
+	numFreedCaches++;
 	// The chunk stores its owner as a tag
 	AreaAndPortalCacheAllocatorBin::FreeTaggedBlock( ptr );
 }
@@ -1132,6 +1146,7 @@ void AiAasRouteCache::InitPathFindingNodes() {
 
 	areaPathFindingNodes = (PathFinderNode *)GetClearedMemory( maxReachAreas * sizeof( PathFinderNode ) );
 	portalPathFindingNodes = (PathFinderNode *)GetClearedMemory( ( aasWorld.NumPortals() + 1 ) * sizeof( PathFinderNode ) );
+	clusterExits = (ClusterExit *)GetClearedMemory( aasWorld.NumPortals() * sizeof( ClusterExit ) );
 
 	oldestCache = nullptr;
 	newestCache = nullptr;
@@ -1355,6 +1370,10 @@ AiAasRouteCache::FindSiblingCache( int clusterNum, int clusterAreaNum, int trave
 	if( !ai_shareRoutingCache->integer ) {
 		return nullptr;
 	}
+	// Other instances might be modifying their caches right now
+	if( isQueriedConcurrently ) {
+		return nullptr;
+	}
 
 	for( const auto *that = AiAasRouteCache::instancesHead; that; that = that->next ) {
 		// Make sure travel flags of instances match
@@ -1583,6 +1602,37 @@ int AiAasRouteCache::FastestRouteToGoalArea( const int *fromAreaNums, int numFro
 	return bestTravelTime;
 }
 
+inline bool AiAasRouteCache::LookupPrecomputedRoute( int fromAreaNum, int toAreaNum,
+													 int travelFlags, RoutingResult *result ) const {
+	const auto *const routes = precomputedRoutes;
+	if( !routes ) {
+		return false;
+	}
+
+	// The table is valid only for the default blocked areas status
+	if( blockedAreasDigest[0] != defaultBlockedAreasDigest[0] ) {
+		return false;
+	}
+	if( blockedAreasDigest[1] != defaultBlockedAreasDigest[1] ) {
+		return false;
+	}
+
+	int flagsIndex;
+	if( travelFlags == routes->travelFlags[0] ) {
+		flagsIndex = 0;
+	} else if( travelFlags == routes->travelFlags[1] ) {
+		flagsIndex = 1;
+	} else {
+		return false;
+	}
+
+	const int index = toAreaNum * routes->rowSize + routes->areaColumns[fromAreaNum];
+	result->travelTime = routes->travelTimes[flagsIndex][index];
+	result->reachNum = aasWorld.AreaSettings()[fromAreaNum].firstreachablearea;
+	result->reachNum += routes->reachOffsets[flagsIndex][index];
+	return true;
+}
+
 bool AiAasRouteCache::RoutingResultToGoalArea( int fromAreaNum, int toAreaNum,
 											   int travelFlags, RoutingResult *result ) const {
 	if( fromAreaNum == toAreaNum ) {
@@ -1599,6 +1649,10 @@ bool AiAasRouteCache::RoutingResultToGoalArea( int fromAreaNum, int toAreaNum,
 		return false;
 	}
 
+	if( LookupPrecomputedRoute( fromAreaNum, toAreaNum, travelFlags, result ) ) {
+		return result->travelTime != 0;
+	}
+
 	if( aasWorld.AreaDoNotEnter( fromAreaNum ) || aasWorld.AreaDoNotEnter( toAreaNum ) ) {
 		travelFlags |= TFL_DONOTENTER;
 	}
@@ -1757,3 +1811,548 @@ bool AiAasRouteCache::RouteToGoalPortal( const RoutingRequest &request,
 	result->travelTime = bestTime;
 	return true;
 }
+
+int AiAasRouteCache::FindClusterExits( int clusterNum, int travelFlags, ClusterExit *exits ) {
+	const auto *const aasAreaSettings = aasWorld.AreaSettings();
+	const auto *const aasPortalIndex = aasWorld.PortalIndex();
+	const auto *const aasPortals = aasWorld.Portals();
+	const auto *cluster = &aasWorld.Clusters()[clusterNum];
+
+	for( int i = 0; i < cluster->numportals; i++ ) {
+		const auto portalNum = aasPortalIndex[cluster->firstportal + i];
+		const auto portalAreaNum = aasPortals[portalNum].areanum;
+		exits[i].areaCache = GetAreaRoutingCache( aasAreaSettings, aasPortals, clusterNum, portalAreaNum, travelFlags );
+		exits[i].portalNum = portalNum;
+	}
+
+	return cluster->numportals;
+}
+
+bool AiAasRouteCache::BulkRoutingResultToGoalArea( int fromAreaNum, int toAreaNum, int travelFlags,
+												   BulkRoutingState *state, RoutingResult *result ) {
+	if( fromAreaNum == toAreaNum ) {
+		result->travelTime = 1;
+		result->reachNum = 0;
+		return true;
+	}
+
+	if( fromAreaNum <= 0 || fromAreaNum >= aasWorld.NumAreas() ) {
+		return false;
+	}
+
+	if( toAreaNum <= 0 || toAreaNum >= aasWorld.NumAreas() ) {
+		return false;
+	}
+
+	if( LookupPrecomputedRoute( fromAreaNum, toAreaNum, travelFlags, result ) ) {
+		return result->travelTime != 0;
+	}
+
+	if( aasWorld.AreaDoNotEnter( fromAreaNum ) || aasWorld.AreaDoNotEnter( toAreaNum ) ) {
+		travelFlags |= TFL_DONOTENTER;
+	}
+
+	// If some cache memory has been released by other queries since the last request, drop saved tables
+	if( state->numFreedCaches != numFreedCaches ) {
+		*state = BulkRoutingState();
+	}
+
+	// Lookups of missing tables release the least recently used ones, make sure these are not the saved tables
+	TouchBulkRoutingState( state );
+
+	const bool found = BulkRouteToGoalArea( fromAreaNum, toAreaNum, travelFlags, state, result );
+	// Tables released by this request are not the saved ones
+	state->numFreedCaches = numFreedCaches;
+	return found;
+}
+
+void AiAasRouteCache::TouchBulkRoutingState( const BulkRoutingState *state ) {
+	for( int i = 0; i < state->numExits; ++i ) {
+		auto *cache = const_cast<AreaOrPortalCacheTable *>( clusterExits[i].areaCache );
+		UnlinkCache( cache );
+		LinkCache( cache );
+	}
+
+	if( auto *cache = const_cast<AreaOrPortalCacheTable *>( state->portalCache ) ) {
+		UnlinkCache( cache );
+		LinkCache( cache );
+	}
+
+	if( auto *cache = const_cast<AreaOrPortalCacheTable *>( state->areaCache ) ) {
+		UnlinkCache( cache );
+		LinkCache( cache );
+	}
+}
+
+bool AiAasRouteCache::BulkRouteToGoalArea( int fromAreaNum, int toAreaNum, int travelFlags,
+										   BulkRoutingState *state, RoutingResult *result ) {
+	const auto *const aasAreaSettings = aasWorld.AreaSettings();
+	const auto *const aasPortals = aasWorld.Portals();
+
+	auto clusterNum = aasAreaSettings[fromAreaNum].cluster;
+	auto goalClusterNum = aasAreaSettings[toAreaNum].cluster;
+	// Check if the area is a portal of the goal area cluster
+	if( clusterNum < 0 && goalClusterNum > 0 ) {
+		const auto *portal = &aasPortals[-clusterNum];
+		if( portal->frontcluster == goalClusterNum || portal->backcluster == goalClusterNum ) {
+			clusterNum = goalClusterNum;
+		}
+	}
+	// Check if the goalarea is a portal of the area cluster
+	else if( clusterNum > 0 && goalClusterNum < 0 ) {
+		const aas_portal_t *portal = &aasPortals[-goalClusterNum];
+		if( portal->frontcluster == clusterNum || portal->backcluster == clusterNum ) {
+			goalClusterNum = clusterNum;
+		}
+	}
+	// Fix invalid access to cluster 0
+	else if( !clusterNum || !goalClusterNum ) {
+		return false;
+	}
+
+	// If both areas are in the same cluster (see RouteToGoalArea() for remarks)
+	if( clusterNum > 0 && goalClusterNum > 0 && clusterNum == goalClusterNum ) {
+		if( !state->areaCache || state->areaCacheClusterNum != clusterNum ||
+			state->areaCacheGoalAreaNum != toAreaNum || state->areaCacheTravelFlags != travelFlags ) {
+			state->areaCache = GetAreaRoutingCache( aasAreaSettings, aasPortals, clusterNum, toAreaNum, travelFlags );
+			state->areaCacheClusterNum = clusterNum;
+			state->areaCacheGoalAreaNum = toAreaNum;
+			state->areaCacheTravelFlags = travelFlags;
+		}
+		const auto *areaCache = state->areaCache;
+		const auto clusterAreaNum = ClusterAreaNum( aasAreaSettings, aasPortals, clusterNum, fromAreaNum );
+		if( clusterAreaNum >= aasWorld.Clusters()[clusterNum].numreachabilityareas ) {
+			return false;
+		}
+		if( areaCache->travelTimes[clusterAreaNum] != 0 ) {
+			result->reachNum = aasAreaSettings[fromAreaNum].firstreachablearea;
+			result->reachNum += areaCache->reachOffsets[clusterAreaNum];
+			result->travelTime = areaCache->travelTimes[clusterAreaNum];
+			return true;
+		}
+	}
+
+	if( !state->portalCache || state->portalCacheGoalAreaNum != toAreaNum ||
+		state->portalCacheTravelFlags != travelFlags ) {
+		goalClusterNum = aasAreaSettings[toAreaNum].cluster;
+		// If the goal area is a portal, just assume the goal area is part of the front cluster
+		if( goalClusterNum < 0 ) {
+			goalClusterNum = aasPortals[-goalClusterNum].frontcluster;
+		}
+		state->portalCache = GetPortalRoutingCache( aasAreaSettings, aasPortals, goalClusterNum, toAreaNum, travelFlags );
+		state->portalCacheGoalAreaNum = toAreaNum;
+		state->portalCacheTravelFlags = travelFlags;
+	}
+	const auto *portalCache = state->portalCache;
+
+	clusterNum = aasAreaSettings[fromAreaNum].cluster;
+	// If the area is a cluster portal, read directly from the portal cache
+	if( clusterNum < 0 ) {
+		result->travelTime = portalCache->travelTimes[-clusterNum];
+		result->reachNum = aasAreaSettings[fromAreaNum].firstreachablearea;
+		result->reachNum += portalCache->reachOffsets[-clusterNum];
+		return result->travelTime != 0;
+	}
+
+	const auto clusterAreaNum = ClusterAreaNum( aasAreaSettings, aasPortals, clusterNum, fromAreaNum );
+	// If the area is NOT a reachability area
+	if( clusterAreaNum >= aasWorld.Clusters()[clusterNum].numreachabilityareas ) {
+		return false;
+	}
+
+	if( state->exitsClusterNum != clusterNum || state->exitsTravelFlags != travelFlags ) {
+		state->numExits = FindClusterExits( clusterNum, travelFlags, clusterExits );
+		state->exitsClusterNum = clusterNum;
+		state->exitsTravelFlags = travelFlags;
+	}
+
+	int bestTime = 0;
+	int bestReachNum = -1;
+	for( int i = 0; i < state->numExits; ++i ) {
+		const auto portalNum = clusterExits[i].portalNum;
+		// If the goal area isn't reachable from the portal
+		const auto travelTimeFromPortalToGoal = portalCache->travelTimes[portalNum];
+		if( !travelTimeFromPortalToGoal ) {
+			continue;
+		}
+
+		const auto *areaCache = clusterExits[i].areaCache;
+		// If the portal is NOT reachable from this area
+		const auto areaToPortalTravelTime = areaCache->travelTimes[clusterAreaNum];
+		if( !areaToPortalTravelTime ) {
+			continue;
+		}
+
+		// See RouteToGoalPortal() for remarks on adding the largest travel time through the portal area
+		uint16_t t = ToUint16CheckingRange( travelTimeFromPortalToGoal + areaToPortalTravelTime );
+		t = ToUint16CheckingRange( t + portalMaxTravelTimes[portalNum] );
+		if( bestTime && t >= bestTime ) {
+			continue;
+		}
+
+		bestReachNum = aasAreaSettings[fromAreaNum].firstreachablearea + areaCache->reachOffsets[clusterAreaNum];
+		bestTime = t;
+	}
+
+	if( bestReachNum < 0 ) {
+		return false;
+	}
+
+	result->reachNum = bestReachNum;
+	result->travelTime = bestTime;
+	return true;
+}
+
+template <bool Fastest>
+void AiAasRouteCache::BulkRoutesToGoalArea( const int *fromAreaNums, int numFromAreas, int toAreaNum,
+											int *travelTimes, int *reachNums ) const {
+	auto *nonConstThis = const_cast<AiAasRouteCache *>( this );
+
+	for( int i = 0; i < numFromAreas; ++i ) {
+		travelTimes[i] = 0;
+	}
+
+	BulkRoutingState state;
+	state.numFreedCaches = numFreedCaches;
+	// Test all areas for each flag before moving to the next one so goal tables are looked up once per flags
+	for( int j = 0; j < 2; ++j ) {
+		for( int i = 0; i < numFromAreas; ++i ) {
+			// An area has already got a preferred route
+			if( !Fastest && travelTimes[i] ) {
+				continue;
+			}
+
+			RoutingResult result;
+			if( !nonConstThis->BulkRoutingResultToGoalArea( fromAreaNums[i], toAreaNum, travelFlags[j], &state, &result ) ) {
+				continue;
+			}
+
+			if( travelTimes[i] && travelTimes[i] <= result.travelTime ) {
+				continue;
+			}
+
+			travelTimes[i] = result.travelTime;
+			if( reachNums ) {
+				reachNums[i] = result.reachNum;
+			}
+		}
+	}
+}
+
+void AiAasRouteCache::PreferredRoutesToGoalArea( const int *fromAreaNums, int numFromAreas, int toAreaNum,
+												 int *travelTimes, int *reachNums ) const {
+	BulkRoutesToGoalArea<false>( fromAreaNums, numFromAreas, toAreaNum, travelTimes, reachNums );
+}
+
+void AiAasRouteCache::FastestRoutesToGoalArea( const int *fromAreaNums, int numFromAreas, int toAreaNum,
+											   int *travelTimes, int *reachNums ) const {
+	BulkRoutesToGoalArea<true>( fromAreaNums, numFromAreas, toAreaNum, travelTimes, reachNums );
+}
+
+template <bool Fastest>
+void AiAasRouteCache::BulkRoutesFromAreas( const int *fromAreaNums, int numFromAreas, const int *toAreaNums,
+										   int numToAreas, int *travelTimes, int *reachNums ) const {
+	auto *nonConstThis = const_cast<AiAasRouteCache *>( this );
+
+	for( int i = 0; i < numToAreas; ++i ) {
+		travelTimes[i] = 0;
+	}
+
+	// Goal tables differ for every goal, so iterate over goals in the innermost loop
+	// to keep exits of a start area cluster for all goals.
+	// The order of flags and start areas matches the multi-area PreferredRouteToGoalArea() overload.
+	for( int j = 0; j < 2; ++j ) {
+		for( int k = 0; k < numFromAreas; ++k ) {
+			BulkRoutingState state;
+			state.numFreedCaches = numFreedCaches;
+			for( int i = 0; i < numToAreas; ++i ) {
+				// A goal has already got a preferred route
+				if( !Fastest && travelTimes[i] ) {
+					continue;
+				}
+
+				RoutingResult result;
+				if( !nonConstThis->BulkRoutingResultToGoalArea( fromAreaNums[k], toAreaNums[i], travelFlags[j], &state, &result ) ) {
+					continue;
+				}
+
+				if( travelTimes[i] && travelTimes[i] <= result.travelTime ) {
+					continue;
+				}
+
+				travelTimes[i] = result.travelTime;
+				if( reachNums ) {
+					reachNums[i] = result.reachNum;
+				}
+			}
+		}
+	}
+}
+
+void AiAasRouteCache::PreferredRoutesFromAreas( const int *fromAreaNums, int numFromAreas, const int *toAreaNums,
+												int numToAreas, int *travelTimes, int *reachNums ) const {
+	BulkRoutesFromAreas<false>( fromAreaNums, numFromAreas, toAreaNums, numToAreas, travelTimes, reachNums );
+}
+
+void AiAasRouteCache::FastestRoutesFromAreas( const int *fromAreaNums, int numFromAreas, const int *toAreaNums,
+											  int numToAreas, int *travelTimes, int *reachNums ) const {
+	BulkRoutesFromAreas<true>( fromAreaNums, numFromAreas, toAreaNums, numToAreas, travelTimes, reachNums );
+}
+
+static constexpr uint32_t PRECOMPUTED_ROUTES_VERSION = 1339;
+static constexpr const char *PRECOMPUTED_ROUTES_TAG = "AasPrecomputedRoutes";
+static constexpr const char *PRECOMPUTED_ROUTES_EXT = ".routes";
+
+void AiAasRouteCache::LoadPrecomputedRoutes( const char *mapName ) {
+	const auto &aasWorld = shared->aasWorld;
+	if( !aasWorld.IsLoaded() ) {
+		return;
+	}
+
+	// The table size is quadratic in the number of areas.
+	// Also make sure chunk lengths of the file (that are 32-bit) never overflow.
+	const int maxAreas = std::min( ai_precomputedRoutesMaxAreas->integer, 16384 );
+	if( maxAreas <= 0 || aasWorld.NumAreas() > maxAreas ) {
+		return;
+	}
+
+	char strippedNameBuffer[MAX_QPATH];
+	char filePath[MAX_QPATH];
+	const auto strippedMapName = AiAasWorld::StripMapName( mapName, strippedNameBuffer );
+	AiAasWorld::MakeFileName( strippedMapName, PRECOMPUTED_ROUTES_EXT, filePath );
+
+	auto *routes = (PrecomputedRoutes *)G_Malloc( sizeof( PrecomputedRoutes ) );
+	memset( routes, 0, sizeof( PrecomputedRoutes ) );
+	if( ReadPrecomputedRoutes( filePath, routes ) ) {
+		precomputedRoutes = routes;
+		return;
+	}
+
+	// Release data of a partially read table
+	FreeRoutesTable( routes );
+
+	// Computing the table takes a while, so it's built by Frame() calls after the map is loaded
+	routes = (PrecomputedRoutes *)G_Malloc( sizeof( PrecomputedRoutes ) );
+	memset( routes, 0, sizeof( PrecomputedRoutes ) );
+	shared->InitPrecomputedRoutes( routes );
+
+	pendingRoutes = routes;
+	pendingRoutesFlagsIndex = 0;
+	pendingRoutesGoalAreaNum = 1;
+	Q_strncpyz( pendingRoutesFilePath, filePath, sizeof( pendingRoutesFilePath ) );
+	G_Printf( "AAS routes for all pairs of areas are going to be computed in background\n" );
+}
+
+void AiAasRouteCache::Frame() {
+	if( !pendingRoutes ) {
+		return;
+	}
+
+	// The table is valid only for the default blocked areas status
+	if( shared->blockedAreasDigest[0] != defaultBlockedAreasDigest[0] ) {
+		return;
+	}
+	if( shared->blockedAreasDigest[1] != defaultBlockedAreasDigest[1] ) {
+		return;
+	}
+
+	const int64_t deadline = trap_Milliseconds() + std::max( 1, ai_precomputedRoutesFrameTime->integer );
+	if( !shared->ComputePendingRoutes( deadline ) ) {
+		return;
+	}
+
+	WritePrecomputedRoutes( pendingRoutesFilePath, pendingRoutes );
+
+	// Set it only after computations as computations must not use the table
+	precomputedRoutes = pendingRoutes;
+	pendingRoutes = nullptr;
+}
+
+bool AiAasRouteCache::ReadPrecomputedRoutes( const char *filePath, PrecomputedRoutes *routes ) {
+	AiPrecomputedFileReader reader( va( "%sReader", PRECOMPUTED_ROUTES_TAG ), PRECOMPUTED_ROUTES_VERSION );
+	if( reader.BeginReading( filePath ) != AiPrecomputedFileReader::SUCCESS ) {
+		return false;
+	}
+
+	uint8_t *data;
+	uint32_t dataLength;
+	if( !reader.ReadLengthAndData( &data, &dataLength ) ) {
+		return false;
+	}
+
+	// The header contains travel flags, the number of areas and the row size
+	int32_t header[4];
+	const bool isHeaderValid = dataLength == sizeof( header );
+	if( isHeaderValid ) {
+		memcpy( header, data, sizeof( header ) );
+	}
+	G_Free( data );
+
+	// Travel flags are a part of the header so changes of default flags invalidate the table
+	const auto &aasWorld = shared->aasWorld;
+	if( !isHeaderValid || header[0] != DEFAULT_TRAVEL_FLAGS[0] || header[1] != DEFAULT_TRAVEL_FLAGS[1] ) {
+		return false;
+	}
+	if( header[2] != aasWorld.NumAreas() || header[3] <= 0 || header[3] > aasWorld.NumAreas() + 1 ) {
+		return false;
+	}
+
+	routes->travelFlags[0] = header[0];
+	routes->travelFlags[1] = header[1];
+	routes->numAreas = header[2];
+	routes->rowSize = header[3];
+
+	const uint32_t numElems = (uint32_t)routes->numAreas * (uint32_t)routes->rowSize;
+	if( !reader.ReadLengthAndData( &data, &dataLength ) ) {
+		return false;
+	}
+	routes->areaColumns = (uint16_t *)data;
+	if( dataLength != routes->numAreas * sizeof( uint16_t ) ) {
+		return false;
+	}
+
+	for( int i = 0; i < routes->numAreas; ++i ) {
+		if( routes->areaColumns[i] >= routes->rowSize ) {
+			return false;
+		}
+	}
+
+	for( int i = 0; i < 2; ++i ) {
+		if( !reader.ReadLengthAndData( &data, &dataLength ) ) {
+			return false;
+		}
+		routes->travelTimes[i] = (uint16_t *)data;
+		if( dataLength != numElems * sizeof( uint16_t ) ) {
+			return false;
+		}
+
+		if( !reader.ReadLengthAndData( &data, &dataLength ) ) {
+			return false;
+		}
+		routes->reachOffsets[i] = data;
+		if( dataLength != numElems * sizeof( uint8_t ) ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void AiAasRouteCache::WritePrecomputedRoutes( const char *filePath, const PrecomputedRoutes *routes ) {
+	AiPrecomputedFileWriter writer( va( "%sWriter", PRECOMPUTED_ROUTES_TAG ), PRECOMPUTED_ROUTES_VERSION );
+	if( !writer.BeginWriting( filePath ) ) {
+		return;
+	}
+
+	const int32_t header[4] = { routes->travelFlags[0], routes->travelFlags[1], routes->numAreas, routes->rowSize };
+	if( !writer.WriteLengthAndData( (const uint8_t *)header, sizeof( header ) ) ) {
+		return;
+	}
+
+	const uint32_t numElems = (uint32_t)routes->numAreas * (uint32_t)routes->rowSize;
+	if( !writer.WriteLengthAndData( (const uint8_t *)routes->areaColumns, routes->numAreas * sizeof( uint16_t ) ) ) {
+		return;
+	}
+
+	for( int i = 0; i < 2; ++i ) {
+		if( !writer.WriteLengthAndData( (const uint8_t *)routes->travelTimes[i], numElems * sizeof( uint16_t ) ) ) {
+			return;
+		}
+		if( !writer.WriteLengthAndData( routes->reachOffsets[i], numElems * sizeof( uint8_t ) ) ) {
+			return;
+		}
+	}
+}
+
+void AiAasRouteCache::FreeRoutesTable( PrecomputedRoutes *routes ) {
+	if( routes->areaColumns ) {
+		G_Free( routes->areaColumns );
+	}
+	for( int i = 0; i < 2; ++i ) {
+		if( routes->travelTimes[i] ) {
+			G_Free( routes->travelTimes[i] );
+		}
+		if( routes->reachOffsets[i] ) {
+			G_Free( routes->reachOffsets[i] );
+		}
+	}
+
+	G_Free( routes );
+}
+
+void AiAasRouteCache::FreePrecomputedRoutes() {
+	if( precomputedRoutes ) {
+		FreeRoutesTable( precomputedRoutes );
+		precomputedRoutes = nullptr;
+	}
+	if( pendingRoutes ) {
+		FreeRoutesTable( pendingRoutes );
+		pendingRoutes = nullptr;
+	}
+}
+
+void AiAasRouteCache::InitPrecomputedRoutes( PrecomputedRoutes *routes ) {
+	const auto *const aasAreaSettings = aasWorld.AreaSettings();
+	const int numAreas = aasWorld.NumAreas();
+
+	routes->travelFlags[0] = travelFlags[0];
+	routes->travelFlags[1] = travelFlags[1];
+	routes->numAreas = numAreas;
+
+	// Areas that have no reachabilities can't be routed from, do not waste table columns for these areas.
+	// The zero column is reserved for these areas and is kept zero-filled.
+	routes->areaColumns = (uint16_t *)G_Malloc( numAreas * sizeof( uint16_t ) );
+	int rowSize = 1;
+	routes->areaColumns[0] = 0;
+	for( int i = 1; i < numAreas; ++i ) {
+		routes->areaColumns[i] = aasAreaSettings[i].numreachableareas ? ToUint16CheckingRange( rowSize++ ) : 0;
+	}
+	routes->rowSize = rowSize;
+
+	const size_t numElems = (size_t)numAreas * (size_t)rowSize;
+	for( int i = 0; i < 2; ++i ) {
+		routes->travelTimes[i] = (uint16_t *)G_Malloc( numElems * sizeof( uint16_t ) );
+		memset( routes->travelTimes[i], 0, numElems * sizeof( uint16_t ) );
+		routes->reachOffsets[i] = (uint8_t *)G_Malloc( numElems * sizeof( uint8_t ) );
+		memset( routes->reachOffsets[i], 0, numElems * sizeof( uint8_t ) );
+	}
+}
+
+bool AiAasRouteCache::ComputePendingRoutes( int64_t deadline ) {
+	const auto *const aasAreaSettings = aasWorld.AreaSettings();
+	auto *const routes = pendingRoutes;
+	const int numAreas = routes->numAreas;
+	const int rowSize = routes->rowSize;
+
+	for(; pendingRoutesFlagsIndex < 2; ++pendingRoutesFlagsIndex, pendingRoutesGoalAreaNum = 1 ) {
+		const int i = pendingRoutesFlagsIndex;
+		uint16_t *const __restrict travelTimes = routes->travelTimes[i];
+		uint8_t *const __restrict reachOffsets = routes->reachOffsets[i];
+		BulkRoutingState state;
+		state.numFreedCaches = numFreedCaches;
+		// Iterate over goals in the outer loop so goal tables are looked up once per a row
+		for(; pendingRoutesGoalAreaNum < numAreas; ++pendingRoutesGoalAreaNum ) {
+			// Check the time after each row, rows are computed fast enough
+			if( trap_Milliseconds() >= deadline ) {
+				return false;
+			}
+			const int toAreaNum = pendingRoutesGoalAreaNum;
+			const int rowOffset = toAreaNum * rowSize;
+			for( int fromAreaNum = 1; fromAreaNum < numAreas; ++fromAreaNum ) {
+				// Same areas never reach the table lookup
+				if( fromAreaNum == toAreaNum || !routes->areaColumns[fromAreaNum] ) {
+					continue;
+				}
+				RoutingResult result;
+				if( !BulkRoutingResultToGoalArea( fromAreaNum, toAreaNum, travelFlags[i], &state, &result ) ) {
+					continue;
+				}
+				const int index = rowOffset + routes->areaColumns[fromAreaNum];
+				travelTimes[index] = ToUint16CheckingRange( result.travelTime );
+				reachOffsets[index] = (uint8_t)( result.reachNum - aasAreaSettings[fromAreaNum].firstreachablearea );
+			}
+		}
+	}
+
+	return true;
+}
@@ -290,6 +290,26 @@ class AiAasRouteCache {
 
 	int *portalMaxTravelTimes;
 
+	/**
+	 * A portal of a cluster along with a cache of travel times from areas of the cluster to the portal area.
+	 * Bulk routing queries share these entries between all areas of the cluster.
+	 */
+	struct ClusterExit {
+		const AreaOrPortalCacheTable *areaCache;
+		int portalNum;
+	};
+
+	/**
+	 * A buffer for {@code ClusterExit} entries of a single cluster (it has capacity for all portals of the map).
+	 */
+	ClusterExit *clusterExits { nullptr };
+
+	/**
+	 * Gets incremented every time an area or portal cache memory is released.
+	 * Bulk routing queries check it to detect that cache tables they have saved might have been freed.
+	 */
+	unsigned numFreedCaches { 0 };
+
 	// We have to waste 8 bytes for the ref count since blocks should be at least 8-byte aligned
 	inline static const int64_t RefCountOf( const void *chunk ) { return *( ( (int64_t *)chunk ) - 1 ); }
 	inline static int64_t &RefCountOf( void *chunk ) { return *( ( (int64_t *)chunk ) - 1 ); }
@@ -447,6 +467,52 @@ public:
 	bool RouteToGoalArea( const RoutingRequest &request, RoutingResult *result );
 	bool RouteToGoalPortal( const RoutingRequest &request, AreaOrPortalCacheTable *portalCache, RoutingResult *result );
 
+	/**
+	 * Caches lookups that are shared by subsequent routing requests of a bulk query.
+	 * Saved tables are valid only while {@code numFreedCaches} matches the value the state has been captured with.
+	 */
+	struct BulkRoutingState {
+		unsigned numFreedCaches { 0 };
+
+		const AreaOrPortalCacheTable *areaCache { nullptr };
+		int areaCacheClusterNum { 0 };
+		int areaCacheGoalAreaNum { 0 };
+		int areaCacheTravelFlags { 0 };
+
+		const AreaOrPortalCacheTable *portalCache { nullptr };
+		int portalCacheGoalAreaNum { 0 };
+		int portalCacheTravelFlags { 0 };
+
+		int exitsClusterNum { 0 };
+		int exitsTravelFlags { 0 };
+		int numExits { 0 };
+	};
+
+	int FindClusterExits( int clusterNum, int travelFlags, ClusterExit *exits );
+
+	/**
+	 * Marks tables saved in the state as the most recently used ones,
+	 * so looking up other tables during a request can't release them.
+	 */
+	void TouchBulkRoutingState( const BulkRoutingState *state );
+
+	/**
+	 * Does the same as {@code RoutingResultToGoalArea()} but bypasses the results cache
+	 * and reuses cluster and portal lookups saved in the state by previous requests.
+	 */
+	bool BulkRoutingResultToGoalArea( int fromAreaNum, int toAreaNum, int travelFlags,
+									  BulkRoutingState *state, RoutingResult *result );
+
+	bool BulkRouteToGoalArea( int fromAreaNum, int toAreaNum, int travelFlags,
+							  BulkRoutingState *state, RoutingResult *result );
+
+	template <bool Fastest>
+	void BulkRoutesToGoalArea( const int *fromAreaNums, int numFromAreas, int toAreaNum,
+							   int *travelTimes, int *reachNums ) const;
+	template <bool Fastest>
+	void BulkRoutesFromAreas( const int *fromAreaNums, int numFromAreas, const int *toAreaNums,
+							  int numToAreas, int *travelTimes, int *reachNums ) const;
+
 	void InitCompactReachDataAreaDataAndHelpers();
 	AreaPathFindingData *CloneAreaPathFindingData();
 
@@ -468,18 +534,77 @@ public:
 	// Should be used for creation of new instances based on shared one
 	AiAasRouteCache( AiAasRouteCache *parent, const int *newTravelFlags );
 
+	/**
+	 * An optional table of travel times and first reachabilities for all pairs of areas.
+	 * It is built for default travel flags on small and medium maps and is stored in an AAS side file.
+	 * Rows are addressed by goal area numbers, elements of a row are addressed by columns of "from" areas.
+	 */
+	struct PrecomputedRoutes {
+		int travelFlags[2];
+		int numAreas;
+		int rowSize;
+		// A table column of an area, zero (a column of zero travel times) if an area has no reachabilities
+		uint16_t *areaColumns;
+		uint16_t *travelTimes[2];
+		uint8_t *reachOffsets[2];
+	};
+
+	static PrecomputedRoutes *precomputedRoutes;
+
+	/**
+	 * A table that is built by {@code Frame()} calls within a time budget.
+	 * It is not used for lookups until it is complete.
+	 */
+	static PrecomputedRoutes *pendingRoutes;
+	static int pendingRoutesFlagsIndex;
+	static int pendingRoutesGoalAreaNum;
+	static char pendingRoutesFilePath[MAX_QPATH];
+
+	static void LoadPrecomputedRoutes( const char *mapName );
+	static bool ReadPrecomputedRoutes( const char *filePath, PrecomputedRoutes *routes );
+	static void WritePrecomputedRoutes( const char *filePath, const PrecomputedRoutes *routes );
+	static void FreeRoutesTable( PrecomputedRoutes *routes );
+	static void FreePrecomputedRoutes();
+
+	void InitPrecomputedRoutes( PrecomputedRoutes *routes );
+	/**
+	 * Computes rows of the pending table until the deadline is reached.
+	 * @return true if the table is complete.
+	 */
+	bool ComputePendingRoutes( int64_t deadline );
+
+	/**
+	 * Returns true if the precomputed table covers the request (an actual result may be a zero travel time).
+	 */
+	inline bool LookupPrecomputedRoute( int fromAreaNum, int toAreaNum, int travelFlags, RoutingResult *result ) const;
+
 	static AiAasRouteCache *shared;
 	static AiAasRouteCache *instancesHead;
 
+	/**
+	 * Set while instances are queried from multiple threads.
+	 * Caches of other instances are not looked up in this case
+	 * as they might be modified by their owners concurrently.
+	 */
+	static bool isQueriedConcurrently;
+
 	static void InitTravelFlagFromType();
 	static void InitDefaultBlockedAreasDigest( const AiAasWorld &aasWorld );
 public:
 	// AiRoutingCache should be init and shutdown explicitly
 	// (a game library is not unloaded when a map changes)
-	static void Init( const AiAasWorld &aasWorld );
+	static void Init( const AiAasWorld &aasWorld, const char *mapName );
 	static void Shutdown();
+	// Continues building the precomputed routes table if it is pending
+	static void Frame();
 
 	static AiAasRouteCache *Shared() { return shared; }
+
+	/**
+	 * Should be set by a caller that is going to query different instances concurrently.
+	 * Each instance must be still accessed by a single thread at the same time.
+	 */
+	static void SetQueriedConcurrently( bool value ) { isQueriedConcurrently = value; }
 	static AiAasRouteCache *NewInstance( const int *travelFlags_ );
 	static void ReleaseInstance( AiAasRouteCache *instance );
 
@@ -524,6 +649,35 @@ public:
 	 */
 	int FastestRouteToGoalArea( const int *fromAreaNums, int numFromAreas, int toAreaNum, int *reachNum ) const;
 
+	/**
+	 * A bulk version of {@code PreferredRouteToGoalArea()} for many "from" areas and a single goal area.
+	 * Writes a travel time (zero if the goal is not reachable) for every "from" area to {@code travelTimes}
+	 * and a reachability to {@code reachNums} if the latter is specified.
+	 * Unlike single-area calls this bypasses the results cache
+	 * and looks up goal routing tables once for all "from" areas.
+	 */
+	void PreferredRoutesToGoalArea( const int *fromAreaNums, int numFromAreas, int toAreaNum,
+									int *travelTimes, int *reachNums = nullptr ) const;
+	/**
+	 * A bulk version of {@code FastestRouteToGoalArea()}, see {@code PreferredRoutesToGoalArea()}.
+	 */
+	void FastestRoutesToGoalArea( const int *fromAreaNums, int numFromAreas, int toAreaNum,
+								  int *travelTimes, int *reachNums = nullptr ) const;
+	/**
+	 * A bulk version of {@code PreferredRouteToGoalArea()} for a set of start areas of a single origin
+	 * (as the multi-area overload treats them) and many goal areas.
+	 * Writes a travel time (zero if a goal is not reachable) for every goal area to {@code travelTimes}
+	 * and a first reachability to {@code reachNums} if the latter is specified.
+	 * Portals of start area clusters are looked up once for all goal areas.
+	 */
+	void PreferredRoutesFromAreas( const int *fromAreaNums, int numFromAreas, const int *toAreaNums,
+								   int numToAreas, int *travelTimes, int *reachNums = nullptr ) const;
+	/**
+	 * A bulk version of {@code FastestRouteToGoalArea()}, see {@code PreferredRoutesFromAreas()}.
+	 */
+	void FastestRoutesFromAreas( const int *fromAreaNums, int numFromAreas, const int *toAreaNums,
+								 int numToAreas, int *travelTimes, int *reachNums = nullptr ) const;
+
 	// It's better to add separate prototypes than set out pointers to null by default and use branching on every call.
 	// We could also set these parameters to an address of some static variable, but it could lead to extra cache misses
 	// since all these variables are likely to be scattered in memory.
@@ -542,6 +696,8 @@ public:
 		return FastestRouteToGoalArea( fromAreaNums, numFromAreas, toAreaNum, dummyIntPtr );
 	}
 
+	const uint64_t *BlockedAreasDigest() const { return blockedAreasDigest; }
+
 	inline bool AreaDisabled( int areaNum ) const {
 		return areaPathFindingData[areaNum].disabledStatus.CurrStatus();
 	}
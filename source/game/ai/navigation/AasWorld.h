@@ -298,9 +298,6 @@ class AiAasWorld
 	// Builds lists of specific area types
 	void BuildSpecificAreaTypesLists();
 
-	static const ArrayRange<char> StripMapName( const char *rawMapName, char buffer[MAX_QPATH] );
-	static const char *MakeFileName( const ArrayRange<char> &strippedName, const char *extension, char buffer[MAX_QPATH] );
-
 	void LoadAreaVisibility( const ArrayRange<char> &strippedMapName );
 	void ComputeAreasVisibility( uint32_t *offsetsDataSize, uint32_t *listsDataSize );
 
@@ -335,6 +332,10 @@ public:
 	inline bool IsLoaded() const { return loaded; }
 	inline const char *Checksum() const { return loaded ? (const char *)checksum : ""; }
 
+	// Helpers for making paths of AAS side files (precomputed data for a map)
+	static const ArrayRange<char> StripMapName( const char *rawMapName, char buffer[MAX_QPATH] );
+	static const char *MakeFileName( const ArrayRange<char> &strippedName, const char *extension, char buffer[MAX_QPATH] );
+
 	void Frame();
 
 	inline int TraceAreas( const Vec3 &start, const Vec3 &end, int *areas_, int maxareas ) const {
@@ -213,8 +213,93 @@ struct NavEntityAndWeight {
 	inline bool operator<( const NavEntityAndWeight &that ) const { return weight > that.weight; }
 };
 
+void BotItemsSelector::PrepareSelection() {
+	const auto *const botTeam = AiBaseTeam::GetTeamForNum( game.edicts[bot->EntNum()].s.team );
+	// Weights provided by a team are computed using a team state that is not safe to access concurrently
+	hasPreparedWeights = !botTeam->OverridesEntityWeights( bot );
+	if( hasPreparedWeights ) {
+		UpdateInternalItemAndGoalWeights();
+	}
+
+	numPreparedFromAreas = bot->EntityPhysicsState()->PrepareRoutingStartAreas( preparedFromAreaNums );
+
+	const auto *routeCache = bot->RouteCache();
+	const uint64_t *blockedAreasDigest = routeCache->BlockedAreasDigest();
+	preparedBlockedAreasDigest[0] = blockedAreasDigest[0];
+	preparedBlockedAreasDigest[1] = blockedAreasDigest[1];
+
+	int toAreaNums[MAX_NAVENTS];
+	int navEntityIds[MAX_NAVENTS];
+	int travelTimes[MAX_NAVENTS];
+	int numNavEntities = 0;
+	auto *navEntitiesRegistry = NavEntitiesRegistry::Instance();
+	for( const NavEntity *navEnt = navEntitiesRegistry->Head(); navEnt; navEnt = navEnt->Next() ) {
+		if( navEnt->IsDisabled() ) {
+			continue;
+		}
+		toAreaNums[numNavEntities] = navEnt->AasAreaNum();
+		navEntityIds[numNavEntities] = navEnt->Id();
+		if( ++numNavEntities == MAX_NAVENTS ) {
+			break;
+		}
+	}
+
+	routeCache->PreferredRoutesFromAreas( preparedFromAreaNums, numPreparedFromAreas,
+										  toAreaNums, numNavEntities, travelTimes );
+
+	// Mark travel times of all other entities as unknown
+	memset( preparedTravelTimes, -1, sizeof( preparedTravelTimes ) );
+	for( int i = 0; i < numNavEntities; ++i ) {
+		preparedTravelTimes[navEntityIds[i]] = travelTimes[i];
+		preparedGoalAreaNums[navEntityIds[i]] = toAreaNums[i];
+	}
+
+	preparedAtFrame = level.framenum;
+}
+
+bool BotItemsSelector::HasPreparedWeights() const {
+	if( !hasPreparedWeights || preparedAtFrame != level.framenum ) {
+		return false;
+	}
+	// Check whether a team has started overriding weights after the preparation
+	return !AiBaseTeam::GetTeamForNum( game.edicts[bot->EntNum()].s.team )->OverridesEntityWeights( bot );
+}
+
+bool BotItemsSelector::HasPreparedTravelTimes( const int *fromAreaNums, int numFromAreas ) const {
+	if( preparedAtFrame != level.framenum || numFromAreas != numPreparedFromAreas ) {
+		return false;
+	}
+	for( int i = 0; i < numFromAreas; ++i ) {
+		if( fromAreaNums[i] != preparedFromAreaNums[i] ) {
+			return false;
+		}
+	}
+	// Check whether blocked areas of the route cache have been changed since the preparation
+	const uint64_t *blockedAreasDigest = bot->RouteCache()->BlockedAreasDigest();
+	if( blockedAreasDigest[0] != preparedBlockedAreasDigest[0] ) {
+		return false;
+	}
+	return blockedAreasDigest[1] == preparedBlockedAreasDigest[1];
+}
+
+int BotItemsSelector::TravelTimeToNavEntity( const NavEntity *navEntity,
+											 const int *fromAreaNums,
+											 int numFromAreas ) const {
+	const int areaNum = navEntity->AasAreaNum();
+	if( HasPreparedTravelTimes( fromAreaNums, numFromAreas ) ) {
+		const int travelTime = preparedTravelTimes[navEntity->Id()];
+		if( travelTime >= 0 && preparedGoalAreaNums[navEntity->Id()] == areaNum ) {
+			return travelTime;
+		}
+	}
+	return bot->RouteCache()->PreferredRouteToGoalArea( fromAreaNums, numFromAreas, areaNum );
+}
+
 SelectedNavEntity BotItemsSelector::SuggestGoalNavEntity( const SelectedNavEntity &currSelectedNavEntity ) {
-	UpdateInternalItemAndGoalWeights();
+	// Weights might have been already computed this frame by PrepareSelection()
+	if( !HasPreparedWeights() ) {
+		UpdateInternalItemAndGoalWeights();
+	}
 
 	StaticVector<NavEntityAndWeight, MAX_NAVENTS> rawWeightCandidates;
 	const auto levelTime = level.time;
@@ -281,10 +366,9 @@ SelectedNavEntity BotItemsSelector::SuggestGoalNavEntity( const SelectedNavEntit
 	auto rawCandidatesIter = rawWeightCandidates.begin();
 	const auto rawCandidatesEnd = rawWeightCandidates.end();
 	const NavEntity *rawBestNavEnt = ( *rawCandidatesIter ).goal;
-	int rawBestAreaNum = rawBestNavEnt->AasAreaNum();
 	unsigned botToBestRawEntMoveDuration = 0;
 	for(;; ) {
-		botToBestRawEntMoveDuration = 10U * routeCache->PreferredRouteToGoalArea( fromAreaNums, numFromAreas, rawBestAreaNum );
+		botToBestRawEntMoveDuration = 10U * TravelTimeToNavEntity( rawBestNavEnt, fromAreaNums, numFromAreas );
 		if( botToBestRawEntMoveDuration ) {
 			break;
 		}
@@ -294,7 +378,6 @@ SelectedNavEntity BotItemsSelector::SuggestGoalNavEntity( const SelectedNavEntit
 			return SelectEmpty();
 		}
 		rawBestNavEnt = ( *rawCandidatesIter ).goal;
-		rawBestAreaNum = rawBestNavEnt->AasAreaNum();
 	}
 
 	// Try checking whether the bot is in some floor cluster to give a greater weight for items in the same cluster
@@ -322,7 +405,7 @@ SelectedNavEntity BotItemsSelector::SuggestGoalNavEntity( const SelectedNavEntit
 		float weight = ( *rawCandidatesIter ).weight;
 
 		const unsigned botToCandidateMoveDuration =
-			routeCache->PreferredRouteToGoalArea( fromAreaNums, numFromAreas, navEnt->AasAreaNum() ) * 10U;
+			TravelTimeToNavEntity( navEnt, fromAreaNums, numFromAreas ) * 10U;
 
 		// AAS functions return 0 as a "none" value, 1 as a lowest feasible value
 		if( !botToCandidateMoveDuration ) {
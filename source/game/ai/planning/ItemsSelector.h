@@ -73,6 +73,21 @@ class BotItemsSelector {
 	// For each item contains a goal weight that would a corresponding AI pickup goal have.
 	float internalPickupGoalWeights[MAX_EDICTS];
 
+	// Travel times (in AAS units) to nav entities computed by PrepareSelection() addressed by a nav entity id
+	int preparedTravelTimes[MAX_EDICTS];
+	// Goal areas of nav entities at the moment of preparation (nav entities might be movable)
+	int preparedGoalAreaNums[MAX_EDICTS];
+	int preparedFromAreaNums[2] { 0, 0 };
+	int numPreparedFromAreas { 0 };
+	uint64_t preparedBlockedAreasDigest[2] { 0, 0 };
+	int64_t preparedAtFrame { -1 };
+	bool hasPreparedWeights { false };
+
+	bool HasPreparedWeights() const;
+	bool HasPreparedTravelTimes( const int *fromAreaNums, int numFromAreas ) const;
+
+	int TravelTimeToNavEntity( const NavEntity *navEntity, const int *fromAreaNums, int numFromAreas ) const;
+
 	float GetEntityWeight( int entNum ) const {
 		float overriddenEntityWeight = overriddenEntityWeights[entNum];
 		if( overriddenEntityWeight != 0 ) {
@@ -146,6 +161,14 @@ public:
 		return navTarget && navTarget->IsTopTierItem( overriddenEntityWeights );
 	}
 
+	/**
+	 * Computes internal item weights and travel times to all nav entities ahead of a think frame.
+	 * This is a read-only (in regard to the world) operation that is allowed to be executed
+	 * concurrently for different bots. Results are used by {@code SuggestGoalNavEntity()}
+	 * if it is called during the same frame and the bot has not changed its routing start areas.
+	 */
+	void PrepareSelection();
+
 	SelectedNavEntity SuggestGoalNavEntity( const SelectedNavEntity &currSelectedNavEntity );
 };
 
@@ -114,6 +114,10 @@ public:
 		itemsSelector.OverrideEntityWeight( ent, weight );
 	}
 
+	void PrepareGoalNavEntitySelection() {
+		itemsSelector.PrepareSelection();
+	}
+
 	SelectedNavEntity SuggestGoalNavEntity( const SelectedNavEntity &currSelectedNavEntity ) {
 		return itemsSelector.SuggestGoalNavEntity( currSelectedNavEntity );
 	}
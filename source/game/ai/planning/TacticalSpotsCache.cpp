@@ -360,15 +360,18 @@ void BotTacticalSpotsCache::FindReachableClassEntities( const Vec3 &origin, floa
 		numFromAreas = fromAreaNums[0] ? 1 : 0;
 	}
 
-	for( EntAndScore &candidate: candidateEntities ) {
-		const edict_t *ent = gameEdicts + candidate.entNum;
+	int toAreaNums[ReachableEntities::capacity()];
+	int travelTimes[ReachableEntities::capacity()];
+	for( unsigned i = 0; i < candidateEntities.size(); ++i ) {
+		toAreaNums[i] = FindMostFeasibleEntityAasArea( gameEdicts + candidateEntities[i].entNum, aasWorld );
+	}
 
-		const int toAreaNum = FindMostFeasibleEntityAasArea( ent, aasWorld );
-		if( !toAreaNum ) {
-			continue;
-		}
+	// Zero area nums just yield zero travel times
+	routeCache->PreferredRoutesFromAreas( fromAreaNums, numFromAreas, toAreaNums, (int)candidateEntities.size(), travelTimes );
 
-		const int travelTime = routeCache->PreferredRouteToGoalArea( fromAreaNums, numFromAreas, toAreaNum );
+	for( unsigned i = 0; i < candidateEntities.size(); ++i ) {
+		const EntAndScore &candidate = candidateEntities[i];
+		const int travelTime = travelTimes[i];
 		if( !travelTime ) {
 			continue;
 		}
@@ -104,10 +104,13 @@ int ClientToClientTable::FindTravelTime( int fromEntNum, int toEntNum ) const {
 		numToAreas = FindEntityAreas( toEnt, toAreaNums );
 	}
 
+	int travelTimes[2];
+	routeCache->PreferredRoutesFromAreas( fromAreaNums, numFromAreas, toAreaNums, numToAreas, travelTimes );
+
 	// AAS routines return 0 on failure (1 is the minimal feasible travel time)
 	int bestTravelTime = 0;
 	for( int i = 0; i < numToAreas; ++i ) {
-		if( const int travelTime = routeCache->PreferredRouteToGoalArea( fromAreaNums, numFromAreas, toAreaNums[i] ) ) {
+		if( const int travelTime = travelTimes[i] ) {
 			if( bestTravelTime && travelTime > bestTravelTime ) {
 				continue;
 			}
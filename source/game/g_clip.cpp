@@ -19,6 +19,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 #include "g_local.h"
 
+#include <atomic>
+
 //
 // g_clip.c - entity contact detection. (high level object sorting to reduce interaction tests)
 //
@@ -49,178 +51,418 @@ typedef struct
 	vec3_t mins;
 	vec3_t maxs;
 	vec3_t size;
-	int marknumber;
-
-	// since the areagrid can have multiple references to one entity,
-	// we should avoid extensive checking on entities already encountered
-	int entmarknumber[MAX_EDICTS];
 } areagrid_t;
 
 static areagrid_t g_areagrid;
 
+#define AABBTREE_NULLNODE   -1
+#define AABBTREE_MAXNODES   ( 2 * MAX_EDICTS )
+#define AABBTREE_MARGIN     16.0f   // leaf boxes are fattened by this value so small moves do not require reinsertion
+
+typedef struct
+{
+	vec3_t mins;
+	vec3_t maxs;
+	int parent;                     // next free node for nodes in the free list
+	int child1, child2;
+	int height;                     // zero for leafs, negative for free nodes
+	int entNum;
+} aabbnode_t;
+
+// An incremental dynamic AABB tree that is an alternative to the area grid.
+// Unlike the grid it does not suffer from large entities and long traces
+// and is able to test a swept box directly instead of its bounds.
+typedef struct
+{
+	aabbnode_t nodes[AABBTREE_MAXNODES];
+	int root;
+	int freelist;
+	int leafs[MAX_EDICTS];          // a leaf for each entity, it is kept while the entity is unlinked
+} aabbtree_t;
+
+static aabbtree_t g_aabbtree;
+static bool g_useAABBTree;
+
 extern cvar_t *g_antilag;
+extern cvar_t *g_clip_aabbtree;
 extern cvar_t *g_antilag_maxtimedelta;
 
-#define CFRAME_UPDATE_BACKUP    64  // copies of entity_state_t to keep buffered (1 second of backup at 62 fps).
+#define CFRAME_UPDATE_BACKUP    64  // number of backed up frames to keep buffered (1 second of backup at 62 fps).
 #define CFRAME_UPDATE_MASK  ( CFRAME_UPDATE_BACKUP - 1 )
 
+#define CFRAME_MAX_RECORDS  ( CFRAME_UPDATE_BACKUP * 256 )  // size of the shared ring of backed up entities, must be a power of two
+#define CFRAME_RECORDS_MASK ( CFRAME_MAX_RECORDS - 1 )
+
 typedef struct c4clipedict_s {
 	entity_state_t s;
 	entity_shared_t r;
 } c4clipedict_t;
 
-//backups of all server frames areas and edicts
+// Scratch state of collision queries.
+// Queries that use different contexts may be executed concurrently
+// as long as no entities are linked, unlinked or backed up meanwhile.
+struct gclipcontext_s {
+	// clip entities for delta time are returned from a ring to prevent overwritings
+	c4clipedict_t clipEnts[8];
+	int clipEntIndex;
+
+	// since the areagrid can have multiple references to one entity,
+	// we should avoid extensive checking on entities already encountered
+	int marknumber;
+	int entmarknumber[MAX_EDICTS];
+
+	int touchlist[MAX_EDICTS];
+
+	// aabb tree traversal stack
+	int nodestack[AABBTREE_MAXNODES];
+
+	// contexts of threads are linked for being freed on shutdown
+	struct gclipcontext_s *nextThreadContext;
+};
+
+static thread_local gclipcontext_t *gclip_threadContext;
+static thread_local int gclip_threadContextGeneration;
+
+// Contexts of all threads, they are released by GClip_FreeThreadContexts() before the game memory gets freed.
+// Threads that have a context of an older generation drop their (freed) one and allocate a new one.
+static std::atomic<gclipcontext_t *> gclip_threadContexts;
+static std::atomic_int gclip_threadContextsGeneration;
+
+// Backups of clipping-relevant fields of solid entities.
+// Records of all frames share a single ring stored as structure-of-arrays,
+// so a backup touches only a few contiguous arrays instead of a full copy of every edict.
+typedef struct c4records_s {
+	vec3_t origin[CFRAME_MAX_RECORDS];
+	vec3_t angles[CFRAME_MAX_RECORDS];
+	vec3_t mins[CFRAME_MAX_RECORDS];
+	vec3_t maxs[CFRAME_MAX_RECORDS];
+	vec3_t absmin[CFRAME_MAX_RECORDS];
+	vec3_t absmax[CFRAME_MAX_RECORDS];
+	unsigned int svflags[CFRAME_MAX_RECORDS];
+	int modelindex[CFRAME_MAX_RECORDS];
+	edict_t *owner[CFRAME_MAX_RECORDS];
+} c4records_t;
+
 typedef struct c4frame_s {
-	c4clipedict_t clipEdicts[MAX_EDICTS];   // fixme: there is a g_maxentities cvar. We have to adjust to it
-	int numedicts;
+	int64_t firstRecord;                    // a monotonic number of the first frame record in the ring
+	int numRecords;
+	short recordOffsets[MAX_EDICTS];        // entity number -> offset from firstRecord, -1 if the entity has not been backed up
 
 	int64_t timestamp;
 	int64_t framenum;
+
+	float moveToNext;                       // the largest move of bounds of a backed up entity until the next frame
 } c4frame_t;
 
-c4frame_t sv_collisionframes[CFRAME_UPDATE_BACKUP];
+static c4records_t sv_collisionrecords;
+static int64_t sv_collisionNumRecords = 0;
+
+static c4frame_t sv_collisionframes[CFRAME_UPDATE_BACKUP];
 static int64_t sv_collisionFrameNum = 0;
+// the oldest frame which records have not been overwritten yet
+static int64_t sv_collisionOldestFrameNum = 0;
+
+// the first frame of the sequence of frames an entity has been backed up with the same solid value in, -1 if none
+static int64_t sv_collisionEntSinceFrameNum[MAX_EDICTS];
+// solid value of an entity in the last backed up frame, -1 if the entity has not been backed up there
+static int sv_collisionEntSolid[MAX_EDICTS];
+// the largest move of bounds of an entity backed up in the last frame since that frame
+static float sv_collisionMoveSinceBackup = 0;
+
+/*
+* GClip_IsBackedUpEntity
+*/
+static inline bool GClip_IsBackedUpEntity( const edict_t *ent, int entNum ) {
+	if( !ent->r.inuse || ent->r.solid == SOLID_NOT ) {
+		return false;
+	}
+	return ent->r.solid != SOLID_TRIGGER || ( entNum >= 1 && entNum <= gs.maxclients );
+}
 
 void GClip_BackUpCollisionFrame( void ) {
 	c4frame_t *cframe;
+	c4records_t *records = &sv_collisionrecords;
 	edict_t *svedict;
-	int i;
+	int i, numRecords;
+	int64_t minFrameNum;
 
 	if( !g_antilag->integer ) {
 		return;
 	}
 
+	// clip edicts for delta time might be requested concurrently, so fix the value here
+	if( g_antilag_maxtimedelta->integer < 0 ) {
+		trap_Cvar_SetValue( "g_antilag_maxtimedelta", abs( g_antilag_maxtimedelta->integer ) );
+	}
+
 	// fixme: should check for any validation here?
 
+	if( sv_collisionFrameNum > 0 ) {
+		sv_collisionframes[( sv_collisionFrameNum - 1 ) & CFRAME_UPDATE_MASK].moveToNext = sv_collisionMoveSinceBackup;
+	}
+	sv_collisionMoveSinceBackup = 0;
+
 	cframe = &sv_collisionframes[sv_collisionFrameNum & CFRAME_UPDATE_MASK];
 	cframe->timestamp = game.serverTime;
 	cframe->framenum = sv_collisionFrameNum;
-	sv_collisionFrameNum++;
-
-	//memset( cframe->clipEdicts, 0, sizeof(cframe->clipEdicts) );
+	cframe->firstRecord = sv_collisionNumRecords;
+	cframe->moveToNext = 0;
 
 	//backup edicts
+	numRecords = 0;
 	for( i = 0; i < game.numentities; i++ ) {
 		svedict = &game.edicts[i];
 
-		cframe->clipEdicts[i].r.inuse = svedict->r.inuse;
-		cframe->clipEdicts[i].r.solid = svedict->r.solid;
-		if( !svedict->r.inuse || svedict->r.solid == SOLID_NOT
-			|| ( svedict->r.solid == SOLID_TRIGGER && !( i >= 1 && i <= gs.maxclients ) ) ) {
+		if( !GClip_IsBackedUpEntity( svedict, i ) ) {
+			cframe->recordOffsets[i] = -1;
+			sv_collisionEntSinceFrameNum[i] = -1;
+			sv_collisionEntSolid[i] = -1;
 			continue;
 		}
 
-		cframe->clipEdicts[i].r = svedict->r;
-		cframe->clipEdicts[i].s = svedict->s;
+		// if solid has changed, we can't step back past this frame
+		if( sv_collisionEntSolid[i] != (int)svedict->r.solid || sv_collisionEntSinceFrameNum[i] < 0 ) {
+			sv_collisionEntSinceFrameNum[i] = sv_collisionFrameNum;
+			sv_collisionEntSolid[i] = svedict->r.solid;
+		}
+
+		const int64_t record = ( sv_collisionNumRecords + numRecords ) & CFRAME_RECORDS_MASK;
+		VectorCopy( svedict->s.origin, records->origin[record] );
+		VectorCopy( svedict->s.angles, records->angles[record] );
+		VectorCopy( svedict->r.mins, records->mins[record] );
+		VectorCopy( svedict->r.maxs, records->maxs[record] );
+		VectorCopy( svedict->r.absmin, records->absmin[record] );
+		VectorCopy( svedict->r.absmax, records->absmax[record] );
+		records->svflags[record] = svedict->r.svflags;
+		records->modelindex[record] = svedict->s.modelindex;
+		records->owner[record] = svedict->r.owner;
+
+		cframe->recordOffsets[i] = (short)numRecords;
+		numRecords++;
+	}
+	for( ; i < MAX_EDICTS; i++ ) {
+		sv_collisionEntSinceFrameNum[i] = -1;
+		sv_collisionEntSolid[i] = -1;
+	}
+
+	cframe->numRecords = numRecords;
+	sv_collisionNumRecords += numRecords;
+	sv_collisionFrameNum++;
+
+	// forget frames that are out of the frames ring or which records have been overwritten
+	minFrameNum = sv_collisionFrameNum - CFRAME_UPDATE_BACKUP;
+	if( sv_collisionOldestFrameNum < minFrameNum ) {
+		sv_collisionOldestFrameNum = minFrameNum;
+	}
+	while( sv_collisionOldestFrameNum < sv_collisionFrameNum ) {
+		const c4frame_t *oldest = &sv_collisionframes[sv_collisionOldestFrameNum & CFRAME_UPDATE_MASK];
+		if( sv_collisionNumRecords - oldest->firstRecord <= CFRAME_MAX_RECORDS ) {
+			break;
+		}
+		sv_collisionOldestFrameNum++;
 	}
-	cframe->numedicts = game.numentities;
 }
 
-static c4clipedict_t *GClip_GetClipEdictForDeltaTime( int entNum, int deltaTime ) {
-	static int index = 0;
-	static c4clipedict_t clipEnts[8];
-	static c4clipedict_t *clipent;
-	static c4clipedict_t clipentNewer; // for interpolation
-	c4frame_t *cframe = NULL;
-	int64_t backTime, cframenum;
-	unsigned bf, i;
-	edict_t *ent = game.edicts + entNum;
+/*
+* GClip_GetBackedUpRecord
+*/
+static inline int64_t GClip_GetBackedUpRecord( const c4frame_t *cframe, int entNum ) {
+	assert( cframe->recordOffsets[entNum] >= 0 );
+	return ( cframe->firstRecord + cframe->recordOffsets[entNum] ) & CFRAME_RECORDS_MASK;
+}
 
-	// pick one of the 8 slots to prevent overwritings
-	clipent = &clipEnts[index];
-	index = ( index + 1 ) & 7;
+/*
+* GClip_UpdateMoveSinceBackup
+*
+* Tracks how far bounds of entities get from the last backed up ones,
+* the aabb tree uses it for finding entities moved out of their leafs since.
+*/
+static void GClip_UpdateMoveSinceBackup( const edict_t *ent ) {
+	const c4frame_t *cframe;
+	const int entNum = ENTNUM( ent );
+	int64_t record;
+	float move;
+	int i;
 
-	if( !entNum || deltaTime >= 0 || !g_antilag->integer ) { // current time entity
-		clipent->r = ent->r;
-		clipent->s = ent->s;
-		return clipent;
+	// not backed up in the last frame, so it can't be stepped back in time
+	if( !g_antilag->integer || sv_collisionEntSinceFrameNum[entNum] < 0 ) {
+		return;
 	}
 
-	if( !ent->r.inuse || ent->r.solid == SOLID_NOT
-		|| ( ent->r.solid == SOLID_TRIGGER && !( entNum >= 1 && entNum <= gs.maxclients ) ) ) {
-		clipent->r = ent->r;
-		clipent->s = ent->s;
-		return clipent;
+	cframe = &sv_collisionframes[( sv_collisionFrameNum - 1 ) & CFRAME_UPDATE_MASK];
+	record = GClip_GetBackedUpRecord( cframe, entNum );
+
+	move = sv_collisionMoveSinceBackup;
+	for( i = 0; i < 3; i++ ) {
+		move = std::max( move, fabsf( ent->r.absmin[i] - sv_collisionrecords.absmin[record][i] ) );
+		move = std::max( move, fabsf( ent->r.absmax[i] - sv_collisionrecords.absmax[record][i] ) );
 	}
+	sv_collisionMoveSinceBackup = move;
+}
+
+/*
+* GClip_GetBackTimestamp
+*/
+static int64_t GClip_GetBackTimestamp( int deltaTime ) {
+	int64_t backTime;
 
 	// clamp delta time inside the backed up limits
 	backTime = abs( deltaTime );
 	if( g_antilag_maxtimedelta->integer ) {
-		if( g_antilag_maxtimedelta->integer < 0 ) {
-			trap_Cvar_SetValue( "g_antilag_maxtimedelta", abs( g_antilag_maxtimedelta->integer ) );
-		}
-		if( backTime > (int64_t)g_antilag_maxtimedelta->integer ) {
-			backTime = (int64_t)g_antilag_maxtimedelta->integer;
+		// the cvar value is fixed in GClip_BackUpCollisionFrame()
+		const int64_t maxTimeDelta = abs( g_antilag_maxtimedelta->integer );
+		if( backTime > maxTimeDelta ) {
+			backTime = maxTimeDelta;
 		}
 	}
 
-	// find the first snap with timestamp < than realtime - backtime
-	cframenum = sv_collisionFrameNum;
-	for( bf = 1; bf < CFRAME_UPDATE_BACKUP && bf < sv_collisionFrameNum; bf++ ) { // never overpass limits
-		cframe = &sv_collisionframes[( cframenum - bf ) & CFRAME_UPDATE_MASK];
+	return game.serverTime - backTime;
+}
 
-		// if solid has changed, we can't keep moving backwards
-		if( ent->r.solid != cframe->clipEdicts[entNum].r.solid
-			|| ent->r.inuse != cframe->clipEdicts[entNum].r.inuse ) {
-			bf--;
-			if( bf == 0 ) {
-				// we can't step back from first
-				cframe = NULL;
-			} else {
-				cframe = &sv_collisionframes[( cframenum - bf ) & CFRAME_UPDATE_MASK];
-			}
-			break;
-		}
+/*
+* GClip_GetMoveForDeltaTime
+*
+* Returns how far bounds of entities for the delta time may be off the current ones.
+*/
+static float GClip_GetMoveForDeltaTime( int deltaTime ) {
+	int64_t backTimestamp, frameNum;
+	float move;
+
+	if( deltaTime >= 0 || !g_antilag->integer ) {
+		return 0;
+	}
 
-		if( game.serverTime >= cframe->timestamp + backTime ) {
+	// sum moves back to the frame GClip_GetClipEdictForDeltaTime() would step back to at most,
+	// interpolated bounds stay within the ones of the frame and the newer one
+	backTimestamp = GClip_GetBackTimestamp( deltaTime );
+	move = sv_collisionMoveSinceBackup;
+	for( frameNum = sv_collisionFrameNum - 1; frameNum > sv_collisionOldestFrameNum; frameNum-- ) {
+		if( sv_collisionframes[frameNum & CFRAME_UPDATE_MASK].timestamp <= backTimestamp ) {
 			break;
 		}
+		move += sv_collisionframes[( frameNum - 1 ) & CFRAME_UPDATE_MASK].moveToNext;
 	}
 
-	if( !cframe ) {
-		// current time entity
-		clipent->r = ent->r;
-		clipent->s = ent->s;
+	return move;
+}
+
+/*
+* GClip_CopyBackedUpRecord
+*/
+static void GClip_CopyBackedUpRecord( c4clipedict_t *clipent, int64_t record ) {
+	const c4records_t *records = &sv_collisionrecords;
+
+	VectorCopy( records->origin[record], clipent->s.origin );
+	VectorCopy( records->angles[record], clipent->s.angles );
+	VectorCopy( records->mins[record], clipent->r.mins );
+	VectorCopy( records->maxs[record], clipent->r.maxs );
+	VectorCopy( records->absmin[record], clipent->r.absmin );
+	VectorCopy( records->absmax[record], clipent->r.absmax );
+	clipent->r.svflags = records->svflags[record];
+	clipent->s.modelindex = records->modelindex[record];
+	clipent->r.owner = records->owner[record];
+}
+
+/*
+* GClip_GetClipEdictForDeltaTime
+*/
+static c4clipedict_t *GClip_GetClipEdictForDeltaTime( gclipcontext_t *ctx, int entNum, int deltaTime ) {
+	c4clipedict_t *clipent;
+	const c4frame_t *cframe;
+	int64_t backTimestamp, record;
+	int64_t minFrameNum, maxFrameNum, lo, hi, mid;
+	unsigned i;
+	edict_t *ent = game.edicts + entNum;
+
+	// pick one of the 8 slots to prevent overwritings
+	clipent = &ctx->clipEnts[ctx->clipEntIndex];
+	ctx->clipEntIndex = ( ctx->clipEntIndex + 1 ) & 7;
+
+	// fields that are not backed up are taken from the current entity
+	clipent->r = ent->r;
+	clipent->s = ent->s;
+
+	if( !entNum || deltaTime >= 0 || !g_antilag->integer ) { // current time entity
+		return clipent;
+	}
+
+	if( !GClip_IsBackedUpEntity( ent, entNum ) ) {
+		return clipent;
+	}
+
+	// if solid has changed since the last backup, we can't step back at all
+	if( sv_collisionEntSolid[entNum] != (int)ent->r.solid ) {
+		return clipent;
+	}
+
+	// frames the entity has been continuously backed up in with the same solid value
+	maxFrameNum = sv_collisionFrameNum - 1;
+	minFrameNum = std::max( sv_collisionOldestFrameNum, sv_collisionEntSinceFrameNum[entNum] );
+	if( minFrameNum < 0 || minFrameNum > maxFrameNum ) {
 		return clipent;
 	}
 
+	// find the newest frame with timestamp <= realtime - backtime (timestamps are not decreasing).
+	// fall back to the oldest frame we can step back to if there is no such frame.
+	backTimestamp = GClip_GetBackTimestamp( deltaTime );
+	lo = minFrameNum;
+	hi = maxFrameNum;
+	while( lo < hi ) {
+		mid = lo + ( hi - lo + 1 ) / 2;
+		if( sv_collisionframes[mid & CFRAME_UPDATE_MASK].timestamp <= backTimestamp ) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	cframe = &sv_collisionframes[lo & CFRAME_UPDATE_MASK];
+
 	// setup with older for the data that is not interpolated
-	*clipent = cframe->clipEdicts[entNum];
+	record = GClip_GetBackedUpRecord( cframe, entNum );
+	GClip_CopyBackedUpRecord( clipent, record );
 
 	// if we found an older than desired backtime frame, interpolate to find a more precise position.
-	if( game.serverTime > cframe->timestamp + backTime ) {
+	if( backTimestamp > cframe->timestamp ) {
+		const float *newerOrigin, *newerMins, *newerMaxs, *newerAngles;
 		float lerpFrac;
 
-		if( bf == 1 ) {
-			// interpolate from 1st backed up to current
-			lerpFrac = (float)( ( game.serverTime - backTime ) - cframe->timestamp )
+		if( lo == maxFrameNum ) {
+			// interpolate from the last backed up to current
+			lerpFrac = (float)( backTimestamp - cframe->timestamp )
 					   / (float)( game.serverTime - cframe->timestamp );
-			clipentNewer.r = ent->r;
-			clipentNewer.s = ent->s;
+			newerOrigin = ent->s.origin;
+			newerMins = ent->r.mins;
+			newerMaxs = ent->r.maxs;
+			newerAngles = ent->s.angles;
 		} else {
 			// interpolate between 2 backed up
-			c4frame_t *cframeNewer = &sv_collisionframes[( cframenum - ( bf - 1 ) ) & CFRAME_UPDATE_MASK];
-			lerpFrac = (float)( ( game.serverTime - backTime ) - cframe->timestamp )
+			const c4frame_t *cframeNewer = &sv_collisionframes[( lo + 1 ) & CFRAME_UPDATE_MASK];
+			const int64_t newerRecord = GClip_GetBackedUpRecord( cframeNewer, entNum );
+			lerpFrac = (float)( backTimestamp - cframe->timestamp )
 					   / (float)( cframeNewer->timestamp - cframe->timestamp );
-			clipentNewer = cframeNewer->clipEdicts[entNum];
+			newerOrigin = sv_collisionrecords.origin[newerRecord];
+			newerMins = sv_collisionrecords.mins[newerRecord];
+			newerMaxs = sv_collisionrecords.maxs[newerRecord];
+			newerAngles = sv_collisionrecords.angles[newerRecord];
 		}
 
 #if 0
 		G_Printf( "backTime:%i cframeBackTime:%i backFrames:%i lerfrac:%f\n",
-				  backTime, game.serverTime - cframe->timestamp, backframes, lerpFrac );
+				  game.serverTime - backTimestamp, game.serverTime - cframe->timestamp, (int)( sv_collisionFrameNum - lo ), lerpFrac );
 #endif
 
 		// interpolate
-		VectorLerp( clipent->s.origin, lerpFrac, clipentNewer.s.origin, clipent->s.origin );
-		VectorLerp( clipent->r.mins, lerpFrac, clipentNewer.r.mins, clipent->r.mins );
-		VectorLerp( clipent->r.maxs, lerpFrac, clipentNewer.r.maxs, clipent->r.maxs );
+		VectorLerp( clipent->s.origin, lerpFrac, newerOrigin, clipent->s.origin );
+		VectorLerp( clipent->r.mins, lerpFrac, newerMins, clipent->r.mins );
+		VectorLerp( clipent->r.maxs, lerpFrac, newerMaxs, clipent->r.maxs );
 		for( i = 0; i < 3; i++ )
-			clipent->s.angles[i] = LerpAngle( clipent->s.angles[i], clipentNewer.s.angles[i], lerpFrac );
+			clipent->s.angles[i] = LerpAngle( clipent->s.angles[i], newerAngles[i], lerpFrac );
 	}
 
 #if 0
-	G_Printf( "backTime:%i cframeBackTime:%i backFrames:%i\n", backTime,
-			  game.serverTime - cframe->timestamp, backframes );
+	G_Printf( "backTime:%i cframeBackTime:%i backFrames:%i\n", game.serverTime - backTimestamp,
+			  game.serverTime - cframe->timestamp, (int)( sv_collisionFrameNum - lo ) );
 #endif
 
 	// back time entity
@@ -253,11 +495,6 @@ static void GClip_InsertLinkBefore( link_t *l, link_t *before, int entNum ) {
 static void GClip_Init_AreaGrid( areagrid_t *areagrid, const vec3_t world_mins, const vec3_t world_maxs ) {
 	int i;
 
-	// the areagrid_marknumber is not allowed to be 0
-	if( areagrid->marknumber < 1 ) {
-		areagrid->marknumber = 1;
-	}
-
 	// choose either the world box size, or a larger box to ensure the grid isn't too fine
 	areagrid->size[0] = std::max( world_maxs[0] - world_mins[0], AREA_GRID * AREA_GRIDMINSIZE );
 	areagrid->size[1] = std::max( world_maxs[1] - world_mins[1], AREA_GRID * AREA_GRIDMINSIZE );
@@ -282,8 +519,6 @@ static void GClip_Init_AreaGrid( areagrid_t *areagrid, const vec3_t world_mins,
 		GClip_ClearLink( &areagrid->grid[i] );
 	}
 
-	memset( areagrid->entmarknumber, 0, sizeof( areagrid->entmarknumber ) );
-
 	if( developer->integer ) {
 		Com_Printf( "areagrid settings: divisions %ix%ix1 : box %f %f %f "
 					": %f %f %f size %f %f %f grid %f %f %f (mingrid %f)\n",
@@ -351,11 +586,12 @@ static void GClip_LinkEntity_AreaGrid( areagrid_t *areagrid, edict_t *ent ) {
 /*
 * GClip_EntitiesInBox_AreaGrid
 */
-static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins, const vec3_t maxs,
+static int GClip_EntitiesInBox_AreaGrid( gclipcontext_t *ctx, const areagrid_t *areagrid,
+										 const vec3_t mins, const vec3_t maxs,
 										 int *list, int maxcount, int areatype, int timeDelta ) {
 	int numlist;
-	link_t *grid;
-	link_t *l;
+	const link_t *grid;
+	const link_t *l;
 	c4clipedict_t *clipEnt;
 	vec3_t paddedmins, paddedmaxs;
 	int igrid[3], igridmins[3], igridmaxs[3];
@@ -367,9 +603,9 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 	VectorCopy( mins, paddedmins );
 	VectorCopy( maxs, paddedmaxs );
 
-	// FIXME: if areagrid_marknumber wraps, all entities need their
-	// ent->priv.server->areagridmarknumber reset
-	areagrid->marknumber++;
+	// FIXME: if the context marknumber wraps, all entities need their
+	// context entmarknumber reset
+	ctx->marknumber++;
 
 	igridmins[0] = (int) floor( ( paddedmins[0] + areagrid->bias[0] ) * areagrid->scale[0] );
 	igridmins[1] = (int) floor( ( paddedmins[1] + areagrid->bias[1] ) * areagrid->scale[1] );
@@ -398,12 +634,12 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 	if( areagrid->outside.next ) {
 		grid = &areagrid->outside;
 		for( l = grid->next; l != grid; l = l->next ) {
-			clipEnt = GClip_GetClipEdictForDeltaTime( l->entNum, timeDelta );
+			clipEnt = GClip_GetClipEdictForDeltaTime( ctx, l->entNum, timeDelta );
 
-			if( areagrid->entmarknumber[l->entNum] == areagrid->marknumber ) {
+			if( ctx->entmarknumber[l->entNum] == ctx->marknumber ) {
 				continue;
 			}
-			areagrid->entmarknumber[l->entNum] = areagrid->marknumber;
+			ctx->entmarknumber[l->entNum] = ctx->marknumber;
 
 			if( !clipEnt->r.inuse ) {
 				continue; // deactivated
@@ -435,12 +671,12 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 			}
 
 			for( l = grid->next; l != grid; l = l->next ) {
-				clipEnt = GClip_GetClipEdictForDeltaTime( l->entNum, timeDelta );
+				clipEnt = GClip_GetClipEdictForDeltaTime( ctx, l->entNum, timeDelta );
 
-				if( areagrid->entmarknumber[l->entNum] == areagrid->marknumber ) {
+				if( ctx->entmarknumber[l->entNum] == ctx->marknumber ) {
 					continue;
 				}
-				areagrid->entmarknumber[l->entNum] = areagrid->marknumber;
+				ctx->entmarknumber[l->entNum] = ctx->marknumber;
 
 				if( !clipEnt->r.inuse ) {
 					continue; // deactivated
@@ -467,6 +703,481 @@ static int GClip_EntitiesInBox_AreaGrid( areagrid_t *areagrid, const vec3_t mins
 }
 
 
+/*
+* GClip_Init_AABBTree
+*/
+static void GClip_Init_AABBTree( aabbtree_t *tree ) {
+	int i;
+
+	for( i = 0; i < AABBTREE_MAXNODES; i++ ) {
+		tree->nodes[i].parent = i + 1;
+		tree->nodes[i].height = -1;
+	}
+	tree->nodes[AABBTREE_MAXNODES - 1].parent = AABBTREE_NULLNODE;
+	tree->freelist = 0;
+	tree->root = AABBTREE_NULLNODE;
+
+	for( i = 0; i < MAX_EDICTS; i++ ) {
+		tree->leafs[i] = AABBTREE_NULLNODE;
+	}
+}
+
+/*
+* GClip_AllocNode_AABBTree
+*/
+static int GClip_AllocNode_AABBTree( aabbtree_t *tree ) {
+	aabbnode_t *node;
+	int nodeNum;
+
+	// there are never more than 2 * MAX_EDICTS - 1 nodes in use
+	nodeNum = tree->freelist;
+	if( nodeNum == AABBTREE_NULLNODE ) {
+		G_Error( "GClip_AllocNode_AABBTree: no free nodes\n" );
+	}
+
+	node = &tree->nodes[nodeNum];
+	tree->freelist = node->parent;
+	node->parent = AABBTREE_NULLNODE;
+	node->child1 = AABBTREE_NULLNODE;
+	node->child2 = AABBTREE_NULLNODE;
+	node->height = 0;
+	node->entNum = 0;
+	return nodeNum;
+}
+
+/*
+* GClip_FreeNode_AABBTree
+*/
+static void GClip_FreeNode_AABBTree( aabbtree_t *tree, int nodeNum ) {
+	tree->nodes[nodeNum].parent = tree->freelist;
+	tree->nodes[nodeNum].height = -1;
+	tree->freelist = nodeNum;
+}
+
+/*
+* GClip_BoxArea
+*/
+static inline float GClip_BoxArea( const vec3_t mins, const vec3_t maxs ) {
+	const float dx = maxs[0] - mins[0];
+	const float dy = maxs[1] - mins[1];
+	const float dz = maxs[2] - mins[2];
+	return 2.0f * ( dx * dy + dy * dz + dz * dx );
+}
+
+/*
+* GClip_UnionBoxArea
+*/
+static inline float GClip_UnionBoxArea( const aabbnode_t *a, const aabbnode_t *b ) {
+	vec3_t mins, maxs;
+	for( int i = 0; i < 3; i++ ) {
+		mins[i] = std::min( a->mins[i], b->mins[i] );
+		maxs[i] = std::max( a->maxs[i], b->maxs[i] );
+	}
+	return GClip_BoxArea( mins, maxs );
+}
+
+/*
+* GClip_FitNode_AABBTree
+*/
+static void GClip_FitNode_AABBTree( aabbtree_t *tree, int nodeNum ) {
+	aabbnode_t *node = &tree->nodes[nodeNum];
+	const aabbnode_t *child1 = &tree->nodes[node->child1];
+	const aabbnode_t *child2 = &tree->nodes[node->child2];
+
+	for( int i = 0; i < 3; i++ ) {
+		node->mins[i] = std::min( child1->mins[i], child2->mins[i] );
+		node->maxs[i] = std::max( child1->maxs[i], child2->maxs[i] );
+	}
+	node->height = 1 + std::max( child1->height, child2->height );
+}
+
+/*
+* GClip_ReplaceChild_AABBTree
+*/
+static void GClip_ReplaceChild_AABBTree( aabbtree_t *tree, int parentNum, int oldChild, int newChild ) {
+	if( parentNum == AABBTREE_NULLNODE ) {
+		tree->root = newChild;
+	} else if( tree->nodes[parentNum].child1 == oldChild ) {
+		tree->nodes[parentNum].child1 = newChild;
+	} else {
+		tree->nodes[parentNum].child2 = newChild;
+	}
+}
+
+/*
+* GClip_Balance_AABBTree
+*
+* Performs a left or right rotation if the node is imbalanced.
+* Returns the new root of the subtree.
+*/
+static int GClip_Balance_AABBTree( aabbtree_t *tree, int iA ) {
+	aabbnode_t *nodes = tree->nodes;
+	aabbnode_t *A = &nodes[iA];
+
+	if( A->height < 2 ) {
+		return iA;
+	}
+
+	const int iB = A->child1;
+	const int iC = A->child2;
+	aabbnode_t *B = &nodes[iB];
+	aabbnode_t *C = &nodes[iC];
+	const int balance = C->height - B->height;
+
+	// rotate C up
+	if( balance > 1 ) {
+		const int iF = C->child1;
+		const int iG = C->child2;
+
+		C->child1 = iA;
+		C->parent = A->parent;
+		A->parent = iC;
+		GClip_ReplaceChild_AABBTree( tree, C->parent, iA, iC );
+
+		if( nodes[iF].height > nodes[iG].height ) {
+			C->child2 = iF;
+			A->child2 = iG;
+			nodes[iG].parent = iA;
+		} else {
+			C->child2 = iG;
+			A->child2 = iF;
+			nodes[iF].parent = iA;
+		}
+		GClip_FitNode_AABBTree( tree, iA );
+		GClip_FitNode_AABBTree( tree, iC );
+		return iC;
+	}
+
+	// rotate B up
+	if( balance < -1 ) {
+		const int iD = B->child1;
+		const int iE = B->child2;
+
+		B->child1 = iA;
+		B->parent = A->parent;
+		A->parent = iB;
+		GClip_ReplaceChild_AABBTree( tree, B->parent, iA, iB );
+
+		if( nodes[iD].height > nodes[iE].height ) {
+			B->child2 = iD;
+			A->child1 = iE;
+			nodes[iE].parent = iA;
+		} else {
+			B->child2 = iE;
+			A->child1 = iD;
+			nodes[iD].parent = iA;
+		}
+		GClip_FitNode_AABBTree( tree, iA );
+		GClip_FitNode_AABBTree( tree, iB );
+		return iB;
+	}
+
+	return iA;
+}
+
+/*
+* GClip_RefitAncestors_AABBTree
+*/
+static void GClip_RefitAncestors_AABBTree( aabbtree_t *tree, int nodeNum ) {
+	while( nodeNum != AABBTREE_NULLNODE ) {
+		nodeNum = GClip_Balance_AABBTree( tree, nodeNum );
+		GClip_FitNode_AABBTree( tree, nodeNum );
+		nodeNum = tree->nodes[nodeNum].parent;
+	}
+}
+
+/*
+* GClip_InsertLeaf_AABBTree
+*/
+static void GClip_InsertLeaf_AABBTree( aabbtree_t *tree, int leaf ) {
+	aabbnode_t *nodes = tree->nodes;
+	const aabbnode_t *leafNode = &nodes[leaf];
+	int index, sibling, oldParent, newParent;
+
+	if( tree->root == AABBTREE_NULLNODE ) {
+		tree->root = leaf;
+		nodes[leaf].parent = AABBTREE_NULLNODE;
+		return;
+	}
+
+	// find the best sibling using the surface area heuristic
+	index = tree->root;
+	while( nodes[index].height > 0 ) {
+		const aabbnode_t *node = &nodes[index];
+		const aabbnode_t *child1 = &nodes[node->child1];
+		const aabbnode_t *child2 = &nodes[node->child2];
+
+		const float combinedArea = GClip_UnionBoxArea( node, leafNode );
+		// cost of creating a new parent for this node and the new leaf
+		const float cost = 2.0f * combinedArea;
+		// minimum cost of pushing the leaf further down the tree
+		const float inheritanceCost = 2.0f * ( combinedArea - GClip_BoxArea( node->mins, node->maxs ) );
+
+		float cost1 = GClip_UnionBoxArea( child1, leafNode ) + inheritanceCost;
+		if( child1->height > 0 ) {
+			cost1 -= GClip_BoxArea( child1->mins, child1->maxs );
+		}
+		float cost2 = GClip_UnionBoxArea( child2, leafNode ) + inheritanceCost;
+		if( child2->height > 0 ) {
+			cost2 -= GClip_BoxArea( child2->mins, child2->maxs );
+		}
+
+		if( cost < cost1 && cost < cost2 ) {
+			break;
+		}
+		index = cost1 < cost2 ? node->child1 : node->child2;
+	}
+
+	sibling = index;
+	oldParent = nodes[sibling].parent;
+	newParent = GClip_AllocNode_AABBTree( tree );
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[newParent].entNum = 0;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+	GClip_ReplaceChild_AABBTree( tree, oldParent, sibling, newParent );
+
+	GClip_RefitAncestors_AABBTree( tree, newParent );
+}
+
+/*
+* GClip_RemoveLeaf_AABBTree
+*/
+static void GClip_RemoveLeaf_AABBTree( aabbtree_t *tree, int leaf ) {
+	aabbnode_t *nodes = tree->nodes;
+	int parent, grandParent, sibling;
+
+	if( leaf == tree->root ) {
+		tree->root = AABBTREE_NULLNODE;
+		return;
+	}
+
+	parent = nodes[leaf].parent;
+	grandParent = nodes[parent].parent;
+	sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	// the sibling takes the place of the parent
+	GClip_ReplaceChild_AABBTree( tree, grandParent, parent, sibling );
+	nodes[sibling].parent = grandParent;
+	GClip_FreeNode_AABBTree( tree, parent );
+
+	GClip_RefitAncestors_AABBTree( tree, grandParent );
+}
+
+/*
+* GClip_LinkEntity_AABBTree
+*
+* Refits the entity leaf. The tree is modified only if the entity has left its fattened box.
+*/
+static void GClip_LinkEntity_AABBTree( aabbtree_t *tree, edict_t *ent ) {
+	aabbnode_t *node;
+	int i, leaf, entNum;
+
+	entNum = NUM_FOR_EDICT( ent );
+	if( entNum <= 0 || entNum >= game.maxentities || EDICT_NUM( entNum ) != ent ) {
+		Com_Printf( "GClip_LinkEntity_AABBTree: invalid edict %p\n", (void *)ent );
+		return;
+	}
+
+	leaf = tree->leafs[entNum];
+	if( leaf != AABBTREE_NULLNODE ) {
+		node = &tree->nodes[leaf];
+		for( i = 0; i < 3; i++ ) {
+			if( ent->r.absmin[i] < node->mins[i] || ent->r.absmax[i] > node->maxs[i] ) {
+				break;
+			}
+		}
+		if( i == 3 ) {
+			return;
+		}
+		GClip_RemoveLeaf_AABBTree( tree, leaf );
+	} else {
+		leaf = GClip_AllocNode_AABBTree( tree );
+		tree->leafs[entNum] = leaf;
+		node = &tree->nodes[leaf];
+		node->entNum = entNum;
+	}
+
+	for( i = 0; i < 3; i++ ) {
+		node->mins[i] = ent->r.absmin[i] - AABBTREE_MARGIN;
+		node->maxs[i] = ent->r.absmax[i] + AABBTREE_MARGIN;
+	}
+
+	GClip_InsertLeaf_AABBTree( tree, leaf );
+}
+
+/*
+* GClip_ClipEdictForQuery
+*
+* Returns a clip edict if the linked entity passes the area type filter, NULL otherwise.
+*/
+static c4clipedict_t *GClip_ClipEdictForQuery( gclipcontext_t *ctx, int entNum, int areatype, int timeDelta ) {
+	c4clipedict_t *clipEnt;
+
+	// leafs of unlinked entities are kept in the tree
+	if( !game.edicts[entNum].linked ) {
+		return NULL;
+	}
+
+	clipEnt = GClip_GetClipEdictForDeltaTime( ctx, entNum, timeDelta );
+	if( !clipEnt->r.inuse ) {
+		return NULL; // deactivated
+	}
+	if( areatype == AREA_TRIGGERS && clipEnt->r.solid != SOLID_TRIGGER ) {
+		return NULL;
+	}
+	if( areatype == AREA_SOLID &&
+		( clipEnt->r.solid == SOLID_TRIGGER || clipEnt->r.solid == SOLID_NOT ) ) {
+		return NULL;
+	}
+	return clipEnt;
+}
+
+/*
+* GClip_EntitiesInBox_AABBTree
+*/
+static int GClip_EntitiesInBox_AABBTree( gclipcontext_t *ctx, const aabbtree_t *tree,
+										 const vec3_t mins, const vec3_t maxs,
+										 int *list, int maxcount, int areatype, int timeDelta ) {
+	int *stack = ctx->nodestack;
+	int stackSize = 0;
+	int numlist = 0;
+	float move;
+	vec3_t nodemins, nodemaxs;
+	c4clipedict_t *clipEnt;
+
+	if( tree->root == AABBTREE_NULLNODE ) {
+		return 0;
+	}
+
+	// leafs are fattened only for current bounds, entities stepped back in time may be out of them
+	move = GClip_GetMoveForDeltaTime( timeDelta );
+	VectorSet( nodemins, mins[0] - move, mins[1] - move, mins[2] - move );
+	VectorSet( nodemaxs, maxs[0] + move, maxs[1] + move, maxs[2] + move );
+
+	stack[stackSize++] = tree->root;
+	while( stackSize ) {
+		const aabbnode_t *node = &tree->nodes[stack[--stackSize]];
+		if( !BoundsIntersect( nodemins, nodemaxs, node->mins, node->maxs ) ) {
+			continue;
+		}
+
+		if( node->height > 0 ) {
+			stack[stackSize++] = node->child1;
+			stack[stackSize++] = node->child2;
+			continue;
+		}
+
+		clipEnt = GClip_ClipEdictForQuery( ctx, node->entNum, areatype, timeDelta );
+		if( clipEnt && BoundsIntersect( mins, maxs, clipEnt->r.absmin, clipEnt->r.absmax ) ) {
+			if( numlist < maxcount ) {
+				list[numlist] = node->entNum;
+			}
+			numlist++;
+		}
+	}
+
+	return numlist;
+}
+
+typedef struct
+{
+	vec3_t start;
+	vec3_t invdir;
+	vec3_t mins, maxs;          // size of the moving box, padded by 1 unit like trace bounds are
+} segmentquery_t;
+
+/*
+* GClip_SetupSegmentQuery
+*/
+static void GClip_SetupSegmentQuery( segmentquery_t *query, const vec3_t start, const vec3_t mins,
+									 const vec3_t maxs, const vec3_t end ) {
+	for( int i = 0; i < 3; i++ ) {
+		const float dir = end[i] - start[i];
+		// avoid infinities, a huge value produces correct results for parallel slabs
+		query->invdir[i] = fabs( dir ) > 1e-6f ? 1.0f / dir : 1e30f;
+		query->start[i] = start[i];
+		query->mins[i] = ( mins ? mins[i] : 0.0f ) - 1.0f;
+		query->maxs[i] = ( maxs ? maxs[i] : 0.0f ) + 1.0f;
+	}
+}
+
+/*
+* GClip_SegmentQueryTouchesBox
+*/
+static bool GClip_SegmentQueryTouchesBox( const segmentquery_t *query, const vec3_t mins, const vec3_t maxs ) {
+	float tmin = 0.0f, tmax = 1.0f;
+
+	for( int i = 0; i < 3; i++ ) {
+		// the box expanded by the size of the moving box
+		float t1 = ( mins[i] - query->maxs[i] - query->start[i] ) * query->invdir[i];
+		float t2 = ( maxs[i] - query->mins[i] - query->start[i] ) * query->invdir[i];
+		if( t1 > t2 ) {
+			std::swap( t1, t2 );
+		}
+		tmin = std::max( tmin, t1 );
+		tmax = std::min( tmax, t2 );
+		if( tmin > tmax ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+* GClip_EntitiesAlongSegment_AABBTree
+*/
+static int GClip_EntitiesAlongSegment_AABBTree( gclipcontext_t *ctx, const aabbtree_t *tree,
+												const segmentquery_t *query,
+												int *list, int maxcount, int areatype, int timeDelta ) {
+	int *stack = ctx->nodestack;
+	int stackSize = 0;
+	int numlist = 0;
+	float move;
+	segmentquery_t nodequery;
+	c4clipedict_t *clipEnt;
+
+	if( tree->root == AABBTREE_NULLNODE ) {
+		return 0;
+	}
+
+	// leafs are fattened only for current bounds, entities stepped back in time may be out of them
+	move = GClip_GetMoveForDeltaTime( timeDelta );
+	nodequery = *query;
+	for( int i = 0; i < 3; i++ ) {
+		nodequery.mins[i] -= move;
+		nodequery.maxs[i] += move;
+	}
+
+	stack[stackSize++] = tree->root;
+	while( stackSize ) {
+		const aabbnode_t *node = &tree->nodes[stack[--stackSize]];
+		if( !GClip_SegmentQueryTouchesBox( &nodequery, node->mins, node->maxs ) ) {
+			continue;
+		}
+
+		if( node->height > 0 ) {
+			stack[stackSize++] = node->child1;
+			stack[stackSize++] = node->child2;
+			continue;
+		}
+
+		clipEnt = GClip_ClipEdictForQuery( ctx, node->entNum, areatype, timeDelta );
+		if( clipEnt && GClip_SegmentQueryTouchesBox( query, clipEnt->r.absmin, clipEnt->r.absmax ) ) {
+			if( numlist < maxcount ) {
+				list[numlist] = node->entNum;
+			}
+			numlist++;
+		}
+	}
+
+	return numlist;
+}
+
+
 /*
 * GClip_ClearWorld
 * called after the world model has been loaded, before linking any entities
@@ -479,6 +1190,70 @@ void GClip_ClearWorld( void ) {
 	trap_CM_InlineModelBounds( world_model, world_mins, world_maxs );
 
 	GClip_Init_AreaGrid( &g_areagrid, world_mins, world_maxs );
+	GClip_Init_AABBTree( &g_aabbtree );
+
+	// the cvar is latched so the broadphase never changes while entities are linked
+	g_useAABBTree = g_clip_aabbtree->integer != 0;
+}
+
+/*
+* GClip_NewContext
+*/
+gclipcontext_t *GClip_NewContext( void ) {
+	gclipcontext_t *ctx = (gclipcontext_t *)G_Malloc( sizeof( gclipcontext_t ) );
+	memset( ctx, 0, sizeof( gclipcontext_t ) );
+	return ctx;
+}
+
+/*
+* GClip_FreeContext
+*/
+void GClip_FreeContext( gclipcontext_t *ctx ) {
+	// contexts of threads are owned by the list of thread contexts
+	assert( ctx != gclip_threadContext );
+	G_Free( ctx );
+}
+
+/*
+* GClip_ThreadContext
+*
+* Returns a context owned by the calling thread. Functions that do not accept
+* a context use this one, so they are safe to call from different threads too.
+*/
+gclipcontext_t *GClip_ThreadContext( void ) {
+	const int generation = gclip_threadContextsGeneration.load( std::memory_order_acquire );
+	gclipcontext_t *ctx;
+
+	if( gclip_threadContext && gclip_threadContextGeneration == generation ) {
+		return gclip_threadContext;
+	}
+
+	ctx = GClip_NewContext();
+	ctx->nextThreadContext = gclip_threadContexts.load( std::memory_order_relaxed );
+	while( !gclip_threadContexts.compare_exchange_weak( ctx->nextThreadContext, ctx, std::memory_order_release ) ) {
+	}
+
+	gclip_threadContext = ctx;
+	gclip_threadContextGeneration = generation;
+	return ctx;
+}
+
+/*
+* GClip_FreeThreadContexts
+*
+* Frees contexts of all threads. Must be called on shutdown while no collision queries are performed.
+*/
+void GClip_FreeThreadContexts( void ) {
+	gclipcontext_t *ctx, *next;
+
+	ctx = gclip_threadContexts.exchange( NULL, std::memory_order_acquire );
+	for(; ctx; ctx = next ) {
+		next = ctx->nextThreadContext;
+		G_Free( ctx );
+	}
+
+	gclip_threadContext = NULL;
+	gclip_threadContextsGeneration.fetch_add( 1, std::memory_order_release );
 }
 
 /*
@@ -644,7 +1419,12 @@ void GClip_LinkEntity( edict_t *ent ) {
 	ent->linkcount++;
 	ent->linked = true;
 
-	GClip_LinkEntity_AreaGrid( &g_areagrid, ent );
+	if( g_useAABBTree ) {
+		GClip_UpdateMoveSinceBackup( ent );
+		GClip_LinkEntity_AABBTree( &g_aabbtree, ent );
+	} else {
+		GClip_LinkEntity_AreaGrid( &g_areagrid, ent );
+	}
 }
 
 /*
@@ -674,16 +1454,71 @@ void GClip_SetAreaPortalState( edict_t *ent, bool open ) {
 * returns the number of pointers filled in
 * ??? does this always return the world?
 */
-int GClip_AreaEdicts( const vec3_t mins, const vec3_t maxs,
-					  int *list, int maxcount, int areatype, int timeDelta ) {
+int GClip_AreaEdictsCtx( gclipcontext_t *ctx, const vec3_t mins, const vec3_t maxs,
+						 int *list, int maxcount, int areatype, int timeDelta ) {
 	int count;
 
-	count = GClip_EntitiesInBox_AreaGrid( &g_areagrid, mins, maxs,
-										  list, maxcount, areatype, timeDelta );
+	if( g_useAABBTree ) {
+		count = GClip_EntitiesInBox_AABBTree( ctx, &g_aabbtree, mins, maxs,
+											  list, maxcount, areatype, timeDelta );
+	} else {
+		count = GClip_EntitiesInBox_AreaGrid( ctx, &g_areagrid, mins, maxs,
+											  list, maxcount, areatype, timeDelta );
+	}
 
 	return std::min( count, maxcount );
 }
 
+int GClip_AreaEdicts( const vec3_t mins, const vec3_t maxs,
+					  int *list, int maxcount, int areatype, int timeDelta ) {
+	return GClip_AreaEdictsCtx( GClip_ThreadContext(), mins, maxs, list, maxcount, areatype, timeDelta );
+}
+
+static void GClip_TraceBounds( const vec3_t start, const vec3_t mins, const vec3_t maxs,
+							   const vec3_t end, vec3_t boxmins, vec3_t boxmaxs );
+
+/*
+* GClip_AreaEdictsAlongSegment
+* fills in a table of edict ids with edicts that have bounding boxes
+* that are touched by the mins/maxs box moving from start to end.
+* Unlike GClip_AreaEdicts called for bounds of the move, it does not
+* return entities that are close to the move but are not swept.
+*/
+int GClip_AreaEdictsAlongSegmentCtx( gclipcontext_t *ctx, const vec3_t start, const vec3_t mins, const vec3_t maxs,
+									 const vec3_t end, int *list, int maxcount, int areatype, int timeDelta ) {
+	segmentquery_t query;
+	vec3_t boxmins, boxmaxs;
+	int i, count, numlist;
+
+	GClip_SetupSegmentQuery( &query, start, mins, maxs, end );
+
+	if( g_useAABBTree ) {
+		count = GClip_EntitiesAlongSegment_AABBTree( ctx, &g_aabbtree, &query,
+													 list, maxcount, areatype, timeDelta );
+		return std::min( count, maxcount );
+	}
+
+	// query the grid for bounds of the move and cut off entities that are not swept
+	GClip_TraceBounds( start, mins ? mins : vec3_origin, maxs ? maxs : vec3_origin, end, boxmins, boxmaxs );
+	count = GClip_AreaEdictsCtx( ctx, boxmins, boxmaxs, list, maxcount, areatype, timeDelta );
+
+	numlist = 0;
+	for( i = 0; i < count; i++ ) {
+		const c4clipedict_t *clipEnt = GClip_GetClipEdictForDeltaTime( ctx, list[i], timeDelta );
+		if( GClip_SegmentQueryTouchesBox( &query, clipEnt->r.absmin, clipEnt->r.absmax ) ) {
+			list[numlist++] = list[i];
+		}
+	}
+
+	return numlist;
+}
+
+int GClip_AreaEdictsAlongSegment( const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end,
+								  int *list, int maxcount, int areatype, int timeDelta ) {
+	return GClip_AreaEdictsAlongSegmentCtx( GClip_ThreadContext(), start, mins, maxs, end,
+											list, maxcount, areatype, timeDelta );
+}
+
 /*
 * GClip_CollisionModelForEntity
 *
@@ -717,9 +1552,9 @@ static struct cmodel_s *GClip_CollisionModelForEntity( entity_state_t *s, entity
 * returns the CONTENTS_* value from the world at the given point.
 * Quake 2 extends this to also check entities, to allow moving liquids
 */
-static int GClip_PointContents( const vec3_t p, int timeDelta ) {
+static int GClip_PointContents( gclipcontext_t *ctx, const vec3_t p, int timeDelta ) {
 	c4clipedict_t *clipEnt;
-	int touch[MAX_EDICTS];
+	int *touch = ctx->touchlist;
 	int i, num;
 	int contents, c2;
 	struct cmodel_s *cmodel;
@@ -728,10 +1563,10 @@ static int GClip_PointContents( const vec3_t p, int timeDelta ) {
 	contents = trap_CM_TransformedPointContents( p, NULL, NULL, NULL );
 
 	// or in contents from all the other entities
-	num = GClip_AreaEdicts( p, p, touch, MAX_EDICTS, AREA_SOLID, timeDelta );
+	num = GClip_AreaEdictsCtx( ctx, p, p, touch, MAX_EDICTS, AREA_SOLID, timeDelta );
 
 	for( i = 0; i < num; i++ ) {
-		clipEnt = GClip_GetClipEdictForDeltaTime( touch[i], timeDelta );
+		clipEnt = GClip_GetClipEdictForDeltaTime( ctx, touch[i], timeDelta );
 
 		// might intersect, so do an exact clip
 		cmodel = GClip_CollisionModelForEntity( &clipEnt->s, &clipEnt->r );
@@ -744,11 +1579,19 @@ static int GClip_PointContents( const vec3_t p, int timeDelta ) {
 }
 
 int G_PointContents( const vec3_t p ) {
-	return GClip_PointContents( p, 0 );
+	return GClip_PointContents( GClip_ThreadContext(), p, 0 );
 }
 
 int G_PointContents4D( const vec3_t p, int timeDelta ) {
-	return GClip_PointContents( p, timeDelta );
+	return GClip_PointContents( GClip_ThreadContext(), p, timeDelta );
+}
+
+int G_PointContentsCtx( gclipcontext_t *ctx, const vec3_t p ) {
+	return GClip_PointContents( ctx, p, 0 );
+}
+
+int G_PointContents4DCtx( gclipcontext_t *ctx, const vec3_t p, int timeDelta ) {
+	return GClip_PointContents( ctx, p, timeDelta );
 }
 
 //===========================================================================
@@ -766,20 +1609,21 @@ typedef struct {
 /*
 * GClip_ClipMoveToEntities
 */
-/*static*/ void GClip_ClipMoveToEntities( moveclip_t *clip, int timeDelta ) {
+static void GClip_ClipMoveToEntities( gclipcontext_t *ctx, moveclip_t *clip, int timeDelta ) {
 	int i, num;
 	c4clipedict_t *touch;
-	int touchlist[MAX_EDICTS];
+	int *touchlist = ctx->touchlist;
 	trace_t trace;
 	struct cmodel_s *cmodel;
 	float *angles;
 
-	num = GClip_AreaEdicts( clip->boxmins, clip->boxmaxs, touchlist, MAX_EDICTS, AREA_SOLID, timeDelta );
+	num = GClip_AreaEdictsAlongSegmentCtx( ctx, clip->start, clip->mins, clip->maxs, clip->end,
+											touchlist, MAX_EDICTS, AREA_SOLID, timeDelta );
 
 	// be careful, it is possible to have an entity in this
 	// list removed before we get to it (killtriggered)
 	for( i = 0; i < num; i++ ) {
-		touch = GClip_GetClipEdictForDeltaTime( touchlist[i], timeDelta );
+		touch = GClip_GetClipEdictForDeltaTime( ctx, touchlist[i], timeDelta );
 		if( clip->passent >= 0 ) {
 			// when they are offseted in time, they can be a different pointer but be the same entity
 			if( touch->s.number == clip->passent ) {
@@ -823,7 +1667,7 @@ typedef struct {
 			clip->trace->startsolid = true;
 		}
 		if( clip->trace->allsolid ) {
-			return;
+			break;
 		}
 	}
 }
@@ -864,7 +1708,7 @@ static void GClip_TraceBounds( const vec3_t start, const vec3_t mins, const vec3
 
 * passedict is explicitly excluded from clipping checks (normally NULL)
 */
-static void GClip_Trace( trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs,
+static void GClip_Trace( gclipcontext_t *ctx, trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs,
 						 const vec3_t end, const edict_t *passedict, int contentmask, int timeDelta ) {
 	moveclip_t clip;
 
@@ -908,17 +1752,27 @@ static void GClip_Trace( trace_t *tr, const vec3_t start, const vec3_t mins, con
 	GClip_TraceBounds( start, clip.mins2, clip.maxs2, end, clip.boxmins, clip.boxmaxs );
 
 	// clip to other solid entities
-	GClip_ClipMoveToEntities( &clip, timeDelta );
+	GClip_ClipMoveToEntities( ctx, &clip, timeDelta );
 }
 
 void G_Trace( trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs,
 			  const vec3_t end, const edict_t *passedict, int contentmask ) {
-	GClip_Trace( tr, start, mins, maxs, end, passedict, contentmask, 0 );
+	GClip_Trace( GClip_ThreadContext(), tr, start, mins, maxs, end, passedict, contentmask, 0 );
 }
 
 void G_Trace4D( trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs,
 				const vec3_t end, const edict_t *passedict, int contentmask, int timeDelta ) {
-	GClip_Trace( tr, start, mins, maxs, end, passedict, contentmask, timeDelta );
+	GClip_Trace( GClip_ThreadContext(), tr, start, mins, maxs, end, passedict, contentmask, timeDelta );
+}
+
+void G_TraceCtx( gclipcontext_t *ctx, trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs,
+				 const vec3_t end, const edict_t *passedict, int contentmask ) {
+	GClip_Trace( ctx, tr, start, mins, maxs, end, passedict, contentmask, 0 );
+}
+
+void G_Trace4DCtx( gclipcontext_t *ctx, trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs,
+				   const vec3_t end, const edict_t *passedict, int contentmask, int timeDelta ) {
+	GClip_Trace( ctx, tr, start, mins, maxs, end, passedict, contentmask, timeDelta );
 }
 
 //===========================================================================
@@ -1002,7 +1856,8 @@ bool GClip_EntityContact( const vec3_t mins, const vec3_t maxs, const edict_t *e
 void GClip_TouchTriggers( edict_t *ent ) {
 	int i, num;
 	edict_t *hit;
-	int touch[MAX_EDICTS];
+	int *touch;
+	size_t frameMark;
 	vec3_t mins, maxs;
 
 	// dead things don't activate triggers!
@@ -1010,6 +1865,9 @@ void GClip_TouchTriggers( edict_t *ent ) {
 		return;
 	}
 
+	frameMark = trap_MemFrameArenaMark();
+	touch = (int *)trap_MemFrameAlloc( MAX_EDICTS * sizeof( int ) );
+
 	VectorAdd( ent->s.origin, ent->r.mins, mins );
 	VectorAdd( ent->s.origin, ent->r.maxs, maxs );
 
@@ -1038,12 +1896,15 @@ void GClip_TouchTriggers( edict_t *ent ) {
 
 		G_CallTouch( hit, ent, NULL, 0 );
 	}
+
+	trap_MemFrameArenaRelease( frameMark );
 }
 
 void G_PMoveTouchTriggers( pmove_t *pm, const vec3_t previous_origin ) {
 	int i, num;
 	edict_t *hit;
-	int touch[MAX_EDICTS];
+	int *touch;
+	size_t frameMark;
 	vec3_t mins, maxs;
 	edict_t *ent;
 
@@ -1092,6 +1953,8 @@ void G_PMoveTouchTriggers( pmove_t *pm, const vec3_t previous_origin ) {
 		}
 	}
 
+	frameMark = trap_MemFrameArenaMark();
+	touch = (int *)trap_MemFrameAlloc( MAX_EDICTS * sizeof( int ) );
 	num = GClip_AreaEdicts( mins, maxs, touch, MAX_EDICTS, AREA_TRIGGERS, 0 );
 
 	// be careful, it is possible to have an entity in this
@@ -1116,6 +1979,8 @@ void G_PMoveTouchTriggers( pmove_t *pm, const vec3_t previous_origin ) {
 
 		G_CallTouch( hit, ent, NULL, 0 );
 	}
+
+	trap_MemFrameArenaRelease( frameMark );
 }
 
 /*
@@ -1128,13 +1993,14 @@ int GClip_FindInRadius4D( const vec3_t org, float rad, int *list, int maxcount,
 	edict_t *check;
 	vec3_t mins, maxs;
 	float rad_ = rad * 1.42;
-	int touch[MAX_EDICTS];
+	gclipcontext_t *ctx = GClip_ThreadContext();
+	int *touch = ctx->touchlist;
 
 	VectorSet( mins, org[0] - ( rad_ + 1 ), org[1] - ( rad_ + 1 ), org[2] - ( rad_ + 1 ) );
 	VectorSet( maxs, org[0] + ( rad_ + 1 ), org[1] + ( rad_ + 1 ), org[2] + ( rad_ + 1 ) );
 
 	listnum = 0;
-	num = GClip_AreaEdicts( mins, maxs, touch, MAX_EDICTS, AREA_ALL, timeDelta );
+	num = GClip_AreaEdictsCtx( ctx, mins, maxs, touch, MAX_EDICTS, AREA_ALL, timeDelta );
 
 	for( i = 0; i < num; i++ ) {
 		check = EDICT_NUM( touch[i] );
@@ -1166,7 +2032,7 @@ void G_SplashFrac4D( int entNum, vec3_t hitpoint, float maxradius, vec3_t pushdi
 					 float *kickFrac, float *dmgFrac, int timeDelta ) {
 	c4clipedict_t *clipEnt;
 
-	clipEnt = GClip_GetClipEdictForDeltaTime( entNum, timeDelta );
+	clipEnt = GClip_GetClipEdictForDeltaTime( GClip_ThreadContext(), entNum, timeDelta );
 	G_SplashFrac( clipEnt->s.origin, clipEnt->r.mins, clipEnt->r.maxs, hitpoint,
 				  maxradius, pushdir, kickFrac, dmgFrac );
 }
@@ -1175,7 +2041,7 @@ void RS_SplashFrac4D( int entNum, vec3_t hitpoint, float maxradius, vec3_t pushd
 					  float *kickFrac, float *dmgFrac, int timeDelta, float splashFrac ) {
 	c4clipedict_t *clipEnt;
 
-	clipEnt = GClip_GetClipEdictForDeltaTime( entNum, timeDelta );
+	clipEnt = GClip_GetClipEdictForDeltaTime( GClip_ThreadContext(), entNum, timeDelta );
 	RS_SplashFrac( clipEnt->s.origin, clipEnt->r.mins, clipEnt->r.maxs, hitpoint,
 				   maxradius, pushdir, kickFrac, dmgFrac, splashFrac );
 }
@@ -1189,7 +2055,7 @@ entity_state_t *G_GetEntityStateForDeltaTime( int entNum, int deltaTime ) {
 
 	assert( entNum >= 0 && entNum < MAX_EDICTS );
 
-	clipEnt = GClip_GetClipEdictForDeltaTime( entNum, deltaTime );
+	clipEnt = GClip_GetClipEdictForDeltaTime( GClip_ThreadContext(), entNum, deltaTime );
 
 	return &clipEnt->s;
 }
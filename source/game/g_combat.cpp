@@ -801,7 +801,9 @@ void G_RadiusDamage( edict_t *inflictor, edict_t *attacker, cplane_t *plane, edi
 	const bool volatileExplosives = GS_RaceGametype() && g_volatile_explosives->integer;
 	const int attackerNum = attacker ? ENTNUM( attacker ) : -1;
 
-	int touch[MAX_EDICTS];
+	// detonations of volatile explosives call this recursively, so keep the list off the stack
+	const size_t frameMark = trap_MemFrameArenaMark();
+	int *touch = (int *)trap_MemFrameAlloc( MAX_EDICTS * sizeof( int ) );
 	const int numTouch = GClip_FindInRadius4D( inflictor->s.origin, radius, touch, MAX_EDICTS, inflictor->timeDelta );
 	for( int i = 0; i < numTouch; i++ ) {
 		const int entNum = touch[i];
@@ -886,4 +888,6 @@ void G_RadiusDamage( edict_t *inflictor, edict_t *attacker, cplane_t *plane, edi
 		const float *org = inflictor->s.origin;
 		G_Damage( ent, inflictor, attacker, pushDir, vel, org, damage, knockback, stun, DAMAGE_RADIUS, mod );
 	}
+
+	trap_MemFrameArenaRelease( frameMark );
 }
\ No newline at end of file
@@ -808,6 +808,18 @@ typedef struct link_s {
 	int entNum;
 } link_t;
 
+// Scratch state of collision queries. Each thread that performs queries concurrently must use its own context.
+typedef struct gclipcontext_s gclipcontext_t;
+
+gclipcontext_t *GClip_NewContext( void );
+void GClip_FreeContext( gclipcontext_t *ctx );
+gclipcontext_t *GClip_ThreadContext( void );
+void GClip_FreeThreadContexts( void );
+int G_PointContentsCtx( gclipcontext_t *ctx, const vec3_t p );
+int G_PointContents4DCtx( gclipcontext_t *ctx, const vec3_t p, int timeDelta );
+void G_TraceCtx( gclipcontext_t *ctx, trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, const edict_t *passedict, int contentmask );
+void G_Trace4DCtx( gclipcontext_t *ctx, trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, const edict_t *passedict, int contentmask, int timeDelta );
+
 int G_PointContents( const vec3_t p );
 void G_Trace( trace_t *tr, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, const edict_t *passedict, int contentmask );
 int G_PointContents4D( const vec3_t p, int timeDelta );
@@ -832,6 +844,9 @@ int GClip_FindInRadius( const vec3_t org, float rad, int *list, int maxcount );
 #define AREA_SOLID      1
 #define AREA_TRIGGERS   2
 int GClip_AreaEdicts( const vec3_t mins, const vec3_t maxs, int *list, int maxcount, int areatype, int timeDelta );
+int GClip_AreaEdictsCtx( gclipcontext_t *ctx, const vec3_t mins, const vec3_t maxs, int *list, int maxcount, int areatype, int timeDelta );
+int GClip_AreaEdictsAlongSegment( const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int *list, int maxcount, int areatype, int timeDelta );
+int GClip_AreaEdictsAlongSegmentCtx( gclipcontext_t *ctx, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int *list, int maxcount, int areatype, int timeDelta );
 bool GClip_EntityContact( const vec3_t mins, const vec3_t maxs, const edict_t *ent );
 
 //
@@ -973,6 +988,14 @@ void SP_target_teleporter( edict_t *self );
 void SP_target_kill( edict_t *self );
 
 
+//
+// g_pmove_replay.cpp
+//
+void G_Pmove( pmove_t *pm );
+void G_StopPmoveRecording( void );
+void G_PmoveRecord_f( void );
+void G_PmoveReplay_f( void );
+
 //
 // g_svcmds.c
 //
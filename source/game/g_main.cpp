@@ -71,6 +71,7 @@ cvar_t *g_maxtimeouts;
 cvar_t *g_antilag;
 cvar_t *g_antilag_maxtimedelta;
 cvar_t *g_antilag_timenudge;
+cvar_t *g_clip_aabbtree;
 cvar_t *g_autorecord;
 cvar_t *g_autorecord_maxdemos;
 
@@ -283,6 +284,7 @@ void G_Init( unsigned int seed, unsigned int framemsec, int protocol, const char
 	g_antilag_maxtimedelta->modified = true;
 	g_antilag_timenudge = trap_Cvar_Get( "g_antilag_timenudge", "0", CVAR_ARCHIVE );
 	g_antilag_timenudge->modified = true;
+	g_clip_aabbtree = trap_Cvar_Get( "g_clip_aabbtree", "0", CVAR_ARCHIVE | CVAR_LATCH );
 
 	g_allow_spectator_voting = trap_Cvar_Get( "g_allow_spectator_voting", "1", CVAR_ARCHIVE );
 
@@ -395,6 +397,8 @@ void G_Shutdown( void ) {
 
 	AI_Shutdown();
 
+	G_StopPmoveRecording();
+
 	G_RemoveCommands();
 
 	G_FreeCallvotes();
@@ -408,6 +412,8 @@ void G_Shutdown( void ) {
 		}
 	}
 
+	GClip_FreeThreadContexts();
+
 	G_Free( game.edicts );
 	game.edicts = nullptr;
 
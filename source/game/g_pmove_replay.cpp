@@ -0,0 +1,653 @@
+#include "g_local.h"
+
+/*
+* Regression harness for the player movement code.
+*
+* Client moves are recorded along with results of every call Pmove() makes to the outer world
+* (traces, point contents, entity states, predicted events and touched triggers).
+* A replay feeds recorded inputs to Pmove() with the recorded world answers and requires
+* the world queries and the resulting state to be bit-exact to the recorded ones.
+* Record moves with a build before a change of the movement code and replay them with a build after it.
+*/
+
+#define PMOVE_RECORD_MAGIC      "QFPM"
+#define PMOVE_RECORD_VERSION    1
+#define PMOVE_RECORD_DIRECTORY  "pmove"
+#define PMOVE_RECORD_EXTENSION  ".pmr"
+
+enum {
+	PMREC_END,
+	PMREC_TRACE,
+	PMREC_POINTCONTENTS,
+	PMREC_ENTITYSTATE,
+	PMREC_EVENT,
+	PMREC_TOUCHTRIGGERS
+};
+
+typedef struct {
+	char magic[4];
+	int version;
+} pmoveRecordFileHeader_t;
+
+typedef struct {
+	game_state_t gameState;
+	player_state_t playerState;
+	usercmd_t cmd;
+	int skipCollision;
+	int skipLadders;
+} pmoveRecordMove_t;
+
+// the part of the move state that is visible outside of Pmove()
+typedef struct {
+	player_state_t playerState;
+	int numtouch;
+	int touchents[MAXTOUCH];
+	float step;
+	vec3_t mins, maxs;
+	int groundentity;
+	cplane_t groundplane;
+	int groundsurfFlags;
+	int groundcontents;
+	int watertype;
+	int waterlevel;
+	int contentmask;
+	int ladder;
+} pmoveRecordState_t;
+
+typedef struct {
+	vec3_t start, mins, maxs, end;
+	int ignore, contentmask, timeDelta;
+	trace_t result;
+} pmoveRecordTrace_t;
+
+typedef struct {
+	vec3_t point;
+	int timeDelta;
+	int result;
+} pmoveRecordPointContents_t;
+
+typedef struct {
+	int entNum, deltaTime;
+	int isNull;
+	entity_state_t result;
+} pmoveRecordEntityState_t;
+
+typedef struct {
+	int entNum, ev, parm;
+} pmoveRecordEvent_t;
+
+typedef struct {
+	vec3_t previousOrigin;
+	pmoveRecordState_t before, after;
+} pmoveRecordTouchTriggers_t;
+
+// a replay of a single move
+typedef struct {
+	const uint8_t *data, *end;
+	const char *error;
+	entity_state_t entityState;
+} pmoveReplay_t;
+
+static int pmove_recordFile;
+static int pmove_numRecordedMoves;
+
+static pmoveReplay_t *pmove_replay;
+
+static const uint8_t *pmove_replayData;
+static size_t pmove_replayDataSize;
+static size_t *pmove_replayMoves;
+
+/*
+* G_PmoveRecord_GetState
+*/
+static void G_PmoveRecord_GetState( const pmove_t *pm, pmoveRecordState_t *state ) {
+	memset( state, 0, sizeof( *state ) );
+	memcpy( &state->playerState, pm->playerState, sizeof( state->playerState ) );
+	state->numtouch = pm->numtouch;
+	memcpy( state->touchents, pm->touchents, sizeof( state->touchents ) );
+	state->step = pm->step;
+	VectorCopy( pm->mins, state->mins );
+	VectorCopy( pm->maxs, state->maxs );
+	state->groundentity = pm->groundentity;
+	state->groundplane = pm->groundplane;
+	state->groundsurfFlags = pm->groundsurfFlags;
+	state->groundcontents = pm->groundcontents;
+	state->watertype = pm->watertype;
+	state->waterlevel = pm->waterlevel;
+	state->contentmask = pm->contentmask;
+	state->ladder = pm->ladder ? 1 : 0;
+}
+
+/*
+* G_PmoveRecord_SetState
+*/
+static void G_PmoveRecord_SetState( pmove_t *pm, const pmoveRecordState_t *state ) {
+	memcpy( pm->playerState, &state->playerState, sizeof( state->playerState ) );
+	pm->numtouch = state->numtouch;
+	memcpy( pm->touchents, state->touchents, sizeof( state->touchents ) );
+	pm->step = state->step;
+	VectorCopy( state->mins, pm->mins );
+	VectorCopy( state->maxs, pm->maxs );
+	pm->groundentity = state->groundentity;
+	pm->groundplane = state->groundplane;
+	pm->groundsurfFlags = state->groundsurfFlags;
+	pm->groundcontents = state->groundcontents;
+	pm->watertype = state->watertype;
+	pm->waterlevel = state->waterlevel;
+	pm->contentmask = state->contentmask;
+	pm->ladder = state->ladder != 0;
+}
+
+/*
+* G_PmoveRecord_Write
+*/
+static void G_PmoveRecord_Write( int type, const void *data, size_t size ) {
+	trap_FS_Write( &type, sizeof( type ), pmove_recordFile );
+	trap_FS_Write( data, size, pmove_recordFile );
+}
+
+/*
+* G_PmoveRecord_Trace
+*/
+static void G_PmoveRecord_Trace( trace_t *t, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end,
+								 int ignore, int contentmask, int timeDelta ) {
+	pmoveRecordTrace_t rec;
+
+	module_Trace( t, start, mins, maxs, end, ignore, contentmask, timeDelta );
+
+	memset( &rec, 0, sizeof( rec ) );
+	VectorCopy( start, rec.start );
+	VectorCopy( mins ? mins : vec3_origin, rec.mins );
+	VectorCopy( maxs ? maxs : vec3_origin, rec.maxs );
+	VectorCopy( end, rec.end );
+	rec.ignore = ignore;
+	rec.contentmask = contentmask;
+	rec.timeDelta = timeDelta;
+	rec.result = *t;
+	G_PmoveRecord_Write( PMREC_TRACE, &rec, sizeof( rec ) );
+}
+
+/*
+* G_PmoveRecord_PointContents
+*/
+static int G_PmoveRecord_PointContents( const vec3_t point, int timeDelta ) {
+	pmoveRecordPointContents_t rec;
+
+	memset( &rec, 0, sizeof( rec ) );
+	VectorCopy( point, rec.point );
+	rec.timeDelta = timeDelta;
+	rec.result = module_PointContents( point, timeDelta );
+	G_PmoveRecord_Write( PMREC_POINTCONTENTS, &rec, sizeof( rec ) );
+	return rec.result;
+}
+
+/*
+* G_PmoveRecord_GetEntityState
+*/
+static entity_state_t *G_PmoveRecord_GetEntityState( int entNum, int deltaTime ) {
+	pmoveRecordEntityState_t rec;
+	entity_state_t *state = module_GetEntityState( entNum, deltaTime );
+
+	memset( &rec, 0, sizeof( rec ) );
+	rec.entNum = entNum;
+	rec.deltaTime = deltaTime;
+	rec.isNull = state ? 0 : 1;
+	if( state ) {
+		rec.result = *state;
+	}
+	G_PmoveRecord_Write( PMREC_ENTITYSTATE, &rec, sizeof( rec ) );
+	return state;
+}
+
+/*
+* G_PmoveRecord_PredictedEvent
+*/
+static void G_PmoveRecord_PredictedEvent( int entNum, int ev, int parm ) {
+	pmoveRecordEvent_t rec;
+
+	rec.entNum = entNum;
+	rec.ev = ev;
+	rec.parm = parm;
+	G_PmoveRecord_Write( PMREC_EVENT, &rec, sizeof( rec ) );
+
+	module_PredictedEvent( entNum, ev, parm );
+}
+
+/*
+* G_PmoveRecord_TouchTriggers
+*/
+static void G_PmoveRecord_TouchTriggers( pmove_t *pm, const vec3_t previous_origin ) {
+	pmoveRecordTouchTriggers_t rec;
+
+	memset( &rec, 0, sizeof( rec ) );
+	VectorCopy( previous_origin, rec.previousOrigin );
+	G_PmoveRecord_GetState( pm, &rec.before );
+
+	module_PMoveTouchTriggers( pm, previous_origin );
+
+	G_PmoveRecord_GetState( pm, &rec.after );
+	G_PmoveRecord_Write( PMREC_TOUCHTRIGGERS, &rec, sizeof( rec ) );
+}
+
+/*
+* G_Pmove
+*
+* Performs a client move, the move gets recorded if there is an active recording.
+*/
+void G_Pmove( pmove_t *pm ) {
+	pmoveRecordMove_t move;
+	pmoveRecordState_t result;
+
+	if( !pmove_recordFile ) {
+		Pmove( pm );
+		return;
+	}
+
+	memset( &move, 0, sizeof( move ) );
+	move.gameState = gs.gameState;
+	memcpy( &move.playerState, pm->playerState, sizeof( move.playerState ) );
+	move.cmd = pm->cmd;
+	move.skipCollision = pm->skipCollision ? 1 : 0;
+	move.skipLadders = pm->skipLadders ? 1 : 0;
+	trap_FS_Write( &move, sizeof( move ), pmove_recordFile );
+
+	pm->trace = G_PmoveRecord_Trace;
+	pm->pointContents = G_PmoveRecord_PointContents;
+	pm->getEntityState = G_PmoveRecord_GetEntityState;
+	pm->predictedEvent = G_PmoveRecord_PredictedEvent;
+	pm->touchTriggers = G_PmoveRecord_TouchTriggers;
+
+	Pmove( pm );
+
+	pm->trace = NULL;
+	pm->pointContents = NULL;
+	pm->getEntityState = NULL;
+	pm->predictedEvent = NULL;
+	pm->touchTriggers = NULL;
+
+	G_PmoveRecord_GetState( pm, &result );
+	G_PmoveRecord_Write( PMREC_END, &result, sizeof( result ) );
+
+	pmove_numRecordedMoves++;
+}
+
+/*
+* G_StopPmoveRecording
+*/
+void G_StopPmoveRecording( void ) {
+	if( !pmove_recordFile ) {
+		return;
+	}
+
+	trap_FS_FCloseFile( pmove_recordFile );
+	pmove_recordFile = 0;
+
+	G_Printf( "Stopped recording of player moves, %i moves recorded\n", pmove_numRecordedMoves );
+}
+
+/*
+* G_PmoveRecord_f
+*/
+void G_PmoveRecord_f( void ) {
+	char filename[MAX_QPATH];
+	pmoveRecordFileHeader_t header;
+
+	if( trap_Cmd_Argc() != 2 ) {
+		G_Printf( "Usage: pmoverecord <name|stop>\n" );
+		return;
+	}
+
+	G_StopPmoveRecording();
+
+	if( !Q_stricmp( trap_Cmd_Argv( 1 ), "stop" ) ) {
+		return;
+	}
+
+	Q_snprintfz( filename, sizeof( filename ), PMOVE_RECORD_DIRECTORY "/%s", trap_Cmd_Argv( 1 ) );
+	COM_SanitizeFilePath( filename );
+	COM_DefaultExtension( filename, PMOVE_RECORD_EXTENSION, sizeof( filename ) );
+
+	if( trap_FS_FOpenFile( filename, &pmove_recordFile, FS_WRITE ) == -1 ) {
+		G_Printf( "Could not open %s for writing\n", filename );
+		pmove_recordFile = 0;
+		return;
+	}
+
+	memcpy( header.magic, PMOVE_RECORD_MAGIC, sizeof( header.magic ) );
+	header.version = PMOVE_RECORD_VERSION;
+	trap_FS_Write( &header, sizeof( header ), pmove_recordFile );
+
+	pmove_numRecordedMoves = 0;
+
+	G_Printf( "Recording player moves to %s\n", filename );
+}
+
+/*
+* G_PmoveReplay_Read
+*
+* Returns a pointer to the next recorded call of the given type, NULL on a mismatch.
+*/
+static const void *G_PmoveReplay_Read( pmoveReplay_t *replay, int type, size_t size ) {
+	int recordedType;
+	const void *data;
+
+	if( replay->error ) {
+		return NULL;
+	}
+
+	if( replay->data + sizeof( recordedType ) + size > replay->end ) {
+		replay->error = "unexpected end of the record";
+		return NULL;
+	}
+
+	memcpy( &recordedType, replay->data, sizeof( recordedType ) );
+	if( recordedType != type ) {
+		replay->error = "the sequence of world queries differs";
+		return NULL;
+	}
+
+	data = replay->data + sizeof( recordedType );
+	replay->data += sizeof( recordedType ) + size;
+	return data;
+}
+
+/*
+* G_PmoveReplay_Trace
+*/
+static void G_PmoveReplay_Trace( trace_t *t, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end,
+								 int ignore, int contentmask, int timeDelta ) {
+	pmoveRecordTrace_t rec;
+	const pmoveRecordTrace_t *recorded;
+
+	// don't leave the trace uninitialized in case of a mismatch, the move is discarded anyway
+	memset( t, 0, sizeof( *t ) );
+	t->fraction = 1.0f;
+	t->ent = -1;
+
+	recorded = ( const pmoveRecordTrace_t * )G_PmoveReplay_Read( pmove_replay, PMREC_TRACE, sizeof( rec ) );
+	if( !recorded ) {
+		return;
+	}
+
+	memcpy( &rec, recorded, sizeof( rec ) );
+	if( memcmp( start, rec.start, sizeof( vec3_t ) ) || memcmp( mins ? mins : vec3_origin, rec.mins, sizeof( vec3_t ) ) ||
+		memcmp( maxs ? maxs : vec3_origin, rec.maxs, sizeof( vec3_t ) ) || memcmp( end, rec.end, sizeof( vec3_t ) ) ||
+		ignore != rec.ignore || contentmask != rec.contentmask || timeDelta != rec.timeDelta ) {
+		pmove_replay->error = "trace arguments differ";
+		return;
+	}
+
+	*t = rec.result;
+}
+
+/*
+* G_PmoveReplay_PointContents
+*/
+static int G_PmoveReplay_PointContents( const vec3_t point, int timeDelta ) {
+	pmoveRecordPointContents_t rec;
+	const void *recorded;
+
+	recorded = G_PmoveReplay_Read( pmove_replay, PMREC_POINTCONTENTS, sizeof( rec ) );
+	if( !recorded ) {
+		return 0;
+	}
+
+	memcpy( &rec, recorded, sizeof( rec ) );
+	if( memcmp( point, rec.point, sizeof( vec3_t ) ) || timeDelta != rec.timeDelta ) {
+		pmove_replay->error = "point contents arguments differ";
+		return 0;
+	}
+
+	return rec.result;
+}
+
+/*
+* G_PmoveReplay_GetEntityState
+*/
+static entity_state_t *G_PmoveReplay_GetEntityState( int entNum, int deltaTime ) {
+	pmoveRecordEntityState_t rec;
+	const void *recorded;
+
+	// the result is not checked for null by the caller, return something valid on a mismatch
+	memset( &pmove_replay->entityState, 0, sizeof( pmove_replay->entityState ) );
+
+	recorded = G_PmoveReplay_Read( pmove_replay, PMREC_ENTITYSTATE, sizeof( rec ) );
+	if( !recorded ) {
+		return &pmove_replay->entityState;
+	}
+
+	memcpy( &rec, recorded, sizeof( rec ) );
+	if( entNum != rec.entNum || deltaTime != rec.deltaTime ) {
+		pmove_replay->error = "entity state arguments differ";
+		return &pmove_replay->entityState;
+	}
+
+	if( rec.isNull ) {
+		return NULL;
+	}
+
+	pmove_replay->entityState = rec.result;
+	return &pmove_replay->entityState;
+}
+
+/*
+* G_PmoveReplay_PredictedEvent
+*/
+static void G_PmoveReplay_PredictedEvent( int entNum, int ev, int parm ) {
+	pmoveRecordEvent_t rec;
+	const void *recorded;
+
+	recorded = G_PmoveReplay_Read( pmove_replay, PMREC_EVENT, sizeof( rec ) );
+	if( !recorded ) {
+		return;
+	}
+
+	memcpy( &rec, recorded, sizeof( rec ) );
+	if( entNum != rec.entNum || ev != rec.ev || parm != rec.parm ) {
+		pmove_replay->error = "predicted events differ";
+	}
+}
+
+/*
+* G_PmoveReplay_TouchTriggers
+*/
+static void G_PmoveReplay_TouchTriggers( pmove_t *pm, const vec3_t previous_origin ) {
+	pmoveRecordState_t state;
+	const pmoveRecordTouchTriggers_t *recorded;
+
+	recorded = ( const pmoveRecordTouchTriggers_t * )G_PmoveReplay_Read( pmove_replay, PMREC_TOUCHTRIGGERS, sizeof( *recorded ) );
+	if( !recorded ) {
+		return;
+	}
+
+	G_PmoveRecord_GetState( pm, &state );
+	if( memcmp( previous_origin, recorded->previousOrigin, sizeof( vec3_t ) ) || memcmp( &state, &recorded->before, sizeof( state ) ) ) {
+		pmove_replay->error = "the state before touching triggers differs";
+		return;
+	}
+
+	// triggers might have modified the state (e.g. teleporters and jumppads)
+	memcpy( &state, &recorded->after, sizeof( state ) );
+	G_PmoveRecord_SetState( pm, &state );
+}
+
+/*
+* G_PmoveReplay_Move
+*
+* Replays the recorded move, returns NULL on success and the reason of a mismatch otherwise.
+*/
+static const char *G_PmoveReplay_Move( size_t offset, size_t endOffset ) {
+	pmoveReplay_t replay;
+	pmoveRecordMove_t move;
+	pmoveRecordState_t result;
+	player_state_t playerState;
+	pmove_t pm;
+	const void *recorded;
+
+	replay.data = pmove_replayData + offset;
+	replay.end = pmove_replayData + endOffset;
+	replay.error = NULL;
+
+	memcpy( &move, replay.data, sizeof( move ) );
+	replay.data += sizeof( move );
+
+	memcpy( &playerState, &move.playerState, sizeof( playerState ) );
+
+	memset( &pm, 0, sizeof( pm ) );
+	pm.playerState = &playerState;
+	pm.cmd = move.cmd;
+	pm.skipCollision = move.skipCollision != 0;
+	pm.skipLadders = move.skipLadders != 0;
+	pm.trace = G_PmoveReplay_Trace;
+	pm.pointContents = G_PmoveReplay_PointContents;
+	pm.getEntityState = G_PmoveReplay_GetEntityState;
+	pm.predictedEvent = G_PmoveReplay_PredictedEvent;
+	pm.touchTriggers = G_PmoveReplay_TouchTriggers;
+
+	pmove_replay = &replay;
+	Pmove( &pm );
+	pmove_replay = NULL;
+
+	if( replay.error ) {
+		return replay.error;
+	}
+
+	recorded = G_PmoveReplay_Read( &replay, PMREC_END, sizeof( result ) );
+	if( !recorded ) {
+		return replay.error;
+	}
+
+	G_PmoveRecord_GetState( &pm, &result );
+	if( memcmp( &result, recorded, sizeof( result ) ) ) {
+		return "the resulting state differs";
+	}
+
+	return NULL;
+}
+
+/*
+* G_PmoveReplay_Index
+*
+* Finds offsets of all recorded moves, the offset past the last move is stored as well.
+* Returns the number of moves or -1 if the record is malformed.
+*/
+static int G_PmoveReplay_Index( size_t *moves, int maxMoves ) {
+	static const size_t callSizes[] = {
+		sizeof( pmoveRecordState_t ),
+		sizeof( pmoveRecordTrace_t ),
+		sizeof( pmoveRecordPointContents_t ),
+		sizeof( pmoveRecordEntityState_t ),
+		sizeof( pmoveRecordEvent_t ),
+		sizeof( pmoveRecordTouchTriggers_t )
+	};
+	size_t offset = sizeof( pmoveRecordFileHeader_t );
+	int type, numMoves = 0;
+
+	while( offset < pmove_replayDataSize ) {
+		if( moves ) {
+			if( numMoves == maxMoves ) {
+				return -1;
+			}
+			moves[numMoves] = offset;
+		}
+
+		offset += sizeof( pmoveRecordMove_t );
+		do {
+			if( offset + sizeof( type ) > pmove_replayDataSize ) {
+				return -1;
+			}
+			memcpy( &type, pmove_replayData + offset, sizeof( type ) );
+			if( type < PMREC_END || type > PMREC_TOUCHTRIGGERS ) {
+				return -1;
+			}
+			offset += sizeof( type ) + callSizes[type];
+		} while( type != PMREC_END );
+
+		if( offset > pmove_replayDataSize ) {
+			return -1;
+		}
+		numMoves++;
+	}
+
+	if( moves ) {
+		moves[numMoves] = offset;
+	}
+	return numMoves;
+}
+
+/*
+* G_PmoveReplay_f
+*/
+void G_PmoveReplay_f( void ) {
+	char filename[MAX_QPATH];
+	int filenum, length;
+	int i, numMoves, numFailed;
+	uint8_t *data;
+	pmoveRecordFileHeader_t header;
+	const game_state_t savedGameState = gs.gameState;
+
+	if( trap_Cmd_Argc() != 2 ) {
+		G_Printf( "Usage: pmovereplay <name>\n" );
+		return;
+	}
+
+	Q_snprintfz( filename, sizeof( filename ), PMOVE_RECORD_DIRECTORY "/%s", trap_Cmd_Argv( 1 ) );
+	COM_SanitizeFilePath( filename );
+	COM_DefaultExtension( filename, PMOVE_RECORD_EXTENSION, sizeof( filename ) );
+
+	length = trap_FS_FOpenFile( filename, &filenum, FS_READ );
+	if( length < 0 || !filenum ) {
+		G_Printf( "Could not open %s\n", filename );
+		return;
+	}
+
+	data = ( uint8_t * )G_Malloc( length + 1 );
+	if( trap_FS_Read( data, length, filenum ) != length ) {
+		length = 0;
+	}
+	trap_FS_FCloseFile( filenum );
+
+	memset( &header, 0, sizeof( header ) );
+	memcpy( &header, data, Q_min( (size_t)length, sizeof( header ) ) );
+	if( memcmp( header.magic, PMOVE_RECORD_MAGIC, sizeof( header.magic ) ) ||
+		header.version != PMOVE_RECORD_VERSION ) {
+		G_Printf( "%s is not a valid record of player moves\n", filename );
+		G_Free( data );
+		return;
+	}
+
+	pmove_replayData = data;
+	pmove_replayDataSize = (size_t)length;
+
+	numMoves = G_PmoveReplay_Index( NULL, 0 );
+	if( numMoves < 0 ) {
+		G_Printf( "%s is malformed\n", filename );
+		G_Free( data );
+		pmove_replayData = NULL;
+		return;
+	}
+
+	pmove_replayMoves = ( size_t * )G_Malloc( ( numMoves + 1 ) * sizeof( *pmove_replayMoves ) );
+	G_PmoveReplay_Index( pmove_replayMoves, numMoves );
+
+	numFailed = 0;
+	for( i = 0; i < numMoves; i++ ) {
+		const char *error;
+		memcpy( &gs.gameState, pmove_replayData + pmove_replayMoves[i], sizeof( gs.gameState ) );
+		if( ( error = G_PmoveReplay_Move( pmove_replayMoves[i], pmove_replayMoves[i + 1] ) ) != NULL ) {
+			if( numFailed++ < 10 ) {
+				G_Printf( "Move %i: %s\n", i, error );
+			}
+		}
+	}
+
+	gs.gameState = savedGameState;
+
+	G_Printf( "%i moves replayed, %i mismatched\n", numMoves, numFailed );
+
+	G_Free( pmove_replayMoves );
+	G_Free( data );
+	pmove_replayMoves = NULL;
+	pmove_replayData = NULL;
+	pmove_replayDataSize = 0;
+}
@@ -20,7 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 // g_public.h -- game dll information visible to server
 
-#define GAME_API_VERSION    61
+#define GAME_API_VERSION    63
 
 //===============================================================
 
@@ -122,6 +122,11 @@ typedef struct {
 	void *( *Mem_Alloc )( size_t size, const char *filename, int fileline );
 	void ( *Mem_Free )( void *data, const char *filename, int fileline );
 
+	// per-frame scratch memory of the calling thread, valid until the next game frame
+	void *( *Mem_FrameAlloc )( size_t size );
+	size_t ( *Mem_FrameArenaMark )( void );
+	void ( *Mem_FrameArenaRelease )( size_t mark );
+
 	// console variable interaction
 	cvar_t *( *Cvar_Get )( const char *name, const char *value, int flags );
 	cvar_t *( *Cvar_Set )( const char *name, const char *value );
@@ -180,6 +185,11 @@ typedef struct {
 	// can vary in size from one game to another.
 	void ( *LocateEntities )( struct edict_s *edicts, int edict_size, int num_edicts, int max_edicts );
 
+	// executes job( item ) for every item in [0, numItems) using the engine job system
+	// and returns once all items are processed, the calling thread executes some items too
+	int ( *NumWorkerThreads )( void );
+	void ( *RunWorkerJobs )( void ( *job )( int item ), int numItems );
+
 	class QueryObject *( *MM_NewPostQuery )( const char *url );
 	class QueryObject *( *MM_NewGetQuery )( const char *url );
 	void ( *MM_DeleteQuery )( class QueryObject *query );
@@ -1293,6 +1293,11 @@ void G_AddServerCommands( void ) {
 	trap_Cmd_AddCommand( "dumpASapi", G_asDumpAPI_f );
 
 	trap_Cmd_AddCommand( "listlocations", Cmd_ListLocations_f );
+
+#ifndef PUBLIC_BUILD
+	trap_Cmd_AddCommand( "pmoverecord", G_PmoveRecord_f );
+	trap_Cmd_AddCommand( "pmovereplay", G_PmoveReplay_f );
+#endif
 }
 
 /*
@@ -1319,4 +1324,9 @@ void G_RemoveCommands( void ) {
 	trap_Cmd_RemoveCommand( "dumpASapi" );
 
 	trap_Cmd_RemoveCommand( "listlocations" );
+
+#ifndef PUBLIC_BUILD
+	trap_Cmd_RemoveCommand( "pmoverecord" );
+	trap_Cmd_RemoveCommand( "pmovereplay" );
+#endif
 }
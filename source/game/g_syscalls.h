@@ -154,6 +154,18 @@ static inline void trap_MemFree( void *data, const char *filename, int fileline
 	GAME_IMPORT.Mem_Free( data, filename, fileline );
 }
 
+static inline void *trap_MemFrameAlloc( size_t size ) {
+	return GAME_IMPORT.Mem_FrameAlloc( size );
+}
+
+static inline size_t trap_MemFrameArenaMark( void ) {
+	return GAME_IMPORT.Mem_FrameArenaMark();
+}
+
+static inline void trap_MemFrameArenaRelease( size_t mark ) {
+	GAME_IMPORT.Mem_FrameArenaRelease( mark );
+}
+
 // cvars
 static inline cvar_t *trap_Cvar_Get( const char *name, const char *value, int flags ) {
 	return GAME_IMPORT.Cvar_Get( name, value, flags );
@@ -296,6 +308,14 @@ static inline void trap_LocateEntities( struct edict_s *edicts, int edict_size,
 	GAME_IMPORT.LocateEntities( edicts, edict_size, num_edicts, max_edicts );
 }
 
+static inline int trap_NumWorkerThreads( void ) {
+	return GAME_IMPORT.NumWorkerThreads();
+}
+
+static inline void trap_RunWorkerJobs( void ( *job )( int item ), int numItems ) {
+	GAME_IMPORT.RunWorkerJobs( job, numItems );
+}
+
 // Matchmaking
 
 inline class QueryObject *trap_MM_NewGetQuery( const char *url ) {
@@ -1545,7 +1545,7 @@ void ClientThink( edict_t *ent, usercmd_t *ucmd, int timeDelta ) {
 	}
 
 	// perform a pmove
-	Pmove( &pm );
+	G_Pmove( &pm );
 
 	// save results of pmove
 	client->old_pmove = client->ps.pmove;
@@ -108,6 +108,48 @@ const float pm_failedwjbouncefactor = 0.1f;
 #define pm_wjminspeed ( ( pml.maxWalkSpeed + pml.maxPlayerSpeed ) * 0.5f )
 #endif
 
+/*
+* PM_Trace
+*/
+static void PM_Trace( trace_t *trace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end ) {
+	if( pm->trace ) {
+		pm->trace( trace, start, mins, maxs, end, pm->playerState->POVnum, pm->contentmask, 0 );
+	} else {
+		module_Trace( trace, start, mins, maxs, end, pm->playerState->POVnum, pm->contentmask, 0 );
+	}
+}
+
+/*
+* PM_PointContents
+*/
+static int PM_PointContents( const vec3_t point ) {
+	if( pm->pointContents ) {
+		return pm->pointContents( point, 0 );
+	}
+	return module_PointContents( point, 0 );
+}
+
+/*
+* PM_PredictedEvent
+*/
+static void PM_PredictedEvent( int ev, int parm ) {
+	if( pm->predictedEvent ) {
+		pm->predictedEvent( pm->playerState->POVnum, ev, parm );
+	} else {
+		module_PredictedEvent( pm->playerState->POVnum, ev, parm );
+	}
+}
+
+/*
+* PM_GetEntityState
+*/
+static entity_state_t *PM_GetEntityState( int entNum ) {
+	if( pm->getEntityState ) {
+		return pm->getEntityState( entNum, 0 );
+	}
+	return module_GetEntityState( entNum, 0 );
+}
+
 //
 // Kurim : some functions/defines that can be useful to work on the horizontal movement of player :
 //
@@ -156,7 +198,7 @@ static void PlayerTouchWall( int nbTestDir, float maxZnormal, vec3_t *normal ) {
 		mins[1] += pml.velocity[1] * 0.015f;
 	}
 	mins[2] = maxs[2] = 0;
-	module_Trace( &trace, pml.origin, mins, maxs, pml.origin, pm->playerState->POVnum, pm->contentmask, 0 );
+	PM_Trace( &trace, pml.origin, mins, maxs, pml.origin );
 	if( !trace.allsolid && trace.fraction == 1 ) {
 		return;
 	}
@@ -211,7 +253,7 @@ static void PlayerTouchWall( int nbTestDir, float maxZnormal, vec3_t *normal ) {
 		dir[1] = pml.origin[1] + dy * m + pml.velocity[1] * 0.015f;
 		dir[2] = pml.origin[2];
 
-		module_Trace( &trace, pml.origin, zero, zero, dir, pm->playerState->POVnum, pm->contentmask, 0 );
+		PM_Trace( &trace, pml.origin, zero, zero, dir );
 
 		if( trace.allsolid ) {
 			return;
@@ -225,7 +267,7 @@ static void PlayerTouchWall( int nbTestDir, float maxZnormal, vec3_t *normal ) {
 			continue;
 		}
 
-		if( trace.ent > 0 && module_GetEntityState( trace.ent, 0 )->type == ET_PLAYER ) {
+		if( trace.ent > 0 && PM_GetEntityState( trace.ent )->type == ET_PLAYER ) {
 			continue;
 		}
 
@@ -301,7 +343,7 @@ static int PM_SlideMove( void ) {
 
 	for( moves = 0; moves < maxmoves; moves++ ) {
 		VectorMA( pml.origin, remainingTime, pml.velocity, end );
-		module_Trace( &trace, pml.origin, pm->mins, pm->maxs, end, pm->playerState->POVnum, pm->contentmask, 0 );
+		PM_Trace( &trace, pml.origin, pm->mins, pm->maxs, end );
 		if( trace.allsolid ) { // trapped into a solid
 			VectorCopy( last_valid_origin, pml.origin );
 			return SLIDEMOVEFLAG_TRAPPED;
@@ -447,7 +489,7 @@ static void PM_StepSlideMove( void ) {
 	VectorCopy( start_o, up );
 	up[2] += STEPSIZE;
 
-	module_Trace( &trace, up, pm->mins, pm->maxs, up, pm->playerState->POVnum, pm->contentmask, 0 );
+	PM_Trace( &trace, up, pm->mins, pm->maxs, up );
 	if( trace.allsolid ) {
 		return; // can't step up
 
@@ -461,7 +503,7 @@ static void PM_StepSlideMove( void ) {
 	// push down the final amount
 	VectorCopy( pml.origin, down );
 	down[2] -= STEPSIZE;
-	module_Trace( &trace, pml.origin, pm->mins, pm->maxs, down, pm->playerState->POVnum, pm->contentmask, 0 );
+	PM_Trace( &trace, pml.origin, pm->mins, pm->maxs, down );
 	if( !trace.allsolid ) {
 		VectorCopy( trace.endpos, pml.origin );
 	}
@@ -988,7 +1030,7 @@ static void PM_GroundTrace( trace_t *trace ) {
 	point[1] = pml.origin[1];
 	point[2] = pml.origin[2] - 0.25;
 
-	module_Trace( trace, pml.origin, pm->mins, pm->maxs, point, pm->playerState->POVnum, pm->contentmask, 0 );
+	PM_Trace( trace, pml.origin, pm->mins, pm->maxs, point );
 }
 
 /*
@@ -999,7 +1041,7 @@ static bool PM_GoodPosition( vec3_t origin, trace_t *trace ) {
 		return true;
 	}
 
-	module_Trace( trace, origin, pm->mins, pm->maxs, origin, pm->playerState->POVnum, pm->contentmask, 0 );
+	PM_Trace( trace, origin, pm->mins, pm->maxs, origin );
 
 	return !trace->allsolid;
 }
@@ -1097,17 +1139,17 @@ static void PM_CategorizePosition( void ) {
 	point[0] = pml.origin[0];
 	point[1] = pml.origin[1];
 	point[2] = pml.origin[2] + pm->mins[2] + 1;
-	cont = module_PointContents( point, 0 );
+	cont = PM_PointContents( point );
 
 	if( cont & MASK_WATER ) {
 		pm->watertype = cont;
 		pm->waterlevel = 1;
 		point[2] = pml.origin[2] + pm->mins[2] + sample1;
-		cont = module_PointContents( point, 0 );
+		cont = PM_PointContents( point );
 		if( cont & MASK_WATER ) {
 			pm->waterlevel = 2;
 			point[2] = pml.origin[2] + pm->mins[2] + sample2;
-			cont = module_PointContents( point, 0 );
+			cont = PM_PointContents( point );
 			if( cont & MASK_WATER ) {
 				pm->waterlevel = 3;
 			}
@@ -1181,13 +1223,13 @@ static void PM_CheckJump( void ) {
 
 	//if( gs.module == GS_MODULE_GAME ) GS_Printf( "upvel %f\n", pml.velocity[2] );
 	if( pml.velocity[2] > 100 ) {
-		module_PredictedEvent( pm->playerState->POVnum, EV_DOUBLEJUMP, 0 );
+		PM_PredictedEvent( EV_DOUBLEJUMP, 0 );
 		pml.velocity[2] += pml.jumpPlayerSpeed;
 	} else if( pml.velocity[2] > 0 ) {
-		module_PredictedEvent( pm->playerState->POVnum, EV_JUMP, 0 );
+		PM_PredictedEvent( EV_JUMP, 0 );
 		pml.velocity[2] += pml.jumpPlayerSpeed;
 	} else {
-		module_PredictedEvent( pm->playerState->POVnum, EV_JUMP, 0 );
+		PM_PredictedEvent( EV_JUMP, 0 );
 		pml.velocity[2] = pml.jumpPlayerSpeed;
 	}
 
@@ -1273,14 +1315,14 @@ static void PM_CheckDash( void ) {
 		// return sound events
 		if( fabs( pml.sidePush ) > 10 && fabs( pml.sidePush ) >= fabs( pml.forwardPush ) ) {
 			if( pml.sidePush > 0 ) {
-				module_PredictedEvent( pm->playerState->POVnum, EV_DASH, 2 );
+				PM_PredictedEvent( EV_DASH, 2 );
 			} else {
-				module_PredictedEvent( pm->playerState->POVnum, EV_DASH, 1 );
+				PM_PredictedEvent( EV_DASH, 1 );
 			}
 		} else if( pml.forwardPush < -10 ) {
-			module_PredictedEvent( pm->playerState->POVnum, EV_DASH, 3 );
+			PM_PredictedEvent( EV_DASH, 3 );
 		} else {
-			module_PredictedEvent( pm->playerState->POVnum, EV_DASH, 0 );
+			PM_PredictedEvent( EV_DASH, 0 );
 		}
 	} else if( pm->groundentity == -1 ) {
 		pm->playerState->pmove.pm_flags &= ~PMF_DASHING;
@@ -1340,7 +1382,7 @@ static void PM_CheckWallJump( void ) {
 		// don't walljump if our height is smaller than a step
 		// unless jump is pressed or the player is moving faster than dash speed and upwards
 		hspeed = VectorLengthFast( tv( pml.velocity[0], pml.velocity[1], 0 ) );
-		module_Trace( &trace, pml.origin, pm->mins, pm->maxs, point, pm->playerState->POVnum, pm->contentmask, 0 );
+		PM_Trace( &trace, pml.origin, pm->mins, pm->maxs, point );
 
 		if( pml.upPush >= 10
 			|| ( hspeed > pm->playerState->pmove.stats[PM_STAT_DASHSPEED] && pml.velocity[2] > 8 )
@@ -1394,13 +1436,13 @@ static void PM_CheckWallJump( void ) {
 					pm->playerState->pmove.stats[PM_STAT_WJTIME] = PM_WALLJUMP_FAILED_TIMEDELAY;
 
 					// Create the event
-					module_PredictedEvent( pm->playerState->POVnum, EV_WALLJUMP_FAILED, DirToByte( normal ) );
+					PM_PredictedEvent( EV_WALLJUMP_FAILED, DirToByte( normal ) );
 				} else {
 					pm->playerState->pmove.stats[PM_STAT_WJTIME] = PM_WALLJUMP_TIMEDELAY;
 					pm->playerState->pmove.skim_time = PM_SKIM_TIME;
 
 					// Create the event
-					module_PredictedEvent( pm->playerState->POVnum, EV_WALLJUMP, DirToByte( normal ) );
+					PM_PredictedEvent( EV_WALLJUMP, DirToByte( normal ) );
 				}
 			}
 		}
@@ -1453,7 +1495,7 @@ static void PM_CheckSpecialMovement( void ) {
 	// check for ladder
 	if( !pm->skipCollision && !pm->skipLadders ) {
 		VectorMA( pml.origin, 1, pml.flatforward, spot );
-		module_Trace( &trace, pml.origin, pm->mins, pm->maxs, spot, pm->playerState->POVnum, pm->contentmask, 0 );
+		PM_Trace( &trace, pml.origin, pm->mins, pm->maxs, spot );
 		if( ( trace.fraction < 1 ) && ( trace.surfFlags & SURF_LADDER ) ) {
 			pml.ladder = true;
 			pm->ladder = true;
@@ -1467,13 +1509,13 @@ static void PM_CheckSpecialMovement( void ) {
 
 	VectorMA( pml.origin, 30, pml.flatforward, spot );
 	spot[2] += 4;
-	cont = module_PointContents( spot, 0 );
+	cont = PM_PointContents( spot );
 	if( !( cont & CONTENTS_SOLID ) ) {
 		return;
 	}
 
 	spot[2] += 16;
-	cont = module_PointContents( spot, 0 );
+	cont = PM_PointContents( spot );
 	if( cont ) {
 		return;
 	}
@@ -1570,7 +1612,7 @@ static void PM_FlyMove( bool doclip ) {
 		for( i = 0; i < 3; i++ )
 			end[i] = pml.origin[i] + pml.frametime * pml.velocity[i];
 
-		module_Trace( &trace, pml.origin, pm->mins, pm->maxs, end, pm->playerState->POVnum, pm->contentmask, 0 );
+		PM_Trace( &trace, pml.origin, pm->mins, pm->maxs, end );
 
 		VectorCopy( trace.endpos, pml.origin );
 	} else {
@@ -1665,7 +1707,7 @@ static void PM_AdjustBBox( void ) {
 		wishviewheight = playerbox_stand_viewheight - ( crouchFrac * ( playerbox_stand_viewheight - playerbox_crouch_viewheight ) );
 
 		// check that the head is not blocked
-		module_Trace( &trace, pml.origin, wishmins, wishmaxs, pml.origin, pm->playerState->POVnum, pm->contentmask, 0 );
+		PM_Trace( &trace, pml.origin, wishmins, wishmaxs, pml.origin );
 		if( trace.allsolid || trace.startsolid ) {
 			// can't do the uncrouching, let the time alone and use old position
 			VectorCopy( curmins, pm->mins );
@@ -2068,7 +2110,11 @@ void Pmove( pmove_t *pmove ) {
 	// We check the entire path between the origin before the pmove and the
 	// current origin to ensure no triggers are missed at high velocity.
 	// Note that this method assumes the movement has been linear.
-	module_PMoveTouchTriggers( pm, pml.previous_origin );
+	if( pm->touchTriggers ) {
+		pm->touchTriggers( pm, pml.previous_origin );
+	} else {
+		module_PMoveTouchTriggers( pm, pml.previous_origin );
+	}
 
 	PM_UpdateDeltaAngles(); // in case some trigger action has moved the view angles (like teleported).
 
@@ -2111,7 +2157,7 @@ void Pmove( pmove_t *pmove ) {
 				Q_clamp( damage, 0.0f, MAX_FALLING_DAMAGE );
 			}
 
-			module_PredictedEvent( pm->playerState->POVnum, EV_FALL, damage );
+			PM_PredictedEvent( EV_FALL, damage );
 		}
 
 		pm->playerState->pmove.pm_flags &= ~PMF_JUMPPAD_TIME;
@@ -455,7 +455,7 @@ typedef struct {
 	uint8_t weaponState;
 } player_state_t;
 
-typedef struct {
+typedef struct pmove_s {
 	// state (in / out)
 	player_state_t *playerState;
 
@@ -467,6 +467,14 @@ typedef struct {
 	// A flag for disabling occasional ladder usage for bots without intrusive changes to bot code (in)
 	bool skipLadders;
 
+	// Overrides of module callbacks for this move, module ones are used if these are null (in).
+	// The harness and bot prediction use these instead of swapping global module_* pointers around a move.
+	void ( *trace )( struct trace_s *t, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int ignore, int contentmask, int timeDelta );
+	int ( *pointContents )( const vec3_t point, int timeDelta );
+	void ( *predictedEvent )( int entNum, int ev, int parm );
+	void ( *touchTriggers )( struct pmove_s *pm, const vec3_t previous_origin );
+	struct entity_state_s *( *getEntityState )( int entNum, int deltaTime );
+
 	// results (out)
 	int numtouch;
 	int touchents[MAXTOUCH];
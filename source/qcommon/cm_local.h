@@ -196,22 +196,6 @@ struct cmodel_state_s {
 
 	uint8_t *cmod_base;
 
-	// cm_trace.c
-	cbrushside_t box_brushsides[6];
-	cbrush_t box_brush[1];
-	cbrush_t *box_markbrushes[1];
-	cmodel_t box_cmodel[1];
-
-	cbrushside_t oct_brushsides[10];
-	cbrush_t oct_brush[1];
-	cbrush_t *oct_markbrushes[1];
-	cmodel_t oct_cmodel[1];
-
-	mutable int leaf_count, leaf_maxcount;
-	mutable int *leaf_list;
-	mutable const float *leaf_mins, *leaf_maxs;
-	mutable int leaf_topnode;
-
 	struct CMTraceComputer *traceComputer;
 };
 
@@ -219,10 +203,6 @@ struct cmodel_state_s {
 
 struct CMTraceComputer *CM_GetTraceComputer( cmodel_state_t *cms );
 
-void CM_InitBoxHull( cmodel_state_t *cms );
-
-void CM_InitOctagonHull( cmodel_state_t *cms );
-
 void CM_BoundBrush( cmodel_state_t *cms, cbrush_t *brush );
 
 void CM_FloodAreaConnections( cmodel_state_t *cms );
@@ -32,6 +32,7 @@ static inline void CM_SetBuiltinBrushBounds( vec_bounds_t mins, vec_bounds_t max
 
 static CMGenericTraceComputer genericTraceComputer;
 static CMSse42TraceComputer sse42TraceComputer;
+static CMAvx2TraceComputer avx2TraceComputer;
 
 static CMTraceComputer *selectedTraceComputer = nullptr;
 
@@ -61,7 +62,11 @@ struct CMTraceComputer *CM_GetTraceComputer( cmodel_state_t *cms ) {
 	constexpr const char *featureDesc = "AVX";
 #endif
 
-	if( Sys_GetProcessorFeatures() & desiredFeatureFlags ) {
+	const unsigned features = Sys_GetProcessorFeatures();
+	if( features & Q_CPU_FEATURE_AVX2 ) {
+		Com_Printf( "AVX2 instructions are supported. An optimized collision code will be used\n" );
+		selectedTraceComputer = &avx2TraceComputer;
+	} else if( features & desiredFeatureFlags ) {
 		Com_Printf( "%s instructions are supported. An optimized collision code will be used\n", featureDesc );
 		selectedTraceComputer = &sse42TraceComputer;
 	} else {
@@ -73,31 +78,50 @@ struct CMTraceComputer *CM_GetTraceComputer( cmodel_state_t *cms ) {
 	return selectedTraceComputer;
 }
 
+// Box and octagon models are rewritten for every query, so each thread
+// that performs collision queries has its own copies of them.
+// These models do not depend on the map so they are not a part of the cmodel state.
+typedef struct {
+	cbrushside_t box_brushsides[6];
+	cbrush_t box_brush[1];
+	cbrush_t *box_markbrushes[1];
+	cmodel_t box_cmodel[1];
+
+	cbrushside_t oct_brushsides[10];
+	cbrush_t oct_brush[1];
+	cbrush_t *oct_markbrushes[1];
+	cmodel_t oct_cmodel[1];
+
+	bool initialized;
+} cm_builtinhulls_t;
+
+static thread_local cm_builtinhulls_t cm_builtinHulls;
+
 /*
 * CM_InitBoxHull
 *
 * Set up the planes so that the six floats of a bounding box
 * can just be stored out and get a proper clipping hull structure.
 */
-void CM_InitBoxHull( cmodel_state_t *cms ) {
-	cms->box_brush->numsides = 6;
-	cms->box_brush->brushsides = cms->box_brushsides;
-	cms->box_brush->contents = CONTENTS_BODY;
+static void CM_InitBoxHull( cm_builtinhulls_t *hulls ) {
+	hulls->box_brush->numsides = 6;
+	hulls->box_brush->brushsides = hulls->box_brushsides;
+	hulls->box_brush->contents = CONTENTS_BODY;
 
 	// Make sure CM_CollideBox() will not reject the brush by its bounds
-	CM_SetBuiltinBrushBounds( cms->box_brush->maxs, cms->box_brush->mins );
+	CM_SetBuiltinBrushBounds( hulls->box_brush->maxs, hulls->box_brush->mins );
 
-	cms->box_markbrushes[0] = cms->box_brush;
+	hulls->box_markbrushes[0] = hulls->box_brush;
 
-	cms->box_cmodel->builtin = true;
-	cms->box_cmodel->numfaces = 0;
-	cms->box_cmodel->faces = NULL;
-	cms->box_cmodel->brushes = cms->box_brush;
-	cms->box_cmodel->numbrushes = 1;
+	hulls->box_cmodel->builtin = true;
+	hulls->box_cmodel->numfaces = 0;
+	hulls->box_cmodel->faces = NULL;
+	hulls->box_cmodel->brushes = hulls->box_brush;
+	hulls->box_cmodel->numbrushes = 1;
 
 	for( int i = 0; i < 6; i++ ) {
 		// brush sides
-		cbrushside_t *s = cms->box_brushsides + i;
+		cbrushside_t *s = hulls->box_brushsides + i;
 
 		// planes
 		cplane_t tmp, *p = &tmp;
@@ -125,7 +149,7 @@ void CM_InitBoxHull( cmodel_state_t *cms ) {
 * Set up the planes so that the six floats of a bounding box
 * can just be stored out and get a proper clipping hull structure.
 */
-void CM_InitOctagonHull( cmodel_state_t *cms ) {
+static void CM_InitOctagonHull( cm_builtinhulls_t *hulls ) {
 	const vec3_t oct_dirs[4] = {
 		{  1,  1, 0 },
 		{ -1,  1, 0 },
@@ -133,25 +157,25 @@ void CM_InitOctagonHull( cmodel_state_t *cms ) {
 		{  1, -1, 0 }
 	};
 
-	cms->oct_brush->numsides = 10;
-	cms->oct_brush->brushsides = cms->oct_brushsides;
-	cms->oct_brush->contents = CONTENTS_BODY;
+	hulls->oct_brush->numsides = 10;
+	hulls->oct_brush->brushsides = hulls->oct_brushsides;
+	hulls->oct_brush->contents = CONTENTS_BODY;
 
 	// Make sure CM_CollideBox() will not reject the brush by its bounds
-	CM_SetBuiltinBrushBounds( cms->oct_brush->maxs, cms->oct_brush->mins );
+	CM_SetBuiltinBrushBounds( hulls->oct_brush->maxs, hulls->oct_brush->mins );
 
-	cms->oct_markbrushes[0] = cms->oct_brush;
+	hulls->oct_markbrushes[0] = hulls->oct_brush;
 
-	cms->oct_cmodel->builtin = true;
-	cms->oct_cmodel->numfaces = 0;
-	cms->oct_cmodel->faces = NULL;
-	cms->oct_cmodel->brushes = cms->oct_brush;
-	cms->oct_cmodel->numbrushes = 1;
+	hulls->oct_cmodel->builtin = true;
+	hulls->oct_cmodel->numfaces = 0;
+	hulls->oct_cmodel->faces = NULL;
+	hulls->oct_cmodel->brushes = hulls->oct_brush;
+	hulls->oct_cmodel->numbrushes = 1;
 
 	// axial planes
 	for( int i = 0; i < 6; i++ ) {
 		// brush sides
-		cbrushside_t *s = cms->oct_brushsides + i;
+		cbrushside_t *s = hulls->oct_brushsides + i;
 
 		// planes
 		cplane_t tmp, *p = &tmp;
@@ -175,7 +199,7 @@ void CM_InitOctagonHull( cmodel_state_t *cms ) {
 	// non-axial planes
 	for( int i = 6; i < 10; i++ ) {
 		// brush sides
-		cbrushside_t *s = cms->oct_brushsides + i;
+		cbrushside_t *s = hulls->oct_brushsides + i;
 
 		// planes
 		cplane_t tmp, *p = &tmp;
@@ -190,13 +214,29 @@ void CM_InitOctagonHull( cmodel_state_t *cms ) {
 	}
 }
 
+/*
+* CM_GetBuiltinHulls
+*/
+static cm_builtinhulls_t *CM_GetBuiltinHulls( void ) {
+	cm_builtinhulls_t *hulls = &cm_builtinHulls;
+
+	if( !hulls->initialized ) {
+		CM_InitBoxHull( hulls );
+		CM_InitOctagonHull( hulls );
+		hulls->initialized = true;
+	}
+	return hulls;
+}
+
 /*
 * CM_ModelForBBox
 *
 * To keep everything totally uniform, bounding boxes are turned into inline models
 */
 cmodel_t *CM_ModelForBBox( cmodel_state_t *cms, const vec3_t mins, const vec3_t maxs ) {
-	cbrushside_t *sides = cms->box_brush->brushsides;
+	cm_builtinhulls_t *hulls = CM_GetBuiltinHulls();
+
+	cbrushside_t *sides = hulls->box_brush->brushsides;
 	sides[0].plane.dist = maxs[0];
 	sides[1].plane.dist = -mins[0];
 	sides[2].plane.dist = maxs[1];
@@ -204,10 +244,10 @@ cmodel_t *CM_ModelForBBox( cmodel_state_t *cms, const vec3_t mins, const vec3_t
 	sides[4].plane.dist = maxs[2];
 	sides[5].plane.dist = -mins[2];
 
-	VectorCopy( mins, cms->box_cmodel->mins );
-	VectorCopy( maxs, cms->box_cmodel->maxs );
+	VectorCopy( mins, hulls->box_cmodel->mins );
+	VectorCopy( maxs, hulls->box_cmodel->maxs );
 
-	return cms->box_cmodel;
+	return hulls->box_cmodel;
 }
 
 /*
@@ -221,6 +261,7 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, const vec3_t mins, const
 	float a, b, d, t;
 	float sina, cosa;
 	vec3_t offset, size[2];
+	cm_builtinhulls_t *hulls = CM_GetBuiltinHulls();
 
 	for( i = 0; i < 3; i++ ) {
 		offset[i] = ( mins[i] + maxs[i] ) * 0.5;
@@ -228,11 +269,11 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, const vec3_t mins, const
 		size[1][i] = maxs[i] - offset[i];
 	}
 
-	VectorCopy( offset, cms->oct_cmodel->cyl_offset );
-	VectorCopy( size[0], cms->oct_cmodel->mins );
-	VectorCopy( size[1], cms->oct_cmodel->maxs );
+	VectorCopy( offset, hulls->oct_cmodel->cyl_offset );
+	VectorCopy( size[0], hulls->oct_cmodel->mins );
+	VectorCopy( size[1], hulls->oct_cmodel->maxs );
 
-	cbrushside_t *sides = cms->oct_brush->brushsides;
+	cbrushside_t *sides = hulls->oct_brush->brushsides;
 	sides[0].plane.dist = size[1][0];
 	sides[1].plane.dist = -size[0][0];
 	sides[2].plane.dist = size[1][1];
@@ -270,7 +311,7 @@ cmodel_t *CM_OctagonModelForBBox( cmodel_state_t *cms, const vec3_t mins, const
 	VectorSet( sides[9].plane.normal, cosa, -sina, 0 );
 	sides[9].plane.dist = d;
 
-	return cms->oct_cmodel;
+	return hulls->oct_cmodel;
 }
 
 /*
@@ -831,6 +872,36 @@ void CMTraceComputer::Trace( trace_t *tr, const vec3_t start, const vec3_t end,
 	}
 }
 
+void CMTraceComputer::TraceBatch( trace_t *traces, const vec3_t *starts, const vec3_t *ends, int numRays,
+								  const vec3_t mins, const vec3_t maxs, int brushmask, int topNodeHint ) {
+	for( int i = 0; i < numRays; i++ ) {
+		Trace( &traces[i], starts[i], ends[i], mins, maxs, cms->map_cmodels, brushmask, topNodeHint );
+	}
+}
+
+/*
+* CM_TraceBatch
+*/
+void CM_TraceBatch( const cmodel_state_t *cms, trace_t *traces,
+					const vec3_t *starts, const vec3_t *ends, int numRays,
+					const vec3_t mins, const vec3_t maxs, int brushmask,
+					int topNodeHint ) {
+	assert( topNodeHint >= 0 );
+
+	if( !traces || numRays <= 0 ) {
+		return;
+	}
+
+	if( !mins ) {
+		mins = vec3_origin;
+	}
+	if( !maxs ) {
+		maxs = vec3_origin;
+	}
+
+	cms->traceComputer->TraceBatch( traces, starts, ends, numRays, mins, maxs, brushmask, topNodeHint );
+}
+
 /*
 * CM_TransformedBoxTrace
 *
@@ -868,7 +939,7 @@ void CM_TransformedBoxTrace( const cmodel_state_t *cms, trace_t *tr,
 	}
 
 	// cylinder offset
-	if( cmodel == cms->oct_cmodel ) {
+	if( cmodel == cm_builtinHulls.oct_cmodel ) {
 		VectorSubtract( start, cmodel->cyl_offset, start_l );
 		VectorSubtract( end, cmodel->cyl_offset, end_l );
 	} else {
@@ -13,6 +13,26 @@ struct cmodel_s;
 #define DIST_EPSILON    ( 1.0f / 32.0f )
 #define RADIUS_EPSILON      1.0f
 
+#ifdef CM_USE_SSE
+/**
+ * Create this object in scopes that match boundaries
+ * of transition between regular SSE2 and VEX-encoded binary code.
+ * Compiling SIMD trace computers using MSVC requires AVX support and the code
+ * is VEX-encoded contrary to the rest of the codebase.
+ * This fence inserts instructions that help to avoid transition penalties.
+ */
+struct VexEncodingFence {
+#ifdef _MSC_VER
+	VexEncodingFence() {
+		_mm256_zeroupper();
+	}
+	~VexEncodingFence() {
+		_mm256_zeroupper();
+	}
+#endif
+};
+#endif
+
 struct CMTraceContext {
 	trace_t *trace;
 
@@ -63,6 +83,16 @@ struct CMTraceComputer {
 
 	void Trace( trace_t *tr, const vec3_t start, const vec3_t end, const vec3_t mins,
 				const vec3_t maxs, const cmodel_s *cmodel, int brushmask, int topNodeHint );
+
+	/**
+	 * Traces multiple boxes of the same size against the world model.
+	 * The default implementation just calls {@code Trace()} for every ray.
+	 * @note Rays that are passed in a single call are assumed to be related
+	 * (e.g. they have a common origin or just lie in the same part of the map)
+	 * so they can share a top node hint and a BSP walk in specialized implementations.
+	 */
+	virtual void TraceBatch( trace_t *traces, const vec3_t *starts, const vec3_t *ends, int numRays,
+							 const vec3_t mins, const vec3_t maxs, int brushmask, int topNodeHint );
 };
 
 struct CMGenericTraceComputer final: public CMTraceComputer {};
@@ -81,6 +111,41 @@ struct CMSse42TraceComputer final: public CMTraceComputer {
 
 	// Overrides a base member by hiding it
 	void ClipBoxToBrush( CMTraceContext *tlc, cbrush_s *brush );
+
+	// Uses CM_TraceBatch_SSE42()
+	void TraceBatch( trace_t *traces, const vec3_t *starts, const vec3_t *ends, int numRays,
+					 const vec3_t mins, const vec3_t maxs, int brushmask, int topNodeHint ) override;
+#endif
+};
+
+#ifdef CM_USE_SSE
+/**
+ * Walks the BSP once for packets of 4 rays and clips brushes against all rays of a packet at once.
+ * Rays that are position tests are traced by the computer.
+ * @note This is shared by all SIMD trace computers as the code requires SSE4.1 only.
+ */
+void CM_TraceBatch_SSE42( CMTraceComputer *computer, trace_t *traces, const vec3_t *starts, const vec3_t *ends,
+						  int numRays, const vec3_t mins, const vec3_t maxs, int brushmask, int topNodeHint );
+#endif
+
+struct CMAvx2TraceComputer final: public CMTraceComputer {
+	// Don't even bother about making prototypes if there is no attempt to compile SIMD code
+	// (this should aid calls devirtualization)
+#ifdef CM_USE_SSE
+	void SetupCollideContext( CMTraceContext *tlc, trace_t *tr, const vec_t *start, const vec_t *end,
+							  const vec_t *mins, const vec_t *maxs, int brushmask ) override;
+
+	// Tests bounds of 8 brushes at once
+	void ClipBoxToLeaf( CMTraceContext *tlc, cbrush_s *brushes, int numbrushes,
+						cface_s *markfaces, int nummarkfaces ) override;
+
+	// Overrides a base member by hiding it. Tests 8 brush sides at once.
+	void ClipBoxToBrush( CMTraceContext *tlc, cbrush_s *brush );
+
+	void TraceBatch( trace_t *traces, const vec3_t *starts, const vec3_t *ends, int numRays,
+					 const vec3_t mins, const vec3_t maxs, int brushmask, int topNodeHint ) override {
+		CM_TraceBatch_SSE42( this, traces, starts, ends, numRays, mins, maxs, brushmask, topNodeHint );
+	}
 #endif
 };
 
@@ -0,0 +1,301 @@
+#include "qcommon.h"
+#include "cm_local.h"
+#include "cm_trace.h"
+
+#include <cstddef>
+
+#ifdef CM_USE_SSE
+
+static inline int CM_LowestBitIndex( unsigned mask ) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward( &index, mask );
+	return (int)index;
+#else
+	return __builtin_ctz( mask );
+#endif
+}
+
+static inline bool CM_MightCollideInLeaf_AVX2( const vec_bounds_t shapeMins,
+											   const vec_bounds_t shapeMaxs,
+											   const vec_bounds_t shapeCenter,
+											   float shapeRadius,
+											   const CMTraceContext *tlc ) {
+	__m128 xmmShapeMins = _mm_loadu_ps( shapeMins );
+	__m128 xmmShapeMaxs = _mm_loadu_ps( shapeMaxs );
+
+	__m128 cmp1 = _mm_cmpge_ps( xmmShapeMins, tlc->xmmAbsmaxs );
+	__m128 cmp2 = _mm_cmpge_ps( tlc->xmmAbsmins, xmmShapeMaxs );
+	if( _mm_movemask_ps( _mm_or_ps( cmp1, cmp2 ) ) ) {
+		return false;
+	}
+
+	vec3_t centerToStart;
+	vec3_t proj, perp;
+
+	VectorSubtract( tlc->start, shapeCenter, centerToStart );
+	float projMagnitude = DotProduct( centerToStart, tlc->traceDir );
+	VectorScale( tlc->traceDir, projMagnitude, proj );
+	VectorSubtract( centerToStart, proj, perp );
+	float distanceThreshold = shapeRadius + tlc->boxRadius;
+	return VectorLengthSquared( perp ) <= distanceThreshold * distanceThreshold;
+}
+
+/**
+ * Tests bounds and bounding spheres of up to 8 consecutive brushes against the trace at once.
+ * @return a mask of brushes that have matching contents and might collide with the trace
+ */
+static inline unsigned CM_MightCollideBrushes_AVX2( const cbrush_t *brushes, int numbrushes, const CMTraceContext *tlc ) {
+	const __m256i ymmOffsets = _mm256_mullo_epi32( _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ),
+												   _mm256_set1_epi32( (int)sizeof( cbrush_t ) ) );
+	const __m256i ymmLanes = _mm256_cmpgt_epi32( _mm256_set1_epi32( numbrushes ), _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+
+	const char *base = (const char *)brushes;
+	const __m256i ymmContents = _mm256_mask_i32gather_epi32( _mm256_setzero_si256(),
+															 (const int *)( base + offsetof( cbrush_t, contents ) ),
+															 ymmOffsets, ymmLanes, 1 );
+	__m256i ymmMatches = _mm256_and_si256( ymmContents, _mm256_set1_epi32( tlc->contents ) );
+	ymmMatches = _mm256_andnot_si256( _mm256_cmpeq_epi32( ymmMatches, _mm256_setzero_si256() ), ymmLanes );
+	if( !_mm256_movemask_epi8( ymmMatches ) ) {
+		return 0;
+	}
+
+	__m256 ymmSeparated = _mm256_setzero_ps();
+	const __m256 ymmMask = _mm256_castsi256_ps( ymmMatches );
+	for( int i = 0; i < 3; i++ ) {
+		const float *mins = (const float *)( base + offsetof( cbrush_t, mins ) ) + i;
+		const float *maxs = (const float *)( base + offsetof( cbrush_t, maxs ) ) + i;
+		__m256 ymmMins = _mm256_mask_i32gather_ps( _mm256_setzero_ps(), mins, ymmOffsets, ymmMask, 1 );
+		__m256 ymmMaxs = _mm256_mask_i32gather_ps( _mm256_setzero_ps(), maxs, ymmOffsets, ymmMask, 1 );
+		__m256 ymmCmp1 = _mm256_cmp_ps( ymmMins, _mm256_set1_ps( tlc->absmaxs[i] ), _CMP_GE_OQ );
+		__m256 ymmCmp2 = _mm256_cmp_ps( _mm256_set1_ps( tlc->absmins[i] ), ymmMaxs, _CMP_GE_OQ );
+		ymmSeparated = _mm256_or_ps( ymmSeparated, _mm256_or_ps( ymmCmp1, ymmCmp2 ) );
+	}
+
+	const __m256 ymmBoundsMask = _mm256_andnot_ps( ymmSeparated, ymmMask );
+	if( !_mm256_movemask_ps( ymmBoundsMask ) ) {
+		return 0;
+	}
+
+	// reject brushes which bounding sphere is too far from the trace line
+	__m256 ymmCenterToStart[3];
+	__m256 ymmProjMagnitude = _mm256_setzero_ps();
+	for( int i = 0; i < 3; i++ ) {
+		const float *center = (const float *)( base + offsetof( cbrush_t, center ) ) + i;
+		__m256 ymmCenter = _mm256_mask_i32gather_ps( _mm256_setzero_ps(), center, ymmOffsets, ymmBoundsMask, 1 );
+		ymmCenterToStart[i] = _mm256_sub_ps( _mm256_set1_ps( tlc->start[i] ), ymmCenter );
+		ymmProjMagnitude = _mm256_add_ps( ymmProjMagnitude, _mm256_mul_ps( ymmCenterToStart[i], _mm256_set1_ps( tlc->traceDir[i] ) ) );
+	}
+
+	__m256 ymmPerpLengthSquared = _mm256_setzero_ps();
+	for( int i = 0; i < 3; i++ ) {
+		__m256 ymmProj = _mm256_mul_ps( _mm256_set1_ps( tlc->traceDir[i] ), ymmProjMagnitude );
+		__m256 ymmPerp = _mm256_sub_ps( ymmCenterToStart[i], ymmProj );
+		ymmPerpLengthSquared = _mm256_add_ps( ymmPerpLengthSquared, _mm256_mul_ps( ymmPerp, ymmPerp ) );
+	}
+
+	const float *radius = (const float *)( base + offsetof( cbrush_t, radius ) );
+	__m256 ymmRadius = _mm256_mask_i32gather_ps( _mm256_setzero_ps(), radius, ymmOffsets, ymmBoundsMask, 1 );
+	__m256 ymmThreshold = _mm256_add_ps( ymmRadius, _mm256_set1_ps( tlc->boxRadius ) );
+	__m256 ymmNear = _mm256_cmp_ps( ymmPerpLengthSquared, _mm256_mul_ps( ymmThreshold, ymmThreshold ), _CMP_LE_OQ );
+
+	return (unsigned)_mm256_movemask_ps( _mm256_and_ps( ymmNear, ymmBoundsMask ) );
+}
+
+void CMAvx2TraceComputer::ClipBoxToLeaf( CMTraceContext *tlc, cbrush_t *brushes,
+										 int numbrushes, cface_t *markfaces, int nummarkfaces ) {
+	volatile VexEncodingFence fence;
+	(void)fence;
+
+	int i, j;
+	cbrush_t *b;
+	cface_t *patch;
+	cbrush_t *facet;
+
+	// Save the exact address to avoid pointer chasing in loops
+	const float *fraction = &tlc->trace->fraction;
+
+	// trace line against all brushes, test 8 brushes at once
+	for( i = 0; i < numbrushes; i += 8 ) {
+		unsigned mask = CM_MightCollideBrushes_AVX2( brushes + i, numbrushes - i, tlc );
+		while( mask ) {
+			b = &brushes[i + CM_LowestBitIndex( mask )];
+			mask &= mask - 1;
+
+			// Specify the "overridden" method explicitly
+			CMAvx2TraceComputer::ClipBoxToBrush( tlc, b );
+			if( !*fraction ) {
+				return;
+			}
+		}
+	}
+
+	// trace line against all patches
+	for( i = 0; i < nummarkfaces; i++ ) {
+		patch = &markfaces[i];
+		if( !( patch->contents & tlc->contents ) ) {
+			continue;
+		}
+		if( !CM_MightCollideInLeaf_AVX2( patch->mins, patch->maxs, patch->center, patch->radius, tlc ) ) {
+			continue;
+		}
+		facet = patch->facets;
+		for( j = 0; j < patch->numfacets; j++, facet++ ) {
+			if( !CM_MightCollideInLeaf_AVX2( facet->mins, facet->maxs, facet->center, facet->radius, tlc ) ) {
+				continue;
+			}
+			// Specify the "overridden" method explicitly
+			CMAvx2TraceComputer::ClipBoxToBrush( tlc, facet );
+			if( !*fraction ) {
+				return;
+			}
+		}
+	}
+}
+
+void CMAvx2TraceComputer::ClipBoxToBrush( CMTraceContext *tlc, cbrush_t *brush ) {
+	if( !brush->numsides ) {
+		return;
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 minusOne = _mm256_set1_ps( -1.0f );
+	const __m256 distEpsilon = _mm256_set1_ps( DIST_EPSILON );
+	const __m256i laneNums = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+	const __m256i offsets = _mm256_mullo_epi32( laneNums, _mm256_set1_epi32( (int)sizeof( cbrushside_t ) ) );
+
+	// A corner of the box that should be used for a plane is selected by plane signbits.
+	// Note: this handles axial planes as well since their normals have a single unit component.
+	const __m256 startmins[3] = {
+		_mm256_set1_ps( tlc->startmins[0] ), _mm256_set1_ps( tlc->startmins[1] ), _mm256_set1_ps( tlc->startmins[2] )
+	};
+	const __m256 startmaxs[3] = {
+		_mm256_set1_ps( tlc->startmaxs[0] ), _mm256_set1_ps( tlc->startmaxs[1] ), _mm256_set1_ps( tlc->startmaxs[2] )
+	};
+	const __m256 endmins[3] = {
+		_mm256_set1_ps( tlc->endmins[0] ), _mm256_set1_ps( tlc->endmins[1] ), _mm256_set1_ps( tlc->endmins[2] )
+	};
+	const __m256 endmaxs[3] = {
+		_mm256_set1_ps( tlc->endmaxs[0] ), _mm256_set1_ps( tlc->endmaxs[1] ), _mm256_set1_ps( tlc->endmaxs[2] )
+	};
+
+	float enterfrac = -1;
+	float leavefrac = 1;
+	int leadSideNum = -1;
+	bool getout = false;
+	bool startout = false;
+
+	const cbrushside_t *sides = brush->brushsides;
+	for( int sideNum = 0, end = brush->numsides; sideNum < end; sideNum += 8 ) {
+		const char *base = (const char *)( sides + sideNum );
+		const __m256i lanes = _mm256_cmpgt_epi32( _mm256_set1_epi32( end - sideNum ), laneNums );
+		const __m256 lanesMask = _mm256_castsi256_ps( lanes );
+
+		// type and signbits are adjacent shorts, signbits are in the high half
+		__m256i signbits = _mm256_mask_i32gather_epi32( _mm256_setzero_si256(),
+														(const int *)( base + offsetof( cbrushside_t, plane.type ) ),
+														offsets, lanes, 1 );
+		signbits = _mm256_srli_epi32( signbits, 16 );
+		const __m256 dist = _mm256_mask_i32gather_ps( zero, (const float *)( base + offsetof( cbrushside_t, plane.dist ) ),
+													  offsets, lanesMask, 1 );
+
+		__m256 d1 = _mm256_sub_ps( zero, dist );
+		__m256 d2 = d1;
+		for( int i = 0; i < 3; i++ ) {
+			const float *normalBase = (const float *)( base + offsetof( cbrushside_t, plane.normal ) ) + i;
+			__m256 normal = _mm256_mask_i32gather_ps( zero, normalBase, offsets, lanesMask, 1 );
+			__m256i bit = _mm256_set1_epi32( 1 << i );
+			__m256 useMaxs = _mm256_castsi256_ps( _mm256_cmpeq_epi32( _mm256_and_si256( signbits, bit ), bit ) );
+			__m256 startCorner = _mm256_blendv_ps( startmins[i], startmaxs[i], useMaxs );
+			__m256 endCorner = _mm256_blendv_ps( endmins[i], endmaxs[i], useMaxs );
+			d1 = _mm256_add_ps( d1, _mm256_mul_ps( normal, startCorner ) );
+			d2 = _mm256_add_ps( d2, _mm256_mul_ps( normal, endCorner ) );
+		}
+
+		// Make unused lanes look like sides that are behind both points, they do not affect anything in this case
+		d1 = _mm256_blendv_ps( minusOne, d1, lanesMask );
+		d2 = _mm256_blendv_ps( minusOne, d2, lanesMask );
+
+		__m256 d1Positive = _mm256_cmp_ps( d1, zero, _CMP_GT_OQ );
+		__m256 d2Positive = _mm256_cmp_ps( d2, zero, _CMP_GT_OQ );
+
+		// if completely in front of any face, no intersection
+		if( _mm256_movemask_ps( _mm256_and_ps( d1Positive, _mm256_cmp_ps( d2, d1, _CMP_GE_OQ ) ) ) ) {
+			return;
+		}
+
+		if( _mm256_movemask_ps( d2Positive ) ) {
+			getout = true; // endpoint is not in solid
+		}
+		if( _mm256_movemask_ps( d1Positive ) ) {
+			startout = true;
+		}
+
+		// crosses face
+		__m256 crosses = _mm256_or_ps( d1Positive, d2Positive );
+		__m256 f = _mm256_sub_ps( d1, d2 );
+		// Values in lanes that do not pass masks are discarded, so a division by zero there is harmless
+		__m256 enterMask = _mm256_and_ps( crosses, _mm256_cmp_ps( f, zero, _CMP_GT_OQ ) );
+		__m256 leaveMask = _mm256_and_ps( crosses, _mm256_cmp_ps( f, zero, _CMP_LT_OQ ) );
+		__m256 fEnter = _mm256_div_ps( _mm256_sub_ps( d1, distEpsilon ), f );
+		__m256 fLeave = _mm256_div_ps( _mm256_add_ps( d1, distEpsilon ), f );
+
+		// Find the first maximal enter fraction in this group of sides
+		fEnter = _mm256_blendv_ps( _mm256_set1_ps( -2.0f ), fEnter, enterMask );
+		__m256 maxEnter = _mm256_max_ps( fEnter, _mm256_permute2f128_ps( fEnter, fEnter, 1 ) );
+		maxEnter = _mm256_max_ps( maxEnter, _mm256_permute_ps( maxEnter, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+		maxEnter = _mm256_max_ps( maxEnter, _mm256_permute_ps( maxEnter, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+		const float groupEnterfrac = _mm256_cvtss_f32( maxEnter );
+		if( groupEnterfrac > enterfrac ) {
+			enterfrac = groupEnterfrac;
+			leadSideNum = sideNum + CM_LowestBitIndex( (unsigned)_mm256_movemask_ps( _mm256_cmp_ps( fEnter, maxEnter, _CMP_EQ_OQ ) ) );
+		}
+
+		fLeave = _mm256_blendv_ps( _mm256_set1_ps( 2.0f ), fLeave, leaveMask );
+		__m256 minLeave = _mm256_min_ps( fLeave, _mm256_permute2f128_ps( fLeave, fLeave, 1 ) );
+		minLeave = _mm256_min_ps( minLeave, _mm256_permute_ps( minLeave, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+		minLeave = _mm256_min_ps( minLeave, _mm256_permute_ps( minLeave, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+		const float groupLeavefrac = _mm256_cvtss_f32( minLeave );
+		if( groupLeavefrac < leavefrac ) {
+			leavefrac = groupLeavefrac;
+		}
+	}
+
+	if( !startout ) {
+		// original point was inside brush
+		tlc->trace->startsolid = true;
+		tlc->trace->contents = brush->contents;
+		if( !getout ) {
+			tlc->trace->allsolid = true;
+			tlc->trace->fraction = 0;
+		}
+		return;
+	}
+	if( enterfrac - ( 1.0f / 1024.0f ) <= leavefrac ) {
+		if( enterfrac > -1 && enterfrac < tlc->trace->fraction ) {
+			if( enterfrac < 0 ) {
+				enterfrac = 0;
+			}
+			const cbrushside_t *leadside = sides + leadSideNum;
+			tlc->trace->fraction = enterfrac;
+			CM_CopyCMToRawPlane( &leadside->plane, &tlc->trace->plane );
+			tlc->trace->surfFlags = leadside->surfFlags;
+			tlc->trace->contents = brush->contents;
+		}
+	}
+}
+
+void CMAvx2TraceComputer::SetupCollideContext( CMTraceContext *tlc, trace_t *tr,
+											   const vec_t *start, const vec3_t end,
+											   const vec3_t mins, const vec3_t maxs, int brushmask ) {
+	CMTraceComputer::SetupCollideContext( tlc, tr, start, end, mins, maxs, brushmask );
+	// Put the fence after the super method call (that does not use VEX encoding)
+	volatile VexEncodingFence fence;
+	(void)fence;
+
+	// Always set xmm trace bounds since it is used by all code paths, leaf-optimized and generic
+	tlc->xmmAbsmins = _mm_setr_ps( tlc->absmins[0], tlc->absmins[1], tlc->absmins[2], 0 );
+	tlc->xmmAbsmaxs = _mm_setr_ps( tlc->absmaxs[0], tlc->absmaxs[1], tlc->absmaxs[2], 1 );
+}
+
+#endif
@@ -4,24 +4,6 @@
 
 #ifdef CM_USE_SSE
 
-/**
- * Create this object in scopes that match boundaries
- * of transition between regular SSE2 and VEX-encoded binary code.
- * Compiling this file using MSVC requires AVX support and the code
- * is VEX-encoded contrary to the rest of the codebase.
- * This fence inserts instructions that help to avoid transition penalties.
- */
-struct VexEncodingFence {
-#ifdef _MSC_VER
-	VexEncodingFence() {
-		_mm256_zeroupper();
-	}
-	~VexEncodingFence() {
-		_mm256_zeroupper();
-	}
-#endif
-};
-
 static inline bool CM_BoundsIntersect_SSE42( __m128 traceAbsmins, __m128 traceAbsmaxs,
 											 const vec4_t shapeMins, const vec4_t shapeMaxs ) {
 	// This version relies on fast unaligned loads, that's why it requires SSE4.
@@ -263,4 +245,471 @@ void CMSse42TraceComputer::SetupCollideContext( CMTraceContext *tlc, trace_t *tr
 	tlc->xmmAbsmaxs = _mm_setr_ps( tlc->absmaxs[0], tlc->absmaxs[1], tlc->absmaxs[2], 1 );
 }
 
-#endif
\ No newline at end of file
+/**
+ * A packet of up to 4 rays that share box dimensions and are traced together.
+ * Per-ray data that is used in vectorized tests is stored as structure-of-arrays.
+ */
+struct alignas( 16 ) CMTracePacket {
+	__m128 startX, startY, startZ;
+	__m128 endX, endY, endZ;
+	__m128 absminsX, absminsY, absminsZ;
+	__m128 absmaxsX, absmaxsY, absmaxsZ;
+	// Corners of the shared box that should be used for a plane with the given signbits
+	__m128 cornerLookup[8];
+
+	trace_t *traces[4];
+	vec3_t extents;
+	int contents;
+	int numRays;
+	bool ispoint;
+
+	/**
+	 * Gets a mask of rays that have not been fully blocked yet.
+	 */
+	int LiveRaysMask( int laneMask ) const {
+		for( int i = 0; i < numRays; i++ ) {
+			if( !traces[i]->fraction ) {
+				laneMask &= ~( 1 << i );
+			}
+		}
+		return laneMask;
+	}
+};
+
+/**
+ * Remaining parts of packet rays that are passed down the BSP tree.
+ */
+struct CMPacketSegments {
+	float p1f[4], p2f[4];
+	vec3_t p1[4], p2[4];
+
+	void CopySegment( int lane, const CMPacketSegments &from ) {
+		p1f[lane] = from.p1f[lane];
+		p2f[lane] = from.p2f[lane];
+		VectorCopy( from.p1[lane], p1[lane] );
+		VectorCopy( from.p2[lane], p2[lane] );
+	}
+
+	void SetSegment( int lane, float p1f_, float p2f_, const vec3_t p1_, const vec3_t p2_ ) {
+		p1f[lane] = p1f_;
+		p2f[lane] = p2f_;
+		VectorCopy( p1_, p1[lane] );
+		VectorCopy( p2_, p2[lane] );
+	}
+};
+
+static const __m128 cm_laneMaskLookup[16] = {
+#define CM_LANE( i, bit ) ( ( ( i ) & ( 1 << ( bit ) ) ) ? -1 : 0 )
+#define CM_LANES( i ) _mm_castsi128_ps( _mm_setr_epi32( CM_LANE( i, 0 ), CM_LANE( i, 1 ), CM_LANE( i, 2 ), CM_LANE( i, 3 ) ) )
+	CM_LANES( 0 ), CM_LANES( 1 ), CM_LANES( 2 ), CM_LANES( 3 ),
+	CM_LANES( 4 ), CM_LANES( 5 ), CM_LANES( 6 ), CM_LANES( 7 ),
+	CM_LANES( 8 ), CM_LANES( 9 ), CM_LANES( 10 ), CM_LANES( 11 ),
+	CM_LANES( 12 ), CM_LANES( 13 ), CM_LANES( 14 ), CM_LANES( 15 )
+#undef CM_LANES
+#undef CM_LANE
+};
+
+/**
+ * Tests shape bounds against bounds of all packet rays at once.
+ * @return a mask of rays that might collide with the shape
+ */
+static inline int CM_MightCollideInPacket_SSE42( const vec_bounds_t shapeMins, const vec_bounds_t shapeMaxs,
+												 const CMTracePacket *packet ) {
+	__m128 xmmMinsX = _mm_set1_ps( shapeMins[0] ), xmmMaxsX = _mm_set1_ps( shapeMaxs[0] );
+	__m128 xmmMinsY = _mm_set1_ps( shapeMins[1] ), xmmMaxsY = _mm_set1_ps( shapeMaxs[1] );
+	__m128 xmmMinsZ = _mm_set1_ps( shapeMins[2] ), xmmMaxsZ = _mm_set1_ps( shapeMaxs[2] );
+
+	__m128 separated = _mm_or_ps( _mm_cmpge_ps( xmmMinsX, packet->absmaxsX ), _mm_cmpge_ps( packet->absminsX, xmmMaxsX ) );
+	separated = _mm_or_ps( separated, _mm_cmpge_ps( xmmMinsY, packet->absmaxsY ) );
+	separated = _mm_or_ps( separated, _mm_cmpge_ps( packet->absminsY, xmmMaxsY ) );
+	separated = _mm_or_ps( separated, _mm_cmpge_ps( xmmMinsZ, packet->absmaxsZ ) );
+	separated = _mm_or_ps( separated, _mm_cmpge_ps( packet->absminsZ, xmmMaxsZ ) );
+
+	return ~_mm_movemask_ps( separated ) & 0xF;
+}
+
+/**
+ * A vectorized version of {@code CMTraceComputer::ClipBoxToBrush()} that clips the brush against 4 rays at once.
+ */
+static void CM_ClipBoxToBrushPacket_SSE42( CMTracePacket *packet, cbrush_t *brush, int laneMask ) {
+	if( !brush->numsides ) {
+		return;
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 distEpsilon = _mm_set1_ps( DIST_EPSILON );
+
+	__m128 alive = cm_laneMaskLookup[laneMask];
+	__m128 enterfrac = _mm_set1_ps( -1.0f );
+	__m128 leavefrac = _mm_set1_ps( 1.0f );
+	__m128 leadSideNum = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+	__m128 getout = zero;
+	__m128 startout = zero;
+
+	const cbrushside_t *side = brush->brushsides;
+	for( int i = 0, end = brush->numsides; i < end; i++, side++ ) {
+		const cm_plane_t *p = &side->plane;
+		__m128 xmmNormal = _mm_loadu_ps( p->normal );
+		// The box corner offset along the normal is the same for all rays.
+		// Note: this handles axial planes as well since their normals have a single unit component.
+		float offset = _mm_cvtss_f32( _mm_dp_ps( packet->cornerLookup[p->signbits & 7], xmmNormal, 0x71 ) ) - p->dist;
+
+		__m128 nx = _mm_set1_ps( p->normal[0] );
+		__m128 ny = _mm_set1_ps( p->normal[1] );
+		__m128 nz = _mm_set1_ps( p->normal[2] );
+		__m128 xmmOffset = _mm_set1_ps( offset );
+
+		__m128 d1 = _mm_add_ps( _mm_mul_ps( nx, packet->startX ), _mm_mul_ps( ny, packet->startY ) );
+		__m128 d2 = _mm_add_ps( _mm_mul_ps( nx, packet->endX ), _mm_mul_ps( ny, packet->endY ) );
+		d1 = _mm_add_ps( _mm_add_ps( d1, _mm_mul_ps( nz, packet->startZ ) ), xmmOffset );
+		d2 = _mm_add_ps( _mm_add_ps( d2, _mm_mul_ps( nz, packet->endZ ) ), xmmOffset );
+
+		__m128 d1Positive = _mm_cmpgt_ps( d1, zero );
+		__m128 d2Positive = _mm_cmpgt_ps( d2, zero );
+		getout = _mm_or_ps( getout, d2Positive );   // endpoint is not in solid
+		startout = _mm_or_ps( startout, d1Positive );
+
+		// if completely in front of face, no intersection
+		alive = _mm_andnot_ps( _mm_and_ps( d1Positive, _mm_cmpge_ps( d2, d1 ) ), alive );
+		if( !_mm_movemask_ps( alive ) ) {
+			return;
+		}
+
+		// crosses face
+		__m128 crosses = _mm_and_ps( alive, _mm_or_ps( d1Positive, d2Positive ) );
+		__m128 f = _mm_sub_ps( d1, d2 );
+		// Values in lanes that do not pass masks are discarded, so a division by zero there is harmless
+		__m128 enterMask = _mm_and_ps( crosses, _mm_cmpgt_ps( f, zero ) );
+		__m128 leaveMask = _mm_and_ps( crosses, _mm_cmplt_ps( f, zero ) );
+		__m128 fEnter = _mm_div_ps( _mm_sub_ps( d1, distEpsilon ), f );
+		__m128 fLeave = _mm_div_ps( _mm_add_ps( d1, distEpsilon ), f );
+
+		enterMask = _mm_and_ps( enterMask, _mm_cmpgt_ps( fEnter, enterfrac ) );
+		enterfrac = _mm_blendv_ps( enterfrac, fEnter, enterMask );
+		leadSideNum = _mm_blendv_ps( leadSideNum, _mm_castsi128_ps( _mm_set1_epi32( i ) ), enterMask );
+
+		leaveMask = _mm_and_ps( leaveMask, _mm_cmplt_ps( fLeave, leavefrac ) );
+		leavefrac = _mm_blendv_ps( leavefrac, fLeave, leaveMask );
+	}
+
+	alignas( 16 ) float enterfracs[4], leavefracs[4];
+	alignas( 16 ) int leadSideNums[4];
+	_mm_store_ps( enterfracs, enterfrac );
+	_mm_store_ps( leavefracs, leavefrac );
+	_mm_store_si128( (__m128i *)leadSideNums, _mm_castps_si128( leadSideNum ) );
+
+	const int aliveMask = _mm_movemask_ps( alive );
+	const int getoutMask = _mm_movemask_ps( getout );
+	const int startoutMask = _mm_movemask_ps( startout );
+	for( int i = 0; i < packet->numRays; i++ ) {
+		if( !( aliveMask & ( 1 << i ) ) ) {
+			continue;
+		}
+
+		trace_t *trace = packet->traces[i];
+		if( !( startoutMask & ( 1 << i ) ) ) {
+			// original point was inside brush
+			trace->startsolid = true;
+			trace->contents = brush->contents;
+			if( !( getoutMask & ( 1 << i ) ) ) {
+				trace->allsolid = true;
+				trace->fraction = 0;
+			}
+			continue;
+		}
+
+		float enterfrac_ = enterfracs[i];
+		if( enterfrac_ - ( 1.0f / 1024.0f ) <= leavefracs[i] ) {
+			if( enterfrac_ > -1 && enterfrac_ < trace->fraction ) {
+				if( enterfrac_ < 0 ) {
+					enterfrac_ = 0;
+				}
+				const cbrushside_t *leadside = brush->brushsides + leadSideNums[i];
+				trace->fraction = enterfrac_;
+				CM_CopyCMToRawPlane( &leadside->plane, &trace->plane );
+				trace->surfFlags = leadside->surfFlags;
+				trace->contents = brush->contents;
+			}
+		}
+	}
+}
+
+static void CM_ClipBoxToLeafPacket_SSE42( CMTracePacket *packet, const cleaf_t *leaf, int laneMask ) {
+	int i, j, mask;
+	const cbrush_t *b;
+	const cface_t *patch;
+	cbrush_t *facet;
+
+	// trace lines against all brushes
+	for( i = 0; i < leaf->numbrushes; i++ ) {
+		b = &leaf->brushes[i];
+		if( !( b->contents & packet->contents ) ) {
+			continue;
+		}
+		if( !( mask = CM_MightCollideInPacket_SSE42( b->mins, b->maxs, packet ) & laneMask ) ) {
+			continue;
+		}
+		CM_ClipBoxToBrushPacket_SSE42( packet, leaf->brushes + i, mask );
+		if( !( laneMask = packet->LiveRaysMask( laneMask ) ) ) {
+			return;
+		}
+	}
+
+	// trace lines against all patches
+	for( i = 0; i < leaf->numfaces; i++ ) {
+		patch = &leaf->faces[i];
+		if( !( patch->contents & packet->contents ) ) {
+			continue;
+		}
+		if( !( CM_MightCollideInPacket_SSE42( patch->mins, patch->maxs, packet ) & laneMask ) ) {
+			continue;
+		}
+		facet = patch->facets;
+		for( j = 0; j < patch->numfacets; j++, facet++ ) {
+			if( !( mask = CM_MightCollideInPacket_SSE42( facet->mins, facet->maxs, packet ) & laneMask ) ) {
+				continue;
+			}
+			CM_ClipBoxToBrushPacket_SSE42( packet, facet, mask );
+			if( !( laneMask = packet->LiveRaysMask( laneMask ) ) ) {
+				return;
+			}
+		}
+	}
+}
+
+/**
+ * A packet counterpart of {@code CMTraceComputer::RecursiveHullCheck()}.
+ * Every node is visited once for all rays of the packet that reach it.
+ */
+static void CM_RecursivePacketHullCheck_SSE42( const cmodel_state_t *cms, CMTracePacket *packet, int num,
+											   const CMPacketSegments *segments, int laneMask ) {
+	// drop rays that have already hit something nearer
+	for( int i = 0; i < packet->numRays; i++ ) {
+		if( ( laneMask & ( 1 << i ) ) && packet->traces[i]->fraction <= segments->p1f[i] ) {
+			laneMask &= ~( 1 << i );
+		}
+	}
+	if( !laneMask ) {
+		return;
+	}
+
+	// if < 0, we are in a leaf node
+	if( num < 0 ) {
+		const cleaf_t *leaf = &cms->map_leafs[-1 - num];
+		if( leaf->contents & packet->contents ) {
+			CM_ClipBoxToLeafPacket_SSE42( packet, leaf, laneMask );
+		}
+		return;
+	}
+
+	const cnode_t *node = cms->map_nodes + num;
+	const cplane_t *plane = node->plane;
+
+	// the offset for the size of the box is the same for all rays
+	float offset;
+	if( plane->type < 3 ) {
+		offset = packet->extents[plane->type];
+	} else if( packet->ispoint ) {
+		offset = 0;
+	} else {
+		offset = fabsf( packet->extents[0] * plane->normal[0] ) +
+				 fabsf( packet->extents[1] * plane->normal[1] ) +
+				 fabsf( packet->extents[2] * plane->normal[2] );
+	}
+
+	CMPacketSegments childSegments[2];
+	int childMasks[2] = { 0, 0 };
+	// numbers of rays that start on each side, the side most rays start on is visited first
+	int nearCounts[2] = { 0, 0 };
+	for( int i = 0; i < packet->numRays; i++ ) {
+		if( !( laneMask & ( 1 << i ) ) ) {
+			continue;
+		}
+
+		const float *p1 = segments->p1[i], *p2 = segments->p2[i];
+		float t1, t2;
+		if( plane->type < 3 ) {
+			t1 = p1[plane->type] - plane->dist;
+			t2 = p2[plane->type] - plane->dist;
+		} else {
+			t1 = DotProduct( plane->normal, p1 ) - plane->dist;
+			t2 = DotProduct( plane->normal, p2 ) - plane->dist;
+		}
+
+		// see which sides we need to consider
+		if( t1 >= offset && t2 >= offset ) {
+			childSegments[0].CopySegment( i, *segments );
+			childMasks[0] |= 1 << i;
+			nearCounts[0]++;
+			continue;
+		}
+		if( t1 < -offset && t2 < -offset ) {
+			childSegments[1].CopySegment( i, *segments );
+			childMasks[1] |= 1 << i;
+			nearCounts[1]++;
+			continue;
+		}
+
+		// put the crosspoint DIST_EPSILON pixels on the near side
+		int side;
+		float frac, frac2, idist;
+		if( t1 < t2 ) {
+			idist = 1.0 / ( t1 - t2 );
+			side = 1;
+			frac2 = ( t1 + offset + DIST_EPSILON ) * idist;
+			frac = ( t1 - offset + DIST_EPSILON ) * idist;
+		} else if( t1 > t2 ) {
+			idist = 1.0 / ( t1 - t2 );
+			side = 0;
+			frac2 = ( t1 - offset - DIST_EPSILON ) * idist;
+			frac = ( t1 + offset + DIST_EPSILON ) * idist;
+		} else {
+			side = 0;
+			frac = 1;
+			frac2 = 0;
+		}
+
+		const float p1f = segments->p1f[i], p2f = segments->p2f[i];
+		vec3_t mid;
+
+		// move up to the node
+		Q_clamp( frac, 0, 1 );
+		VectorLerp( p1, frac, p2, mid );
+		childSegments[side].SetSegment( i, p1f, p1f + ( p2f - p1f ) * frac, p1, mid );
+		childMasks[side] |= 1 << i;
+		nearCounts[side]++;
+
+		// go past the node
+		Q_clamp( frac2, 0, 1 );
+		VectorLerp( p1, frac2, p2, mid );
+		childSegments[side ^ 1].SetSegment( i, p1f + ( p2f - p1f ) * frac2, p2f, mid, p2 );
+		childMasks[side ^ 1] |= 1 << i;
+	}
+
+	// hits on the near side let rays skip the far one
+	const int nearSide = nearCounts[1] > nearCounts[0] ? 1 : 0;
+	if( childMasks[nearSide] ) {
+		CM_RecursivePacketHullCheck_SSE42( cms, packet, node->children[nearSide],
+										   &childSegments[nearSide], childMasks[nearSide] );
+	}
+	if( childMasks[nearSide ^ 1] ) {
+		CM_RecursivePacketHullCheck_SSE42( cms, packet, node->children[nearSide ^ 1],
+										   &childSegments[nearSide ^ 1], childMasks[nearSide ^ 1] );
+	}
+}
+
+void CM_TraceBatch_SSE42( CMTraceComputer *computer, trace_t *traces, const vec3_t *starts, const vec3_t *ends,
+						  int numRays, const vec3_t mins, const vec3_t maxs, int brushmask, int topNodeHint ) {
+	const cmodel_state_t *cms = computer->cms;
+
+	assert( topNodeHint >= 0 );
+
+	if( !cms->numnodes ) { // map not loaded
+		for( int i = 0; i < numRays; i++ ) {
+			memset( &traces[i], 0, sizeof( trace_t ) );
+			traces[i].fraction = 1;
+		}
+		return;
+	}
+
+	volatile VexEncodingFence fence;
+	(void)fence;
+
+	alignas( 16 ) CMTracePacket packet;
+	packet.contents = brushmask;
+	packet.ispoint = VectorCompare( mins, vec3_origin ) && VectorCompare( maxs, vec3_origin );
+	VectorSet( packet.extents,
+			   -mins[0] > maxs[0] ? -mins[0] : maxs[0],
+			   -mins[1] > maxs[1] ? -mins[1] : maxs[1],
+			   -mins[2] > maxs[2] ? -mins[2] : maxs[2] );
+
+	// a plane with a sign bit set for an axis should be tested against the maximal box coordinate for that axis
+	for( int i = 0; i < 8; i++ ) {
+		packet.cornerLookup[i] = _mm_setr_ps( ( i & 1 ) ? maxs[0] : mins[0],
+											  ( i & 2 ) ? maxs[1] : mins[1],
+											  ( i & 4 ) ? maxs[2] : mins[2], 0 );
+	}
+
+	for( int rayNum = 0; rayNum < numRays; ) {
+		alignas( 16 ) float rayData[12][4];
+		CMPacketSegments segments;
+
+		packet.numRays = 0;
+		for(; rayNum < numRays && packet.numRays < 4; rayNum++ ) {
+			const float *start = starts[rayNum], *end = ends[rayNum];
+			trace_t *tr = &traces[rayNum];
+
+			// position tests are rare in batches, just use the scalar path for these rays
+			if( VectorCompare( start, end ) ) {
+				computer->Trace( tr, start, end, mins, maxs, cms->map_cmodels, brushmask, topNodeHint );
+				continue;
+			}
+
+			memset( tr, 0, sizeof( *tr ) );
+			tr->fraction = 1;
+
+			const int lane = packet.numRays++;
+			packet.traces[lane] = tr;
+			for( int j = 0; j < 3; j++ ) {
+				rayData[0 + j][lane] = start[j];
+				rayData[3 + j][lane] = end[j];
+				// build a bounding box of the entire move
+				rayData[6 + j][lane] = ( start[j] < end[j] ? start[j] : end[j] ) + mins[j];
+				rayData[9 + j][lane] = ( start[j] > end[j] ? start[j] : end[j] ) + maxs[j];
+			}
+			segments.SetSegment( lane, 0, 1, start, end );
+		}
+
+		if( !packet.numRays ) {
+			break;
+		}
+
+		// fill unused lanes with copies of the first ray, they are masked out anyway
+		for( int lane = packet.numRays; lane < 4; lane++ ) {
+			for( int j = 0; j < 12; j++ ) {
+				rayData[j][lane] = rayData[j][0];
+			}
+		}
+
+		packet.startX = _mm_load_ps( rayData[0] );
+		packet.startY = _mm_load_ps( rayData[1] );
+		packet.startZ = _mm_load_ps( rayData[2] );
+		packet.endX = _mm_load_ps( rayData[3] );
+		packet.endY = _mm_load_ps( rayData[4] );
+		packet.endZ = _mm_load_ps( rayData[5] );
+		packet.absminsX = _mm_load_ps( rayData[6] );
+		packet.absminsY = _mm_load_ps( rayData[7] );
+		packet.absminsZ = _mm_load_ps( rayData[8] );
+		packet.absmaxsX = _mm_load_ps( rayData[9] );
+		packet.absmaxsY = _mm_load_ps( rayData[10] );
+		packet.absmaxsZ = _mm_load_ps( rayData[11] );
+
+		//
+		// general sweeping through world
+		//
+		CM_RecursivePacketHullCheck_SSE42( cms, &packet, topNodeHint, &segments, ( 1 << packet.numRays ) - 1 );
+
+		for( int i = 0; i < packet.numRays; i++ ) {
+			trace_t *tr = packet.traces[i];
+			const float *start = segments.p1[i], *end = segments.p2[i];
+			if( tr->fraction == 1 ) {
+				VectorCopy( end, tr->endpos );
+			} else {
+				VectorLerp( start, tr->fraction, end, tr->endpos );
+#ifdef TRACE_NOAXIAL
+				if( PlaneTypeForNormal( tr->plane.normal ) == PLANE_NONAXIAL ) {
+					VectorMA( tr->endpos, TRACE_NOAXIAL_SAFETY_OFFSET, tr->plane.normal, tr->endpos );
+				}
+#endif
+			}
+		}
+	}
+}
+
+
+void CMSse42TraceComputer::TraceBatch( trace_t *traces, const vec3_t *starts, const vec3_t *ends, int numRays,
+									   const vec3_t mins, const vec3_t maxs, int brushmask, int topNodeHint ) {
+	CM_TraceBatch_SSE42( this, traces, starts, ends, numRays, mins, maxs, brushmask, topNodeHint );
+}
+
+#endif
@@ -83,6 +83,25 @@ void CM_TransformedBoxTrace( const cmodel_state_t *cms, trace_t *tr,
 							 const vec3_t origin, const vec3_t angles,
 							 int topNodeHint = 0 );
 
+/**
+ * Traces multiple boxes of the same size against the world.
+ * This is a faster alternative to calling {@code CM_TransformedBoxTrace()} for many related rays
+ * (for example, rays that are cast from the same origin).
+ * @param cms a collision model instance
+ * @param traces an array of results, one per ray
+ * @param starts an array of ray start points
+ * @param ends an array of ray end points
+ * @param numRays a number of rays
+ * @param mins box mins that are shared by all rays (might be null for point traces)
+ * @param maxs box maxs that are shared by all rays (might be null for point traces)
+ * @param brushmask a contents mask
+ * @param topNodeHint a BSP node that contains all rays
+ */
+void CM_TraceBatch( const cmodel_state_t *cms, trace_t *traces,
+					const vec3_t *starts, const vec3_t *ends, int numRays,
+					const vec3_t mins, const vec3_t maxs, int brushmask,
+					int topNodeHint = 0 );
+
 int CM_ClusterRowSize( const cmodel_state_t *cms );
 int CM_AreaRowSize( const cmodel_state_t *cms );
 int CM_PointLeafnum( const cmodel_state_t *cms, const vec3_t p, int topNodeHint = 0 );
@@ -713,6 +713,7 @@ void Qcommon_InitCommands( void ) {
 #ifndef PUBLIC_BUILD
 	Cmd_AddCommand( "error", Com_Error_f );
 	Cmd_AddCommand( "lag", Com_Lag_f );
+	Cmd_AddCommand( "bufpipetest", QBufPipe_Test_f );
 #endif
 
 	if( dedicated->integer ) {
@@ -733,6 +734,7 @@ void Qcommon_ShutdownCommands( void ) {
 #ifndef PUBLIC_BUILD
 	Cmd_RemoveCommand( "error" );
 	Cmd_RemoveCommand( "lag" );
+	Cmd_RemoveCommand( "bufpipetest" );
 #endif
 
 	if( dedicated->integer ) {
@@ -761,6 +763,9 @@ void Qcommon_Init( int argc, char **argv ) {
 	// Required being able to call Com_Printf().
 	systemFeaturesHolder.EnsureInitialized();
 
+	// the number of worker threads depends on the number of processors
+	QJobs_Init();
+
 	// initialize memory manager
 	Memory_Init();
 
@@ -1033,6 +1038,8 @@ void Qcommon_Shutdown( void ) {
 
 	QMutex_Destroy( &com_print_mutex );
 
+	QJobs_Shutdown();
+
 	QThreads_Shutdown();
 }
 
@@ -1083,11 +1090,20 @@ unsigned SystemFeaturesHolder::TestProcessorFeatures() {
 	if( cpuInfo[0] == 0 ) {
 		return 0;
 	}
+	const int maxFunctionId = cpuInfo[0];
+	// Get extended feature bits if they are supported
+	int extendedEBX = 0;
+	if( maxFunctionId >= 7 ) {
+		__cpuidex( cpuInfo, 7, 0 );
+		extendedEBX = cpuInfo[1];
+	}
 	// Get standard feature bits (look for description here https://en.wikipedia.org/wiki/CPUID)
 	__cpuid( cpuInfo, 1 );
 	const int ECX = cpuInfo[2];
 	const int EDX = cpuInfo[3];
-	if( ECX & ( 1 << 28 ) ) {
+	if( ( ECX & ( 1 << 28 ) ) && ( extendedEBX & ( 1 << 5 ) ) ) {
+		features |= Q_CPU_FEATURE_AVX2;
+	} else if( ECX & ( 1 << 28 ) ) {
 		features |= Q_CPU_FEATURE_AVX;
 	} else if( ECX & ( 1 << 20 ) ) {
 		features |= Q_CPU_FEATURE_SSE42;
@@ -1101,7 +1117,9 @@ unsigned SystemFeaturesHolder::TestProcessorFeatures() {
 	// Clang does not even have this intrinsic, executables work fine without it.
 	__builtin_cpu_init();
 #endif // clang-specific code
-	if( __builtin_cpu_supports( "avx" ) ) {
+	if( __builtin_cpu_supports( "avx2" ) ) {
+		features |= Q_CPU_FEATURE_AVX2;
+	} else if( __builtin_cpu_supports( "avx" ) ) {
 		features |= Q_CPU_FEATURE_AVX;
 	} else if( __builtin_cpu_supports( "sse4.2" ) ) {
 		features |= Q_CPU_FEATURE_SSE42;
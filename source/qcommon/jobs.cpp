@@ -0,0 +1,413 @@
+#include "qcommon.h"
+
+#include <algorithm>
+#include <atomic>
+
+/*
+* Every worker thread owns a deque of jobs. A worker pops jobs from the back
+* of its own deque and steals jobs from the front of other deques once it runs out of work.
+* Threads that are not workers push jobs to a shared deque that is only stolen from.
+* Parallel loops are split into many small jobs so idle threads are always able to pick up a part of the work.
+*/
+
+#define QJOBS_MAX_THREADS   32
+#define QJOBS_DEQUE_SIZE    256     // must be a power of two
+#define QJOBS_DEQUE_MASK    ( QJOBS_DEQUE_SIZE - 1 )
+#define QJOBS_SPLIT_FACTOR  4       // a parallel loop is split into this number of jobs per thread
+
+typedef struct {
+	qjobfunc_t func;
+	qjobgroup_t *group;
+	unsigned first, items;
+	uint8_t arg[QJOB_MAX_ARG_SIZE];
+} qjob_t;
+
+typedef struct {
+	qmutex_t *lock;
+	unsigned head, tail;            // jobs are stolen from the head and popped by the owner from the tail
+	qjob_t jobs[QJOBS_DEQUE_SIZE];
+} qjobdeque_t;
+
+struct qjobgroup_s {
+	std::atomic_int numPendingJobs;
+};
+
+typedef struct {
+	int numThreads;
+	qthread_t *threads[QJOBS_MAX_THREADS];
+
+	// the deque #0 is shared by threads that are not workers
+	qjobdeque_t deques[QJOBS_MAX_THREADS + 1];
+
+	qmutex_t *sleepLock;
+	qcondvar_t *wakeCondVar;
+	bool terminate;                 // guarded by the sleep lock
+
+	std::atomic_int numQueuedJobs;
+} qjobs_t;
+
+static qjobs_t qjobs;
+
+// the deque of the current thread
+static thread_local int qjobs_dequeNum;
+
+/*
+* QJobs_ExecJob
+*/
+static void QJobs_ExecJob( qjob_t *job ) {
+	qjobgroup_t *group = job->group;
+
+	job->func( job->first, job->items, job->arg );
+
+	// publish results of the job
+	group->numPendingJobs.fetch_sub( 1, std::memory_order_release );
+}
+
+/*
+* QJobs_TryPopJob
+*/
+static bool QJobs_TryPopJob( qjobdeque_t *deque, qjob_t *job ) {
+	bool result = false;
+
+	QMutex_Lock( deque->lock );
+	if( deque->head != deque->tail ) {
+		deque->tail--;
+		*job = deque->jobs[deque->tail & QJOBS_DEQUE_MASK];
+		result = true;
+	}
+	QMutex_Unlock( deque->lock );
+	return result;
+}
+
+/*
+* QJobs_TryStealJob
+*/
+static bool QJobs_TryStealJob( qjobdeque_t *deque, qjob_t *job ) {
+	bool result = false;
+
+	QMutex_Lock( deque->lock );
+	if( deque->head != deque->tail ) {
+		*job = deque->jobs[deque->head & QJOBS_DEQUE_MASK];
+		deque->head++;
+		result = true;
+	}
+	QMutex_Unlock( deque->lock );
+	return result;
+}
+
+/*
+* QJobs_TryTakeGroupJob
+*
+* Removes the job of the group that is closest to the end jobs are usually taken from
+* (the tail for the own deque, the head for other ones) keeping the order of remaining jobs.
+*/
+static bool QJobs_TryTakeGroupJob( qjobdeque_t *deque, const qjobgroup_t *group, qjob_t *job, bool own ) {
+	unsigned i, j;
+	bool result = false;
+
+	QMutex_Lock( deque->lock );
+	for( j = 0; j < deque->tail - deque->head; j++ ) {
+		i = own ? deque->tail - 1 - j : deque->head + j;
+		if( deque->jobs[i & QJOBS_DEQUE_MASK].group != group ) {
+			continue;
+		}
+
+		*job = deque->jobs[i & QJOBS_DEQUE_MASK];
+		for(; i != deque->head; i-- ) {
+			deque->jobs[i & QJOBS_DEQUE_MASK] = deque->jobs[( i - 1 ) & QJOBS_DEQUE_MASK];
+		}
+		deque->head++;
+		result = true;
+		break;
+	}
+	QMutex_Unlock( deque->lock );
+	return result;
+}
+
+/*
+* QJobs_TryExecGroupJob
+*
+* Executes a single queued job of the group, returns false if there are no such jobs.
+* Waiters execute only jobs of the group they wait for, so waiting for a group
+* of short jobs never gets stuck in an unrelated long job (e.g. decoding of an image).
+*/
+static bool QJobs_TryExecGroupJob( const qjobgroup_t *group ) {
+	int i, numDeques;
+	qjob_t job;
+
+	if( !qjobs.numQueuedJobs.load( std::memory_order_relaxed ) ) {
+		return false;
+	}
+
+	numDeques = qjobs.numThreads + 1;
+	for( i = 0; i < numDeques; i++ ) {
+		const int dequeNum = ( qjobs_dequeNum + i ) % numDeques;
+		if( QJobs_TryTakeGroupJob( &qjobs.deques[dequeNum], group, &job, i == 0 ) ) {
+			qjobs.numQueuedJobs.fetch_sub( 1, std::memory_order_relaxed );
+			QJobs_ExecJob( &job );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+* QJobs_TryExecJob
+*
+* Executes a single job of any group, returns false if there are no queued jobs.
+*/
+static bool QJobs_TryExecJob( void ) {
+	int i, numDeques;
+	qjob_t job;
+
+	if( !qjobs.numQueuedJobs.load( std::memory_order_relaxed ) ) {
+		return false;
+	}
+
+	// prefer recently pushed jobs of the own deque, their data is likely to be in cache
+	if( qjobs_dequeNum && QJobs_TryPopJob( &qjobs.deques[qjobs_dequeNum], &job ) ) {
+		qjobs.numQueuedJobs.fetch_sub( 1, std::memory_order_relaxed );
+		QJobs_ExecJob( &job );
+		return true;
+	}
+
+	numDeques = qjobs.numThreads + 1;
+	for( i = 1; i <= numDeques; i++ ) {
+		const int dequeNum = ( qjobs_dequeNum + i ) % numDeques;
+		if( QJobs_TryStealJob( &qjobs.deques[dequeNum], &job ) ) {
+			qjobs.numQueuedJobs.fetch_sub( 1, std::memory_order_relaxed );
+			QJobs_ExecJob( &job );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+* QJobs_WakeThreads
+*/
+static void QJobs_WakeThreads( int numJobs ) {
+	int i;
+
+	// sleeping threads check the counter while holding the lock, so the wakeup can't be lost
+	qjobs.numQueuedJobs.fetch_add( numJobs, std::memory_order_relaxed );
+
+	QMutex_Lock( qjobs.sleepLock );
+	for( i = 0; i < numJobs && i < qjobs.numThreads; i++ ) {
+		QCondVar_Wake( qjobs.wakeCondVar );
+	}
+	QMutex_Unlock( qjobs.sleepLock );
+}
+
+/*
+* QJobs_Schedule
+*
+* Splits items into jobs and pushes them to the deque of the current thread.
+* Jobs that do not fit the deque are executed immediately.
+*/
+static void QJobs_Schedule( qjobgroup_t *group, qjobfunc_t func, const void *arg, size_t argSize,
+							unsigned items, unsigned grain ) {
+	qjobdeque_t *deque;
+	qjob_t job;
+	unsigned first, numJobs, numQueued;
+
+	if( argSize > QJOB_MAX_ARG_SIZE ) {
+		Com_Error( ERR_FATAL, "QJobs_Schedule: the job argument is too large (%u bytes)\n", (unsigned)argSize );
+	}
+
+	numJobs = ( items + grain - 1 ) / grain;
+	group->numPendingJobs.fetch_add( (int)numJobs, std::memory_order_relaxed );
+
+	job.func = func;
+	job.group = group;
+	if( argSize ) {
+		memcpy( job.arg, arg, argSize );
+	}
+
+	first = 0;
+	numQueued = 0;
+	if( qjobs.numThreads ) {
+		deque = &qjobs.deques[qjobs_dequeNum];
+		QMutex_Lock( deque->lock );
+		for(; first < items && deque->tail - deque->head < QJOBS_DEQUE_SIZE; first += grain, numQueued++ ) {
+			job.first = first;
+			job.items = std::min( grain, items - first );
+			deque->jobs[deque->tail & QJOBS_DEQUE_MASK] = job;
+			deque->tail++;
+		}
+		QMutex_Unlock( deque->lock );
+
+		if( numQueued ) {
+			QJobs_WakeThreads( (int)numQueued );
+		}
+	}
+
+	// there are no threads or the deque is full
+	for(; first < items; first += grain ) {
+		job.first = first;
+		job.items = std::min( grain, items - first );
+		QJobs_ExecJob( &job );
+	}
+}
+
+/*
+* QJobs_ThreadProc
+*/
+static void *QJobs_ThreadProc( void *param ) {
+	bool terminate;
+
+	qjobs_dequeNum = (int)(intptr_t)param;
+
+	for(;; ) {
+		if( QJobs_TryExecJob() ) {
+			continue;
+		}
+
+		QMutex_Lock( qjobs.sleepLock );
+		while( !qjobs.numQueuedJobs.load( std::memory_order_relaxed ) && !qjobs.terminate ) {
+			QCondVar_Wait( qjobs.wakeCondVar, qjobs.sleepLock, Q_THREADS_WAIT_INFINITE );
+		}
+		terminate = qjobs.terminate;
+		QMutex_Unlock( qjobs.sleepLock );
+
+		if( terminate ) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+* QJobs_Init
+*/
+void QJobs_Init( void ) {
+	int i, numThreads;
+	unsigned numPhysicalProcessors, numLogicalProcessors;
+
+	QJobs_Shutdown();
+
+	// the caller thread helps executing jobs
+	Sys_GetNumberOfProcessors( &numPhysicalProcessors, &numLogicalProcessors );
+	numThreads = (int)numLogicalProcessors - 1;
+	Q_clamp( numThreads, 0, QJOBS_MAX_THREADS );
+
+	qjobs.numQueuedJobs = 0;
+	qjobs.terminate = false;
+	qjobs.sleepLock = QMutex_Create();
+	qjobs.wakeCondVar = QCondVar_Create();
+
+	for( i = 0; i <= numThreads; i++ ) {
+		qjobs.deques[i].lock = QMutex_Create();
+		qjobs.deques[i].head = qjobs.deques[i].tail = 0;
+	}
+
+	// set the count first as threads access all deques
+	qjobs.numThreads = numThreads;
+	for( i = 0; i < numThreads; i++ ) {
+		qjobs.threads[i] = QThread_Create( QJobs_ThreadProc, (void *)(intptr_t)( i + 1 ) );
+	}
+}
+
+/*
+* QJobs_Shutdown
+*/
+void QJobs_Shutdown( void ) {
+	int i;
+
+	if( !qjobs.sleepLock ) {
+		return;
+	}
+
+	QMutex_Lock( qjobs.sleepLock );
+	qjobs.terminate = true;
+	for( i = 0; i < qjobs.numThreads; i++ ) {
+		QCondVar_Wake( qjobs.wakeCondVar );
+	}
+	QMutex_Unlock( qjobs.sleepLock );
+
+	for( i = 0; i < qjobs.numThreads; i++ ) {
+		QThread_Join( qjobs.threads[i] );
+		qjobs.threads[i] = NULL;
+	}
+
+	for( i = 0; i <= qjobs.numThreads; i++ ) {
+		QMutex_Destroy( &qjobs.deques[i].lock );
+	}
+	qjobs.numThreads = 0;
+
+	QCondVar_Destroy( &qjobs.wakeCondVar );
+	QMutex_Destroy( &qjobs.sleepLock );
+}
+
+/*
+* QJobs_NumThreads
+*/
+int QJobs_NumThreads( void ) {
+	return qjobs.numThreads;
+}
+
+/*
+* QJobGroup_Create
+*/
+qjobgroup_t *QJobGroup_Create( void ) {
+	qjobgroup_t *group = (qjobgroup_t *)Q_malloc( sizeof( qjobgroup_t ) );
+	group->numPendingJobs = 0;
+	return group;
+}
+
+/*
+* QJobGroup_Destroy
+*/
+void QJobGroup_Destroy( qjobgroup_t **pgroup ) {
+	assert( pgroup != NULL );
+	if( pgroup && *pgroup ) {
+		QJobGroup_Wait( *pgroup );
+		Q_free( *pgroup );
+		*pgroup = NULL;
+	}
+}
+
+/*
+* QJobGroup_AddJob
+*
+* Schedules a single job, it is called for the only item.
+*/
+void QJobGroup_AddJob( qjobgroup_t *group, qjobfunc_t func, const void *arg, size_t argSize ) {
+	QJobs_Schedule( group, func, arg, argSize, 1, 1 );
+}
+
+/*
+* QJobGroup_ParallelFor
+*
+* Schedules jobs for items in [0, items) split into ranges of grain items.
+* A zero grain lets the items be split evenly into several jobs per thread.
+*/
+void QJobGroup_ParallelFor( qjobgroup_t *group, qjobfunc_t func, const void *arg, size_t argSize,
+							unsigned items, unsigned grain ) {
+	if( !items ) {
+		return;
+	}
+
+	if( !grain ) {
+		const unsigned numJobs = (unsigned)( qjobs.numThreads + 1 ) * QJOBS_SPLIT_FACTOR;
+		grain = std::max( 1u, ( items + numJobs - 1 ) / numJobs );
+	}
+
+	QJobs_Schedule( group, func, arg, argSize, items, grain );
+}
+
+/*
+* QJobGroup_Wait
+*
+* Returns once all jobs of the group are executed, the caller executes pending jobs of the group meanwhile.
+*/
+void QJobGroup_Wait( qjobgroup_t *group ) {
+	while( group->numPendingJobs.load( std::memory_order_acquire ) ) {
+		if( !QJobs_TryExecGroupJob( group ) ) {
+			QThread_Yield();
+		}
+	}
+}
@@ -20,6 +20,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // Z_zone.c
 
 #include "qcommon.h"
+#include "sys_threads.h"
+
+#include <atomic>
 
 //#define MEMTRASH
 
@@ -30,8 +33,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #define MEMALIGNMENT_DEFAULT        16
 
+// sentinel1 of blocks that have been returned to the small-object allocator
+#define MEMHEADER_SENTINEL_FREED    0xF4EEB10C
+
 typedef struct memheader_s {
 	// address returned by malloc (may be significantly before this header to satisify alignment)
+	// NULL for blocks of the small-object allocator
 	void *baseaddress;
 
 	// next and previous memheaders in chain belonging to pool
@@ -61,16 +68,22 @@ struct mempool_s {
 	unsigned int sentinel1;
 
 	// chain of individual memory allocations
+	// (blocks of the small-object allocator are linked into smallChain)
 	struct memheader_s *chain;
 
+	// chain of blocks of the small-object allocator, these are allocated
+	// and freed without taking memMutex, so the chain has its own lock
+	struct memheader_s *smallChain;
+	qmutex_t *smallMutex;
+
 	// temporary, etc
 	int flags;
 
 	// total memory allocated in this pool (inside memheaders)
-	int totalsize;
+	volatile int totalsize;
 
 	// total memory allocated in this pool (actual malloc total)
-	int realsize;
+	volatile int realsize;
 
 	// updated each time the pool is displayed by memlist, shows change from previous time (unless pool was freed)
 	int lastchecksize;
@@ -125,10 +138,652 @@ static void _Mem_Error( const char *format, ... ) {
 	Sys_Error( "%s", msg );
 }
 
+/*
+==============================================================================
+
+SMALL-OBJECT ALLOCATOR
+
+Small blocks are carved from fixed-size slabs, one free list per size class.
+Every thread caches a few free blocks of each class, so most allocations
+neither take a lock nor call malloc. Blocks keep the regular memheader_t
+so sentinels, sizes and pool accounting work as usual. They are linked into
+a separate chain of the pool that has its own lock, so allocations of different
+pools don't contend and freeing a pool walks only the blocks it owns.
+==============================================================================
+*/
+
+#define MEMSLAB_SIZE                0x10000
+
+// blocks moved between a thread cache and the shared free list at once
+#define MEMSMALL_CACHE_BATCH        32
+
+// the memheader_t is put at the end of a 16-byte aligned area so the data is aligned too
+#define MEMSMALL_HEADER_SIZE        ( ( sizeof( memheader_t ) + 15 ) & ~15 )
+#define MEMSMALL_HEADER_OFFSET      ( MEMSMALL_HEADER_SIZE - sizeof( memheader_t ) )
+
+// total sizes of blocks, including the header and sentinel2
+static const unsigned memSmallBlockSizes[] = {
+	80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512, 640, 768, 896, 1024
+};
+
+#define MEMSMALL_NUM_CLASSES        ( sizeof( memSmallBlockSizes ) / sizeof( memSmallBlockSizes[0] ) )
+#define MEMSMALL_MAX_BLOCKSIZE      1024
+
+typedef struct memfreeblock_s {
+	struct memfreeblock_s *next;
+} memfreeblock_t;
+
+typedef struct memslab_s {
+	struct memslab_s *next;
+	uint8_t *blocks;
+	int numBlocks;
+} memslab_t;
+
+typedef struct {
+	qmutex_t *mutex;
+	unsigned blockSize;
+	int numSlabs;
+	memslab_t *slabs;
+	memfreeblock_t *freeBlocks;
+} memsmallclass_t;
+
+static memsmallclass_t memSmallClasses[MEMSMALL_NUM_CLASSES];
+
+// size class for each 16-byte step of the block size
+static uint8_t memSmallClassForSize[MEMSMALL_MAX_BLOCKSIZE / 16 + 1];
+
+// allows comparing both allocators in the "membench" command
+static std::atomic_bool memSmallAllocsEnabled( true );
+
+static void Mem_SmallFlushThreadCache( struct MemThreadCache *cache );
+
+struct MemThreadCache {
+	memfreeblock_t *freeBlocks[MEMSMALL_NUM_CLASSES];
+	int numFreeBlocks[MEMSMALL_NUM_CLASSES];
+
+	~MemThreadCache() {
+		Mem_SmallFlushThreadCache( this );
+	}
+};
+
+static thread_local MemThreadCache memThreadCache;
+
+/*
+* Mem_SmallInit
+*/
+static void Mem_SmallInit( void ) {
+	unsigned i, size, classNum;
+
+	for( i = 0; i < MEMSMALL_NUM_CLASSES; i++ ) {
+		memsmallclass_t *smallClass = &memSmallClasses[i];
+		smallClass->mutex = QMutex_Create();
+		smallClass->blockSize = memSmallBlockSizes[i];
+		smallClass->numSlabs = 0;
+		smallClass->slabs = NULL;
+		smallClass->freeBlocks = NULL;
+	}
+
+	for( size = 0, classNum = 0; size <= MEMSMALL_MAX_BLOCKSIZE; size += 16 ) {
+		while( memSmallBlockSizes[classNum] < size ) {
+			classNum++;
+		}
+		memSmallClassForSize[size / 16] = classNum;
+	}
+}
+
+/*
+* Mem_SmallShutdown
+*/
+static void Mem_SmallShutdown( void ) {
+	unsigned i;
+	memslab_t *slab, *next;
+
+	// blocks cached by the main thread point into slabs that are going away
+	memset( memThreadCache.freeBlocks, 0, sizeof( memThreadCache.freeBlocks ) );
+	memset( memThreadCache.numFreeBlocks, 0, sizeof( memThreadCache.numFreeBlocks ) );
+
+	for( i = 0; i < MEMSMALL_NUM_CLASSES; i++ ) {
+		memsmallclass_t *smallClass = &memSmallClasses[i];
+		for( slab = smallClass->slabs; slab; slab = next ) {
+			next = slab->next;
+			free( slab );
+		}
+		smallClass->slabs = NULL;
+		smallClass->freeBlocks = NULL;
+		smallClass->numSlabs = 0;
+		QMutex_Destroy( &smallClass->mutex );
+	}
+}
+
+/*
+* Mem_SmallClassForAlloc
+*
+* Returns the size class for the allocation or -1 if it should be malloc'ed.
+*/
+static int Mem_SmallClassForAlloc( size_t size, size_t alignment ) {
+	size_t blockSize;
+
+	if( !memSmallAllocsEnabled.load( std::memory_order_relaxed ) || alignment > MEMALIGNMENT_DEFAULT ) {
+		return -1;
+	}
+	// track every allocation in the pool chain for debugging
+	if( developer_memory && developer_memory->integer ) {
+		return -1;
+	}
+
+	blockSize = MEMSMALL_HEADER_SIZE + size + 1;
+	if( blockSize > MEMSMALL_MAX_BLOCKSIZE ) {
+		return -1;
+	}
+
+	return memSmallClassForSize[( blockSize + 15 ) / 16];
+}
+
+/*
+* Mem_SmallAllocSlab
+*
+* Allocates a new slab and puts all its blocks to the free list. The class mutex must be held.
+*/
+static void Mem_SmallAllocSlab( memsmallclass_t *smallClass ) {
+	int i;
+	uint8_t *block;
+	memslab_t *slab;
+
+	slab = (memslab_t *)malloc( MEMSLAB_SIZE );
+	if( slab == NULL ) {
+		_Mem_Error( "Mem_Alloc: out of memory (small-object slab of %u bytes blocks)", smallClass->blockSize );
+	}
+
+	slab->blocks = (uint8_t *)( ( (size_t)( slab + 1 ) + 15 ) & ~(size_t)15 );
+	slab->numBlocks = (int)( ( (uint8_t *)slab + MEMSLAB_SIZE - slab->blocks ) / smallClass->blockSize );
+	slab->next = smallClass->slabs;
+	smallClass->slabs = slab;
+	smallClass->numSlabs++;
+
+	// push in reverse order so blocks are handed out in the address order
+	for( i = slab->numBlocks - 1; i >= 0; i-- ) {
+		block = slab->blocks + i * smallClass->blockSize;
+		( (memheader_t *)( block + MEMSMALL_HEADER_OFFSET ) )->sentinel1 = MEMHEADER_SENTINEL_FREED;
+		( (memfreeblock_t *)block )->next = smallClass->freeBlocks;
+		smallClass->freeBlocks = (memfreeblock_t *)block;
+	}
+}
+
+/*
+* Mem_SmallAllocBlock
+*/
+static memheader_t *Mem_SmallAllocBlock( int classNum ) {
+	MemThreadCache *cache = &memThreadCache;
+	memfreeblock_t *block = cache->freeBlocks[classNum];
+
+	if( !block ) {
+		memsmallclass_t *smallClass = &memSmallClasses[classNum];
+		memfreeblock_t *last = NULL;
+		int count = 0;
+
+		// refill the cache from the shared free list
+		QMutex_Lock( smallClass->mutex );
+		if( !smallClass->freeBlocks ) {
+			Mem_SmallAllocSlab( smallClass );
+		}
+		block = smallClass->freeBlocks;
+		for( last = block; last->next && count < MEMSMALL_CACHE_BATCH - 1; last = last->next ) {
+			count++;
+		}
+		smallClass->freeBlocks = last->next;
+		last->next = NULL;
+		QMutex_Unlock( smallClass->mutex );
+
+		cache->numFreeBlocks[classNum] = count + 1;
+	}
+
+	cache->freeBlocks[classNum] = block->next;
+	cache->numFreeBlocks[classNum]--;
+
+	return (memheader_t *)( (uint8_t *)block + MEMSMALL_HEADER_OFFSET );
+}
+
+/*
+* Mem_SmallFreeBlock
+*/
+static void Mem_SmallFreeBlock( memheader_t *mem ) {
+	MemThreadCache *cache = &memThreadCache;
+	memfreeblock_t *block = (memfreeblock_t *)( (uint8_t *)mem - MEMSMALL_HEADER_OFFSET );
+	const int classNum = memSmallClassForSize[mem->realsize / 16];
+
+	mem->sentinel1 = MEMHEADER_SENTINEL_FREED;
+
+	block->next = cache->freeBlocks[classNum];
+	cache->freeBlocks[classNum] = block;
+
+	// give a batch back if the thread frees more than it allocates
+	if( ++cache->numFreeBlocks[classNum] >= 2 * MEMSMALL_CACHE_BATCH ) {
+		memsmallclass_t *smallClass = &memSmallClasses[classNum];
+		memfreeblock_t *last = block;
+		int i;
+
+		for( i = 1; i < MEMSMALL_CACHE_BATCH; i++ ) {
+			last = last->next;
+		}
+		cache->freeBlocks[classNum] = last->next;
+		cache->numFreeBlocks[classNum] -= MEMSMALL_CACHE_BATCH;
+
+		QMutex_Lock( smallClass->mutex );
+		last->next = smallClass->freeBlocks;
+		smallClass->freeBlocks = block;
+		QMutex_Unlock( smallClass->mutex );
+	}
+}
+
+/*
+* Mem_SmallFlushThreadCache
+*
+* Returns all blocks cached by the thread to shared free lists.
+*/
+static void Mem_SmallFlushThreadCache( MemThreadCache *cache ) {
+	unsigned i;
+	memfreeblock_t *last;
+
+	if( !memory_initialized ) {
+		return;
+	}
+
+	for( i = 0; i < MEMSMALL_NUM_CLASSES; i++ ) {
+		memsmallclass_t *smallClass = &memSmallClasses[i];
+
+		if( !cache->freeBlocks[i] ) {
+			continue;
+		}
+
+		for( last = cache->freeBlocks[i]; last->next; last = last->next ) ;
+
+		QMutex_Lock( smallClass->mutex );
+		last->next = smallClass->freeBlocks;
+		smallClass->freeBlocks = cache->freeBlocks[i];
+		QMutex_Unlock( smallClass->mutex );
+
+		cache->freeBlocks[i] = NULL;
+		cache->numFreeBlocks[i] = 0;
+	}
+}
+
+/*
+* Mem_SmallLinkBlock
+*/
+static void Mem_SmallLinkBlock( mempool_t *pool, memheader_t *mem ) {
+	QMutex_Lock( pool->smallMutex );
+	mem->prev = NULL;
+	mem->next = pool->smallChain;
+	if( mem->next ) {
+		mem->next->prev = mem;
+	}
+	pool->smallChain = mem;
+	QMutex_Unlock( pool->smallMutex );
+}
+
+/*
+* Mem_SmallUnlinkBlock
+*/
+static void Mem_SmallUnlinkBlock( mempool_t *pool, memheader_t *mem ) {
+	QMutex_Lock( pool->smallMutex );
+	if( ( mem->prev ? mem->prev->next != mem : pool->smallChain != mem ) || ( mem->next && mem->next->prev != mem ) ) {
+		QMutex_Unlock( pool->smallMutex );
+		_Mem_Error( "Mem_Free: not allocated or double freed (alloc at %s:%i)", mem->filename, mem->fileline );
+	}
+	if( mem->prev ) {
+		mem->prev->next = mem->next;
+	} else {
+		pool->smallChain = mem->next;
+	}
+	if( mem->next ) {
+		mem->next->prev = mem->prev;
+	}
+	QMutex_Unlock( pool->smallMutex );
+}
+
+/*
+* Mem_SmallForEachPoolBlock
+*
+* Calls the function for every allocated small block of the pool.
+* The pool chain is locked during the call, so the function must not free the block.
+*/
+static void Mem_SmallForEachPoolBlock( mempool_t *pool, void ( *func )( memheader_t *, void * ), void *param ) {
+	memheader_t *mem;
+
+	QMutex_Lock( pool->smallMutex );
+	for( mem = pool->smallChain; mem; mem = mem->next ) {
+		func( mem, param );
+	}
+	QMutex_Unlock( pool->smallMutex );
+}
+
+/*
+* Mem_SmallFreePoolBlocks
+*
+* Returns all small blocks of the pool to shared free lists, taking the lock of every class once.
+*/
+static void Mem_SmallFreePoolBlocks( mempool_t *pool ) {
+	unsigned i;
+	memheader_t *mem, *next;
+	memfreeblock_t *heads[MEMSMALL_NUM_CLASSES], *tails[MEMSMALL_NUM_CLASSES];
+
+	QMutex_Lock( pool->smallMutex );
+	mem = pool->smallChain;
+	pool->smallChain = NULL;
+	QMutex_Unlock( pool->smallMutex );
+
+	memset( heads, 0, sizeof( heads ) );
+	memset( tails, 0, sizeof( tails ) );
+
+	for( ; mem; mem = next ) {
+		memfreeblock_t *block = (memfreeblock_t *)( (uint8_t *)mem - MEMSMALL_HEADER_OFFSET );
+		const int classNum = memSmallClassForSize[mem->realsize / 16];
+
+		next = mem->next;
+
+		Mem_CheckSentinels( (uint8_t *)mem + sizeof( memheader_t ) );
+
+		Sys_Atomic_Add( &pool->totalsize, -(int)mem->size, NULL );
+		Sys_Atomic_Add( &pool->realsize, -(int)mem->realsize, NULL );
+
+		mem->sentinel1 = MEMHEADER_SENTINEL_FREED;
+		block->next = heads[classNum];
+		heads[classNum] = block;
+		if( !tails[classNum] ) {
+			tails[classNum] = block;
+		}
+	}
+
+	for( i = 0; i < MEMSMALL_NUM_CLASSES; i++ ) {
+		memsmallclass_t *smallClass = &memSmallClasses[i];
+
+		if( !heads[i] ) {
+			continue;
+		}
+
+		QMutex_Lock( smallClass->mutex );
+		tails[i]->next = smallClass->freeBlocks;
+		smallClass->freeBlocks = heads[i];
+		QMutex_Unlock( smallClass->mutex );
+	}
+}
+
+/*
+* Mem_SmallCheckPoolBlock
+*/
+static void Mem_SmallCheckPoolBlock( memheader_t *mem, void *param ) {
+	const char **location = (const char **)param;
+	_Mem_CheckSentinels( (uint8_t *)mem + sizeof( memheader_t ), location[0], (int)(intptr_t)location[1] );
+}
+
+/*
+* Mem_SmallPrintPoolBlock
+*/
+static void Mem_SmallPrintPoolBlock( memheader_t *mem, void *param ) {
+	Com_Printf( "%10" PRIu64 " bytes allocated at %s:%i\n", (uint64_t)mem->size, mem->filename, mem->fileline );
+}
+
+/*
+==============================================================================
+
+FRAME ARENAS
+
+Bump-pointer scratch memory for per-frame temporaries. Every thread has its own
+arena, so allocations don't lock anything. Mem_ResetFrameArenas() starts a new frame,
+each arena rewinds lazily on the first use by its thread in the new frame.
+Chunks are kept between frames, so a warmed-up arena doesn't touch the heap at all.
+==============================================================================
+*/
+
+#define MEMARENA_CHUNK_SIZE         0x40000
+
+typedef struct memarenachunk_s {
+	struct memarenachunk_s *prev, *next;
+	size_t base;                // position of the chunk start in the arena
+	size_t size;
+	uint8_t *data;
+} memarenachunk_t;
+
+static mempool_t *memArenaPool;
+
+static std::atomic_uint memArenaFrameNum( 1 );
+
+struct MemFrameArena {
+	memarenachunk_t *first;
+	memarenachunk_t *current;
+	size_t offset;              // in the current chunk
+	unsigned frameNum;
+
+	// statistics for memlist, updated by the owning thread
+	std::atomic_size_t capacity;
+	std::atomic_size_t frameUsage;
+	std::atomic_size_t lastFrameUsage;
+	std::atomic_size_t peakUsage;
+	size_t used;
+
+	// guarded by memMutex
+	bool registered;
+	int threadNum;
+	MemFrameArena *next;
+
+	~MemFrameArena();
+};
+
+static MemFrameArena *memFrameArenas;
+static int memFrameArenasNextThreadNum;
+
+static thread_local MemFrameArena memFrameArena;
+
+static void Mem_FrameArenaRegister( MemFrameArena *arena );
+static void Mem_FrameArenaFreeChunks( MemFrameArena *arena );
+
+/*
+* MemFrameArena::~MemFrameArena
+*/
+MemFrameArena::~MemFrameArena() {
+	MemFrameArena **prev;
+
+	if( !memory_initialized || !registered ) {
+		return;
+	}
+
+	Mem_FrameArenaFreeChunks( this );
+
+	QMutex_Lock( memMutex );
+	for( prev = &memFrameArenas; *prev; prev = &( *prev )->next ) {
+		if( *prev == this ) {
+			*prev = next;
+			break;
+		}
+	}
+	QMutex_Unlock( memMutex );
+}
+
+/*
+* Mem_FrameArenaRegister
+*/
+static void Mem_FrameArenaRegister( MemFrameArena *arena ) {
+	QMutex_Lock( memMutex );
+	arena->registered = true;
+	arena->threadNum = memFrameArenasNextThreadNum++;
+	arena->next = memFrameArenas;
+	memFrameArenas = arena;
+	QMutex_Unlock( memMutex );
+}
+
+/*
+* Mem_FrameArenaFreeChunks
+*/
+static void Mem_FrameArenaFreeChunks( MemFrameArena *arena ) {
+	memarenachunk_t *chunk, *next;
+
+	for( chunk = arena->first; chunk; chunk = next ) {
+		next = chunk->next;
+		Mem_Free( chunk );
+	}
+
+	arena->first = arena->current = NULL;
+	arena->offset = 0;
+	arena->used = 0;
+	arena->capacity = 0;
+}
+
+/*
+* Mem_FrameArenaCheckFrame
+*
+* Rewinds the arena of the calling thread if a new frame has been started.
+*/
+static MemFrameArena *Mem_FrameArenaCheckFrame( void ) {
+	MemFrameArena *arena = &memFrameArena;
+	const unsigned frameNum = memArenaFrameNum.load( std::memory_order_relaxed );
+
+	if( arena->frameNum != frameNum ) {
+		if( !arena->registered ) {
+			Mem_FrameArenaRegister( arena );
+		}
+
+		arena->lastFrameUsage.store( arena->frameUsage.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+		arena->frameUsage.store( 0, std::memory_order_relaxed );
+		arena->frameNum = frameNum;
+		arena->current = arena->first;
+		arena->offset = 0;
+		arena->used = 0;
+	}
+
+	return arena;
+}
+
+/*
+* _Mem_FrameAlloc
+*/
+void *_Mem_FrameAlloc( size_t size, size_t alignment ) {
+	MemFrameArena *arena = Mem_FrameArenaCheckFrame();
+	memarenachunk_t *chunk = arena->current;
+	size_t offset;
+
+	if( !alignment ) {
+		alignment = MEMALIGNMENT_DEFAULT;
+	}
+
+	offset = 0;
+	if( chunk ) {
+		offset = ( ( (size_t)chunk->data + arena->offset + alignment - 1 ) & ~( alignment - 1 ) ) - (size_t)chunk->data;
+	}
+	if( !chunk || offset + size > chunk->size ) {
+		memarenachunk_t *next = chunk ? chunk->next : arena->first;
+		const size_t needed = size + alignment;
+
+		// chunks that are too small for the request are replaced by a larger one
+		if( next && next->size < needed ) {
+			memarenachunk_t *tail, *tailnext;
+			for( tail = next; tail; tail = tailnext ) {
+				tailnext = tail->next;
+				arena->capacity -= tail->size;
+				Mem_Free( tail );
+			}
+			if( chunk ) {
+				chunk->next = NULL;
+			} else {
+				arena->first = NULL;
+			}
+			next = NULL;
+		}
+
+		if( !next ) {
+			const size_t chunkSize = needed > MEMARENA_CHUNK_SIZE ? needed : MEMARENA_CHUNK_SIZE;
+
+			next = (memarenachunk_t *)Mem_AllocExt( memArenaPool, sizeof( memarenachunk_t ) + chunkSize, 0 );
+			next->data = (uint8_t *)( next + 1 );
+			next->size = chunkSize;
+			next->base = chunk ? chunk->base + chunk->size : 0;
+			next->prev = chunk;
+			next->next = NULL;
+			if( chunk ) {
+				chunk->next = next;
+			} else {
+				arena->first = next;
+			}
+			arena->capacity += chunkSize;
+		}
+
+		chunk = arena->current = next;
+		offset = ( ( (size_t)chunk->data + alignment - 1 ) & ~( alignment - 1 ) ) - (size_t)chunk->data;
+	}
+
+	arena->offset = offset + size;
+	arena->used = chunk->base + arena->offset;
+	if( arena->used > arena->frameUsage.load( std::memory_order_relaxed ) ) {
+		arena->frameUsage.store( arena->used, std::memory_order_relaxed );
+		if( arena->used > arena->peakUsage.load( std::memory_order_relaxed ) ) {
+			arena->peakUsage.store( arena->used, std::memory_order_relaxed );
+		}
+	}
+
+	return chunk->data + offset;
+}
+
+/*
+* Mem_FrameArenaMark
+*/
+size_t Mem_FrameArenaMark( void ) {
+	return Mem_FrameArenaCheckFrame()->used;
+}
+
+/*
+* Mem_FrameArenaRelease
+*
+* Frees everything allocated from the arena of the calling thread since the mark has been taken.
+*/
+void Mem_FrameArenaRelease( size_t mark ) {
+	MemFrameArena *arena = Mem_FrameArenaCheckFrame();
+	memarenachunk_t *chunk = arena->current;
+
+	if( mark >= arena->used ) {
+		return;
+	}
+
+	while( chunk->base > mark ) {
+		chunk = chunk->prev;
+	}
+
+	arena->current = chunk;
+	arena->offset = mark - chunk->base;
+	arena->used = mark;
+}
+
+/*
+* Mem_ResetFrameArenas
+*
+* Starts a new frame, everything allocated from frame arenas of all threads becomes invalid.
+*/
+void Mem_ResetFrameArenas( void ) {
+	memArenaFrameNum.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/*
+* Mem_PrintFrameArenas
+*/
+static void Mem_PrintFrameArenas( void ) {
+	MemFrameArena *arena;
+
+	QMutex_Lock( memMutex );
+	if( memFrameArenas ) {
+		Com_Printf( "frame arenas:\n" "size    used last frame, peak\n" );
+	}
+	for( arena = memFrameArenas; arena; arena = arena->next ) {
+		Com_Printf( "%6ik %6ik, %6ik thread #%i\n", (int)( ( arena->capacity + 1023 ) / 1024 ),
+					(int)( ( arena->lastFrameUsage + 1023 ) / 1024 ), (int)( ( arena->peakUsage + 1023 ) / 1024 ), arena->threadNum );
+	}
+	QMutex_Unlock( memMutex );
+}
+
+// ============================================================================
+
 ATTRIBUTE_MALLOC void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t alignment, int z, int musthave, int canthave, const char *filename, int fileline ) {
 	void *base;
 	size_t realsize;
 	memheader_t *mem;
+	int smallClass;
 
 	if( size <= 0 ) {
 		return NULL;
@@ -156,12 +811,34 @@ ATTRIBUTE_MALLOC void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t align
 		Com_DPrintf( format, pool->name, filename, fileline, (uint64_t)size );
 	}
 
-	QMutex_Lock( memMutex );
+	smallClass = Mem_SmallClassForAlloc( size, alignment );
+	if( smallClass >= 0 ) {
+		mem = Mem_SmallAllocBlock( smallClass );
+		mem->baseaddress = NULL;
+		mem->filename = filename;
+		mem->fileline = fileline;
+		mem->size = size;
+		mem->realsize = memSmallBlockSizes[smallClass];
+		mem->pool = pool;
+		mem->sentinel1 = MEMHEADER_SENTINEL1;
+		*( (uint8_t *) mem + sizeof( memheader_t ) + mem->size ) = MEMHEADER_SENTINEL2;
+
+		Mem_SmallLinkBlock( pool, mem );
+
+		Sys_Atomic_Add( &pool->totalsize, (int)size, NULL );
+		Sys_Atomic_Add( &pool->realsize, (int)mem->realsize, NULL );
+
+		if( z ) {
+			memset( (void *)( (uint8_t *) mem + sizeof( memheader_t ) ), 0, mem->size );
+		}
+
+		return (void *)( (uint8_t *) mem + sizeof( memheader_t ) );
+	}
 
-	pool->totalsize += size;
 	realsize = sizeof( memheader_t ) + size + alignment + sizeof( int );
 
-	pool->realsize += realsize;
+	Sys_Atomic_Add( &pool->totalsize, (int)size, NULL );
+	Sys_Atomic_Add( &pool->realsize, (int)realsize, NULL );
 
 	base = malloc( realsize );
 	if( base == NULL ) {
@@ -181,6 +858,8 @@ ATTRIBUTE_MALLOC void *_Mem_AllocExt( mempool_t *pool, size_t size, size_t align
 	// we have to use only a single byte for this sentinel, because it may not be aligned, and some platforms can't use unaligned accesses
 	*( (uint8_t *) mem + sizeof( memheader_t ) + mem->size ) = MEMHEADER_SENTINEL2;
 
+	QMutex_Lock( memMutex );
+
 	// append to head of list
 	mem->next = pool->chain;
 	mem->prev = NULL;
@@ -251,6 +930,10 @@ void _Mem_Free( void *data, int musthave, int canthave, const char *filename, in
 
 	mem = ( memheader_t * )( (uint8_t *) data - sizeof( memheader_t ) );
 
+	if( mem->sentinel1 == MEMHEADER_SENTINEL_FREED ) {
+		_Mem_Error( "Mem_Free: not allocated or double freed (free at %s:%i)", filename, fileline );
+	}
+
 	assert( mem->sentinel1 == MEMHEADER_SENTINEL1 );
 	assert( *( (uint8_t *) mem + sizeof( memheader_t ) + mem->size ) == MEMHEADER_SENTINEL2 );
 
@@ -274,6 +957,15 @@ void _Mem_Free( void *data, int musthave, int canthave, const char *filename, in
 		Com_DPrintf( format, pool->name, mem->filename, mem->fileline, filename, fileline, (size_t)mem->size );
 	}
 
+	Sys_Atomic_Add( &pool->totalsize, -(int)mem->size, NULL );
+	Sys_Atomic_Add( &pool->realsize, -(int)mem->realsize, NULL );
+
+	if( !mem->baseaddress ) {
+		Mem_SmallUnlinkBlock( pool, mem );
+		Mem_SmallFreeBlock( mem );
+		return;
+	}
+
 	QMutex_Lock( memMutex );
 
 	// unlink memheader from doubly linked list
@@ -291,10 +983,7 @@ void _Mem_Free( void *data, int musthave, int canthave, const char *filename, in
 	}
 
 	// memheader has been unlinked, do the actual free now
-	pool->totalsize -= mem->size;
-
 	base = mem->baseaddress;
-	pool->realsize -= mem->realsize;
 
 	QMutex_Unlock( memMutex );
 
@@ -327,6 +1016,8 @@ mempool_t *_Mem_AllocPool( mempool_t *parent, const char *name, int flags, const
 	pool->fileline = fileline;
 	pool->flags = flags;
 	pool->chain = NULL;
+	pool->smallChain = NULL;
+	pool->smallMutex = QMutex_Create();
 	pool->parent = parent;
 	pool->child = NULL;
 	pool->totalsize = 0;
@@ -388,12 +1079,13 @@ void _Mem_FreePool( mempool_t **pool, int musthave, int canthave, const char *fi
 	}
 
 #ifdef SHOW_NONFREED
-	if( ( *pool )->chain ) {
+	if( ( *pool )->totalsize ) {
 		Com_Printf( "Warning: Memory pool %s has resources that weren't freed:\n", ( *pool )->name );
 	}
 	for( mem = ( *pool )->chain; mem; mem = mem->next ) {
 		Com_Printf( "%10i bytes allocated at %s:%i\n", mem->size, mem->filename, mem->fileline );
 	}
+	Mem_SmallForEachPoolBlock( *pool, Mem_SmallPrintPoolBlock, NULL );
 #endif
 
 	// unlink pool from chain
@@ -409,9 +1101,12 @@ void _Mem_FreePool( mempool_t **pool, int musthave, int canthave, const char *fi
 
 	while( ( *pool )->chain )  // free memory owned by the pool
 		Mem_Free( (void *)( (uint8_t *)( *pool )->chain + sizeof( memheader_t ) ) );
+	Mem_SmallFreePoolBlocks( *pool );
 
 	*chainAddress = ( *pool )->next;
 
+	QMutex_Destroy( &( *pool )->smallMutex );
+
 	// free the pool itself
 #ifdef MEMTRASH
 	memset( *pool, 0xBF, sizeof( mempool_t ) );
@@ -455,15 +1150,17 @@ void _Mem_EmptyPool( mempool_t *pool, int musthave, int canthave, const char *fi
 	}
 
 #ifdef SHOW_NONFREED
-	if( pool->chain ) {
+	if( pool->totalsize ) {
 		Com_Printf( "Warning: Memory pool %s has resources that weren't freed:\n", pool->name );
 	}
 	for( mem = pool->chain; mem; mem = mem->next ) {
 		Com_Printf( "%10i bytes allocated at %s:%i\n", mem->size, mem->filename, mem->fileline );
 	}
+	Mem_SmallForEachPoolBlock( pool, Mem_SmallPrintPoolBlock, NULL );
 #endif
 	while( pool->chain )        // free memory owned by the pool
 		Mem_Free( (void *)( (uint8_t *) pool->chain + sizeof( memheader_t ) ) );
+	Mem_SmallFreePoolBlocks( pool );
 }
 
 size_t Mem_PoolTotalSize( mempool_t *pool ) {
@@ -495,6 +1192,7 @@ void _Mem_CheckSentinels( void *data, const char *filename, int fileline ) {
 static void _Mem_CheckSentinelsPool( mempool_t *pool, const char *filename, int fileline ) {
 	memheader_t *mem;
 	mempool_t *child;
+	const char *location[2];
 
 	// recurse into children
 	if( pool->child ) {
@@ -514,6 +1212,10 @@ static void _Mem_CheckSentinelsPool( mempool_t *pool, const char *filename, int
 
 	for( mem = pool->chain; mem; mem = mem->next )
 		_Mem_CheckSentinels( (void *)( (uint8_t *) mem + sizeof( memheader_t ) ), filename, fileline );
+
+	location[0] = filename;
+	location[1] = (const char *)(intptr_t)fileline;
+	Mem_SmallForEachPoolBlock( pool, Mem_SmallCheckPoolBlock, (void *)location );
 }
 
 void _Mem_CheckSentinelsGlobal( const char *filename, int fileline ) {
@@ -544,6 +1246,8 @@ static void Mem_CountPoolStats( mempool_t *pool, int *count, int *size, int *rea
 }
 
 static void Mem_PrintStats( void ) {
+	unsigned i;
+	int numSlabs;
 	int count, size, real;
 	int total, totalsize, realsize;
 	mempool_t *pool;
@@ -562,15 +1266,21 @@ static void Mem_PrintStats( void ) {
 
 	// temporary pools are not nested
 	for( pool = poolChain; pool; pool = pool->next ) {
-		if( ( pool->flags & MEMPOOL_TEMPORARY ) && pool->chain ) {
+		if( ( pool->flags & MEMPOOL_TEMPORARY ) && pool->totalsize ) {
 			Com_Printf( "%i bytes (%.3fMB) (%i bytes (%.3fMB actual)) of temporary memory still allocated (Leak!)\n", pool->totalsize, pool->totalsize / 1048576.0,
 						pool->realsize, pool->realsize / 1048576.0 );
 			Com_Printf( "listing temporary memory allocations for %s:\n", pool->name );
 
 			for( mem = tempMemPool->chain; mem; mem = mem->next )
 				Com_Printf( "%10" PRIu64 " bytes allocated at %s:%i\n", (uint64_t)mem->size, mem->filename, mem->fileline );
+			Mem_SmallForEachPoolBlock( pool, Mem_SmallPrintPoolBlock, NULL );
 		}
 	}
+
+	for( i = 0, numSlabs = 0; i < MEMSMALL_NUM_CLASSES; i++ ) {
+		numSlabs += memSmallClasses[i].numSlabs;
+	}
+	Com_Printf( "%i small-object slabs, %i bytes (%.3fMB)\n", numSlabs, numSlabs * MEMSLAB_SIZE, numSlabs * MEMSLAB_SIZE / 1048576.0 );
 }
 
 static void Mem_PrintPoolStats( mempool_t *pool, int listchildren, int listallocations ) {
@@ -599,6 +1309,7 @@ static void Mem_PrintPoolStats( mempool_t *pool, int listchildren, int listalloc
 	if( listallocations ) {
 		for( mem = pool->chain; mem; mem = mem->next )
 			Com_Printf( "%10" PRIu64 " bytes allocated at %s:%i\n", (uint64_t)mem->size, mem->filename, mem->fileline );
+		Mem_SmallForEachPoolBlock( pool, Mem_SmallPrintPoolBlock, NULL );
 	}
 
 	if( listchildren ) {
@@ -618,6 +1329,8 @@ static void Mem_PrintList( int listchildren, int listallocations ) {
 
 	for( pool = poolChain; pool; pool = pool->next )
 		Mem_PrintPoolStats( pool, listchildren, listallocations );
+
+	Mem_PrintFrameArenas();
 }
 
 static void MemList_f( void ) {
@@ -658,6 +1371,90 @@ static void MemStats_f( void ) {
 	Mem_PrintStats();
 }
 
+#define MEMBENCH_MAX_THREADS        16
+#define MEMBENCH_LIVE_ALLOCS        256
+
+typedef struct {
+	mempool_t *pool;
+	int numAllocs;
+	unsigned seed;
+} membenchthread_t;
+
+/*
+* Mem_BenchThreadProc
+*
+* Keeps a window of live allocations of random small sizes, replacing a random one each step.
+*/
+static void *Mem_BenchThreadProc( void *param ) {
+	membenchthread_t *thread = (membenchthread_t *)param;
+	void *allocs[MEMBENCH_LIVE_ALLOCS];
+	unsigned seed = thread->seed;
+	int i, slot;
+
+	for( i = 0; i < MEMBENCH_LIVE_ALLOCS; i++ ) {
+		allocs[i] = Mem_Alloc( thread->pool, 16 + i % 512 );
+	}
+
+	for( i = 0; i < thread->numAllocs; i++ ) {
+		seed = seed * 1103515245 + 12345;
+		slot = ( seed >> 16 ) % MEMBENCH_LIVE_ALLOCS;
+		Mem_Free( allocs[slot] );
+		allocs[slot] = Mem_Alloc( thread->pool, 8 + ( seed >> 8 ) % 600 );
+	}
+
+	for( i = 0; i < MEMBENCH_LIVE_ALLOCS; i++ ) {
+		Mem_Free( allocs[i] );
+	}
+
+	return NULL;
+}
+
+/*
+* MemBench_f
+*
+* Compares the small-object allocator against plain malloc'ed blocks under concurrent load.
+*/
+static void MemBench_f( void ) {
+	int i, pass, numThreads, numAllocs;
+	membenchthread_t threads[MEMBENCH_MAX_THREADS];
+	qthread_t *handles[MEMBENCH_MAX_THREADS];
+	mempool_t *pool;
+	uint64_t timestamp, passTimes[2];
+	const bool wasEnabled = memSmallAllocsEnabled.load();
+
+	numThreads = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 4;
+	numAllocs = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 1000000;
+	if( numThreads <= 0 || numThreads > MEMBENCH_MAX_THREADS || numAllocs <= 0 ) {
+		Com_Printf( "Usage: membench [numthreads (1-%i)] [allocsperthread]\n", MEMBENCH_MAX_THREADS );
+		return;
+	}
+
+	pool = Mem_AllocPool( NULL, "Memory Benchmark" );
+
+	for( pass = 0; pass < 2; pass++ ) {
+		memSmallAllocsEnabled = pass != 0;
+
+		timestamp = Sys_Microseconds();
+		for( i = 0; i < numThreads; i++ ) {
+			threads[i].pool = pool;
+			threads[i].numAllocs = numAllocs;
+			threads[i].seed = i + 1;
+			handles[i] = QThread_Create( Mem_BenchThreadProc, &threads[i] );
+		}
+		for( i = 0; i < numThreads; i++ ) {
+			QThread_Join( handles[i] );
+		}
+		passTimes[pass] = Sys_Microseconds() - timestamp;
+	}
+
+	memSmallAllocsEnabled = wasEnabled;
+
+	Mem_FreePool( &pool );
+
+	Com_Printf( "%i threads, %i allocations each\n", numThreads, numAllocs );
+	Com_Printf( "malloc: %.3f ms, small-object allocator: %.3f ms\n", passTimes[0] / 1000.0, passTimes[1] / 1000.0 );
+}
+
 
 /*
 * Memory_Init
@@ -667,8 +1464,11 @@ void Memory_Init( void ) {
 
 	memMutex = QMutex_Create();
 
+	Mem_SmallInit();
+
 	zoneMemPool = Mem_AllocPool( NULL, "Zone" );
 	tempMemPool = Mem_AllocTempPool( "Temporary Memory" );
+	memArenaPool = Mem_AllocPool( NULL, "Frame Arenas" );
 
 	memory_initialized = true;
 }
@@ -683,6 +1483,7 @@ void Memory_InitCommands( void ) {
 
 	Cmd_AddCommand( "memlist", MemList_f );
 	Cmd_AddCommand( "memstats", MemStats_f );
+	Cmd_AddCommand( "membench", MemBench_f );
 
 	commands_initialized = true;
 }
@@ -704,8 +1505,14 @@ void Memory_Shutdown( void ) {
 
 	Mem_CheckSentinelsGlobal();
 
+	// chunks are freed along with the pool, don't let the main thread reuse them
+	memFrameArena.first = memFrameArena.current = NULL;
+	memFrameArena.frameNum = 0;
+
 	Mem_FreePool( &zoneMemPool );
 	Mem_FreePool( &tempMemPool );
+	Mem_FreePool( &memArenaPool );
+	memFrameArenas = NULL;
 
 	for( pool = poolChain; pool; pool = next ) {
 		// do it here, because pool is to be freed
@@ -717,6 +1524,8 @@ void Memory_Shutdown( void ) {
 		Mem_FreePool( &pool );
 	}
 
+	Mem_SmallShutdown();
+
 	QMutex_Destroy( &memMutex );
 
 	memory_initialized = false;
@@ -732,4 +1541,5 @@ void Memory_ShutdownCommands( void ) {
 
 	Cmd_RemoveCommand( "memlist" );
 	Cmd_RemoveCommand( "memstats" );
+	Cmd_RemoveCommand( "membench" );
 }
@@ -43,7 +43,21 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/time.h>
 #endif
 
+#if defined( __linux__ )
+#define NET_USE_EPOLL
+#define NET_USE_MMSG
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <time.h>
+#endif
+
 #include <algorithm>
+#include <atomic>
+
+#ifdef NET_USE_EPOLL
+#include <unordered_map>
+#endif
 
 #define MAX_LOOPBACK    4
 
@@ -65,6 +79,38 @@ typedef struct {
 	int datalen;
 } loopmsg_t;
 
+#define NET_MAX_PACKETS_BATCH   64
+#define NET_MAX_BATCHED_PACKETS 128
+
+typedef struct {
+	const socket_t *socket;
+	socket_handle_t handle;
+	netadr_t address;
+	socklen_t addrlen;
+	struct sockaddr_storage addr;
+	size_t length;
+	uint8_t data[MAX_PACKETLEN];
+} net_batchedpacket_t;
+
+typedef struct {
+	const socket_t *socket;
+	netadr_t address;
+	char error[128];
+} net_batchedsenderror_t;
+
+// outgoing UDP datagrams queued between NET_BeginSendBatch() and NET_FlushSendBatch()
+typedef struct {
+	qmutex_t *mutex;
+	std::atomic_int depth;
+	int numPackets;
+	net_batchedpacket_t packets[NET_MAX_BATCHED_PACKETS];
+	// datagrams might be flushed before the outermost NET_FlushSendBatch() call, so errors are kept till then
+	int numErrors;
+	net_batchedsenderror_t errors[NET_MAX_BATCHED_PACKETS];
+} net_sendbatch_t;
+
+static net_sendbatch_t net_sendBatch;
+
 typedef struct {
 	bool open;
 	loopmsg_t msgs[MAX_LOOPBACK];
@@ -75,6 +121,9 @@ static loopback_t loopbacks[2];
 static char errorstring[MAX_PRINTMSG];
 static bool net_initialized = false;
 
+// Sockets get a new serial every time they are opened, so waiters can tell a reused handle from a registered one
+static std::atomic<unsigned> net_socketSerial( 0 );
+
 #define MAX_IPS 16
 static int numIP;
 static uint8_t localIP[MAX_IPS][4];
@@ -375,6 +424,219 @@ static int NET_UDP_GetPacket( const socket_t *socket, netadr_t *address, msg_t *
 	return 1;
 }
 
+/*
+* NET_UDP_GetPackets
+*
+* Reads up to maxPackets datagrams with a single recvmmsg() call.
+* Malformed datagrams are skipped, -1 is returned only if no valid datagram has been read.
+*/
+#ifdef NET_USE_MMSG
+static int NET_UDP_GetPackets( const socket_t *socket, netadr_t *addresses, msg_t *messages, int maxPackets ) {
+	struct mmsghdr hdrs[NET_MAX_PACKETS_BATCH];
+	struct iovec iovecs[NET_MAX_PACKETS_BATCH];
+	struct sockaddr_storage from[NET_MAX_PACKETS_BATCH];
+	int i, ret, numPackets, numDropped;
+
+	assert( socket && socket->open && socket->type == SOCKET_UDP );
+	assert( addresses );
+	assert( messages );
+	assert( maxPackets > 0 );
+
+	if( maxPackets > NET_MAX_PACKETS_BATCH ) {
+		maxPackets = NET_MAX_PACKETS_BATCH;
+	}
+
+	memset( hdrs, 0, maxPackets * sizeof( hdrs[0] ) );
+	for( i = 0; i < maxPackets; i++ ) {
+		assert( messages[i].data );
+		assert( messages[i].maxsize > 0 );
+		iovecs[i].iov_base = messages[i].data;
+		iovecs[i].iov_len = messages[i].maxsize;
+		hdrs[i].msg_hdr.msg_name = &from[i];
+		hdrs[i].msg_hdr.msg_namelen = sizeof( from[i] );
+		hdrs[i].msg_hdr.msg_iov = &iovecs[i];
+		hdrs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	ret = recvmmsg( socket->handle, hdrs, maxPackets, MSG_DONTWAIT, NULL );
+	if( ret == SOCKET_ERROR ) {
+		net_error_t err;
+
+		NET_SetErrorStringFromLastError( "recvmmsg" );
+
+		err = Sys_NET_GetLastError();
+		if( err == NET_ERR_WOULDBLOCK || err == NET_ERR_CONNRESET ) { // would block
+			return 0;
+		}
+
+		return -1;
+	}
+
+	numPackets = 0;
+	numDropped = 0;
+	for( i = 0; i < ret; i++ ) {
+		const unsigned length = hdrs[i].msg_len;
+
+		if( !SockaddressToAddress( (struct sockaddr*)&from[i], &addresses[numPackets] ) ) {
+			numDropped++;
+			continue;
+		}
+
+		if( ( hdrs[i].msg_hdr.msg_flags & MSG_TRUNC ) || length == (unsigned)messages[i].maxsize ) {
+			NET_SetErrorString( "Oversized packet" );
+			numDropped++;
+			continue;
+		}
+
+		// keep valid messages contiguous, buffers travel along with their msg_t
+		if( numPackets != i ) {
+			std::swap( messages[numPackets], messages[i] );
+		}
+		messages[numPackets].readcount = 0;
+		messages[numPackets].cursize = length;
+		numPackets++;
+	}
+
+	if( !numPackets && numDropped ) {
+		return -1;
+	}
+
+	return numPackets;
+}
+#endif
+
+/*
+* NET_SendBatch_AddErrorLocked
+*
+* Records the current error string for the destination of the datagram, once per socket and address.
+*/
+static void NET_SendBatch_AddErrorLocked( const net_batchedpacket_t *packet ) {
+	int i;
+	net_batchedsenderror_t *error;
+
+	for( i = 0; i < net_sendBatch.numErrors; i++ ) {
+		error = &net_sendBatch.errors[i];
+		if( error->socket == packet->socket && NET_CompareAddress( &error->address, &packet->address ) ) {
+			return;
+		}
+	}
+
+	if( net_sendBatch.numErrors == NET_MAX_BATCHED_PACKETS ) {
+		return;
+	}
+
+	error = &net_sendBatch.errors[net_sendBatch.numErrors++];
+	error->socket = packet->socket;
+	error->address = packet->address;
+	Q_strncpyz( error->error, NET_ErrorString(), sizeof( error->error ) );
+}
+
+/*
+* NET_SendBatch_FlushLocked
+*
+* Transmits all queued datagrams, consecutive datagrams of the same socket are sent by a single call.
+*/
+static void NET_SendBatch_FlushLocked( void ) {
+	int i, first, count;
+
+	for( first = 0; first < net_sendBatch.numPackets; first += count ) {
+		const socket_handle_t handle = net_sendBatch.packets[first].handle;
+
+		for( count = 1; first + count < net_sendBatch.numPackets; count++ ) {
+			if( net_sendBatch.packets[first + count].handle != handle ) {
+				break;
+			}
+		}
+
+#ifdef NET_USE_MMSG
+		struct mmsghdr hdrs[NET_MAX_BATCHED_PACKETS];
+		struct iovec iovecs[NET_MAX_BATCHED_PACKETS];
+
+		memset( hdrs, 0, count * sizeof( hdrs[0] ) );
+		for( i = 0; i < count; i++ ) {
+			net_batchedpacket_t *packet = &net_sendBatch.packets[first + i];
+			iovecs[i].iov_base = packet->data;
+			iovecs[i].iov_len = packet->length;
+			hdrs[i].msg_hdr.msg_name = &packet->addr;
+			hdrs[i].msg_hdr.msg_namelen = packet->addrlen;
+			hdrs[i].msg_hdr.msg_iov = &iovecs[i];
+			hdrs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		for( i = 0; i < count; ) {
+			int sent = sendmmsg( handle, hdrs + i, count - i, MSG_NOSIGNAL );
+			if( sent == SOCKET_ERROR ) {
+				// the error belongs to the first datagram that has not been sent, skip it
+				NET_SetErrorStringFromLastError( "sendmmsg" );
+				NET_SendBatch_AddErrorLocked( &net_sendBatch.packets[first + i] );
+				sent = 1;
+			}
+			i += sent;
+		}
+#else
+		for( i = 0; i < count; i++ ) {
+			const net_batchedpacket_t *packet = &net_sendBatch.packets[first + i];
+#ifndef _WIN32
+			ssize_t res = ::sendto( handle, packet->data, packet->length, 0, (const struct sockaddr *)&packet->addr, packet->addrlen );
+#else
+			int64_t res = ::sendto( handle, (const char *)packet->data, (int)packet->length, 0, (const struct sockaddr *)&packet->addr, (int)packet->addrlen );
+#endif
+			if( res == SOCKET_ERROR ) {
+				NET_SetErrorStringFromLastError( "sendto" );
+				NET_SendBatch_AddErrorLocked( packet );
+			}
+		}
+#endif
+	}
+
+	net_sendBatch.numPackets = 0;
+}
+
+/*
+* NET_SendBatch_QueuePacket
+*
+* Returns false if the datagram should be sent immediately.
+*/
+static bool NET_SendBatch_QueuePacket( const socket_t *socket, const netadr_t *address, const void *data, size_t length,
+									   const struct sockaddr_storage *addr, socklen_t addrlen ) {
+	net_batchedpacket_t *packet;
+
+	// avoid locking when nothing is batched, which is the case for everything but the server frame
+	if( net_sendBatch.depth.load( std::memory_order_relaxed ) <= 0 ) {
+		return false;
+	}
+
+	QMutex_Lock( net_sendBatch.mutex );
+
+	if( net_sendBatch.depth.load( std::memory_order_relaxed ) <= 0 ) {
+		QMutex_Unlock( net_sendBatch.mutex );
+		return false;
+	}
+
+	if( length > sizeof( packet->data ) ) {
+		// preserve ordering of datagrams, the caller is going to send this one directly
+		NET_SendBatch_FlushLocked();
+		QMutex_Unlock( net_sendBatch.mutex );
+		return false;
+	}
+
+	if( net_sendBatch.numPackets == NET_MAX_BATCHED_PACKETS ) {
+		NET_SendBatch_FlushLocked();
+	}
+
+	packet = &net_sendBatch.packets[net_sendBatch.numPackets++];
+	packet->socket = socket;
+	packet->handle = socket->handle;
+	packet->address = *address;
+	packet->addr = *addr;
+	packet->addrlen = addrlen;
+	packet->length = length;
+	memcpy( packet->data, data, length );
+
+	QMutex_Unlock( net_sendBatch.mutex );
+	return true;
+}
+
 /*
 * NET_UDP_SendPacket
 */
@@ -393,6 +655,11 @@ static bool NET_UDP_SendPacket( const socket_t *socket, const void *data, size_t
 
 	addrlen = ( addr.ss_family == AF_INET6 ? sizeof( struct sockaddr_in6 ) : sizeof( struct sockaddr_in ) );
 
+	// send errors of queued datagrams are reported on flush
+	if( NET_SendBatch_QueuePacket( socket, address, data, length, &addr, addrlen ) ) {
+		return true;
+	}
+
 #ifndef _WIN32
 	ssize_t res = ::sendto( socket->handle, data, length, 0, (struct sockaddr *)&addr, addrlen );
 #else
@@ -479,6 +746,7 @@ static bool NET_IP_OpenSocket( socket_t *sock, const netadr_t *address, socket_t
 	sock->address = *address;
 	sock->server = server;
 	sock->handle = newsocket;
+	sock->serial = ++net_socketSerial;
 
 	return true;
 }
@@ -778,6 +1046,7 @@ static int NET_TCP_Accept( const socket_t *socket, socket_t *newsocket, netadr_t
 	newsocket->address = socket->address;
 	newsocket->remoteAddress = *address;
 	newsocket->handle = handle;
+	newsocket->serial = ++net_socketSerial;
 
 	return 1;
 }
@@ -994,6 +1263,81 @@ int NET_GetPacket( const socket_t *socket, netadr_t *address, msg_t *message ) {
 	}
 }
 
+/*
+* NET_GetPackets
+*
+* Reads up to maxPackets datagrams at once, data buffers may get swapped between the messages.
+* Returns the number of read packets, -1 on error.
+*/
+int NET_GetPackets( const socket_t *socket, netadr_t *addresses, msg_t *messages, int maxPackets ) {
+	int i, ret;
+
+	assert( socket->open );
+
+	if( !socket->open ) {
+		return -1;
+	}
+
+#ifdef NET_USE_MMSG
+	if( socket->type == SOCKET_UDP ) {
+		return NET_UDP_GetPackets( socket, addresses, messages, maxPackets );
+	}
+#endif
+
+	for( i = 0; i < maxPackets; i++ ) {
+		ret = NET_GetPacket( socket, &addresses[i], &messages[i] );
+		if( ret == 0 ) {
+			break;
+		}
+		if( ret == -1 ) {
+			return i ? i : -1;
+		}
+	}
+
+	return i;
+}
+
+/*
+* NET_BeginSendBatch
+*
+* Queues outgoing UDP datagrams until the matching NET_FlushSendBatch() call.
+* Calls may be nested, only the outermost flush transmits the datagrams.
+*/
+void NET_BeginSendBatch( void ) {
+	QMutex_Lock( net_sendBatch.mutex );
+	net_sendBatch.depth.fetch_add( 1, std::memory_order_relaxed );
+	QMutex_Unlock( net_sendBatch.mutex );
+}
+
+/*
+* NET_FlushSendBatch
+*
+* Once the outermost batch is flushed, error_cb (if any) is called for every socket and address
+* a queued datagram could not be sent to.
+*/
+void NET_FlushSendBatch( net_senderror_cb_t error_cb ) {
+	int i, numErrors = 0;
+	static net_batchedsenderror_t errors[NET_MAX_BATCHED_PACKETS];
+
+	QMutex_Lock( net_sendBatch.mutex );
+	assert( net_sendBatch.depth.load( std::memory_order_relaxed ) > 0 );
+	if( net_sendBatch.depth.fetch_sub( 1, std::memory_order_relaxed ) == 1 ) {
+		NET_SendBatch_FlushLocked();
+
+		// the callback might send datagrams itself, so call it without holding the lock
+		numErrors = net_sendBatch.numErrors;
+		memcpy( errors, net_sendBatch.errors, numErrors * sizeof( errors[0] ) );
+		net_sendBatch.numErrors = 0;
+	}
+	QMutex_Unlock( net_sendBatch.mutex );
+
+	if( error_cb ) {
+		for( i = 0; i < numErrors; i++ ) {
+			error_cb( errors[i].socket, &errors[i].address, errors[i].error );
+		}
+	}
+}
+
 /*
 * NET_Get
 *
@@ -1730,18 +2074,200 @@ int NET_SetSocketNoDelay( socket_t *socket, int nodelay ) {
 	return 0;
 }
 
+#ifdef NET_USE_EPOLL
+
+#define NET_EPOLL_MAX_EVENTS 64
+
+/**
+ * A set of sockets that are registered in an epoll instance.
+ * Registrations are kept across calls, so waiting on the same sockets every frame
+ * does not require any epoll_ctl() calls. Each thread that waits on sockets has its own set.
+ */
+struct NetEpollWaitSet {
+	struct Registration {
+		unsigned serial;
+		uint32_t events;
+		unsigned mark;
+		int socketNum;
+	};
+
+	int epollFd;
+	bool failed;
+	bool hasPwait2;
+	unsigned mark;
+	std::unordered_map<int, Registration> registrations;
+
+	NetEpollWaitSet(): epollFd( -1 ), failed( false ), hasPwait2( true ), mark( 0 ) {}
+
+	~NetEpollWaitSet() {
+		if( epollFd >= 0 ) {
+			close( epollFd );
+		}
+	}
+};
+
+static thread_local NetEpollWaitSet net_epollWaitSet;
+
 /*
-* NET_Sleep
+* NET_Epoll_Register
 */
-void NET_Sleep( int msec, socket_t *sockets[] ) {
+static bool NET_Epoll_Register( NetEpollWaitSet *waitSet, const socket_t *socket, int socketNum, uint32_t events ) {
+	struct epoll_event event;
+	int op = EPOLL_CTL_ADD;
+
+	auto it = waitSet->registrations.find( socket->handle );
+	if( it != waitSet->registrations.end() ) {
+		NetEpollWaitSet::Registration &reg = it->second;
+		if( reg.serial == socket->serial && reg.events == events ) {
+			reg.mark = waitSet->mark;
+			reg.socketNum = socketNum;
+			return true;
+		}
+		// The handle might still be registered if the socket has been reopened with the same handle
+		op = EPOLL_CTL_MOD;
+	}
+
+	memset( &event, 0, sizeof( event ) );
+	event.events = events;
+	event.data.fd = socket->handle;
+	if( epoll_ctl( waitSet->epollFd, op, socket->handle, &event ) < 0 ) {
+		// The old registration might have been dropped by the kernel on closing the old socket and vice versa
+		op = ( op == EPOLL_CTL_ADD ) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+		if( epoll_ctl( waitSet->epollFd, op, socket->handle, &event ) < 0 ) {
+			NET_SetErrorStringFromLastError( "epoll_ctl" );
+			return false;
+		}
+	}
+
+	NetEpollWaitSet::Registration &reg = waitSet->registrations[socket->handle];
+	reg.serial = socket->serial;
+	reg.events = events;
+	reg.mark = waitSet->mark;
+	reg.socketNum = socketNum;
+	return true;
+}
+
+/*
+* NET_Epoll_Wait
+*
+* Returns a number of ready sockets, or -1 if epoll can't be used and the caller should fall back to select().
+*/
+static int NET_Epoll_Wait( int64_t usec, socket_t *sockets[], uint32_t events,
+						   void ( *read_cb )( socket_t *, void* ), void ( *write_cb )( socket_t *, void* ),
+						   void ( *exception_cb )( socket_t *, void* ), void *privatep[] ) {
+	NetEpollWaitSet *waitSet = &net_epollWaitSet;
+	struct epoll_event readyEvents[NET_EPOLL_MAX_EVENTS];
+	int i, ret;
+
+	if( waitSet->failed ) {
+		return -1;
+	}
+
+	if( waitSet->epollFd < 0 ) {
+		waitSet->epollFd = epoll_create1( EPOLL_CLOEXEC );
+		if( waitSet->epollFd < 0 ) {
+			NET_SetErrorStringFromLastError( "epoll_create1" );
+			Com_DPrintf( "NET_Epoll_Wait: %s, falling back to select()\n", NET_ErrorString() );
+			waitSet->failed = true;
+			return -1;
+		}
+	}
+
+	waitSet->mark++;
+	for( i = 0; sockets[i]; i++ ) {
+		if( !sockets[i]->open ) {
+			continue;
+		}
+		if( sockets[i]->type != SOCKET_UDP
+#ifdef TCP_SUPPORT
+			&& sockets[i]->type != SOCKET_TCP
+#endif
+			) {
+			continue;
+		}
+		assert( sockets[i]->handle > 0 );
+		if( !NET_Epoll_Register( waitSet, sockets[i], i, events ) ) {
+			return -1;
+		}
+	}
+
+	// Drop sockets that are not waited for anymore
+	for( auto it = waitSet->registrations.begin(); it != waitSet->registrations.end(); ) {
+		if( it->second.mark != waitSet->mark ) {
+			// Closed handles are removed by the kernel automatically, so errors are expected here
+			epoll_ctl( waitSet->epollFd, EPOLL_CTL_DEL, it->first, NULL );
+			it = waitSet->registrations.erase( it );
+		} else {
+			++it;
+		}
+	}
+
+	ret = -1;
+#ifdef SYS_epoll_pwait2
+	if( waitSet->hasPwait2 ) {
+		struct timespec timeout;
+		timeout.tv_sec = usec / 1000000;
+		timeout.tv_nsec = ( usec % 1000000 ) * 1000;
+		ret = (int)syscall( SYS_epoll_pwait2, waitSet->epollFd, readyEvents, NET_EPOLL_MAX_EVENTS, &timeout, NULL, 0 );
+		if( ret < 0 && errno == ENOSYS ) {
+			// Kernels older than 5.11 do not have it
+			waitSet->hasPwait2 = false;
+		}
+	}
+	if( !waitSet->hasPwait2 )
+#endif
+	{
+		// Round up so we never wake up before the requested time
+		ret = epoll_wait( waitSet->epollFd, readyEvents, NET_EPOLL_MAX_EVENTS, (int)( ( usec + 999 ) / 1000 ) );
+	}
+
+	if( ret < 0 ) {
+		if( errno != EINTR ) {
+			NET_SetErrorStringFromLastError( "epoll_wait" );
+		}
+		return 0;
+	}
+
+	if( !read_cb && !write_cb && !exception_cb ) {
+		return ret;
+	}
+
+	// Launch callbacks
+	for( i = 0; i < ret; i++ ) {
+		const uint32_t readyMask = readyEvents[i].events;
+		auto it = waitSet->registrations.find( readyEvents[i].data.fd );
+		if( it == waitSet->registrations.end() ) {
+			continue;
+		}
+
+		const int socketNum = it->second.socketNum;
+		socket_t *socket = sockets[socketNum];
+		void *priv = privatep ? privatep[socketNum] : NULL;
+		// Report errors and hangups like select() does (a socket in this state is readable and writable)
+		if( exception_cb && ( readyMask & EPOLLPRI ) && socket->open ) {
+			exception_cb( socket, priv );
+		}
+		if( read_cb && ( readyMask & ( EPOLLIN | EPOLLERR | EPOLLHUP ) ) && socket->open ) {
+			read_cb( socket, priv );
+		}
+		if( write_cb && ( readyMask & ( EPOLLOUT | EPOLLERR ) ) && socket->open ) {
+			write_cb( socket, priv );
+		}
+	}
+
+	return ret;
+}
+
+#endif
+
+/*
+* NET_Sleep_Select
+*/
+static void NET_Sleep_Select( int64_t usec, socket_t *sockets[] ) {
 	struct timeval timeout;
 	fd_set fdset;
 	int i;
 
-	if( !sockets || !sockets[0] ) {
-		return;
-	}
-
 	FD_ZERO( &fdset );
 
 	for( i = 0; sockets[i]; i++ ) {
@@ -1762,32 +2288,46 @@ void NET_Sleep( int msec, socket_t *sockets[] ) {
 		}
 	}
 
-	timeout.tv_sec = msec / 1000;
-	timeout.tv_usec = ( msec % 1000 ) * 1000;
+	timeout.tv_sec = usec / 1000000;
+	timeout.tv_usec = usec % 1000000;
 	select( FD_SETSIZE, &fdset, NULL, NULL, &timeout );
 }
 
 /*
-* NET_Monitor
-* Monitors the given sockets with the given timeout in milliseconds
-* It ignores closed and loopback sockets.
-* Calls the callback function read_cb(socket_t *) with the socket as parameter when incoming data was detected on it
-* Calls the callback function write_cb(socket_t *) with the socket as parameter when the socket is ready to accept outgoing data
-* Calls the callback function exception_cb(socket_t *) with the socket as parameter when a socket exception was detected on that socket
-* For both callbacks, NULL can be passed. When NULL is passed for the exception_cb, no exception detection is performed
-* Incoming data is always detected, even if the 'read_cb' callback was NULL.
+* NET_SleepMicros
+* Waits for incoming data on the given sockets for the given timeout in microseconds
 */
-int NET_Monitor( int msec, socket_t *sockets[], void ( *read_cb )( socket_t *, void* ), void ( *write_cb )( socket_t *, void* ), void ( *exception_cb )( socket_t *, void* ), void *privatep[] ) {
+void NET_SleepMicros( int64_t usec, socket_t *sockets[] ) {
+	if( !sockets || !sockets[0] ) {
+		return;
+	}
+
+#ifdef NET_USE_EPOLL
+	if( NET_Epoll_Wait( usec, sockets, EPOLLIN, NULL, NULL, NULL, NULL ) >= 0 ) {
+		return;
+	}
+#endif
+
+	NET_Sleep_Select( usec, sockets );
+}
+
+/*
+* NET_Sleep
+*/
+void NET_Sleep( int msec, socket_t *sockets[] ) {
+	NET_SleepMicros( (int64_t)msec * 1000, sockets );
+}
+
+/*
+* NET_Monitor_Select
+*/
+static int NET_Monitor_Select( int msec, socket_t *sockets[], void ( *read_cb )( socket_t *, void* ), void ( *write_cb )( socket_t *, void* ), void ( *exception_cb )( socket_t *, void* ), void *privatep[] ) {
 	struct timeval timeout;
 	fd_set fdsetr, fdsetw, fdsete;
 	fd_set *p_fdsetw = NULL, *p_fdsete = NULL;
 	int i, ret;
 	int fdmax = 0;
 
-	if( !sockets || !sockets[0] ) {
-		return 0;
-	}
-
 	FD_ZERO( &fdsetr );
 	if( write_cb ) {
 		FD_ZERO( &fdsetw );
@@ -1857,6 +2397,39 @@ int NET_Monitor( int msec, socket_t *sockets[], void ( *read_cb )( socket_t *, v
 	return ret;
 }
 
+/*
+* NET_Monitor
+* Monitors the given sockets with the given timeout in milliseconds
+* It ignores closed and loopback sockets.
+* Calls the callback function read_cb(socket_t *) with the socket as parameter when incoming data was detected on it
+* Calls the callback function write_cb(socket_t *) with the socket as parameter when the socket is ready to accept outgoing data
+* Calls the callback function exception_cb(socket_t *) with the socket as parameter when a socket exception was detected on that socket
+* For both callbacks, NULL can be passed. When NULL is passed for the exception_cb, no exception detection is performed
+* Incoming data is always detected, even if the 'read_cb' callback was NULL.
+*/
+int NET_Monitor( int msec, socket_t *sockets[], void ( *read_cb )( socket_t *, void* ), void ( *write_cb )( socket_t *, void* ), void ( *exception_cb )( socket_t *, void* ), void *privatep[] ) {
+	if( !sockets || !sockets[0] ) {
+		return 0;
+	}
+
+#ifdef NET_USE_EPOLL
+	uint32_t events = EPOLLIN;
+	if( write_cb ) {
+		events |= EPOLLOUT;
+	}
+	if( exception_cb ) {
+		events |= EPOLLPRI;
+	}
+
+	int ret = NET_Epoll_Wait( (int64_t)msec * 1000, sockets, events, read_cb, write_cb, exception_cb, privatep );
+	if( ret >= 0 ) {
+		return ret;
+	}
+#endif
+
+	return NET_Monitor_Select( msec, sockets, read_cb, write_cb, exception_cb, privatep );
+}
+
 /*
 * NET_SendFile
 */
@@ -1906,6 +2479,10 @@ void NET_Init( void ) {
 
 	GetLocalAddress();
 
+	net_sendBatch.mutex = QMutex_Create();
+	net_sendBatch.depth = 0;
+	net_sendBatch.numPackets = 0;
+
 	net_initialized = true;
 }
 
@@ -1919,6 +2496,8 @@ void NET_Shutdown( void ) {
 
 	errorstring[0] = '\0';
 
+	QMutex_Destroy( &net_sendBatch.mutex );
+
 	Sys_NET_Shutdown();
 
 	net_initialized = false;
@@ -61,6 +61,7 @@ typedef struct {
 	netadr_t remoteAddress;
 
 	socket_handle_t handle;
+	unsigned serial;            // changes every time the socket is opened
 } socket_t;
 
 typedef enum {
@@ -94,13 +95,19 @@ int         NET_Accept( const socket_t *socket, socket_t *newsocket, netadr_t *a
 #endif
 
 int         NET_GetPacket( const socket_t *socket, netadr_t *address, struct msg_s *message );
+int         NET_GetPackets( const socket_t *socket, netadr_t *addresses, struct msg_s *messages, int maxPackets );
 bool        NET_SendPacket( const socket_t *socket, const void *data, size_t length, const netadr_t *address );
 
 int         NET_Get( const socket_t *socket, netadr_t *address, void *data, size_t length );
 int         NET_Send( const socket_t *socket, const void *data, size_t length, const netadr_t *address );
 int64_t     NET_SendFile( const socket_t *socket, int file, size_t offset, size_t count, const netadr_t *address );
+// called for every socket and address a batched datagram could not be sent to
+typedef void ( *net_senderror_cb_t )( const socket_t *socket, const netadr_t *address, const char *error );
+void        NET_BeginSendBatch( void );
+void        NET_FlushSendBatch( net_senderror_cb_t error_cb );
 
 void        NET_Sleep( int msec, socket_t *sockets[] );
+void        NET_SleepMicros( int64_t usec, socket_t *sockets[] );
 int         NET_Monitor( int msec, socket_t *sockets[],
 						 void ( *read_cb )( socket_t *socket, void* ),
 						 void ( *write_cb )( socket_t *socket, void* ),
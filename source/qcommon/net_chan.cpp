@@ -141,90 +141,19 @@ void Netchan_Setup( netchan_t *chan, const socket_t *socket, const netadr_t *add
 
 static uint8_t msg_process_data[MAX_MSGLEN];
 
-//=============================================================
-// Zlib compression
-//=============================================================
-
-#include "compression.h"
-
-static int Netchan_ZLibCompressChunk( const uint8_t *source, unsigned long sourceLen, uint8_t *dest, unsigned long destLen,
-									  int level, int wbits ) {
-	int result, zlerror;
-
-	zlerror = qzcompress2( dest, &destLen, source, sourceLen, level );
-	switch( zlerror ) {
-		case Z_OK:
-			result = destLen; // returns the new length into destLen
-			break;
-		case Z_MEM_ERROR:
-			Com_DPrintf( "ZLib data error! Z_MEM_ERROR on compress.\n" );
-			result = -1;
-			break;
-		case Z_BUF_ERROR:
-			Com_DPrintf( "ZLib data error! Z_BUF_ERROR on compress.\n" );
-			result = -1;
-			break;
-		case Z_STREAM_ERROR:
-			Com_DPrintf( "ZLib data error! Z_STREAM_ERROR on compress.\n" );
-			result = -1;
-			break;
-		default:
-			Com_DPrintf( "ZLib data error! Error code %i on compress.\n", zlerror );
-			result = -1;
-			break;
-	}
-
-	return result;
-}
-
-static int Netchan_ZLibDecompressChunk( const uint8_t *source, unsigned long sourceLen, uint8_t *dest, unsigned long destLen,
-										int wbits ) {
-	int result, zlerror;
-
-	zlerror = qzuncompress( dest, &destLen, source, sourceLen );
-	switch( zlerror ) {
-		case Z_OK:
-			result = destLen; // returns the new length into destLen
-			break;
-		case Z_MEM_ERROR:
-			Com_DPrintf( "ZLib data error! Z_MEM_ERROR on decompress.\n" );
-			result = -1;
-			break;
-		case Z_BUF_ERROR:
-			Com_DPrintf( "ZLib data error! Z_BUF_ERROR on decompress.\n" );
-			result = -1;
-			break;
-		case Z_DATA_ERROR:
-			Com_DPrintf( "ZLib data error! Z_DATA_ERROR on decompress.\n" );
-			result = -1;
-			break;
-		default:
-			Com_DPrintf( "ZLib data error! Error code %i on decompress.\n", zlerror );
-			result = -1;
-			break;
-	}
-
-	return result;
-}
-
 /*
 * Netchan_CompressMessage
 */
-int Netchan_CompressMessage( msg_t *msg ) {
+int Netchan_CompressMessage( msg_t *msg, int codec ) {
 	int length;
 
 	if( msg == NULL || !msg->data ) {
 		return 0;
 	}
 
-	// zero-fill our buffer
-	length = 0;
-	memset( msg_process_data, 0, sizeof( msg_process_data ) );
-
 	//compress the message
-	length = Netchan_ZLibCompressChunk( msg->data, msg->cursize,
-										msg_process_data, sizeof( msg_process_data ), Z_BEST_COMPRESSION, -MAX_WBITS );
-	if( length < 0 ) { // failed to compress, return the error
+	length = Netchan_CodecCompress( codec, msg->data, msg->cursize, msg_process_data, sizeof( msg_process_data ) );
+	if( length <= 0 ) { // failed to compress, return the error
 		return length;
 	}
 
@@ -243,7 +172,7 @@ int Netchan_CompressMessage( msg_t *msg ) {
 /*
 * Netchan_DecompressMessage
 */
-int Netchan_DecompressMessage( msg_t *msg ) {
+int Netchan_DecompressMessage( msg_t *msg, int codec ) {
 	int length;
 
 	if( msg == NULL || !msg->data ) {
@@ -254,7 +183,8 @@ int Netchan_DecompressMessage( msg_t *msg ) {
 		return 0;
 	}
 
-	length = Netchan_ZLibDecompressChunk( msg->data + msg->readcount, msg->cursize - msg->readcount, msg_process_data, ( sizeof( msg_process_data ) - msg->readcount ), -MAX_WBITS );
+	length = Netchan_CodecDecompress( codec, msg->data + msg->readcount, msg->cursize - msg->readcount,
+									  msg_process_data, ( sizeof( msg_process_data ) - msg->readcount ) );
 	if( length < 0 ) {
 		return length;
 	}
@@ -628,10 +558,13 @@ void Netchan_Init( void ) {
 	showpackets = Cvar_Get( "showpackets", "0", 0 );
 	showdrop = Cvar_Get( "showdrop", "0", 0 );
 	net_showfragments = Cvar_Get( "net_showfragments", "0", 0 );
+
+	Netchan_InitCodecs();
 }
 
 /*
 * Netchan_Shutdown
 */
 void Netchan_Shutdown( void ) {
+	Netchan_ShutdownCodecs();
 }
@@ -0,0 +1,763 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// net_codec.cpp -- netchan message compression codecs
+
+#include "qcommon.h"
+#include "compression.h"
+#include "../qalgo/md5.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+/*
+
+Codecs are negotiated per connection: the client offers a mask of codecs
+it's willing to use along with the checksum of its dictionary in the connect
+packet, the server picks the best one both sides support and replies with
+it in client_connect. Connections that haven't negotiated anything use zlib.
+
+The LZ codec is a byte-oriented LZ77 variant in the spirit of LZ4. A sequence is
+
+token           (literals length << 4) | (match length - NETCHAN_LZ_MIN_MATCH), 15 means "extended"
+[lit. length]   extra 255-terminated bytes if the literals length is 15
+literals
+offset          16-bit little endian distance to the match
+[match length]  extra 255-terminated bytes if the match length is 15
+
+The last sequence of a message consists of literals only.
+
+A dictionary is conceptually prepended to every message, so matches can
+refer to it. Dictionaries are trained on recorded traffic with netdicttrain.
+
+*/
+
+#define NETCHAN_LZ_MIN_MATCH        4
+#define NETCHAN_LZ_MAX_OFFSET       0xFFFF
+#define NETCHAN_LZ_HASH_LOG         13
+#define NETCHAN_LZ_HASH_SIZE        ( 1 << NETCHAN_LZ_HASH_LOG )
+#define NETCHAN_LZ_SKIP_TRIGGER     5
+
+#define NETCHAN_MAX_DICTIONARY_SIZE 0x8000
+
+typedef struct {
+	const char *name;
+	int ( *compress )( const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen );
+	int ( *decompress )( const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen );
+} netchan_codec_t;
+
+static cvar_t *net_compression_codec;
+
+// the dictionary is followed by the message being compressed
+static uint8_t lz_window[NETCHAN_MAX_DICTIONARY_SIZE + MAX_MSGLEN];
+static size_t lz_dictionaryLen;
+static unsigned lz_dictionaryChecksum;
+
+typedef struct {
+	uint32_t entry;
+	uint32_t generation;        // slots of older generations are stale
+} netchan_lzslot_t;
+
+// positions + 1 of the latest occurrences of 4-byte sequences in the window, 0 means none.
+// every message starts a new generation instead of clearing the table, stale slots
+// fall back to the dictionary table (or to none if the dictionary is not used).
+static netchan_lzslot_t lz_hashTable[NETCHAN_LZ_HASH_SIZE];
+static uint32_t lz_hashGeneration;
+static uint32_t lz_dictionaryHashTable[NETCHAN_LZ_HASH_SIZE];
+
+//=============================================================
+// Zlib compression
+//=============================================================
+
+static int Netchan_ZLibCompressChunk( const uint8_t *source, unsigned long sourceLen, uint8_t *dest, unsigned long destLen,
+									  int level, int wbits ) {
+	int result, zlerror;
+
+	zlerror = qzcompress2( dest, &destLen, source, sourceLen, level );
+	switch( zlerror ) {
+		case Z_OK:
+			result = destLen; // returns the new length into destLen
+			break;
+		case Z_MEM_ERROR:
+			Com_DPrintf( "ZLib data error! Z_MEM_ERROR on compress.\n" );
+			result = -1;
+			break;
+		case Z_BUF_ERROR:
+			Com_DPrintf( "ZLib data error! Z_BUF_ERROR on compress.\n" );
+			result = -1;
+			break;
+		case Z_STREAM_ERROR:
+			Com_DPrintf( "ZLib data error! Z_STREAM_ERROR on compress.\n" );
+			result = -1;
+			break;
+		default:
+			Com_DPrintf( "ZLib data error! Error code %i on compress.\n", zlerror );
+			result = -1;
+			break;
+	}
+
+	return result;
+}
+
+static int Netchan_ZLibDecompressChunk( const uint8_t *source, unsigned long sourceLen, uint8_t *dest, unsigned long destLen,
+										int wbits ) {
+	int result, zlerror;
+
+	zlerror = qzuncompress( dest, &destLen, source, sourceLen );
+	switch( zlerror ) {
+		case Z_OK:
+			result = destLen; // returns the new length into destLen
+			break;
+		case Z_MEM_ERROR:
+			Com_DPrintf( "ZLib data error! Z_MEM_ERROR on decompress.\n" );
+			result = -1;
+			break;
+		case Z_BUF_ERROR:
+			Com_DPrintf( "ZLib data error! Z_BUF_ERROR on decompress.\n" );
+			result = -1;
+			break;
+		case Z_DATA_ERROR:
+			Com_DPrintf( "ZLib data error! Z_DATA_ERROR on decompress.\n" );
+			result = -1;
+			break;
+		default:
+			Com_DPrintf( "ZLib data error! Error code %i on decompress.\n", zlerror );
+			result = -1;
+			break;
+	}
+
+	return result;
+}
+
+static int Netchan_ZLibCompress( const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen ) {
+	return Netchan_ZLibCompressChunk( source, sourceLen, dest, destLen, Z_BEST_COMPRESSION, -MAX_WBITS );
+}
+
+static int Netchan_ZLibDecompress( const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen ) {
+	return Netchan_ZLibDecompressChunk( source, sourceLen, dest, destLen, -MAX_WBITS );
+}
+
+//=============================================================
+// LZ compression
+//=============================================================
+
+static inline uint32_t Netchan_LZRead32( const uint8_t *p ) {
+	uint32_t v;
+	memcpy( &v, p, sizeof( v ) );
+	return v;
+}
+
+static inline unsigned Netchan_LZHash( uint32_t v ) {
+	return ( v * 2654435761u ) >> ( 32 - NETCHAN_LZ_HASH_LOG );
+}
+
+/*
+* Netchan_LZWriteLength
+*/
+static uint8_t *Netchan_LZWriteLength( uint8_t *op, const uint8_t *oend, size_t len ) {
+	for( len -= 15; len >= 255; len -= 255 ) {
+		if( op == oend ) {
+			return NULL;
+		}
+		*op++ = 255;
+	}
+	if( op == oend ) {
+		return NULL;
+	}
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+/*
+* Netchan_LZReadLength
+*/
+static const uint8_t *Netchan_LZReadLength( const uint8_t *ip, const uint8_t *iend, size_t *len ) {
+	unsigned b;
+
+	do {
+		if( ip == iend ) {
+			return NULL;
+		}
+		b = *ip++;
+		*len += b;
+	} while( b == 255 );
+
+	return ip;
+}
+
+/*
+* Netchan_LZWriteSequence
+*
+* Writes literals [anchor, ip) followed by the match, if any. Returns NULL if the output buffer is exhausted.
+*/
+static uint8_t *Netchan_LZWriteSequence( uint8_t *op, const uint8_t *oend, const uint8_t *anchor, const uint8_t *ip,
+										 unsigned offset, size_t matchLen ) {
+	const size_t litLen = ip - anchor;
+	uint8_t *token;
+
+	if( op == oend ) {
+		return NULL;
+	}
+
+	token = op++;
+	*token = (uint8_t)( std::min( litLen, (size_t)15 ) << 4 );
+	if( litLen >= 15 && !( op = Netchan_LZWriteLength( op, oend, litLen ) ) ) {
+		return NULL;
+	}
+
+	if( litLen > (size_t)( oend - op ) ) {
+		return NULL;
+	}
+	memcpy( op, anchor, litLen );
+	op += litLen;
+
+	if( !matchLen ) {
+		return op;
+	}
+
+	if( oend - op < 2 ) {
+		return NULL;
+	}
+	*op++ = offset & 0xFF;
+	*op++ = offset >> 8;
+
+	matchLen -= NETCHAN_LZ_MIN_MATCH;
+	*token |= (uint8_t)std::min( matchLen, (size_t)15 );
+	if( matchLen >= 15 && !( op = Netchan_LZWriteLength( op, oend, matchLen ) ) ) {
+		return NULL;
+	}
+
+	return op;
+}
+
+/*
+* Netchan_LZCompressWithDictionary
+*
+* Returns 0 if the compressed data doesn't fit the destination buffer
+*/
+static int Netchan_LZCompressWithDictionary( const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen,
+											 size_t dictionaryLen ) {
+	uint8_t *const base = lz_window + dictionaryLen;
+	const uint8_t *ip, *anchor, *iend, *matchLimit;
+	uint8_t *op;
+	const uint8_t *const oend = dest + destLen;
+	unsigned misses;
+
+	if( sourceLen > MAX_MSGLEN ) {
+		return -1;
+	}
+
+	if( !++lz_hashGeneration ) {
+		// wrapped around, slots of the old 0 generation would be taken for current ones
+		memset( lz_hashTable, 0, sizeof( lz_hashTable ) );
+		lz_hashGeneration = 1;
+	}
+	memcpy( base, source, sourceLen );
+
+	ip = anchor = base;
+	iend = base + sourceLen;
+	matchLimit = iend - std::min( sourceLen, (size_t)NETCHAN_LZ_MIN_MATCH );
+	op = dest;
+	misses = 0;
+
+	while( ip < matchLimit ) {
+		const uint32_t seq = Netchan_LZRead32( ip );
+		const unsigned hash = Netchan_LZHash( seq );
+		netchan_lzslot_t *const slot = &lz_hashTable[hash];
+		uint32_t entry;
+		if( slot->generation == lz_hashGeneration ) {
+			entry = slot->entry;
+		} else {
+			entry = dictionaryLen ? lz_dictionaryHashTable[hash] : 0;
+		}
+		const uint8_t *ref = lz_window + entry - 1;
+
+		slot->entry = ( ip - lz_window ) + 1;
+		slot->generation = lz_hashGeneration;
+
+		if( !entry || ip - ref > NETCHAN_LZ_MAX_OFFSET || Netchan_LZRead32( ref ) != seq ) {
+			// skip faster over incompressible data
+			ip += 1 + ( misses++ >> NETCHAN_LZ_SKIP_TRIGGER );
+			continue;
+		}
+
+		size_t matchLen = NETCHAN_LZ_MIN_MATCH;
+		while( ip + matchLen < iend && ref[matchLen] == ip[matchLen] ) {
+			matchLen++;
+		}
+
+		op = Netchan_LZWriteSequence( op, oend, anchor, ip, ip - ref, matchLen );
+		if( !op ) {
+			return 0;
+		}
+
+		ip += matchLen;
+		anchor = ip;
+		misses = 0;
+	}
+
+	op = Netchan_LZWriteSequence( op, oend, anchor, iend, 0, 0 );
+	if( !op ) {
+		return 0;
+	}
+
+	return op - dest;
+}
+
+/*
+* Netchan_LZDecompressWithDictionary
+*
+* The input is untrusted, so every read and write is checked
+*/
+static int Netchan_LZDecompressWithDictionary( const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen,
+											   size_t dictionaryLen ) {
+	const uint8_t *ip = source;
+	const uint8_t *const iend = source + sourceLen;
+	uint8_t *op = dest;
+	const uint8_t *const oend = dest + destLen;
+	const uint8_t *const dictionaryEnd = lz_window + dictionaryLen;
+
+	while( ip < iend ) {
+		const unsigned token = *ip++;
+		size_t litLen = token >> 4;
+		size_t matchLen = token & 15;
+		size_t offset;
+
+		if( litLen == 15 && !( ip = Netchan_LZReadLength( ip, iend, &litLen ) ) ) {
+			return -1;
+		}
+		if( litLen > (size_t)( iend - ip ) || litLen > (size_t)( oend - op ) ) {
+			return -1;
+		}
+		memcpy( op, ip, litLen );
+		op += litLen;
+		ip += litLen;
+
+		if( ip == iend ) {
+			// the last sequence
+			break;
+		}
+
+		if( iend - ip < 2 ) {
+			return -1;
+		}
+		offset = ip[0] | ( ip[1] << 8 );
+		ip += 2;
+
+		if( matchLen == 15 && !( ip = Netchan_LZReadLength( ip, iend, &matchLen ) ) ) {
+			return -1;
+		}
+		matchLen += NETCHAN_LZ_MIN_MATCH;
+
+		if( !offset || offset > (size_t)( op - dest ) + dictionaryLen || matchLen > (size_t)( oend - op ) ) {
+			return -1;
+		}
+
+		if( offset > (size_t)( op - dest ) ) {
+			// the match starts in the dictionary
+			const size_t inDictionary = offset - ( op - dest );
+			const size_t len = std::min( inDictionary, matchLen );
+			memcpy( op, dictionaryEnd - inDictionary, len );
+			op += len;
+			matchLen -= len;
+		}
+
+		// the match may overlap the output
+		const uint8_t *ref = op - offset;
+		while( matchLen-- ) {
+			*op++ = *ref++;
+		}
+	}
+
+	return op - dest;
+}
+
+static int Netchan_LZCompress( const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen ) {
+	return Netchan_LZCompressWithDictionary( source, sourceLen, dest, destLen, 0 );
+}
+
+static int Netchan_LZDecompress( const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen ) {
+	return Netchan_LZDecompressWithDictionary( source, sourceLen, dest, destLen, 0 );
+}
+
+static int Netchan_LZDictCompress( const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen ) {
+	return Netchan_LZCompressWithDictionary( source, sourceLen, dest, destLen, lz_dictionaryLen );
+}
+
+static int Netchan_LZDictDecompress( const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen ) {
+	return Netchan_LZDecompressWithDictionary( source, sourceLen, dest, destLen, lz_dictionaryLen );
+}
+
+//=============================================================
+
+static const netchan_codec_t netchan_codecs[NETCHAN_NUM_CODECS] = {
+	{ "zlib", Netchan_ZLibCompress, Netchan_ZLibDecompress },
+	{ "lz", Netchan_LZCompress, Netchan_LZDecompress },
+	{ "lz+dict", Netchan_LZDictCompress, Netchan_LZDictDecompress },
+};
+
+/*
+* Netchan_CodecName
+*/
+const char *Netchan_CodecName( int codec ) {
+	if( codec < 0 || codec >= NETCHAN_NUM_CODECS ) {
+		return "unknown";
+	}
+	return netchan_codecs[codec].name;
+}
+
+/*
+* Netchan_CodecCompress
+*
+* Returns the compressed length, 0 if the data can't be compressed into destLen bytes
+* and a negative value on error
+*/
+int Netchan_CodecCompress( int codec, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen ) {
+	if( codec < 0 || codec >= NETCHAN_NUM_CODECS ) {
+		return -1;
+	}
+	return netchan_codecs[codec].compress( source, sourceLen, dest, destLen );
+}
+
+/*
+* Netchan_CodecDecompress
+*/
+int Netchan_CodecDecompress( int codec, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen ) {
+	if( codec < 0 || codec >= NETCHAN_NUM_CODECS ) {
+		return -1;
+	}
+	return netchan_codecs[codec].decompress( source, sourceLen, dest, destLen );
+}
+
+/*
+* Netchan_LocalCodecs
+*
+* Returns the mask of codecs this side is willing to use
+*/
+unsigned Netchan_LocalCodecs( void ) {
+	int i;
+	unsigned mask = 0;
+
+	for( i = 0; i < NETCHAN_NUM_CODECS && i <= net_compression_codec->integer; i++ ) {
+		if( i == NETCHAN_CODEC_LZ_DICT && !lz_dictionaryLen ) {
+			continue;
+		}
+		mask |= 1u << i;
+	}
+
+	// zlib is always supported
+	return mask | ( 1u << NETCHAN_CODEC_ZLIB );
+}
+
+/*
+* Netchan_DictionaryChecksum
+*/
+unsigned Netchan_DictionaryChecksum( void ) {
+	return lz_dictionaryChecksum;
+}
+
+/*
+* Netchan_NegotiateCodec
+*
+* Picks the best codec supported by both sides
+*/
+int Netchan_NegotiateCodec( unsigned remoteCodecs, unsigned remoteDictionaryChecksum ) {
+	int i;
+	unsigned mask = Netchan_LocalCodecs() & remoteCodecs;
+
+	if( remoteDictionaryChecksum != lz_dictionaryChecksum ) {
+		mask &= ~( 1u << NETCHAN_CODEC_LZ_DICT );
+	}
+
+	for( i = NETCHAN_NUM_CODECS - 1; i > NETCHAN_CODEC_ZLIB; i-- ) {
+		if( mask & ( 1u << i ) ) {
+			return i;
+		}
+	}
+
+	return NETCHAN_CODEC_ZLIB;
+}
+
+/*
+* Netchan_LoadDictionary
+*/
+static void Netchan_LoadDictionary( void ) {
+	int length;
+	size_t i;
+	void *buffer;
+	md5_byte_t digest[16];
+	md5_state_t state;
+
+	lz_dictionaryLen = 0;
+	lz_dictionaryChecksum = 0;
+	memset( lz_dictionaryHashTable, 0, sizeof( lz_dictionaryHashTable ) );
+
+	length = FS_LoadFile( NETCHAN_DICTIONARY_FILE, &buffer, NULL, 0 );
+	if( !buffer ) {
+		return;
+	}
+
+	if( length < NETCHAN_LZ_MIN_MATCH || length > NETCHAN_MAX_DICTIONARY_SIZE ) {
+		Com_Printf( "Ignoring %s: bad size %i\n", NETCHAN_DICTIONARY_FILE, length );
+		FS_FreeFile( buffer );
+		return;
+	}
+
+	lz_dictionaryLen = length;
+	memcpy( lz_window, buffer, lz_dictionaryLen );
+	FS_FreeFile( buffer );
+
+	for( i = 0; i + NETCHAN_LZ_MIN_MATCH <= lz_dictionaryLen; i++ ) {
+		lz_dictionaryHashTable[Netchan_LZHash( Netchan_LZRead32( lz_window + i ) )] = i + 1;
+	}
+
+	md5_init( &state );
+	md5_append( &state, (md5_byte_t *)lz_window, lz_dictionaryLen );
+	md5_finish( &state, digest );
+	lz_dictionaryChecksum = md5_reduce( digest );
+
+	Com_Printf( "Loaded netchan compression dictionary: %i bytes\n", length );
+}
+
+//=============================================================
+// Benchmarking and dictionary training
+//=============================================================
+
+/*
+* Netchan_LoadDemoMessages
+*
+* Reads messages of the demos listed in command arguments starting from firstArg
+*/
+static void Netchan_LoadDemoMessages( int firstArg, std::vector<std::vector<uint8_t> > &messages ) {
+	int i, demofile;
+	msg_t msg;
+	static uint8_t msg_buffer[MAX_MSGLEN];
+
+	for( i = firstArg; i < Cmd_Argc(); i++ ) {
+		char name[MAX_QPATH];
+
+		Q_snprintfz( name, sizeof( name ), "demos/%s", Cmd_Argv( i ) );
+		COM_DefaultExtension( name, APP_DEMO_EXTENSION_STR, sizeof( name ) );
+
+		if( FS_FOpenFile( name, &demofile, FS_READ | SNAP_DEMO_GZ ) == -1 ) {
+			Com_Printf( "Couldn't open %s\n", name );
+			continue;
+		}
+
+		MSG_Init( &msg, msg_buffer, sizeof( msg_buffer ) );
+		while( SNAP_ReadDemoMessage( demofile, &msg ) > 0 ) {
+			messages.emplace_back( msg.data, msg.data + msg.cursize );
+		}
+
+		FS_FCloseFile( demofile );
+	}
+}
+
+/*
+* Netchan_CodecBench_f
+*
+* Compares codecs on messages recorded in demos
+*/
+static void Netchan_CodecBench_f( void ) {
+	int codec;
+	static uint8_t compressed[MAX_MSGLEN * 2], decompressed[MAX_MSGLEN];
+	std::vector<std::vector<uint8_t> > messages;
+
+	if( Cmd_Argc() < 2 ) {
+		Com_Printf( "Usage: %s <demo1> [demo2] ...\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	Netchan_LoadDemoMessages( 1, messages );
+	if( messages.empty() ) {
+		Com_Printf( "No messages to compress\n" );
+		return;
+	}
+
+	Com_Printf( "%-8s %10s %10s %7s %10s %10s\n", "codec", "in", "out", "ratio", "comp us", "decomp us" );
+
+	for( codec = 0; codec < NETCHAN_NUM_CODECS; codec++ ) {
+		size_t inBytes = 0, outBytes = 0;
+		uint64_t compTime = 0, decompTime = 0;
+		unsigned numErrors = 0;
+
+		if( codec == NETCHAN_CODEC_LZ_DICT && !lz_dictionaryLen ) {
+			continue;
+		}
+
+		for( const auto &message : messages ) {
+			int length;
+			uint64_t t0, t1, t2;
+
+			t0 = Sys_Microseconds();
+			length = Netchan_CodecCompress( codec, message.data(), message.size(), compressed, sizeof( compressed ) );
+			t1 = Sys_Microseconds();
+			if( length <= 0 ) {
+				numErrors++;
+				continue;
+			}
+
+			inBytes += message.size();
+			outBytes += length;
+			compTime += t1 - t0;
+
+			length = Netchan_CodecDecompress( codec, compressed, length, decompressed, sizeof( decompressed ) );
+			t2 = Sys_Microseconds();
+			decompTime += t2 - t1;
+
+			if( length != (int)message.size() || memcmp( decompressed, message.data(), length ) ) {
+				numErrors++;
+			}
+		}
+
+		Com_Printf( "%-8s %10" PRIu64 " %10" PRIu64 " %6.1f%% %10" PRIu64 " %10" PRIu64 "\n", Netchan_CodecName( codec ),
+					(uint64_t)inBytes, (uint64_t)outBytes, inBytes ? 100.0 * outBytes / inBytes : 0.0, compTime, decompTime );
+		if( numErrors ) {
+			Com_Printf( "%s%u messages failed to roundtrip\n", S_COLOR_YELLOW, numErrors );
+		}
+	}
+}
+
+#define NETCHAN_TRAIN_GRAM          8
+#define NETCHAN_TRAIN_SEGMENT       32
+#define NETCHAN_TRAIN_DICT_SIZE     0x4000
+
+/*
+* Netchan_DictTrain_f
+*
+* Builds a dictionary from the most common segments of demo messages
+*/
+static void Netchan_DictTrain_f( void ) {
+	int filenum;
+	size_t dictLen;
+	std::vector<std::vector<uint8_t> > messages;
+	struct gramstat_t {
+		unsigned count;
+		const uint8_t *sample;
+	};
+	std::unordered_map<uint64_t, gramstat_t> grams;
+	std::vector<std::pair<unsigned, const uint8_t *> > candidates;
+	std::vector<const uint8_t *> segments;
+	static uint8_t dict[NETCHAN_MAX_DICTIONARY_SIZE];
+
+	if( Cmd_Argc() < 3 ) {
+		Com_Printf( "Usage: %s <output> <demo1> [demo2] ...\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	Netchan_LoadDemoMessages( 2, messages );
+
+	for( const auto &message : messages ) {
+		for( size_t i = 0; i + NETCHAN_TRAIN_SEGMENT <= message.size(); i++ ) {
+			uint64_t gram;
+			memcpy( &gram, &message[i], sizeof( gram ) );
+			auto &stat = grams[gram];
+			if( !stat.count++ ) {
+				stat.sample = &message[i];
+			}
+		}
+	}
+
+	for( const auto &it : grams ) {
+		if( it.second.count > 1 ) {
+			candidates.emplace_back( it.second.count, it.second.sample );
+		}
+	}
+	std::sort( candidates.begin(), candidates.end(), []( const std::pair<unsigned, const uint8_t *> &a,
+														 const std::pair<unsigned, const uint8_t *> &b ) {
+		return a.first > b.first;
+	} );
+
+	// pick the most frequent segments, skipping ones already covered by picked segments
+	dictLen = 0;
+	for( const auto &candidate : candidates ) {
+		uint64_t gram;
+		size_t i;
+
+		if( dictLen + NETCHAN_TRAIN_SEGMENT > NETCHAN_TRAIN_DICT_SIZE ) {
+			break;
+		}
+
+		memcpy( &gram, candidate.second, sizeof( gram ) );
+		if( !grams[gram].count ) {
+			continue;
+		}
+
+		for( i = 0; i + NETCHAN_TRAIN_GRAM <= NETCHAN_TRAIN_SEGMENT; i++ ) {
+			memcpy( &gram, candidate.second + i, sizeof( gram ) );
+			auto it = grams.find( gram );
+			if( it != grams.end() ) {
+				it->second.count = 0;
+			}
+		}
+
+		segments.push_back( candidate.second );
+		dictLen += NETCHAN_TRAIN_SEGMENT;
+	}
+
+	if( !dictLen ) {
+		Com_Printf( "Not enough data to train a dictionary\n" );
+		return;
+	}
+
+	// the most frequent segments go last, so they are closer to the data and have shorter offsets
+	dictLen = 0;
+	for( auto it = segments.rbegin(); it != segments.rend(); ++it ) {
+		memcpy( dict + dictLen, *it, NETCHAN_TRAIN_SEGMENT );
+		dictLen += NETCHAN_TRAIN_SEGMENT;
+	}
+
+	if( FS_FOpenFile( Cmd_Argv( 1 ), &filenum, FS_WRITE ) == -1 ) {
+		Com_Printf( "Couldn't open %s for writing\n", Cmd_Argv( 1 ) );
+		return;
+	}
+	FS_Write( dict, dictLen, filenum );
+	FS_FCloseFile( filenum );
+
+	Com_Printf( "Wrote %" PRIu64 " bytes dictionary trained on %" PRIu64 " messages to %s\n",
+				(uint64_t)dictLen, (uint64_t)messages.size(), Cmd_Argv( 1 ) );
+}
+
+//=============================================================
+
+/*
+* Netchan_InitCodecs
+*/
+void Netchan_InitCodecs( void ) {
+	// 0 - zlib only, 1 - allow the fast LZ codec, 2 - also allow LZ with a dictionary
+	net_compression_codec = Cvar_Get( "net_compression_codec", "2", CVAR_ARCHIVE );
+
+	Netchan_LoadDictionary();
+
+	Cmd_AddCommand( "netcodecbench", Netchan_CodecBench_f );
+	Cmd_AddCommand( "netdicttrain", Netchan_DictTrain_f );
+}
+
+/*
+* Netchan_ShutdownCodecs
+*/
+void Netchan_ShutdownCodecs( void ) {
+	Cmd_RemoveCommand( "netcodecbench" );
+	Cmd_RemoveCommand( "netdicttrain" );
+
+	lz_dictionaryLen = 0;
+	lz_dictionaryChecksum = 0;
+}
@@ -432,6 +432,7 @@ typedef struct {
 	netadr_t remoteAddress;
 
 	socket_handle_t handle;
+	unsigned serial;            // changes every time the socket is opened
 } socket_t;
 
 typedef enum {
@@ -465,13 +466,19 @@ int         NET_Accept( const socket_t *socket, socket_t *newsocket, netadr_t *a
 #endif
 
 int         NET_GetPacket( const socket_t *socket, netadr_t *address, msg_t *message );
+int         NET_GetPackets( const socket_t *socket, netadr_t *addresses, msg_t *messages, int maxPackets );
 bool        NET_SendPacket( const socket_t *socket, const void *data, size_t length, const netadr_t *address );
 
 int         NET_Get( const socket_t *socket, netadr_t *address, void *data, size_t length );
 int         NET_Send( const socket_t *socket, const void *data, size_t length, const netadr_t *address );
 int64_t     NET_SendFile( const socket_t *socket, int file, size_t offset, size_t count, const netadr_t *address );
+// called for every socket and address a batched datagram could not be sent to
+typedef void ( *net_senderror_cb_t )( const socket_t *socket, const netadr_t *address, const char *error );
+void        NET_BeginSendBatch( void );
+void        NET_FlushSendBatch( net_senderror_cb_t error_cb );
 
 void        NET_Sleep( int msec, socket_t *sockets[] );
+void        NET_SleepMicros( int64_t usec, socket_t *sockets[] );
 int         NET_Monitor( int msec, socket_t *sockets[],
 						 void ( *read_cb )( socket_t *socket, void* ),
 						 void ( *write_cb )( socket_t *socket, void* ),
@@ -532,6 +539,8 @@ typedef struct {
 	uint8_t unsentBuffer[MAX_MSGLEN];
 	bool unsentIsCompressed;
 
+	int codec;                  // compression codec negotiated on connection, see NETCHAN_CODEC_*
+
 	bool fatal_error;
 } netchan_t;
 
@@ -545,8 +554,8 @@ bool Netchan_Process( netchan_t *chan, msg_t *msg );
 bool Netchan_Transmit( netchan_t *chan, msg_t *msg );
 bool Netchan_PushAllFragments( netchan_t *chan );
 bool Netchan_TransmitNextFragment( netchan_t *chan );
-int Netchan_CompressMessage( msg_t *msg );
-int Netchan_DecompressMessage( msg_t *msg );
+int Netchan_CompressMessage( msg_t *msg, int codec );
+int Netchan_DecompressMessage( msg_t *msg, int codec );
 void Netchan_OutOfBand( const socket_t *socket, const netadr_t *address, size_t length, const uint8_t *data );
 
 #ifndef _MSC_VER
@@ -557,6 +566,26 @@ void Netchan_OutOfBandPrint( const socket_t *socket, const netadr_t *address, _P
 
 int Netchan_GamePort( void );
 
+// message compression codecs, a newer codec is always preferred
+enum {
+	NETCHAN_CODEC_ZLIB,         // the default for connections that haven't negotiated anything
+	NETCHAN_CODEC_LZ,           // fast LZ77
+	NETCHAN_CODEC_LZ_DICT,      // fast LZ77 with a dictionary, requires the same dictionary on both sides
+
+	NETCHAN_NUM_CODECS
+};
+
+#define NETCHAN_DICTIONARY_FILE "netchan.dict"
+
+void Netchan_InitCodecs( void );
+void Netchan_ShutdownCodecs( void );
+const char *Netchan_CodecName( int codec );
+int Netchan_CodecCompress( int codec, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen );
+int Netchan_CodecDecompress( int codec, const uint8_t *source, size_t sourceLen, uint8_t *dest, size_t destLen );
+unsigned Netchan_LocalCodecs( void );
+unsigned Netchan_DictionaryChecksum( void );
+int Netchan_NegotiateCodec( unsigned remoteCodecs, unsigned remoteDictionaryChecksum );
+
 /*
 ==============================================================
 
@@ -777,6 +806,18 @@ void _Mem_CheckSentinelsGlobal( const char *filename, int fileline );
 
 size_t Mem_PoolTotalSize( mempool_t *pool );
 
+/**
+ * Per-frame scratch memory of the calling thread.
+ * Allocations are not zeroed and stay valid until the next Mem_ResetFrameArenas() call.
+ * @note Mem_FrameArenaMark() and Mem_FrameArenaRelease() allow returning memory of scoped temporaries early.
+ */
+void *_Mem_FrameAlloc( size_t size, size_t alignment );
+size_t Mem_FrameArenaMark( void );
+void Mem_FrameArenaRelease( size_t mark );
+void Mem_ResetFrameArenas( void );
+
+#define Mem_FrameAlloc( size ) _Mem_FrameAlloc( size, 0 )
+
 #define Mem_AllocExt( pool, size, z ) _Mem_AllocExt( pool, size, 0, z, 0, 0, __FILE__, __LINE__ )
 #define Mem_Alloc( pool, size ) _Mem_Alloc( pool, size, 0, 0, __FILE__, __LINE__ )
 #define Mem_Realloc( data, size ) _Mem_Realloc( data, size, __FILE__, __LINE__ )
@@ -878,6 +919,7 @@ CPU FEATURES
 #define Q_CPU_FEATURE_SSE41   ( 0x2u )
 #define Q_CPU_FEATURE_SSE42   ( 0x4u )
 #define Q_CPU_FEATURE_AVX     ( 0x8u )
+#define Q_CPU_FEATURE_AVX2    ( 0x10u )
 
 unsigned Sys_GetProcessorFeatures();
 
@@ -949,6 +991,7 @@ MULTITHREADING
 ==============================================================
 */
 #include "qthreads.h"
+#include "qjobs.h"
 
 /*
 ==============================================================
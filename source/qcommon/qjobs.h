@@ -0,0 +1,30 @@
+#ifndef Q_JOBS_H
+#define Q_JOBS_H
+
+/*
+* An engine-wide work-stealing job system.
+*
+* Jobs are executed by a pool of worker threads sized to the hardware threads count.
+* Jobs are tracked by groups, a thread that waits for a group executes pending jobs of this group meanwhile.
+*/
+
+#define QJOB_MAX_ARG_SIZE   32
+
+struct qjobgroup_s;
+typedef struct qjobgroup_s qjobgroup_t;
+
+// The job is called for a range of items, arg points to a copy of the argument supplied on scheduling
+typedef void ( *qjobfunc_t )( unsigned first, unsigned items, void *arg );
+
+void QJobs_Init( void );
+void QJobs_Shutdown( void );
+int QJobs_NumThreads( void );
+
+qjobgroup_t *QJobGroup_Create( void );
+void QJobGroup_Destroy( qjobgroup_t **pgroup );
+void QJobGroup_AddJob( qjobgroup_t *group, qjobfunc_t func, const void *arg, size_t argSize );
+void QJobGroup_ParallelFor( qjobgroup_t *group, qjobfunc_t func, const void *arg, size_t argSize,
+							unsigned items, unsigned grain );
+void QJobGroup_Wait( qjobgroup_t *group );
+
+#endif // Q_JOBS_H
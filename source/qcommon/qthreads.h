@@ -57,8 +57,13 @@ qbufPipe_t *QBufPipe_Create( size_t bufSize, int flags );
 void QBufPipe_Destroy( qbufPipe_t **pqueue );
 void QBufPipe_Finish( qbufPipe_t *queue );
 void QBufPipe_WriteCmd( qbufPipe_t *queue, const void *cmd, unsigned cmd_size );
+void QBufPipe_WriteCmds( qbufPipe_t *queue, const void *const *cmds, const unsigned *cmd_sizes, unsigned num_cmds );
 int QBufPipe_ReadCmds( qbufPipe_t *queue, unsigned( **cmdHandlers )( const void * ) );
 void QBufPipe_Wait( qbufPipe_t *queue, int ( *read )( qbufPipe_t *, unsigned( ** )( const void * ), bool ),
 					unsigned( **cmdHandlers )( const void * ), unsigned timeout_msec );
 
+#ifndef PUBLIC_BUILD
+void QBufPipe_Test_f( void );
+#endif
+
 #endif // Q_THREADS_H
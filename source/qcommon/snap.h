@@ -6,6 +6,12 @@
 // define this 0 to disable compression of demo files
 #define SNAP_DEMO_GZ                    FS_GZ
 
+// server demos write a full (non-delta) keyframe this often (in milliseconds)
+#define SNAP_DEMO_KEYFRAME_INTERVAL     10000
+
+// meta data key holding the file offset of the keyframe index
+#define SNAP_DEMO_KEYFRAMES_META_KEY    "keyframes"
+
 void SNAP_ParseBaseline( struct msg_s *msg, entity_state_t *baselines );
 void SNAP_SkipFrame( struct msg_s *msg, struct snapshot_s *header );
 struct snapshot_s *SNAP_ParseFrame( struct msg_s *msg, struct snapshot_s *lastFrame, int *suppressCount,
@@ -38,6 +44,7 @@ void SNAP_WriteFrameSnapToClient( const struct ginfo_s *gi, struct client_s *cli
 #define SNAP_VAR_USE_VIEWDIR_CULLING     ( "sv_snap_aggressive_fov_culling" )
 #define SNAP_VAR_SHADOW_EVENTS_DATA      ( "sv_snap_shadow_events_data" )
 
+void SNAP_FixEntityNumbers( struct ginfo_s *gi );
 void SNAP_BuildClientFrameSnap( struct cmodel_state_s *cms, struct ginfo_s *gi, int64_t frameNum, int64_t timeStamp,
 								struct fatvis_s *fatvis, struct client_s *client,
 								game_state_t *gameState, struct client_entities_s *client_entities,
@@ -56,6 +63,25 @@ size_t SNAP_ClearDemoMeta( char *meta_data, size_t meta_data_max_size );
 size_t SNAP_SetDemoMetaKeyValue( char *meta_data, size_t meta_data_max_size, size_t meta_data_realsize,
 								 const char *key, const char *value );
 size_t SNAP_ReadDemoMetaData( int demofile, char *meta_data, size_t meta_data_size );
+const char *SNAP_GetDemoMetaKeyValue( const char *meta_data, size_t meta_data_realsize, const char *key );
+
+typedef struct {
+	int64_t serverTime;
+	int offset;             // uncompressed offset of the keyframe messages in the demo file
+} snapDemoKeyframe_t;
+
+typedef struct {
+	snapDemoKeyframe_t *keyframes;  // sorted by serverTime
+	int numKeyframes;
+	int maxKeyframes;
+} snapDemoKeyframeIndex_t;
+
+void SNAP_WriteDemoKeyframe( snapDemoKeyframeIndex_t *index, int64_t serverTime, int offset,
+							 const char *configstrings, void ( *writeMessage )( struct msg_s *msg ) );
+int SNAP_WriteDemoKeyframeIndex( int demofile, const snapDemoKeyframeIndex_t *index );
+bool SNAP_ReadDemoKeyframeIndex( int demofile, int indexOffset, snapDemoKeyframeIndex_t *index );
+const snapDemoKeyframe_t *SNAP_FindDemoKeyframe( const snapDemoKeyframeIndex_t *index, int64_t serverTime );
+void SNAP_FreeDemoKeyframeIndex( snapDemoKeyframeIndex_t *index );
 
 #endif
 
@@ -412,3 +412,221 @@ size_t SNAP_ReadDemoMetaData( int demofile, char *meta_data, size_t meta_data_si
 
 	return meta_data_realsize;
 }
+
+/*
+* SNAP_GetDemoMetaKeyValue
+*
+* Returns the value stored for the key or NULL if there's no such key
+*/
+const char *SNAP_GetDemoMetaKeyValue( const char *meta_data, size_t meta_data_realsize, const char *key ) {
+	const char *s, *m_val;
+	const char *end = meta_data + meta_data_realsize;
+
+	for( s = meta_data; s < end && *s; ) {
+		m_val = s + strlen( s ) + 1;
+		if( m_val >= end ) {
+			break;
+		}
+		if( !Q_stricmp( s, key ) ) {
+			return m_val;
+		}
+		s = m_val + strlen( m_val ) + 1;
+	}
+
+	return NULL;
+}
+
+//================================================================
+//
+//	KEYFRAMES
+//
+//	A keyframe is a bunch of configstring commands followed by a non-delta frame,
+//	so the playback can be started from it without parsing anything before.
+//	The index of keyframes follows the end-of-demo marker, its uncompressed
+//	offset is stored in the meta data. Older readers stop at the marker.
+//
+//================================================================
+
+#define SNAP_DEMO_KEYFRAMES_MAGIC   ( ( 'X' << 24 ) + ( 'I' << 16 ) + ( 'F' << 8 ) + 'K' )
+#define SNAP_DEMO_KEYFRAME_EMPTY_BATCH  64
+
+/*
+* SNAP_WriteDemoKeyframe
+*
+* Adds the keyframe at given file offset to the index and passes messages with all configstrings
+* to writeMessage. The caller must write a non-delta frame right after this.
+*/
+void SNAP_WriteDemoKeyframe( snapDemoKeyframeIndex_t *index, int64_t serverTime, int offset,
+							 const char *configstrings, void ( *writeMessage )( msg_t *msg ) ) {
+	int i, numEmpty;
+	char empty[MAX_STRING_CHARS];
+	msg_t msg;
+	uint8_t msg_buffer[MAX_MSGLEN];
+	snapDemoKeyframe_t *keyframe;
+
+	if( index->numKeyframes == index->maxKeyframes ) {
+		index->maxKeyframes = index->maxKeyframes ? index->maxKeyframes * 2 : 64;
+		if( index->keyframes ) {
+			index->keyframes = ( snapDemoKeyframe_t * )Mem_Realloc( index->keyframes, index->maxKeyframes * sizeof( *keyframe ) );
+		} else {
+			index->keyframes = ( snapDemoKeyframe_t * )Mem_ZoneMalloc( index->maxKeyframes * sizeof( *keyframe ) );
+		}
+	}
+
+	keyframe = &index->keyframes[index->numKeyframes++];
+	keyframe->serverTime = serverTime;
+	keyframe->offset = offset;
+
+	MSG_Init( &msg, msg_buffer, sizeof( msg_buffer ) );
+
+	// empty configstrings must be written as well, since the playback may seek backwards
+	// from a moment they were set. They are batched to save some space.
+	numEmpty = 0;
+	for( i = 0; i < MAX_CONFIGSTRINGS; i++ ) {
+		const char *configstring = configstrings + i * MAX_CONFIGSTRING_CHARS;
+		if( configstring[0] ) {
+			MSG_WriteUint8( &msg, svc_servercs );
+			MSG_WriteString( &msg, va( "cs %i \"%s\"", i, configstring ) );
+		} else {
+			if( !numEmpty ) {
+				Q_strncpyz( empty, "cs", sizeof( empty ) );
+			}
+			Q_strncatz( empty, va( " %i \"\"", i ), sizeof( empty ) );
+			if( ++numEmpty < SNAP_DEMO_KEYFRAME_EMPTY_BATCH && i != MAX_CONFIGSTRINGS - 1 ) {
+				continue;
+			}
+
+			MSG_WriteUint8( &msg, svc_servercs );
+			MSG_WriteString( &msg, empty );
+			numEmpty = 0;
+		}
+
+		if( msg.cursize > msg.maxsize / 2 ) {
+			writeMessage( &msg );
+			MSG_Clear( &msg );
+		}
+	}
+
+	if( msg.cursize ) {
+		writeMessage( &msg );
+	}
+}
+
+/*
+* SNAP_WriteDemoKeyframeIndex
+*
+* Writes the index past the end-of-demo marker and returns its offset, -1 if there's nothing to write
+*/
+int SNAP_WriteDemoKeyframeIndex( int demofile, const snapDemoKeyframeIndex_t *index ) {
+	int i, offset;
+	int header[2], record[3];
+
+	if( !demofile || !index->numKeyframes ) {
+		return -1;
+	}
+
+	offset = FS_Tell( demofile );
+
+	header[0] = LittleLong( SNAP_DEMO_KEYFRAMES_MAGIC );
+	header[1] = LittleLong( index->numKeyframes );
+	FS_Write( header, sizeof( header ), demofile );
+
+	for( i = 0; i < index->numKeyframes; i++ ) {
+		const snapDemoKeyframe_t *keyframe = &index->keyframes[i];
+		record[0] = LittleLong( (int)( keyframe->serverTime & 0xFFFFFFFF ) );
+		record[1] = LittleLong( (int)( keyframe->serverTime >> 32 ) );
+		record[2] = LittleLong( keyframe->offset );
+		FS_Write( record, sizeof( record ), demofile );
+	}
+
+	return offset;
+}
+
+/*
+* SNAP_ReadDemoKeyframeIndex
+*
+* Note that the file position is left at the end of the index
+*/
+bool SNAP_ReadDemoKeyframeIndex( int demofile, int indexOffset, snapDemoKeyframeIndex_t *index ) {
+	int i, numKeyframes;
+	int header[2], record[3];
+	int64_t prevTime;
+
+	SNAP_FreeDemoKeyframeIndex( index );
+
+	if( indexOffset <= 0 || FS_Seek( demofile, indexOffset, FS_SEEK_SET ) < 0 ) {
+		return false;
+	}
+
+	if( FS_Read( header, sizeof( header ), demofile ) != sizeof( header ) ) {
+		return false;
+	}
+	if( LittleLong( header[0] ) != SNAP_DEMO_KEYFRAMES_MAGIC ) {
+		return false;
+	}
+
+	numKeyframes = LittleLong( header[1] );
+	if( numKeyframes <= 0 || numKeyframes > indexOffset / (int)sizeof( record ) ) {
+		return false;
+	}
+
+	index->keyframes = ( snapDemoKeyframe_t * )Mem_ZoneMalloc( numKeyframes * sizeof( snapDemoKeyframe_t ) );
+	index->maxKeyframes = numKeyframes;
+
+	prevTime = INT64_MIN;
+	for( i = 0; i < numKeyframes; i++ ) {
+		snapDemoKeyframe_t *keyframe = &index->keyframes[i];
+
+		if( FS_Read( record, sizeof( record ), demofile ) != sizeof( record ) ) {
+			break;
+		}
+
+		keyframe->serverTime = (int64_t)(uint32_t)LittleLong( record[0] ) | ( (int64_t)LittleLong( record[1] ) << 32 );
+		keyframe->offset = LittleLong( record[2] );
+		if( keyframe->serverTime < prevTime || keyframe->offset <= 0 || keyframe->offset >= indexOffset ) {
+			break;
+		}
+		prevTime = keyframe->serverTime;
+	}
+
+	if( i != numKeyframes ) {
+		Com_Printf( "SNAP_ReadDemoKeyframeIndex: Bad keyframe index\n" );
+		SNAP_FreeDemoKeyframeIndex( index );
+		return false;
+	}
+
+	index->numKeyframes = numKeyframes;
+	return true;
+}
+
+/*
+* SNAP_FindDemoKeyframe
+*
+* Returns the last keyframe at or before the given time
+*/
+const snapDemoKeyframe_t *SNAP_FindDemoKeyframe( const snapDemoKeyframeIndex_t *index, int64_t serverTime ) {
+	const snapDemoKeyframe_t *begin = index->keyframes;
+	const snapDemoKeyframe_t *end = index->keyframes + index->numKeyframes;
+	const snapDemoKeyframe_t *it;
+
+	if( !index->numKeyframes ) {
+		return NULL;
+	}
+
+	it = std::upper_bound( begin, end, serverTime, []( int64_t time, const snapDemoKeyframe_t &keyframe ) {
+		return time < keyframe.serverTime;
+	} );
+
+	return it != begin ? it - 1 : NULL;
+}
+
+/*
+* SNAP_FreeDemoKeyframeIndex
+*/
+void SNAP_FreeDemoKeyframeIndex( snapDemoKeyframeIndex_t *index ) {
+	if( index->keyframes ) {
+		Mem_Free( index->keyframes );
+	}
+	index->keyframes = NULL;
+	index->numKeyframes = index->maxKeyframes = 0;
+}
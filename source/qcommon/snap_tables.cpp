@@ -19,8 +19,9 @@ SnapShadowTable *SnapShadowTable::Instance() {
 }
 
 SnapShadowTable::SnapShadowTable() {
+	static_assert( sizeof( std::atomic_bool ) == sizeof( bool ), "Atomics are assumed to be layout-compatible" );
 	// Get zeroed memory
-	table = (bool *)::calloc( ( MAX_CLIENTS ) * ( MAX_EDICTS ) * sizeof( bool ), 1 );
+	table = (std::atomic_bool *)::calloc( ( MAX_CLIENTS ) * ( MAX_EDICTS ) * sizeof( *table ), 1 );
 	// Shouldn't happen?
 	if( !table ) {
 		Com_Error( ERR_FATAL, "Can't allocate snapshots entity shadow table" );
@@ -42,7 +43,8 @@ SnapVisTable *SnapVisTable::Instance() {
 }
 
 SnapVisTable::SnapVisTable( cmodel_state_t *cms_ ): cms( cms_ ) {
-	table = (int8_t *)::calloc( ( MAX_CLIENTS ) * ( MAX_CLIENTS ) * sizeof( int8_t ), 1 );
+	static_assert( sizeof( std::atomic<int8_t> ) == sizeof( int8_t ), "Atomics are assumed to be layout-compatible" );
+	table = (std::atomic<int8_t> *)::calloc( ( MAX_CLIENTS ) * ( MAX_CLIENTS ) * sizeof( *table ), 1 );
 	// Shouldn't happen?
 	if( !table ) {
 		Com_Error( ERR_FATAL, "Can't allocate snapshots visibility table" );
@@ -269,4 +271,93 @@ bool SnapVisTable::TryCullingByCastingRays( const edict_t *povEnt, const vec_t *
 
 	MarkAsVisible( povEnt->s.number, targetEnt->s.number );
 	return false;
-}
\ No newline at end of file
+}
+
+static SingletonHolder<SnapEntityDeltaCache> deltaCacheHolder;
+
+void SnapEntityDeltaCache::Init() {
+	::deltaCacheHolder.Init();
+}
+
+void SnapEntityDeltaCache::Shutdown() {
+	::deltaCacheHolder.Shutdown();
+}
+
+SnapEntityDeltaCache *SnapEntityDeltaCache::Instance() {
+	return ::deltaCacheHolder.Instance();
+}
+
+SnapEntityDeltaCache::SnapEntityDeltaCache() {
+	static_assert( sizeof( std::atomic<uint8_t> ) == sizeof( uint8_t ), "Atomics are assumed to be layout-compatible" );
+	states = (std::atomic<uint8_t> *)::calloc( MAX_EDICTS * NUM_SLOTS_PER_ENTITY * sizeof( *states ), 1 );
+	slots = (Slot *)::malloc( MAX_EDICTS * NUM_SLOTS_PER_ENTITY * sizeof( Slot ) );
+	// Shouldn't happen?
+	if( !states || !slots ) {
+		Com_Error( ERR_FATAL, "Can't allocate snapshots entity delta cache" );
+	}
+}
+
+bool SnapEntityDeltaCache::TryWriteCachedDelta( msg_t *msg, int64_t frameNum, int64_t fromFrameNum, int entNum ) {
+	assert( (unsigned)entNum < (unsigned)MAX_EDICTS );
+
+	const int firstSlot = entNum * NUM_SLOTS_PER_ENTITY;
+	for( int i = firstSlot; i < firstSlot + NUM_SLOTS_PER_ENTITY; ++i ) {
+		if( states[i].load( std::memory_order_acquire ) != SLOT_READY ) {
+			continue;
+		}
+		const Slot &slot = slots[i];
+		if( slot.frameNum != frameNum || slot.fromFrameNum != fromFrameNum ) {
+			continue;
+		}
+		if( slot.size ) {
+			MSG_WriteData( msg, slot.data, slot.size );
+		}
+		numHits.fetch_add( 1, std::memory_order_relaxed );
+		return true;
+	}
+
+	numMisses.fetch_add( 1, std::memory_order_relaxed );
+	return false;
+}
+
+void SnapEntityDeltaCache::AddDelta( int64_t frameNum, int64_t fromFrameNum, int entNum,
+									 const uint8_t *data, unsigned size ) {
+	assert( (unsigned)entNum < (unsigned)MAX_EDICTS );
+
+	if( size > MAX_DELTA_BYTES ) {
+		return;
+	}
+
+	const int firstSlot = entNum * NUM_SLOTS_PER_ENTITY;
+	for( int i = firstSlot; i < firstSlot + NUM_SLOTS_PER_ENTITY; ++i ) {
+		uint8_t expected = SLOT_EMPTY;
+		if( !states[i].compare_exchange_strong( expected, SLOT_BUSY, std::memory_order_relaxed ) ) {
+			continue;
+		}
+		Slot *slot = &slots[i];
+		slot->frameNum = frameNum;
+		slot->fromFrameNum = fromFrameNum;
+		slot->size = size;
+		memcpy( slot->data, data, size );
+		states[i].store( SLOT_READY, std::memory_order_release );
+		return;
+	}
+}
+
+void SnapEntityDeltaCache::PrintStats() const {
+	const uint64_t hits = numHits.load( std::memory_order_relaxed );
+	const uint64_t misses = numMisses.load( std::memory_order_relaxed );
+	const uint64_t bypasses = numBypasses.load( std::memory_order_relaxed );
+	const uint64_t lookups = hits + misses;
+
+	Com_Printf( "Entity delta cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " bypasses\n", hits, misses, bypasses );
+	if( lookups ) {
+		Com_Printf( "Entity delta cache hit rate: %.1f%%\n", 100.0 * (double)hits / (double)lookups );
+	}
+}
+
+void SnapEntityDeltaCache::ResetStats() {
+	numHits.store( 0, std::memory_order_relaxed );
+	numMisses.store( 0, std::memory_order_relaxed );
+	numBypasses.store( 0, std::memory_order_relaxed );
+}
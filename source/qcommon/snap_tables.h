@@ -4,17 +4,24 @@
 #include "qcommon.h"
 #include "snap_write.h"
 
+#include <atomic>
+
 /**
  * Stores a "shadowed" state of entities for every client.
  * Shadowing an entity means transmission of randomized data
  * for fields that should not be really transmitted but
  * we are forced to transmit some parts of it (that's how the current netcode works).
  * Shadowing has an anti-cheat purpose.
+ * @note Snapshots of different clients might be built in parallel.
+ * A row of MAX_EDICTS cells belongs to a player number and is written only by the snapshot builder
+ * of the client having this player number (multi-POV frames never shadow entities).
+ * Cells are still atomics as the table is tested while writing messages of other clients.
+ * Relaxed ordering is sufficient as all workers are joined before the next phase starts.
  */
 class SnapShadowTable {
 	template <typename> friend class SingletonHolder;
 
-	bool *table;
+	std::atomic_bool *table;
 
 	SnapShadowTable();
 
@@ -28,16 +35,22 @@ public:
 
 	void MarkEntityAsShadowed( int playerNum, int targetEntNum ) {
 		assert( (unsigned)playerNum < (unsigned)MAX_CLIENTS );
-		table[playerNum * MAX_CLIENTS + targetEntNum] = true;
+		assert( (unsigned)targetEntNum < (unsigned)MAX_EDICTS );
+		table[playerNum * MAX_EDICTS + targetEntNum].store( true, std::memory_order_relaxed );
 	}
 
 	bool IsEntityShadowed( int playerNum, int targetEntNum ) const {
 		assert( (unsigned)playerNum < (unsigned)MAX_CLIENTS );
-		return table[playerNum * MAX_CLIENTS + targetEntNum];
+		assert( (unsigned)targetEntNum < (unsigned)MAX_EDICTS );
+		return table[playerNum * MAX_EDICTS + targetEntNum].load( std::memory_order_relaxed );
 	}
 
+	/**
+	 * Must not be called while snapshots are being built.
+	 */
 	void Clear() {
-		::memset( table, 0, ( MAX_CLIENTS ) * ( MAX_EDICTS ) * sizeof( bool ) );
+		// Lock-free atomics are layout-compatible with their underlying types
+		::memset( (void *)table, 0, ( MAX_CLIENTS ) * ( MAX_EDICTS ) * sizeof( *table ) );
 	}
 };
 
@@ -51,12 +64,17 @@ public:
  * For performance reasons only entities that are clients are tested for visibility.
  * An introduction of aggressive transmitted entities visibility culling greatly reduces wallhack utility.
  * Moreover this cached visibility table can be used for various server-side purposes (like AI vision).
+ * @note Snapshots of different clients might be built in parallel.
+ * A result is stored only in the row of the POV client so every row has a single writer
+ * (the snapshot builder of this client). The visibility is assumed to be symmetric,
+ * so a lookup falls back to the transposed cell that has been written by another worker.
+ * Reading cells of other rows concurrently is why cells are relaxed atomics.
  */
 class SnapVisTable {
 	template <typename> friend class SingletonHolder;
 
 	cmodel_state_t *const cms;
-	int8_t *table;
+	std::atomic<int8_t> *table;
 	float collisionWorldRadius;
 
 	explicit SnapVisTable( cmodel_state_t *cms_ );
@@ -64,30 +82,33 @@ class SnapVisTable {
 	bool CastRay( const vec3_t from, const vec3_t to, int topNodeHint );
 	bool DoCullingByCastingRays( const edict_t *clientEnt, const vec3_t viewOrigin, const edict_t *targetEnt );
 
-	void MarkCachedResult( int entNum1, int entNum2, bool isVisible ) {
-		const int clientNum1 = entNum1 - 1;
-		const int clientNum2 = entNum2 - 1;
+	void MarkCachedResult( int povEntNum, int targetEntNum, bool isVisible ) {
+		const int clientNum1 = povEntNum - 1;
+		const int clientNum2 = targetEntNum - 1;
 		assert( (unsigned)clientNum1 < (unsigned)( MAX_CLIENTS ) );
 		assert( (unsigned)clientNum2 < (unsigned)( MAX_CLIENTS ) );
 		auto value = (int8_t)( isVisible ? +1 : -1 );
-		table[clientNum1 * MAX_CLIENTS + clientNum2] = value;
-		table[clientNum2 * MAX_CLIENTS + clientNum1] = value;
+		table[clientNum1 * MAX_CLIENTS + clientNum2].store( value, std::memory_order_relaxed );
 	}
 public:
 	static void Init( cmodel_state_t *cms_ );
 	static void Shutdown();
 	static SnapVisTable *Instance();
 
+	/**
+	 * Must not be called while snapshots are being built.
+	 */
 	void Clear() {
-		memset( table, 0, ( MAX_CLIENTS ) * ( MAX_CLIENTS ) * sizeof( int8_t ) );
+		// Lock-free atomics are layout-compatible with their underlying types
+		memset( (void *)table, 0, ( MAX_CLIENTS ) * ( MAX_CLIENTS ) * sizeof( *table ) );
 	}
 
-	void MarkAsInvisible( int entNum1, int entNum2 ) {
-		MarkCachedResult( entNum1, entNum2, false );
+	void MarkAsInvisible( int povEntNum, int targetEntNum ) {
+		MarkCachedResult( povEntNum, targetEntNum, false );
 	}
 
-	void MarkAsVisible( int entNum1, int entNum2 ) {
-		MarkCachedResult( entNum1, entNum2, true );
+	void MarkAsVisible( int povEntNum, int targetEntNum ) {
+		MarkCachedResult( povEntNum, targetEntNum, true );
 	}
 
 	int GetExistingResult( int povEntNum, int targetEntNum ) {
@@ -102,10 +123,85 @@ public:
 		if( (unsigned)clientNum2 >= (unsigned)( MAX_CLIENTS ) ) {
 			return 0;
 		}
-		return table[clientNum1 * MAX_CLIENTS + clientNum2];
+		if( int result = table[clientNum1 * MAX_CLIENTS + clientNum2].load( std::memory_order_relaxed ) ) {
+			return result;
+		}
+		return table[clientNum2 * MAX_CLIENTS + clientNum1].load( std::memory_order_relaxed );
 	}
 
 	bool TryCullingByCastingRays( const edict_t *clientEnt, const vec3_t viewOrigin, const edict_t *targetEnt );
 };
 
+/**
+ * Stores encoded entity deltas for reuse by different clients during a single server frame.
+ * Most clients acknowledge the same previous server frame, so they need exactly the same bytes
+ * for transmitting an unchanged-in-shadowing entity delta from that frame.
+ * Deltas are keyed by (the current frame, the frame a delta is built from, the entity number).
+ * Deltas from baselines use a negative "from" frame number.
+ * Shadowed entities produce different per-client data and must bypass the cache.
+ * @note Snapshots of different clients might be written in parallel.
+ * A slot is claimed by a CAS on its state and is published using release/acquire ordering.
+ * Slots of other states are never read.
+ */
+class SnapEntityDeltaCache {
+	template <typename> friend class SingletonHolder;
+public:
+	enum { MAX_DELTA_BYTES = 248 };
+private:
+	enum { NUM_SLOTS_PER_ENTITY = 4 };
+	enum : uint8_t { SLOT_EMPTY, SLOT_BUSY, SLOT_READY };
+
+	struct Slot {
+		int64_t frameNum;
+		int64_t fromFrameNum;
+		unsigned size;
+		uint8_t data[MAX_DELTA_BYTES];
+	};
+
+	// Kept separately from slots for a fast clearing
+	std::atomic<uint8_t> *states;
+	Slot *slots;
+
+	std::atomic<uint64_t> numHits { 0 };
+	std::atomic<uint64_t> numMisses { 0 };
+	std::atomic<uint64_t> numBypasses { 0 };
+
+	SnapEntityDeltaCache();
+
+	~SnapEntityDeltaCache() {
+		::free( (void *)states );
+		::free( slots );
+	}
+public:
+	static void Init();
+	static void Shutdown();
+	static SnapEntityDeltaCache *Instance();
+
+	/**
+	 * Must not be called while snapshots are being written.
+	 */
+	void Clear() {
+		// Lock-free atomics are layout-compatible with their underlying types
+		::memset( (void *)states, SLOT_EMPTY, MAX_EDICTS * NUM_SLOTS_PER_ENTITY * sizeof( *states ) );
+	}
+
+	/**
+	 * Tries to write a cached delta of the entity to the message.
+	 * @return false if there is no such delta in the cache.
+	 */
+	bool TryWriteCachedDelta( msg_t *msg, int64_t frameNum, int64_t fromFrameNum, int entNum );
+
+	/**
+	 * Tries to put an encoded delta in the cache (this might fail if there is no free slot).
+	 */
+	void AddDelta( int64_t frameNum, int64_t fromFrameNum, int entNum, const uint8_t *data, unsigned size );
+
+	void NotifyOfBypass() {
+		numBypasses.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	void PrintStats() const;
+	void ResetStats();
+};
+
 #endif
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "qcommon.h"
 #include "snap_write.h"
 #include "snap_tables.h"
+#include "sys_threads.h"
 #include "../gameshared/gs_public.h"
 #include "../gameshared/q_comref.h"
 
@@ -50,6 +51,35 @@ static inline void SNAP_WriteDeltaEntity( msg_t *msg, const entity_state_t *from
 	Vector2Copy( backupAngles, (float *)( to->angles ) );
 }
 
+/*
+* SNAP_WriteCachedDeltaEntity
+*
+* Same as SNAP_WriteDeltaEntity() but tries reusing bytes encoded for another client first.
+* A delta is fully defined by the current frame, the frame it is built from and the entity number
+* (a negative fromFrameNum stands for a baseline) unless the entity is shadowed for the client.
+*/
+static void SNAP_WriteCachedDeltaEntity( msg_t *msg, const entity_state_t *from, const entity_state_t *to,
+										 const client_snapshot_t *frame, bool force,
+										 int64_t frameNum, int64_t fromFrameNum ) {
+	SnapEntityDeltaCache *const cache = SnapEntityDeltaCache::Instance();
+
+	// Removal is cheap to encode and shadowing produces client-specific data
+	if( !to || SnapShadowTable::Instance()->IsEntityShadowed( frame->ps->playerNum, to->number ) ) {
+		cache->NotifyOfBypass();
+		SNAP_WriteDeltaEntity( msg, from, to, frame, force );
+		return;
+	}
+
+	if( cache->TryWriteCachedDelta( msg, frameNum, fromFrameNum, to->number ) ) {
+		return;
+	}
+
+	const size_t oldcursize = msg->cursize;
+	MSG_WriteDeltaEntity( msg, from, to, force );
+	const size_t size = msg->cursize - oldcursize;
+	cache->AddDelta( frameNum, fromFrameNum, to->number, msg->data + oldcursize, (unsigned)size );
+}
+
 /*
 =========================================================================
 
@@ -65,7 +95,8 @@ Encode a client frame onto the network channel
 */
 static void SNAP_EmitPacketEntities( const client_snapshot_t *from, const client_snapshot_t *to,
 								     msg_t *msg, const entity_state_t *baselines,
-								     const entity_state_t *client_entities, int num_client_entities ) {
+								     const entity_state_t *client_entities, int num_client_entities,
+								     int64_t frameNum, int64_t fromFrameNum ) {
 	MSG_WriteUint8( msg, svc_packetentities );
 
 	const int from_num_entities = !from ? 0 : from->num_entities;
@@ -93,7 +124,7 @@ static void SNAP_EmitPacketEntities( const client_snapshot_t *from, const client
 			// in any bytes being emited if the entity has not changed at all
 			// note that players are always 'newentities', this updates their oldorigin always
 			// and prevents warping ( wsw : jal : I removed it from the players )
-			SNAP_WriteDeltaEntity( msg, oldent, newent, to, false );
+			SNAP_WriteCachedDeltaEntity( msg, oldent, newent, to, false, frameNum, fromFrameNum );
 			oldindex++;
 			newindex++;
 			continue;
@@ -101,14 +132,14 @@ static void SNAP_EmitPacketEntities( const client_snapshot_t *from, const client
 
 		if( newnum < oldnum ) {
 			// this is a new entity, send it from the baseline
-			SNAP_WriteDeltaEntity( msg, &baselines[newnum], newent, to, true );
+			SNAP_WriteCachedDeltaEntity( msg, &baselines[newnum], newent, to, true, frameNum, -1 );
 			newindex++;
 			continue;
 		}
 
 		if( newnum > oldnum ) {
 			// the old entity isn't present in the new message
-			SNAP_WriteDeltaEntity( msg, oldent, nullptr, to, false );
+			SNAP_WriteCachedDeltaEntity( msg, oldent, nullptr, to, false, frameNum, fromFrameNum );
 			oldindex++;
 			continue;
 		}
@@ -397,7 +428,8 @@ void SNAP_WriteFrameSnapToClient( const ginfo_t *gi, client_t *client, msg_t *ms
 	// delta encode the entities
 	const entity_state_t *entityStates = client_entities ? client_entities->entities : nullptr;
 	const int numEntities = client_entities ? client_entities->num_entities : 0;
-	SNAP_EmitPacketEntities( oldframe, frame, msg, baselines, entityStates, numEntities );
+	const int64_t oldFrameNum = oldframe ? client->lastframe : -1;
+	SNAP_EmitPacketEntities( oldframe, frame, msg, baselines, entityStates, numEntities, frameNum, oldFrameNum );
 
 	// write length into reserved space
 	const int length = msg->cursize - pos - 2;
@@ -474,6 +506,7 @@ public:
 
 	const int *begin() const { assert( isSorted ); return nums; }
 	const int *end() const { assert( isSorted ); return nums + numEnts; }
+	int Size() const { assert( isSorted ); return numEnts; }
 
 	void AddEntNum( int num );
 
@@ -765,10 +798,6 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi,
 		// if the client is outside of the world, don't send him any entity (excepting himself)
 		if( !frame->allentities && clusternum == -1 ) {
 			const int entNum = NUM_FOR_EDICT( clent );
-			if( clent->s.number != entNum ) {
-				Com_Printf( "FIXING CLENT->S.NUMBER: %i %i!!!\n", clent->s.number, entNum );
-				clent->s.number = entNum;
-			}
 
 			// FIXME we should send all the entities who's POV we are sending if frame->multipov
 			list.AddEntNum( entNum );
@@ -802,12 +831,6 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi,
 	for( int entNum = 1; entNum < gi->num_edicts; entNum++ ) {
 		edict_t *ent = EDICT_NUM( entNum );
 
-		// fix number if broken
-		if( ent->s.number != entNum ) {
-			Com_Printf( "FIXING ENT->S.NUMBER: %i %i!!!\n", ent->s.number, entNum );
-			ent->s.number = entNum;
-		}
-
 		// always add the client entity, even if SVF_NOCLIENT
 		if( ( ent != clent ) && SNAP_SnapCullEntity( cms, ent, clent, frame, vieworg, fatpvs, snapHintFlags ) ) {
 			continue;
@@ -816,18 +839,39 @@ static void SNAP_BuildSnapEntitiesList( cmodel_state_t *cms, ginfo_t *gi,
 		// add it
 		list.AddEntNum( entNum );
 
+		// the owner number has been validated by SNAP_FixEntityNumbers()
+		if( ( ent->r.svflags & SVF_FORCEOWNER ) && ent->s.ownerNum > 0 ) {
+			list.AddEntNum( ent->s.ownerNum );
+		}
+	}
+
+	list.Sort();
+}
+
+/*
+* SNAP_FixEntityNumbers
+*
+* Snapshots of different clients might be built in parallel and must not modify entities,
+* so broken entity and owner numbers are fixed once before building any snapshot.
+*/
+void SNAP_FixEntityNumbers( ginfo_t *gi ) {
+	for( int entNum = 0; entNum < gi->num_edicts; entNum++ ) {
+		edict_t *ent = EDICT_NUM( entNum );
+
+		// fix number if broken
+		if( ent->s.number != entNum ) {
+			Com_Printf( "FIXING ENT->S.NUMBER: %i %i!!!\n", ent->s.number, entNum );
+			ent->s.number = entNum;
+		}
+
+		// make sure owner number is valid too
 		if( ent->r.svflags & SVF_FORCEOWNER ) {
-			// make sure owner number is valid too
-			if( ent->s.ownerNum > 0 && ent->s.ownerNum < gi->num_edicts ) {
-				list.AddEntNum( ent->s.ownerNum );
-			} else {
+			if( ent->s.ownerNum < 0 || ent->s.ownerNum >= gi->num_edicts ) {
 				Com_Printf( "FIXING ENT->S.OWNERNUM: %i %i!!!\n", ent->s.type, ent->s.ownerNum );
 				ent->s.ownerNum = 0;
 			}
 		}
 	}
-
-	list.Sort();
 }
 
 /*
@@ -939,8 +983,11 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, int64_t frameN
 
 	//=============================
 
-	// dump the entities list
-	int ne = client_entities->next_entities;
+	// dump the entities list.
+	// Snapshots of different clients might be built in parallel,
+	// so reserve a range of the circular client_entities array atomically.
+	const int numReserved = list.Size();
+	int ne = Sys_Atomic_Add( (volatile int *)&client_entities->next_entities, numReserved, nullptr );
 	frame->num_entities = 0;
 	frame->first_entity = ne;
 
@@ -961,7 +1008,7 @@ void SNAP_BuildClientFrameSnap( cmodel_state_t *cms, ginfo_t *gi, int64_t frameN
 		ne++;
 	}
 
-	client_entities->next_entities = ne;
+	assert( frame->num_entities == numReserved );
 }
 
 template <typename T>
@@ -21,6 +21,18 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "qcommon.h"
 #include "sys_threads.h"
 
+#include <atomic>
+#include <cstddef>
+
+#if defined( __linux__ )
+#define QBUFPIPE_USE_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#endif
+
 /*
 * QMutex_Create
 */
@@ -143,17 +155,44 @@ void QThreads_Shutdown( void ) {
 
 // ============================================================================
 
+/*
+* A single-producer/single-consumer ring buffer of variable-sized commands.
+*
+* The writer and the reader own their positions in the buffer, the only shared state
+* is a pair of free-running byte counters published with release/acquire ordering.
+* The reader announces that it is going to sleep before waiting, so the writer
+* touches the futex (or the condition variable where there are no futexes)
+* only if the reader is really asleep.
+*/
+
+#define QBUFPIPE_CACHELINE_SIZE 64
+
 struct qbufPipe_s {
 	int blockWrite;
-	volatile int terminated;
+	std::atomic_int terminated;
+	size_t bufSize;
+	char *buf;
+
+	// owned by the writer
+	char pad1[QBUFPIPE_CACHELINE_SIZE];
 	unsigned write_pos;
+	unsigned written;
+	unsigned cachedRead;            // last seen value of readCount
+	std::atomic_uint writtenCount;  // published value of written
+
+	// owned by the reader
+	char pad2[QBUFPIPE_CACHELINE_SIZE];
 	unsigned read_pos;
-	volatile int cmdbuf_len;
-	qmutex_t *cmdbuf_mutex;
-	size_t bufSize;
+	unsigned read;
+	std::atomic_uint readCount;     // published value of read
+
+	char pad3[QBUFPIPE_CACHELINE_SIZE];
+	std::atomic_int readerSleeping;
+	std::atomic_int wakeSeq;        // the futex word
+#ifndef QBUFPIPE_USE_FUTEX
 	qcondvar_t *nonempty_condvar;
 	qmutex_t *nonempty_mutex;
-	char *buf;
+#endif
 };
 
 /*
@@ -161,13 +200,14 @@ struct qbufPipe_s {
 */
 qbufPipe_t *QBufPipe_Create( size_t bufSize, int flags ) {
 	qbufPipe_t *pipe = (qbufPipe_t *)malloc( sizeof( *pipe ) + bufSize );
-	memset( pipe, 0, sizeof( *pipe ) );
+	memset( (void *)pipe, 0, sizeof( *pipe ) );
 	pipe->blockWrite = flags & 1;
 	pipe->buf = (char *)( pipe + 1 );
 	pipe->bufSize = bufSize;
-	pipe->cmdbuf_mutex = QMutex_Create();
+#ifndef QBUFPIPE_USE_FUTEX
 	pipe->nonempty_condvar = QCondVar_Create();
 	pipe->nonempty_mutex = QMutex_Create();
+#endif
 	return pipe;
 }
 
@@ -185,9 +225,10 @@ void QBufPipe_Destroy( qbufPipe_t **ppipe ) {
 	pipe = *ppipe;
 	*ppipe = NULL;
 
-	QMutex_Destroy( &pipe->cmdbuf_mutex );
+#ifndef QBUFPIPE_USE_FUTEX
 	QMutex_Destroy( &pipe->nonempty_mutex );
 	QCondVar_Destroy( &pipe->nonempty_condvar );
+#endif
 	free( pipe );
 }
 
@@ -197,7 +238,87 @@ void QBufPipe_Destroy( qbufPipe_t **ppipe ) {
 * Signals the waiting thread to wake up.
 */
 static void QBufPipe_Wake( qbufPipe_t *pipe ) {
+#ifdef QBUFPIPE_USE_FUTEX
+	pipe->wakeSeq.fetch_add( 1, std::memory_order_release );
+	syscall( SYS_futex, (int *)&pipe->wakeSeq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0 );
+#else
+	QMutex_Lock( pipe->nonempty_mutex );
+	pipe->wakeSeq.fetch_add( 1, std::memory_order_release );
 	QCondVar_Wake( pipe->nonempty_condvar );
+	QMutex_Unlock( pipe->nonempty_mutex );
+#endif
+}
+
+/*
+* QBufPipe_WakeIfSleeping
+*/
+static void QBufPipe_WakeIfSleeping( qbufPipe_t *pipe ) {
+	// pairs with the fence in QBufPipe_Sleep(): either we see the reader
+	// going to sleep, or the reader sees the published commands
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+
+	if( !pipe->readerSleeping.load( std::memory_order_relaxed ) ) {
+		return;
+	}
+	// only a single writer call pays for the wakeup
+	if( pipe->readerSleeping.exchange( 0, std::memory_order_relaxed ) ) {
+		QBufPipe_Wake( pipe );
+	}
+}
+
+/*
+* QBufPipe_Sleep
+*
+* Puts the reader to sleep until new commands are published. Returns false on timeout.
+*/
+static bool QBufPipe_Sleep( qbufPipe_t *pipe, unsigned timeout_msec ) {
+	bool timeout = false;
+	const int seq = pipe->wakeSeq.load( std::memory_order_acquire );
+
+	pipe->readerSleeping.store( 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+
+	if( pipe->writtenCount.load( std::memory_order_relaxed ) != pipe->read || pipe->terminated ) {
+		pipe->readerSleeping.store( 0, std::memory_order_relaxed );
+		return true;
+	}
+
+#ifdef QBUFPIPE_USE_FUTEX
+	struct timespec ts, *pts = NULL;
+	if( timeout_msec != Q_THREADS_WAIT_INFINITE ) {
+		ts.tv_sec = timeout_msec / 1000;
+		ts.tv_nsec = ( timeout_msec % 1000 ) * 1000000;
+		pts = &ts;
+	}
+
+	// returns immediately if the sequence has been changed after we've read it
+	if( syscall( SYS_futex, (int *)&pipe->wakeSeq, FUTEX_WAIT_PRIVATE, seq, pts, NULL, 0 ) < 0 ) {
+		timeout = ( errno == ETIMEDOUT );
+	}
+#else
+	QMutex_Lock( pipe->nonempty_mutex );
+	if( pipe->wakeSeq.load( std::memory_order_relaxed ) == seq ) {
+		timeout = QCondVar_Wait( pipe->nonempty_condvar, pipe->nonempty_mutex, timeout_msec ) == false;
+	}
+	QMutex_Unlock( pipe->nonempty_mutex );
+#endif
+
+	pipe->readerSleeping.store( 0, std::memory_order_relaxed );
+	return !timeout;
+}
+
+/*
+* QBufPipe_Publish
+*
+* Makes written commands visible to the reader.
+*/
+static void QBufPipe_Publish( qbufPipe_t *pipe ) {
+	if( pipe->writtenCount.load( std::memory_order_relaxed ) == pipe->written ) {
+		return;
+	}
+
+	pipe->writtenCount.store( pipe->written, std::memory_order_release );
+	QBufPipe_WakeIfSleeping( pipe );
 }
 
 /*
@@ -207,28 +328,80 @@ static void QBufPipe_Wake( qbufPipe_t *pipe ) {
 * or terminates with an error.
 */
 void QBufPipe_Finish( qbufPipe_t *pipe ) {
-	while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0, pipe->cmdbuf_mutex ) == false && !pipe->terminated ) {
-		QMutex_Lock( pipe->nonempty_mutex );
-		QBufPipe_Wake( pipe );
-		QMutex_Unlock( pipe->nonempty_mutex );
+	QBufPipe_Publish( pipe );
+
+	while( pipe->readCount.load( std::memory_order_acquire ) != pipe->written && !pipe->terminated ) {
+		QBufPipe_WakeIfSleeping( pipe );
 		QThread_Yield();
 	}
 }
 
 /*
-* QBufPipe_AllocCmd
+* QBufPipe_ReserveSpace
+*
+* Checks whether there's enough free space in the buffer for size bytes,
+* waits for the reader to consume commands if the pipe is blocking.
 */
-static void *QBufPipe_AllocCmd( qbufPipe_t *pipe, unsigned cmd_size ) {
-	void *buf = &pipe->buf[pipe->write_pos];
-	pipe->write_pos += cmd_size;
-	return buf;
+static bool QBufPipe_ReserveSpace( qbufPipe_t *pipe, unsigned size ) {
+	for(;; ) {
+		if( pipe->written - pipe->cachedRead + size <= pipe->bufSize ) {
+			return true;
+		}
+
+		pipe->cachedRead = pipe->readCount.load( std::memory_order_acquire );
+		if( pipe->written - pipe->cachedRead + size <= pipe->bufSize ) {
+			return true;
+		}
+
+		if( !pipe->blockWrite || pipe->terminated ) {
+			return false;
+		}
+
+		// the reader is not going to free any space if it doesn't see pending commands
+		QBufPipe_Publish( pipe );
+		QThread_Yield();
+	}
 }
 
 /*
-* QBufPipe_BufLenAdd
+* QBufPipe_PutCmd
+*
+* Copies the command to the buffer without publishing it.
 */
-static void QBufPipe_BufLenAdd( qbufPipe_t *pipe, int val ) {
-	Sys_Atomic_Add( &pipe->cmdbuf_len, val, pipe->cmdbuf_mutex );
+static void QBufPipe_PutCmd( qbufPipe_t *pipe, const void *pcmd, unsigned cmd_size ) {
+	unsigned write_remains;
+	unsigned skip = 0;
+	bool rewind = false;
+
+	assert( pipe->bufSize >= pipe->write_pos );
+	if( pipe->bufSize < pipe->write_pos ) {
+		pipe->write_pos = 0;
+	}
+
+	write_remains = pipe->bufSize - pipe->write_pos;
+
+	if( sizeof( int ) > write_remains || cmd_size > write_remains ) {
+		// the command doesn't fit the tail, rewind (there might be no bytes to skip if the tail is full)
+		rewind = true;
+		skip = write_remains;
+	}
+
+	if( !QBufPipe_ReserveSpace( pipe, skip + cmd_size ) ) {
+		return;
+	}
+
+	if( rewind ) {
+		if( sizeof( int ) <= write_remains ) {
+			// explicit pointer reset cmd, otherwise the reader rewinds implicitly
+			*( (int *)( pipe->buf + pipe->write_pos ) ) = -1;
+		}
+		pipe->written += skip;
+		pipe->write_pos = 0;
+	}
+
+	memcpy( pipe->buf + pipe->write_pos, pcmd, cmd_size );
+	pipe->write_pos += cmd_size;
+	pipe->written += cmd_size;
 }
 
 /*
@@ -237,13 +410,9 @@ static void QBufPipe_BufLenAdd( qbufPipe_t *pipe, int val ) {
 * Add new command to buffer. Never allow the distance between the reader
 * and the writer to grow beyond the size of the buffer.
 *
-* Note that there are race conditions here but in the worst case we're going
-* to erroneously drop cmd's instead of stepping on the reader's toes.
+* If the pipe is not blocking, commands that don't fit the buffer are dropped.
 */
 void QBufPipe_WriteCmd( qbufPipe_t *pipe, const void *pcmd, unsigned cmd_size ) {
-	void *buf;
-	unsigned write_remains;
-
 	if( !pipe ) {
 		return;
 	}
@@ -251,60 +420,30 @@ void QBufPipe_WriteCmd( qbufPipe_t *pipe, const void *pcmd, unsigned cmd_size )
 		return;
 	}
 
-	assert( pipe->bufSize >= pipe->write_pos );
-	if( pipe->bufSize < pipe->write_pos ) {
-		pipe->write_pos = 0;
-	}
-
-	write_remains = pipe->bufSize - pipe->write_pos;
-
-	if( sizeof( int ) > write_remains ) {
-		while( pipe->cmdbuf_len + cmd_size + write_remains > pipe->bufSize ) {
-			if( pipe->blockWrite ) {
-				QThread_Yield();
-				continue;
-			}
-			return;
-		}
-
-		// not enough space to enpipe even the reset cmd, rewind
-		QBufPipe_BufLenAdd( pipe, write_remains ); // atomic
-		pipe->write_pos = 0;
-	} else if( cmd_size > write_remains ) {
-		int *cmd;
-
-		while( pipe->cmdbuf_len + sizeof( int ) + cmd_size + write_remains > pipe->bufSize ) {
-			if( pipe->blockWrite ) {
-				QThread_Yield();
-				continue;
-			}
-			return;
-		}
+	QBufPipe_PutCmd( pipe, pcmd, cmd_size );
+	QBufPipe_Publish( pipe );
+}
 
-		// explicit pointer reset cmd
-		cmd = (int *)QBufPipe_AllocCmd( pipe, sizeof( int ) );
-		*cmd = -1;
+/*
+* QBufPipe_WriteCmds
+*
+* Adds several commands to the buffer at once. The commands become visible
+* to the reader together and the reader is woken up at most once.
+*/
+void QBufPipe_WriteCmds( qbufPipe_t *pipe, const void *const *pcmds, const unsigned *cmd_sizes, unsigned num_cmds ) {
+	unsigned i;
 
-		QBufPipe_BufLenAdd( pipe, sizeof( *cmd ) + write_remains ); // atomic
-		pipe->write_pos = 0;
-	} else {
-		while( pipe->cmdbuf_len + cmd_size > pipe->bufSize ) {
-			if( pipe->blockWrite ) {
-				QThread_Yield();
-				continue;
-			}
-			return;
-		}
+	if( !pipe ) {
+		return;
+	}
+	if( pipe->terminated ) {
+		return;
 	}
 
-	buf = QBufPipe_AllocCmd( pipe, cmd_size );
-	memcpy( buf, pcmd, cmd_size );
-	QBufPipe_BufLenAdd( pipe, cmd_size ); // atomic
-
-	// wake the other thread waiting for signal
-	QMutex_Lock( pipe->nonempty_mutex );
-	QBufPipe_Wake( pipe );
-	QMutex_Unlock( pipe->nonempty_mutex );
+	for( i = 0; i < num_cmds; i++ ) {
+		QBufPipe_PutCmd( pipe, pcmds[i], cmd_sizes[i] );
+	}
+	QBufPipe_Publish( pipe );
 }
 
 /*
@@ -317,10 +456,15 @@ int QBufPipe_ReadCmds( qbufPipe_t *pipe, unsigned( **cmdHandlers )( const void *
 		return -1;
 	}
 
-	while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0, pipe->cmdbuf_mutex ) == false && !pipe->terminated ) {
+	while( !pipe->terminated ) {
 		int cmd;
-		int cmd_size;
-		int read_remains;
+		unsigned cmd_size;
+		unsigned read_remains;
+		const unsigned cmdbuf_len = pipe->writtenCount.load( std::memory_order_acquire ) - pipe->read;
+
+		if( !cmdbuf_len ) {
+			break;
+		}
 
 		assert( pipe->bufSize >= pipe->read_pos );
 		if( pipe->bufSize < pipe->read_pos ) {
@@ -329,17 +473,20 @@ int QBufPipe_ReadCmds( qbufPipe_t *pipe, unsigned( **cmdHandlers )( const void *
 
 		read_remains = pipe->bufSize - pipe->read_pos;
 
-		if( (int )sizeof( int ) > read_remains ) {
+		if( sizeof( int ) > read_remains ) {
 			// implicit reset
 			pipe->read_pos = 0;
-			QBufPipe_BufLenAdd( pipe, -read_remains );
+			pipe->read += read_remains;
+			pipe->readCount.store( pipe->read, std::memory_order_release );
+			continue;
 		}
 
 		cmd = *( (int *)( pipe->buf + pipe->read_pos ) );
 		if( cmd == -1 ) {
 			// this cmd is special
 			pipe->read_pos = 0;
-			QBufPipe_BufLenAdd( pipe, -( (int)( sizeof( int ) + read_remains ) ) ); // atomic
+			pipe->read += read_remains;
+			pipe->readCount.store( pipe->read, std::memory_order_release );
 			continue;
 		}
 
@@ -351,14 +498,15 @@ int QBufPipe_ReadCmds( qbufPipe_t *pipe, unsigned( **cmdHandlers )( const void *
 			return -1;
 		}
 
-		if( cmd_size > pipe->cmdbuf_len ) {
+		if( cmd_size > cmdbuf_len ) {
 			assert( 0 );
 			pipe->terminated = 1;
 			return -1;
 		}
 
 		pipe->read_pos += cmd_size;
-		QBufPipe_BufLenAdd( pipe, -cmd_size ); // atomic
+		pipe->read += cmd_size;
+		pipe->readCount.store( pipe->read, std::memory_order_release );
 	}
 
 	return read;
@@ -373,18 +521,12 @@ void QBufPipe_Wait( qbufPipe_t *pipe, int ( *read )( qbufPipe_t *, unsigned( **
 		int res;
 		bool timeout = false;
 
-		while( Sys_Atomic_CAS( &pipe->cmdbuf_len, 0, 0, pipe->cmdbuf_mutex ) == true ) {
-			QMutex_Lock( pipe->nonempty_mutex );
-
-			timeout = QCondVar_Wait( pipe->nonempty_condvar, pipe->nonempty_mutex, timeout_msec ) == false;
-
-			// don't hold the mutex, changes to cmdbuf_len are atomic anyway
-			QMutex_Unlock( pipe->nonempty_mutex );
-			break;
+		if( pipe->writtenCount.load( std::memory_order_acquire ) == pipe->read ) {
+			timeout = QBufPipe_Sleep( pipe, timeout_msec ) == false;
 		}
 
-		// we're guaranteed at this point that either cmdbuf_len is > 0
-		// or that waiting on the condition variable has timed out
+		// we're guaranteed at this point that either there are commands to read
+		// or that waiting has timed out
 		res = read( pipe, cmdHandlers, timeout );
 		if( res < 0 ) {
 			// done
@@ -392,3 +534,92 @@ void QBufPipe_Wait( qbufPipe_t *pipe, int ( *read )( qbufPipe_t *, unsigned( **
 		}
 	}
 }
+
+#ifndef PUBLIC_BUILD
+
+#define QBUFPIPE_TEST_BUFSIZE   64
+
+typedef struct {
+	int id;
+	unsigned seq;
+	unsigned size;
+	unsigned char payload[QBUFPIPE_TEST_BUFSIZE];
+} qbufPipeTestCmd_t;
+
+static unsigned qbufpipe_testReadSeq;
+static bool qbufpipe_testFailed;
+
+/*
+* QBufPipe_TestCmd
+*/
+static unsigned QBufPipe_TestCmd( const void *pcmd ) {
+	qbufPipeTestCmd_t cmdCopy;
+	const qbufPipeTestCmd_t *cmd = &cmdCopy;
+	unsigned i;
+
+	// odd sized commands are not aligned
+	memcpy( &cmdCopy, pcmd, offsetof( qbufPipeTestCmd_t, payload ) );
+	memcpy( cmdCopy.payload, (const char *)pcmd + offsetof( qbufPipeTestCmd_t, payload ),
+			cmdCopy.size - offsetof( qbufPipeTestCmd_t, payload ) );
+
+	if( cmd->seq != qbufpipe_testReadSeq ) {
+		qbufpipe_testFailed = true;
+	}
+	for( i = 0; i + offsetof( qbufPipeTestCmd_t, payload ) < cmd->size; i++ ) {
+		if( cmd->payload[i] != (unsigned char)( cmd->seq + i ) ) {
+			qbufpipe_testFailed = true;
+		}
+	}
+
+	qbufpipe_testReadSeq++;
+	return cmd->size;
+}
+
+/*
+* QBufPipe_Test_f
+*
+* Pushes commands of various sizes through a small pipe, so that the writer
+* fills the tail exactly, leaves room for the explicit rewind marker
+* or leaves less than that, then checks what the reader gets.
+*/
+void QBufPipe_Test_f( void ) {
+	unsigned( *cmdHandlers[] )( const void * ) = { QBufPipe_TestCmd };
+	qbufPipeTestCmd_t cmd;
+	unsigned cmdSize, seq, i;
+	int numFailed = 0;
+
+	for( cmdSize = offsetof( qbufPipeTestCmd_t, payload ); cmdSize <= QBUFPIPE_TEST_BUFSIZE / 2; cmdSize++ ) {
+		// a canary after the end of the buffer
+		qbufPipe_t *pipe = QBufPipe_Create( QBUFPIPE_TEST_BUFSIZE + sizeof( int ), 0 );
+		pipe->bufSize = QBUFPIPE_TEST_BUFSIZE;
+		*( (int *)( pipe->buf + QBUFPIPE_TEST_BUFSIZE ) ) = 0x7EADBEEF;
+
+		qbufpipe_testReadSeq = 0;
+		qbufpipe_testFailed = false;
+		for( seq = 0; seq < 4 * QBUFPIPE_TEST_BUFSIZE && !qbufpipe_testFailed; seq++ ) {
+			cmd.id = 0;
+			cmd.seq = seq;
+			cmd.size = cmdSize;
+			for( i = 0; i + offsetof( qbufPipeTestCmd_t, payload ) < cmdSize; i++ ) {
+				cmd.payload[i] = (unsigned char)( seq + i );
+			}
+
+			// the pipe is not blocking, so drain it before a command might not fit
+			QBufPipe_WriteCmd( pipe, &cmd, cmdSize );
+			QBufPipe_ReadCmds( pipe, cmdHandlers );
+			if( *( (int *)( pipe->buf + QBUFPIPE_TEST_BUFSIZE ) ) != 0x7EADBEEF ) {
+				qbufpipe_testFailed = true;
+			}
+		}
+		if( qbufpipe_testFailed || qbufpipe_testReadSeq != seq ) {
+			Com_Printf( "bufpipetest: FAILED for %u bytes commands (read %u of %u)\n", cmdSize, qbufpipe_testReadSeq, seq );
+			numFailed++;
+		}
+
+		QBufPipe_Destroy( &pipe );
+	}
+
+	Com_Printf( "bufpipetest: %s\n", numFailed ? "FAILED" : "passed" );
+}
+
+#endif
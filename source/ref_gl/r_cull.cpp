@@ -182,6 +182,123 @@ bool R_CullSphere( const vec3_t centre, const float radius, const unsigned int c
 	return false;
 }
 
+/*
+* R_CullBounds
+*
+* Tests up to 32 boxes starting at the first one against frustum planes enabled by clipflags.
+* Returns the mask of boxes that are completely outside the frustum. The mask of boxes that
+* intersect any of the tested planes is stored to partial if it is not NULL.
+* Boxes are tested in groups of 4, every group is tested against all planes without branching.
+*/
+unsigned R_CullBounds( const mcullbounds_t *bounds, unsigned first, unsigned count, unsigned clipflags, unsigned *partial ) {
+	unsigned i, j, bit;
+	unsigned numPlanes;
+	unsigned outside, intersecting;
+	const cplane_t *planes[sizeof( rn.frustum ) / sizeof( rn.frustum[0] )];
+
+	assert( count <= 32 );
+	assert( first + count <= bounds->numBoxes );
+
+	if( partial ) {
+		*partial = 0;
+	}
+
+	if( r_nocull->integer ) {
+		return 0;
+	}
+
+	numPlanes = 0;
+	for( j = 0, bit = 1; j < sizeof( rn.frustum ) / sizeof( rn.frustum[0] ); j++, bit <<= 1 ) {
+		if( clipflags & bit ) {
+			planes[numPlanes++] = &rn.frustum[j];
+		}
+	}
+
+	if( !numPlanes || !count ) {
+		return 0;
+	}
+
+	outside = intersecting = 0;
+
+#ifdef QF_SSE2
+	// arrays are padded so the last group can be read as a whole
+	for( i = 0; i < count; i += 4 ) {
+		const __m128 xmins = _mm_loadu_ps( bounds->mins[0] + first + i );
+		const __m128 ymins = _mm_loadu_ps( bounds->mins[1] + first + i );
+		const __m128 zmins = _mm_loadu_ps( bounds->mins[2] + first + i );
+		const __m128 xmaxs = _mm_loadu_ps( bounds->maxs[0] + first + i );
+		const __m128 ymaxs = _mm_loadu_ps( bounds->maxs[1] + first + i );
+		const __m128 zmaxs = _mm_loadu_ps( bounds->maxs[2] + first + i );
+		__m128 out = _mm_setzero_ps();
+		__m128 cross = _mm_setzero_ps();
+
+		for( j = 0; j < numPlanes; j++ ) {
+			const cplane_t *p = planes[j];
+			const __m128 nx = _mm_set1_ps( p->normal[0] );
+			const __m128 ny = _mm_set1_ps( p->normal[1] );
+			const __m128 nz = _mm_set1_ps( p->normal[2] );
+			const __m128 dist = _mm_set1_ps( p->dist );
+			__m128 farDist, nearDist;
+
+			// the far corner is the farthest one along the plane normal
+			farDist = _mm_mul_ps( nx, ( p->signbits & 1 ) ? xmins : xmaxs );
+			farDist = _mm_add_ps( farDist, _mm_mul_ps( ny, ( p->signbits & 2 ) ? ymins : ymaxs ) );
+			farDist = _mm_add_ps( farDist, _mm_mul_ps( nz, ( p->signbits & 4 ) ? zmins : zmaxs ) );
+
+			nearDist = _mm_mul_ps( nx, ( p->signbits & 1 ) ? xmaxs : xmins );
+			nearDist = _mm_add_ps( nearDist, _mm_mul_ps( ny, ( p->signbits & 2 ) ? ymaxs : ymins ) );
+			nearDist = _mm_add_ps( nearDist, _mm_mul_ps( nz, ( p->signbits & 4 ) ? zmaxs : zmins ) );
+
+			out = _mm_or_ps( out, _mm_cmplt_ps( farDist, dist ) );
+			cross = _mm_or_ps( cross, _mm_cmplt_ps( nearDist, dist ) );
+		}
+
+		outside |= (unsigned)_mm_movemask_ps( out ) << i;
+		intersecting |= (unsigned)_mm_movemask_ps( cross ) << i;
+	}
+#else
+	for( i = 0; i < count; i++ ) {
+		vec3_t mins, maxs;
+		float farDist, nearDist;
+
+		for( j = 0; j < 3; j++ ) {
+			mins[j] = bounds->mins[j][first + i];
+			maxs[j] = bounds->maxs[j][first + i];
+		}
+
+		for( j = 0; j < numPlanes; j++ ) {
+			const cplane_t *p = planes[j];
+
+			farDist = p->normal[0] * ( ( p->signbits & 1 ) ? mins[0] : maxs[0] );
+			farDist += p->normal[1] * ( ( p->signbits & 2 ) ? mins[1] : maxs[1] );
+			farDist += p->normal[2] * ( ( p->signbits & 4 ) ? mins[2] : maxs[2] );
+
+			nearDist = p->normal[0] * ( ( p->signbits & 1 ) ? maxs[0] : mins[0] );
+			nearDist += p->normal[1] * ( ( p->signbits & 2 ) ? maxs[1] : mins[1] );
+			nearDist += p->normal[2] * ( ( p->signbits & 4 ) ? maxs[2] : mins[2] );
+
+			if( farDist < p->dist ) {
+				outside |= 1u << i;
+			}
+			if( nearDist < p->dist ) {
+				intersecting |= 1u << i;
+			}
+		}
+	}
+#endif
+
+	// drop bits of boxes read past the requested range
+	if( count < 32 ) {
+		outside &= ( 1u << count ) - 1;
+		intersecting &= ( 1u << count ) - 1;
+	}
+
+	if( partial ) {
+		*partial = intersecting & ~outside;
+	}
+	return outside;
+}
+
 /*
 * R_VisCullBox
 */
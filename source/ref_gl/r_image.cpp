@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "../qcommon/qcommon.h"
 
 #include <algorithm>
+#include <atomic>
 
 #define MAX_GLIMAGES        8192
 #define IMAGES_HASH_SIZE    64
@@ -63,6 +64,7 @@ static int gl_anisotropic_filter = 0;
 static void R_InitImageLoader( int id );
 static void R_ShutdownImageLoader( int id );
 static bool R_LoadAsyncImageFromDisk( image_t *image );
+static bool R_LoadImageFromDisk( int ctx, image_t *image );
 
 typedef struct {
 	const char *name;
@@ -399,10 +401,13 @@ static uint8_t *_R_AllocImageBufferCb( void *ptr, size_t size, const char *filen
 }
 
 /*
-* R_ReadImageFromDisk
+* R_ReadImageFromDiskExt
+*
+* Stores the pixels in the buffer returned by allocbuf, may be called by any thread.
 */
-static int R_ReadImageFromDisk( int ctx, char *pathname, size_t pathname_size,
-								uint8_t **pic, int *width, int *height, int *flags, int side ) {
+static int R_ReadImageFromDiskExt( char *pathname, size_t pathname_size,
+								   uint8_t **pic, int *width, int *height, int *flags,
+								   uint8_t *( *allocbuf )( void *, size_t, const char *, int ), void *uptr ) {
 	const char *extension;
 	int samples;
 
@@ -413,16 +418,15 @@ static int R_ReadImageFromDisk( int ctx, char *pathname, size_t pathname_size,
 	extension =FS_FirstExtension( pathname, IMAGE_EXTENSIONS, NUM_IMAGE_EXTENSIONS - 1 ); // last is KTX
 	if( extension ) {
 		r_imginfo_t imginfo;
-		loaderCbInfo_t cbinfo = { ctx, side };
 
 		COM_ReplaceExtension( pathname, extension, pathname_size );
 
 		if( !Q_stricmp( extension, ".jpg" ) ) {
-			imginfo = LoadJPG( pathname, _R_AllocImageBufferCb, (void *)&cbinfo );
+			imginfo = LoadJPG( pathname, allocbuf, uptr );
 		} else if( !Q_stricmp( extension, ".tga" ) ) {
-			imginfo = LoadTGA( pathname, _R_AllocImageBufferCb, (void *)&cbinfo );
+			imginfo = LoadTGA( pathname, allocbuf, uptr );
 		} else if( !Q_stricmp( extension, ".png" ) ) {
-			imginfo = LoadPNG( pathname, _R_AllocImageBufferCb, (void *)&cbinfo );
+			imginfo = LoadPNG( pathname, allocbuf, uptr );
 		} else {
 			return 0;
 		}
@@ -451,6 +455,17 @@ static int R_ReadImageFromDisk( int ctx, char *pathname, size_t pathname_size,
 	return samples;
 }
 
+/*
+* R_ReadImageFromDisk
+*/
+static int R_ReadImageFromDisk( int ctx, char *pathname, size_t pathname_size,
+								uint8_t **pic, int *width, int *height, int *flags, int side ) {
+	loaderCbInfo_t cbinfo = { ctx, side };
+
+	return R_ReadImageFromDiskExt( pathname, pathname_size, pic, width, height, flags,
+								   _R_AllocImageBufferCb, (void *)&cbinfo );
+}
+
 /*
 * R_ScaledImageSize
 */
@@ -583,10 +598,12 @@ static void R_CutImage( const uint8_t *in, int inwidth, int height, uint8_t *out
 }
 
 /*
-* R_ResampleTexture
+* R_ResampleTextureExt
+*
+* The line buffer must hold outwidth * 2 offsets, it's not used if the size is not changed.
 */
-static void R_ResampleTexture( int ctx, const uint8_t *in, int inwidth, int inheight, uint8_t *out,
-							   int outwidth, int outheight, int samples, int alignment ) {
+static void R_ResampleTextureExt( const uint8_t *in, int inwidth, int inheight, uint8_t *out,
+								  int outwidth, int outheight, int samples, int alignment, unsigned *lineBuf ) {
 	int i, j, k;
 	int inwidthS, outwidthS;
 	unsigned int frac, fracstep;
@@ -599,7 +616,7 @@ static void R_ResampleTexture( int ctx, const uint8_t *in, int inwidth, int inhe
 		return;
 	}
 
-	p1 = ( unsigned * )R_PrepareImageBuffer( ctx, TEXTURE_LINE_BUF, outwidth * sizeof( *p1 ) * 2 );
+	p1 = lineBuf;
 	p2 = p1 + outwidth;
 
 	fracstep = inwidth * 0x10000 / outwidth;
@@ -634,6 +651,20 @@ static void R_ResampleTexture( int ctx, const uint8_t *in, int inwidth, int inhe
 	}
 }
 
+/*
+* R_ResampleTexture
+*/
+static void R_ResampleTexture( int ctx, const uint8_t *in, int inwidth, int inheight, uint8_t *out,
+							   int outwidth, int outheight, int samples, int alignment ) {
+	unsigned *lineBuf = NULL;
+
+	if( inwidth != outwidth || inheight != outheight ) {
+		lineBuf = ( unsigned * )R_PrepareImageBuffer( ctx, TEXTURE_LINE_BUF, outwidth * sizeof( *lineBuf ) * 2 );
+	}
+
+	R_ResampleTextureExt( in, inwidth, inheight, out, outwidth, outheight, samples, alignment, lineBuf );
+}
+
 /*
 * R_ResampleTexture16
 *
@@ -690,18 +721,49 @@ static void R_ResampleTexture16( int ctx, const unsigned short *in, int inwidth,
 	}
 }
 
+#ifdef QF_SSE2
 /*
-* R_MipMap
+* R_MipMapPixels_SSE2
 *
-* Operates in place, quartering the size of the texture
+* Averages 2x2 blocks of 8 RGBA pixels of two rows, giving 4 pixels.
+* Sums are kept in 16 bits so the result matches the generic code exactly.
 */
-static void R_MipMap( uint8_t *in, int width, int height, int samples, int alignment ) {
+static inline __m128i R_MipMapPixels_SSE2( const uint8_t *in, const uint8_t *next ) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i a0 = _mm_loadu_si128( ( const __m128i * )in ), a1 = _mm_loadu_si128( ( const __m128i * )( in + 16 ) );
+	const __m128i b0 = _mm_loadu_si128( ( const __m128i * )next ), b1 = _mm_loadu_si128( ( const __m128i * )( next + 16 ) );
+	__m128i s0, s1, s2, s3;
+
+	// vertical sums, each register holds two horizontally adjacent pixels
+	s0 = _mm_add_epi16( _mm_unpacklo_epi8( a0, zero ), _mm_unpacklo_epi8( b0, zero ) );
+	s1 = _mm_add_epi16( _mm_unpackhi_epi8( a0, zero ), _mm_unpackhi_epi8( b0, zero ) );
+	s2 = _mm_add_epi16( _mm_unpacklo_epi8( a1, zero ), _mm_unpacklo_epi8( b1, zero ) );
+	s3 = _mm_add_epi16( _mm_unpackhi_epi8( a1, zero ), _mm_unpackhi_epi8( b1, zero ) );
+
+	// horizontal sums of the pixel pairs
+	s0 = _mm_add_epi16( _mm_unpacklo_epi64( s0, s1 ), _mm_unpackhi_epi64( s0, s1 ) );
+	s2 = _mm_add_epi16( _mm_unpacklo_epi64( s2, s3 ), _mm_unpackhi_epi64( s2, s3 ) );
+
+	return _mm_packus_epi16( _mm_srli_epi16( s0, 2 ), _mm_srli_epi16( s2, 2 ) );
+}
+#endif
+
+/*
+* R_MipMapTo
+*
+* Quarters the size of the texture, the output may be the same buffer as the input
+*/
+static void R_MipMapTo( const uint8_t *in, uint8_t *out, int width, int height, int samples, int alignment ) {
 	int i, j, k;
 	int instride = ALIGN( width * samples, alignment );
 	int outwidth, outheight, outpadding;
-	uint8_t *out = in;
-	uint8_t *next;
+	const uint8_t *next;
 	int inofs;
+#ifdef QF_SSE2
+	// rows of RGBA textures are never padded, 4 output pixels are written after reading 8 input ones,
+	// so it's safe for in-place operation as well
+	const int simdwidth = ( samples == 4 ) ? ( ( width >> 1 ) & ~3 ) : 0;
+#endif
 
 	outwidth = width >> 1;
 	outheight = height >> 1;
@@ -715,7 +777,13 @@ static void R_MipMap( uint8_t *in, int width, int height, int samples, int align
 
 	for( i = 0; i < outheight; i++, in += instride * 2, out += outpadding ) {
 		next = ( ( ( i << 1 ) + 1 ) < height ) ? ( in + instride ) : in;
-		for( j = 0, inofs = 0; j < outwidth; j++, inofs += samples ) {
+		j = 0;
+#ifdef QF_SSE2
+		for( ; j < simdwidth; j += 4, out += 16 ) {
+			_mm_storeu_si128( ( __m128i * )out, R_MipMapPixels_SSE2( in + j * 8, next + j * 8 ) );
+		}
+#endif
+		for( inofs = j * samples * 2; j < outwidth; j++, inofs += samples ) {
 			if( ( ( j << 1 ) + 1 ) < width ) {
 				for( k = 0; k < samples; ++k, ++inofs )
 					*( out++ ) = ( in[inofs] + in[inofs + samples] + next[inofs] + next[inofs + samples] ) >> 2;
@@ -727,6 +795,15 @@ static void R_MipMap( uint8_t *in, int width, int height, int samples, int align
 	}
 }
 
+/*
+* R_MipMap
+*
+* Operates in place, quartering the size of the texture
+*/
+static void R_MipMap( uint8_t *in, int width, int height, int samples, int alignment ) {
+	R_MipMapTo( in, in, width, height, samples, alignment );
+}
+
 /*
 * R_MipMap16
 *
@@ -1612,6 +1689,714 @@ error: // must not be reached after actually starting uploading the texture
 	return false;
 }
 
+/*
+=================================================================
+
+IMAGE DECODING
+
+=================================================================
+*/
+
+// Decoding of image files and generation of mipmaps don't require the GL context,
+// so they are performed by the job system while loader threads are only busy with uploading.
+// Fully processed mipmap chains are stored in the cache directory and are reused
+// as long as the size and the modification time of the source file do not change.
+// The index of cache files is used for evicting least recently used files
+// once the total size of the cache exceeds r_imagecache_maxsize.
+
+#define IMAGE_CACHE_DIRECTORY   "cache/images"
+#define IMAGE_CACHE_EXTENSION   ".mips"
+#define IMAGE_CACHE_INDEX       IMAGE_CACHE_DIRECTORY "/index.txt"
+#define IMAGE_CACHE_MAGIC       "QFIC"
+#define IMAGE_CACHE_VERSION     2
+#define IMAGE_CACHE_HASH_SIZE   1024
+
+// images with these flags are assembled from several files or transformed at upload
+#define IMAGE_NODECODE_FLAGS    ( IT_CUBEMAP | IT_ARRAY | IT_3D | IT_LEFTHALF | IT_RIGHTHALF | IT_FLIPX | IT_FLIPY | IT_FLIPDIAGONAL )
+
+typedef struct {
+	char magic[4];
+	int version;
+	int64_t fileSize;                   // size of the source file
+	int64_t mtime;                      // modification time of the source file
+	int width, height, samples;         // of the source image
+	int flags;
+	int uploadWidth, uploadHeight;
+	int numMips;
+	char extension[8];                  // of the source file
+} imageCacheHeader_t;
+
+typedef struct {
+	qjobgroup_t *group;                 // NULL if the image is decoded by the loading thread
+	char *name;
+	int flags;                          // IT_LOADFLAGS may be updated by decoding
+	int minmipsize;
+	int width, height, samples;
+	int uploadWidth, uploadHeight;
+	int numMips;
+	char extension[8];
+	uint8_t *mips;                      // NULL if the image is to be loaded by R_LoadImageFromDisk
+} imageDecode_t;
+
+typedef struct {
+	std::atomic_int numDecoded;
+	std::atomic_int numCached;
+	std::atomic_int numCacheWrites;
+	std::atomic<uint64_t> decodeTime;   // in microseconds, summed for all threads
+	std::atomic<uint64_t> cacheTime;
+	uint64_t startTime;
+} imageLoadStats_t;
+
+static imageLoadStats_t r_imageLoadStats;
+
+typedef struct {
+	char *name;                         // of the cache file
+	size_t size;                        // of the cache file
+	int64_t lastUse;                    // sequence number of the last registration that used the file
+	int hashNext;
+} imageCacheEntry_t;
+
+typedef struct {
+	qmutex_t *lock;                     // entries are touched by decoding jobs
+	imageCacheEntry_t *entries;
+	int numEntries, maxEntries;
+	int hashHeads[IMAGE_CACHE_HASH_SIZE];
+	size_t totalSize;
+	int64_t sequence;
+	bool modified;
+} imageCacheIndex_t;
+
+static imageCacheIndex_t r_imageCacheIndex;
+
+/*
+* R_AllocDecodeBufferCb
+*/
+static uint8_t *R_AllocDecodeBufferCb( void *ptr, size_t size, const char *filename, int linenum ) {
+	return ( uint8_t * )_Mem_AllocExt( r_imagesPool, size, 0, 0, MEMPOOL_REFMODULE, 0, filename, linenum );
+}
+
+/*
+* R_DecodedMipCount
+*/
+static int R_DecodedMipCount( int uploadWidth, int uploadHeight, int flags, int minmipsize ) {
+	return ( flags & IT_NOMIPMAP ) ? 1 : R_MipCount( uploadWidth, uploadHeight, minmipsize );
+}
+
+/*
+* R_MipChainSize
+*/
+static size_t R_MipChainSize( int width, int height, int numMips, int samples ) {
+	int i;
+	size_t size = 0;
+
+	for( i = 0; i < numMips; i++ ) {
+		size += width * height * samples;
+		width = std::max( width >> 1, 1 );
+		height = std::max( height >> 1, 1 );
+	}
+	return size;
+}
+
+/*
+* R_ImageCacheName
+*/
+static void R_ImageCacheName( const imageDecode_t *decode, char *name, size_t name_size ) {
+	Q_snprintfz( name, name_size, IMAGE_CACHE_DIRECTORY "/%s_%x_%i" IMAGE_CACHE_EXTENSION,
+				 decode->name, decode->flags & ~IT_LOADFLAGS, decode->minmipsize );
+}
+
+/*
+* R_HashImageCacheIndex
+*/
+static void R_HashImageCacheIndex( void ) {
+	int i;
+	unsigned hash;
+	imageCacheIndex_t *index = &r_imageCacheIndex;
+
+	for( i = 0; i < IMAGE_CACHE_HASH_SIZE; i++ ) {
+		index->hashHeads[i] = -1;
+	}
+
+	index->totalSize = 0;
+	for( i = 0; i < index->numEntries; i++ ) {
+		hash = COM_SuperFastHash( ( const uint8_t * )index->entries[i].name, strlen( index->entries[i].name ), 0 ) % IMAGE_CACHE_HASH_SIZE;
+		index->entries[i].hashNext = index->hashHeads[hash];
+		index->hashHeads[hash] = i;
+		index->totalSize += index->entries[i].size;
+	}
+}
+
+/*
+* R_AddImageCacheEntry
+*
+* The index lock must be held by the caller.
+*/
+static imageCacheEntry_t *R_AddImageCacheEntry( const char *name ) {
+	imageCacheIndex_t *index = &r_imageCacheIndex;
+	imageCacheEntry_t *entry;
+	const size_t len = strlen( name );
+	const unsigned hash = COM_SuperFastHash( ( const uint8_t * )name, len, 0 ) % IMAGE_CACHE_HASH_SIZE;
+	int i;
+
+	for( i = index->hashHeads[hash]; i >= 0; i = index->entries[i].hashNext ) {
+		if( !strcmp( index->entries[i].name, name ) ) {
+			return &index->entries[i];
+		}
+	}
+
+	if( index->numEntries == index->maxEntries ) {
+		index->maxEntries = index->maxEntries ? index->maxEntries * 2 : 256;
+		if( index->entries ) {
+			index->entries = ( imageCacheEntry_t * )R_Realloc( index->entries, index->maxEntries * sizeof( *index->entries ) );
+		} else {
+			index->entries = ( imageCacheEntry_t * )R_MallocExt( r_imagesPool, index->maxEntries * sizeof( *index->entries ), 0, 0 );
+		}
+	}
+
+	entry = &index->entries[index->numEntries];
+	entry->name = R_CopyString( name );
+	entry->size = 0;
+	entry->lastUse = 0;
+	entry->hashNext = index->hashHeads[hash];
+	index->hashHeads[hash] = index->numEntries++;
+	return entry;
+}
+
+/*
+* R_TouchImageCacheEntry
+*/
+static void R_TouchImageCacheEntry( const char *name, size_t size ) {
+	imageCacheIndex_t *index = &r_imageCacheIndex;
+	imageCacheEntry_t *entry;
+
+	QMutex_Lock( index->lock );
+	entry = R_AddImageCacheEntry( name );
+	index->totalSize += size - entry->size;
+	entry->size = size;
+	entry->lastUse = index->sequence;
+	index->modified = true;
+	QMutex_Unlock( index->lock );
+}
+
+/*
+* R_LoadImageCacheIndex
+*
+* Every line of the index file but the first one (the registration sequence number)
+* is "<last use> <size> <cache file name>".
+*/
+static void R_LoadImageCacheIndex( void ) {
+	imageCacheIndex_t *index = &r_imageCacheIndex;
+	char *buffer, *line, *next, *name;
+	long long lastUse, size;
+	int i;
+
+	memset( index, 0, sizeof( *index ) );
+	index->lock = QMutex_Create();
+	for( i = 0; i < IMAGE_CACHE_HASH_SIZE; i++ ) {
+		index->hashHeads[i] = -1;
+	}
+
+	if( R_LoadCacheFile( IMAGE_CACHE_INDEX, ( void ** )&buffer ) < 0 || !buffer ) {
+		return;
+	}
+
+	for( line = buffer; line && *line; line = next ) {
+		next = strchr( line, '\n' );
+		if( next ) {
+			*next++ = '\0';
+		}
+
+		if( line == buffer ) {
+			index->sequence = atoll( line );
+			continue;
+		}
+
+		if( sscanf( line, "%lld %lld", &lastUse, &size ) != 2 || size < 0 ) {
+			continue;
+		}
+		name = strchr( line, ' ' );
+		name = name ? strchr( name + 1, ' ' ) : NULL;
+		if( !name || !*++name ) {
+			continue;
+		}
+
+		imageCacheEntry_t *entry = R_AddImageCacheEntry( name );
+		entry->size = (size_t)size;
+		entry->lastUse = (int64_t)lastUse;
+	}
+
+	R_FreeFile( buffer );
+
+	R_HashImageCacheIndex();
+
+	// entries touched by this session are newer than all loaded ones
+	index->sequence++;
+}
+
+/*
+* R_WriteImageCacheIndex
+*/
+static void R_WriteImageCacheIndex( void ) {
+	int i, filenum;
+	imageCacheIndex_t *index = &r_imageCacheIndex;
+
+	if( !index->modified ) {
+		return;
+	}
+
+	if( FS_FOpenFile( IMAGE_CACHE_INDEX, &filenum, FS_WRITE | FS_CACHE ) == -1 ) {
+		Com_DPrintf( S_COLOR_YELLOW "Could not open %s for writing.\n", IMAGE_CACHE_INDEX );
+		return;
+	}
+
+	FS_Printf( filenum, "%lld\n", (long long)index->sequence );
+	for( i = 0; i < index->numEntries; i++ ) {
+		const imageCacheEntry_t *entry = &index->entries[i];
+		FS_Printf( filenum, "%lld %lld %s\n", (long long)entry->lastUse, (long long)entry->size, entry->name );
+	}
+
+	FS_FCloseFile( filenum );
+
+	index->modified = false;
+}
+
+/*
+* R_CompareImageCacheEntries
+*/
+static int R_CompareImageCacheEntries( const void *p1, const void *p2 ) {
+	const imageCacheEntry_t *e1 = ( const imageCacheEntry_t * )p1, *e2 = ( const imageCacheEntry_t * )p2;
+
+	// most recently used ones go first
+	if( e1->lastUse != e2->lastUse ) {
+		return e1->lastUse > e2->lastUse ? -1 : 1;
+	}
+	return 0;
+}
+
+/*
+* R_TrimImageCache
+*
+* Removes least recently used cache files until the total size of the cache fits r_imagecache_maxsize.
+* Must not be called while images are being decoded.
+*/
+void R_TrimImageCache( void ) {
+	int i, numKept;
+	size_t maxSize, keptSize;
+	imageCacheIndex_t *index = &r_imageCacheIndex;
+
+	if( !index->lock ) {
+		return;
+	}
+
+	QMutex_Lock( index->lock );
+
+	maxSize = (size_t)std::max( r_imagecache_maxsize->integer, 0 ) * 1024 * 1024;
+	if( index->totalSize > maxSize ) {
+		qsort( index->entries, index->numEntries, sizeof( *index->entries ), R_CompareImageCacheEntries );
+
+		// keep the most recently used files that fit the limit
+		numKept = 0;
+		keptSize = 0;
+		for( i = 0; i < index->numEntries; i++ ) {
+			imageCacheEntry_t *entry = &index->entries[i];
+			if( keptSize + entry->size <= maxSize ) {
+				keptSize += entry->size;
+				index->entries[numKept++] = *entry;
+				continue;
+			}
+
+			FS_RemoveAbsoluteFile( va( "%s/%s/%s", FS_CacheDirectory(), FS_GameDirectory(), entry->name ) );
+			R_Free( entry->name );
+		}
+
+		index->numEntries = numKept;
+		index->modified = true;
+
+		R_HashImageCacheIndex();
+	}
+
+	R_WriteImageCacheIndex();
+
+	// files used by the next registration are going to be newer
+	index->sequence++;
+
+	QMutex_Unlock( index->lock );
+}
+
+/*
+* R_ShutdownImageCacheIndex
+*/
+static void R_ShutdownImageCacheIndex( void ) {
+	int i;
+	imageCacheIndex_t *index = &r_imageCacheIndex;
+
+	if( !index->lock ) {
+		return;
+	}
+
+	R_WriteImageCacheIndex();
+
+	for( i = 0; i < index->numEntries; i++ ) {
+		R_Free( index->entries[i].name );
+	}
+	if( index->entries ) {
+		R_Free( index->entries );
+	}
+
+	QMutex_Destroy( &index->lock );
+
+	memset( index, 0, sizeof( *index ) );
+}
+
+/*
+* R_ReadImageCache
+*/
+static bool R_ReadImageCache( imageDecode_t *decode, const char *extension, int64_t fileSize, int64_t mtime ) {
+	char name[1024];
+	int filenum, length;
+	int uploadWidth, uploadHeight, numMips;
+	size_t size;
+	imageCacheHeader_t header;
+
+	R_ImageCacheName( decode, name, sizeof( name ) );
+
+	length = FS_FOpenFile( name, &filenum, FS_READ | FS_CACHE );
+	if( length == -1 ) {
+		return false;
+	}
+
+	if( FS_Read( &header, sizeof( header ), filenum ) != sizeof( header ) ) {
+		goto error;
+	}
+	if( memcmp( header.magic, IMAGE_CACHE_MAGIC, sizeof( header.magic ) ) || header.version != IMAGE_CACHE_VERSION ) {
+		goto error;
+	}
+	if( header.fileSize != fileSize || header.mtime != mtime ) {
+		goto error;
+	}
+	// the source might have been replaced by a file of another format
+	header.extension[sizeof( header.extension ) - 1] = '\0';
+	if( Q_stricmp( header.extension, extension ) ) {
+		goto error;
+	}
+	if( ( header.flags & IT_BGRA ) && !glConfig.ext.bgra ) {
+		goto error;
+	}
+
+	// picmip or the maximum texture size might have changed since the file was written
+	R_ScaledImageSize( header.width, header.height, &uploadWidth, &uploadHeight, decode->flags, 1, decode->minmipsize, false );
+	numMips = R_DecodedMipCount( uploadWidth, uploadHeight, decode->flags, decode->minmipsize );
+	if( header.uploadWidth != uploadWidth || header.uploadHeight != uploadHeight || header.numMips != numMips ) {
+		goto error;
+	}
+
+	size = R_MipChainSize( uploadWidth, uploadHeight, numMips, header.samples );
+	if( (size_t)length != sizeof( header ) + size ) {
+		goto error;
+	}
+
+	decode->mips = ( uint8_t * )R_MallocExt( r_imagesPool, size, 0, 0 );
+	if( FS_Read( decode->mips, size, filenum ) != (int)size ) {
+		R_Free( decode->mips );
+		decode->mips = NULL;
+		goto error;
+	}
+
+	decode->flags = ( decode->flags & ~IT_LOADFLAGS ) | ( header.flags & IT_LOADFLAGS );
+	decode->width = header.width;
+	decode->height = header.height;
+	decode->samples = header.samples;
+	decode->uploadWidth = uploadWidth;
+	decode->uploadHeight = uploadHeight;
+	decode->numMips = numMips;
+	Q_strncpyz( decode->extension, header.extension, sizeof( decode->extension ) );
+
+	FS_FCloseFile( filenum );
+
+	R_TouchImageCacheEntry( name, (size_t)length );
+	return true;
+
+error:
+	FS_FCloseFile( filenum );
+	return false;
+}
+
+/*
+* R_WriteImageCache
+*/
+static void R_WriteImageCache( const imageDecode_t *decode, int64_t fileSize, int64_t mtime ) {
+	char name[1024];
+	int filenum;
+	size_t size;
+	imageCacheHeader_t header;
+
+	R_ImageCacheName( decode, name, sizeof( name ) );
+
+	if( FS_FOpenFile( name, &filenum, FS_WRITE | FS_CACHE ) == -1 ) {
+		Com_DPrintf( S_COLOR_YELLOW "Could not open %s for writing.\n", name );
+		return;
+	}
+
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, IMAGE_CACHE_MAGIC, sizeof( header.magic ) );
+	header.version = IMAGE_CACHE_VERSION;
+	header.fileSize = fileSize;
+	header.mtime = mtime;
+	header.width = decode->width;
+	header.height = decode->height;
+	header.samples = decode->samples;
+	header.flags = decode->flags & IT_LOADFLAGS;
+	header.uploadWidth = decode->uploadWidth;
+	header.uploadHeight = decode->uploadHeight;
+	header.numMips = decode->numMips;
+	Q_strncpyz( header.extension, decode->extension, sizeof( header.extension ) );
+
+	size = R_MipChainSize( decode->uploadWidth, decode->uploadHeight, decode->numMips, decode->samples );
+	FS_Write( &header, sizeof( header ), filenum );
+	FS_Write( decode->mips, size, filenum );
+	FS_FCloseFile( filenum );
+
+	R_TouchImageCacheEntry( name, sizeof( header ) + size );
+
+	r_imageLoadStats.numCacheWrites.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/*
+* R_BuildMipChain
+*
+* Scales the image exactly the same way R_Upload32 does and stores all mipmap levels
+* in a single buffer, one after another, with unpack alignment of 1.
+*/
+static void R_BuildMipChain( imageDecode_t *decode, const uint8_t *pic, int width, int height, int samples ) {
+	int i, w, h;
+	uint8_t *mip, *next;
+	unsigned *lineBuf = NULL;
+
+	R_ScaledImageSize( width, height, &w, &h, decode->flags, 1, decode->minmipsize, false );
+
+	decode->width = width;
+	decode->height = height;
+	decode->samples = samples;
+	decode->uploadWidth = w;
+	decode->uploadHeight = h;
+	decode->numMips = R_DecodedMipCount( w, h, decode->flags, decode->minmipsize );
+	decode->mips = ( uint8_t * )R_MallocExt( r_imagesPool, R_MipChainSize( w, h, decode->numMips, samples ), 0, 0 );
+
+	if( w != width || h != height ) {
+		lineBuf = ( unsigned * )R_MallocExt( r_imagesPool, w * sizeof( *lineBuf ) * 2, 0, 0 );
+	}
+	R_ResampleTextureExt( pic, width, height, decode->mips, w, h, samples, 1, lineBuf );
+	if( lineBuf ) {
+		R_Free( lineBuf );
+	}
+
+	for( i = 1, mip = decode->mips; i < decode->numMips; i++, mip = next ) {
+		next = mip + w * h * samples;
+		R_MipMapTo( mip, next, w, h, samples, 1 );
+		w = std::max( w >> 1, 1 );
+		h = std::max( h >> 1, 1 );
+	}
+}
+
+/*
+* R_DecodeImage
+*
+* Reads the image from the cache or decodes the source file and builds the mipmap chain.
+* Doesn't touch the GL state, so may be called by any thread.
+*/
+static bool R_DecodeImage( imageDecode_t *decode ) {
+	char pathname[1024];
+	size_t len = strlen( decode->name );
+	const char *extension;
+	uint8_t *pic;
+	int width, height, samples;
+	int64_t fileSize = 0, mtime = 0;
+	bool cache = r_imagecache->integer != 0;
+	uint64_t startTime = Sys_Microseconds();
+
+	if( len >= sizeof( pathname ) - 7 ) {
+		return false;
+	}
+
+	memcpy( pathname, decode->name, len + 1 );
+
+	// KTX files are uploaded as is by R_LoadImageFromDisk
+	Q_strncatz( pathname, ".ktx", sizeof( pathname ) );
+	if( FS_FOpenFile( pathname, NULL, FS_READ ) != -1 ) {
+		return false;
+	}
+	pathname[len] = 0;
+
+	Q_strncatz( pathname, ".tga", sizeof( pathname ) );
+	extension = FS_FirstExtension( pathname, IMAGE_EXTENSIONS, NUM_IMAGE_EXTENSIONS - 1 );
+	if( !extension ) {
+		return false;
+	}
+	COM_ReplaceExtension( pathname, extension, sizeof( pathname ) );
+
+	if( cache ) {
+		// don't read the source file just for validating the cache
+		fileSize = FS_FOpenFile( pathname, NULL, FS_READ );
+		mtime = (int64_t)FS_FileMTime( pathname );
+
+		if( R_ReadImageCache( decode, extension, fileSize, mtime ) ) {
+			r_imageLoadStats.numCached.fetch_add( 1, std::memory_order_relaxed );
+			r_imageLoadStats.cacheTime.fetch_add( Sys_Microseconds() - startTime, std::memory_order_relaxed );
+			return true;
+		}
+	}
+
+	samples = R_ReadImageFromDiskExt( pathname, sizeof( pathname ), &pic, &width, &height, &decode->flags,
+									  R_AllocDecodeBufferCb, NULL );
+	if( !pic ) {
+		return false;
+	}
+
+	R_BuildMipChain( decode, pic, width, height, samples );
+	R_Free( pic );
+
+	Q_strncpyz( decode->extension, extension, sizeof( decode->extension ) );
+
+	r_imageLoadStats.numDecoded.fetch_add( 1, std::memory_order_relaxed );
+	r_imageLoadStats.decodeTime.fetch_add( Sys_Microseconds() - startTime, std::memory_order_relaxed );
+
+	if( cache ) {
+		R_WriteImageCache( decode, fileSize, mtime );
+	}
+
+	return true;
+}
+
+/*
+* R_DecodeImageJob
+*/
+static void R_DecodeImageJob( unsigned first, unsigned items, void *arg ) {
+	R_DecodeImage( *( imageDecode_t ** )arg );
+}
+
+/*
+* R_AllocImageDecode
+*/
+static imageDecode_t *R_AllocImageDecode( const image_t *image ) {
+	size_t nameSize = strlen( image->name ) + 1;
+	auto *decode = ( imageDecode_t * )R_MallocExt( r_imagesPool, sizeof( imageDecode_t ) + nameSize, 0, 1 );
+
+	// the image may be freed before the job is executed
+	decode->name = ( char * )( decode + 1 );
+	memcpy( decode->name, image->name, nameSize );
+	decode->flags = image->flags;
+	decode->minmipsize = image->minmipsize;
+	return decode;
+}
+
+/*
+* R_FreeImageDecode
+*/
+static void R_FreeImageDecode( imageDecode_t *decode ) {
+	if( decode->group ) {
+		QJobGroup_Destroy( &decode->group );
+	}
+	if( decode->mips ) {
+		R_Free( decode->mips );
+	}
+	R_Free( decode );
+}
+
+/*
+* R_UploadDecodedImage
+*/
+static void R_UploadDecodedImage( int ctx, image_t *image, const imageDecode_t *decode ) {
+	int i, w, h;
+	int target, comp, format, type;
+	const uint8_t *mip;
+
+	R_BindImage( image );
+
+	R_TextureTarget( decode->flags, &target );
+
+	R_TextureFormat( decode->flags, decode->samples, &comp, &format, &type );
+
+	R_SetupTexParameters( decode->flags, decode->uploadWidth, decode->uploadHeight, decode->minmipsize );
+
+	R_UnpackAlignment( ctx, 1 );
+
+	w = decode->uploadWidth;
+	h = decode->uploadHeight;
+	for( i = 0, mip = decode->mips; i < decode->numMips; i++, mip += w * h * decode->samples ) {
+		if( i ) {
+			w = std::max( w >> 1, 1 );
+			h = std::max( h >> 1, 1 );
+		}
+		qglTexImage2D( target, i, comp, w, h, 0, format, type, mip );
+	}
+
+	image->width = decode->width;
+	image->height = decode->height;
+	image->samples = decode->samples;
+	image->upload_width = decode->uploadWidth;
+	image->upload_height = decode->uploadHeight;
+	image->flags = decode->flags;
+	Q_strncpyz( image->extension, decode->extension, sizeof( image->extension ) );
+
+	R_DeferDataSync();
+}
+
+/*
+* R_LoadDecodedImage
+*
+* Falls back to R_LoadImageFromDisk if the image couldn't be decoded in advance.
+*/
+static bool R_LoadDecodedImage( int ctx, image_t *image, imageDecode_t *decode ) {
+	if( decode->group ) {
+		// help with decoding while waiting
+		QJobGroup_Wait( decode->group );
+	}
+
+	if( !decode->mips ) {
+		return R_LoadImageFromDisk( ctx, image );
+	}
+
+	R_UploadDecodedImage( ctx, image, decode );
+	return true;
+}
+
+/*
+* R_ResetImageLoadStats
+*/
+void R_ResetImageLoadStats( void ) {
+	imageLoadStats_t *stats = &r_imageLoadStats;
+
+	stats->numDecoded = 0;
+	stats->numCached = 0;
+	stats->numCacheWrites = 0;
+	stats->decodeTime = 0;
+	stats->cacheTime = 0;
+	stats->startTime = Sys_Microseconds();
+}
+
+/*
+* R_PrintImageLoadStats
+*
+* Waits for all pending images to be decoded and uploaded.
+*/
+void R_PrintImageLoadStats( void ) {
+	imageLoadStats_t *stats = &r_imageLoadStats;
+	int numDecoded, numCached;
+
+	R_FinishLoadingImages();
+
+	numDecoded = stats->numDecoded;
+	numCached = stats->numCached;
+
+	if( numDecoded || numCached ) {
+		Com_Printf( "Images: %i decoded in %.1f ms, %i read from cache in %.1f ms, %i cache files written, %.1f ms elapsed\n",
+					numDecoded, stats->decodeTime / 1000.0, numCached, stats->cacheTime / 1000.0,
+					(int)stats->numCacheWrites, ( Sys_Microseconds() - stats->startTime ) / 1000.0 );
+	}
+
+	R_ResetImageLoadStats();
+}
+
 /*
 * R_LoadImageFromDisk
 */
@@ -2070,7 +2855,15 @@ image_t *R_FindImage( const char *name, const char *suffix, int flags, int minmi
 		}
 	}
 
-	loaded = R_LoadImageFromDisk( QGL_CONTEXT_MAIN, image );
+	if( !( image->flags & IMAGE_NODECODE_FLAGS ) ) {
+		imageDecode_t *decode = R_AllocImageDecode( image );
+
+		R_DecodeImage( decode );
+		loaded = R_LoadDecodedImage( QGL_CONTEXT_MAIN, image, decode );
+		R_FreeImageDecode( decode );
+	} else {
+		loaded = R_LoadImageFromDisk( QGL_CONTEXT_MAIN, image );
+	}
 	R_UnbindImage( image );
 
 	if( !loaded ) {
@@ -2775,6 +3568,8 @@ void R_InitImages( void ) {
 	r_imagesPool = R_AllocPool( r_mempool, "Images" );
 	r_imagesLock = QMutex_Create();
 
+	R_LoadImageCacheIndex();
+
 	r_unpackAlignment[QGL_CONTEXT_MAIN] = 4;
 	qglPixelStorei( GL_PACK_ALIGNMENT, 1 );
 
@@ -2905,6 +3700,8 @@ void R_ShutdownImages( void ) {
 	}
 	r_8to24table[0] = r_8to24table[1] = NULL;
 
+	R_ShutdownImageCacheIndex();
+
 	QMutex_Destroy( &r_imagesLock );
 
 	R_FreePool( &r_imagesPool );
@@ -2928,6 +3725,7 @@ enum {
 	CMD_LOADER_SHUTDOWN,
 	CMD_LOADER_LOAD_PIC,
 	CMD_LOADER_DATA_SYNC,
+	CMD_LOADER_UPLOAD_PIC,
 
 	NUM_LOADER_CMDS
 };
@@ -2943,6 +3741,13 @@ typedef struct {
 	int pic;
 } loaderPicCmd_t;
 
+typedef struct {
+	int id;
+	int self;
+	int pic;
+	imageDecode_t *decode;
+} loaderUploadPicCmd_t;
+
 typedef unsigned (*queueCmdHandler_t)( const void * );
 
 static qbufPipe_t *loader_queue[NUM_LOADER_THREADS] = { NULL };
@@ -2983,6 +3788,18 @@ static void R_IssueLoadPicLoaderCmd( int id, int pic ) {
 	QBufPipe_WriteCmd( loader_queue[id], &cmd, sizeof( cmd ) );
 }
 
+/*
+* R_IssueUploadPicLoaderCmd
+*/
+static void R_IssueUploadPicLoaderCmd( int id, int pic, imageDecode_t *decode ) {
+	loaderUploadPicCmd_t cmd;
+	cmd.id = CMD_LOADER_UPLOAD_PIC;
+	cmd.self = id;
+	cmd.pic = pic;
+	cmd.decode = decode;
+	QBufPipe_WriteCmd( loader_queue[id], &cmd, sizeof( cmd ) );
+}
+
 /*
 * R_IssueDataSyncLoaderCmd
 */
@@ -3040,6 +3857,7 @@ void R_FinishLoadingImages( void ) {
 static bool R_LoadAsyncImageFromDisk( image_t *image ) {
 	int pic;
 	int id;
+	imageDecode_t *decode;
 
 	if( loader_gl_context[0] == NULL ) {
 		return false;
@@ -3061,7 +3879,17 @@ static bool R_LoadAsyncImageFromDisk( image_t *image ) {
 	R_UnbindImage( image );
 	qglFinish();
 
-	R_IssueLoadPicLoaderCmd( id, pic );
+	if( image->flags & IMAGE_NODECODE_FLAGS ) {
+		R_IssueLoadPicLoaderCmd( id, pic );
+		return true;
+	}
+
+	// decode on the job system, the loader thread picks up the result in the order of issued commands
+	decode = R_AllocImageDecode( image );
+	decode->group = QJobGroup_Create();
+	QJobGroup_AddJob( decode->group, R_DecodeImageJob, &decode, sizeof( decode ) );
+
+	R_IssueUploadPicLoaderCmd( id, pic, decode );
 	return true;
 }
 
@@ -3114,14 +3942,9 @@ static unsigned R_HandleShutdownLoaderCmd( void *pcmd ) {
 }
 
 /*
-* R_HandleLoadPicLoaderCmd
+* R_FinishLoaderPic
 */
-static unsigned R_HandleLoadPicLoaderCmd( void *pcmd ) {
-	auto *cmd = (loaderPicCmd_t *)pcmd;
-	image_t *image = r_images + cmd->pic;
-	bool loaded;
-
-	loaded = R_LoadImageFromDisk( QGL_CONTEXT_LOADER + cmd->self, image );
+static void R_FinishLoaderPic( image_t *image, bool loaded ) {
 	R_UnbindImage( image );
 
 	if( !loaded ) {
@@ -3136,6 +3959,29 @@ static unsigned R_HandleLoadPicLoaderCmd( void *pcmd ) {
 		}
 		image->loaded = true;
 	}
+}
+
+/*
+* R_HandleLoadPicLoaderCmd
+*/
+static unsigned R_HandleLoadPicLoaderCmd( void *pcmd ) {
+	auto *cmd = (loaderPicCmd_t *)pcmd;
+	image_t *image = r_images + cmd->pic;
+
+	R_FinishLoaderPic( image, R_LoadImageFromDisk( QGL_CONTEXT_LOADER + cmd->self, image ) );
+
+	return sizeof( *cmd );
+}
+
+/*
+* R_HandleUploadPicLoaderCmd
+*/
+static unsigned R_HandleUploadPicLoaderCmd( void *pcmd ) {
+	auto *cmd = (loaderUploadPicCmd_t *)pcmd;
+	image_t *image = r_images + cmd->pic;
+
+	R_FinishLoaderPic( image, R_LoadDecodedImage( QGL_CONTEXT_LOADER + cmd->self, image, cmd->decode ) );
+	R_FreeImageDecode( cmd->decode );
 
 	return sizeof( *cmd );
 }
@@ -3169,6 +4015,7 @@ static void *R_ImageLoaderThreadProc( void *param ) {
 		(queueCmdHandler_t)R_HandleShutdownLoaderCmd,
 		(queueCmdHandler_t)R_HandleLoadPicLoaderCmd,
 		(queueCmdHandler_t)R_HandleDataSyncLoaderCmd,
+		(queueCmdHandler_t)R_HandleUploadPicLoaderCmd,
 	};
 
 	QBufPipe_Wait( cmdQueue, R_ImageLoaderCmdsWaiter, cmdHandlers, Q_THREADS_WAIT_INFINITE );
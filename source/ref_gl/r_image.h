@@ -112,6 +112,9 @@ image_t *R_GetPortalTexture( int viewportWidth, int viewportHeight, int flags, u
 image_t *R_GetShadowmapTexture( int id, int viewportWidth, int viewportHeight, int flags );
 void R_InitDrawFlatTexture( void );
 void R_FreeImageBuffers( void );
+void R_ResetImageLoadStats( void );
+void R_PrintImageLoadStats( void );
+void R_TrimImageCache( void );
 
 void R_PrintImageList( const char *pattern, bool ( *filter )( const char *filter, const char *value ) );
 void R_ScreenShot( const char *filename, int x, int y, int width, int height, int quality,
@@ -427,6 +427,7 @@ typedef struct {
 		unsigned int t_add_world_surfs;
 		unsigned int t_add_polys, t_add_entities;
 		unsigned int t_draw_meshes;
+		unsigned int t_sort_draw_surfs;     // in microseconds
 	} stats;
 
 	struct {
@@ -539,6 +540,8 @@ extern cvar_t *r_gamma;
 extern cvar_t *r_texturemode;
 extern cvar_t *r_texturefilter;
 extern cvar_t *r_texturecompression;
+extern cvar_t *r_imagecache;
+extern cvar_t *r_imagecache_maxsize;
 extern cvar_t *r_mode;
 extern cvar_t *r_nobind;
 extern cvar_t *r_picmip;
@@ -627,6 +630,7 @@ void        R_ShaderDump_f( void );
 void        R_SetupFrustum( const refdef_t *rd, float farClip, cplane_t *frustum );
 bool    R_CullBox( const vec3_t mins, const vec3_t maxs, const unsigned int clipflags );
 bool    R_CullSphere( const vec3_t centre, const float radius, const unsigned int clipflags );
+unsigned    R_CullBounds( const mcullbounds_t *bounds, unsigned first, unsigned count, unsigned clipflags, unsigned *partial );
 bool    R_VisCullBox( const vec3_t mins, const vec3_t maxs );
 bool    R_VisCullSphere( const vec3_t origin, float radius );
 int         R_CullModelEntity( const entity_t *e, vec3_t mins, vec3_t maxs, float radius, bool sphereCull, bool pvsCull );
@@ -901,6 +905,18 @@ bool        R_SkeletalModelLerpTag( orientation_t *orient, const mskmodel_t *skm
 void        R_InitSkeletalCache( void );
 void        R_ClearSkeletalCache( void );
 void        R_ShutdownSkeletalCache( void );
+#ifndef PUBLIC_BUILD
+void        R_SkeletalBench_f( void );
+#endif
+
+#ifdef QF_SSE2
+// r_skm_avx.c: compiled with AVX code generation enabled, must be called only if the CPU supports AVX
+void        R_SkeletalBlendPoses_AVX( unsigned int numblends, mskblend_t *blends, unsigned int numbones, mat4_t *relbonepose );
+void        R_SkeletalTransformVerts_AVX( int numverts, const unsigned int *blends, mat4_t *relbonepose, const vec_t *v, vec_t *ov );
+void        R_SkeletalTransformNormals_AVX( int numverts, const unsigned int *blends, mat4_t *relbonepose, const vec_t *v, vec_t *ov );
+void        R_SkeletalTransformNormalsAndSVecs_AVX( int numverts, const unsigned int *blends, mat4_t *relbonepose,
+													const vec_t *v, vec_t *ov, const vec_t *sv, vec_t *osv );
+#endif
 
 //
 // r_vbo.c
@@ -1458,10 +1458,12 @@ const char *R_WriteSpeedsMessage( char *out, size_t size ) {
 				Q_snprintfz( out, size,
 							 "cull nodes\\surfs: %5u\\%5u\n"
 							 "node: %5u\n"
-							 "polys\\ents: %5u\\%5u  draw: %5u\n",
+							 "polys\\ents: %5u\\%5u  draw: %5u\n"
+							 "sort: %5u us\n",
 							 rf.stats.t_cull_world_nodes, rf.stats.t_cull_world_surfs, 
 							 rf.stats.t_world_node,
-							 rf.stats.t_add_polys, rf.stats.t_add_entities, rf.stats.t_draw_meshes
+							 rf.stats.t_add_polys, rf.stats.t_add_entities, rf.stats.t_draw_meshes,
+							 rf.stats.t_sort_draw_surfs
 							 );
 				break;
 			case 4:
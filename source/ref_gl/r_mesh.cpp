@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // r_mesh.c: transformation and sorting
 
 #include "r_local.h"
+#include "../qcommon/qcommon.h"
 
 #include <algorithm>
 
@@ -82,7 +83,13 @@ static void R_ReserveDrawSurfaces( drawList_t *list, int minMeshes ) {
 		R_Free( ds );
 	}
 
+	// the scratch buffer contents are not preserved between sorts
+	if( list->sortScratch ) {
+		R_Free( list->sortScratch );
+	}
+
 	list->drawSurfs = newDs;
+	list->sortScratch = (sortedDrawSurf_t *)R_Malloc( newSize * sizeof( sortedDrawSurf_t ) );
 	list->maxDrawSurfs = newSize;
 }
 
@@ -238,42 +245,166 @@ portalSurface_t *R_GetDrawListSurfPortal( void *psds ) {
 	return portalNum >= 0 ? rn.portalSurfaces + portalNum : NULL;
 }
 
+#define R_SORT_RADIX_BITS           8
+#define R_SORT_RADIX_SIZE           ( 1 << R_SORT_RADIX_BITS )
+#define R_SORT_NUM_PASSES           ( 64 / R_SORT_RADIX_BITS )
+#define R_SORT_MIN_RADIX_SURFS      64      // smaller lists are sorted by comparison
+#define R_SORT_PARALLEL_CHUNK_SIZE  4096    // lists of at least 2 chunks are histogrammed in parallel
+#define R_SORT_MAX_CHUNKS           16
+
+typedef unsigned sortHistogram_t[R_SORT_NUM_PASSES][R_SORT_RADIX_SIZE];
+
+static sortHistogram_t r_sortHistograms[R_SORT_MAX_CHUNKS];
+
+/*
+* R_DrawSurfKey
+*
+* The distance key takes precedence over the sort key.
+*/
+static inline uint64_t R_DrawSurfKey( const sortedDrawSurf_t *sds ) {
+	return ( (uint64_t)sds->distKey << 32 ) | sds->sortKey;
+}
+
 /*
-* R_DrawSurfCompare
+* R_BuildDrawSurfHistogram
 *
-* Comparison callback function for R_SortDrawList
+* Counts occurrences of every digit of keys for all radix sort passes at once.
 */
-static int R_DrawSurfCompare( const sortedDrawSurf_t *sbs1, const sortedDrawSurf_t *sbs2 ) {
-	if( sbs1->distKey > sbs2->distKey ) {
-		return 1;
+static void R_BuildDrawSurfHistogram( const sortedDrawSurf_t *surfs, unsigned numSurfs, sortHistogram_t hist ) {
+	unsigned i, pass;
+	uint64_t key;
+
+	memset( hist, 0, sizeof( sortHistogram_t ) );
+
+	for( i = 0; i < numSurfs; i++ ) {
+		key = R_DrawSurfKey( &surfs[i] );
+		for( pass = 0; pass < R_SORT_NUM_PASSES; pass++ ) {
+			hist[pass][( key >> ( pass * R_SORT_RADIX_BITS ) ) & ( R_SORT_RADIX_SIZE - 1 )]++;
+		}
 	}
-	if( sbs2->distKey > sbs1->distKey ) {
-		return -1;
+}
+
+/*
+* R_BuildDrawSurfHistogramJob
+*/
+static void R_BuildDrawSurfHistogramJob( unsigned first, unsigned items, jobarg_t *arg ) {
+	unsigned chunk, start, end;
+	const unsigned numSurfs = arg->uarg;
+	const unsigned numChunks = (unsigned)arg->iarg;
+	const sortedDrawSurf_t *surfs = (const sortedDrawSurf_t *)arg->parg;
+
+	for( chunk = first; chunk < first + items; chunk++ ) {
+		start = (unsigned)( (uint64_t)numSurfs * chunk / numChunks );
+		end = (unsigned)( (uint64_t)numSurfs * ( chunk + 1 ) / numChunks );
+		R_BuildDrawSurfHistogram( surfs + start, end - start, r_sortHistograms[chunk] );
 	}
+}
 
-	if( sbs1->sortKey > sbs2->sortKey ) {
-		return 1;
+/*
+* R_RadixSortDrawSurfs
+*
+* LSD radix sort on 64-bit keys composed of the distance and the sort key.
+* Returns the buffer that holds the sorted surfaces, that is either surfs or scratch.
+*/
+static sortedDrawSurf_t *R_RadixSortDrawSurfs( sortedDrawSurf_t *surfs, sortedDrawSurf_t *scratch, unsigned numSurfs ) {
+	unsigned i, pass, chunk, numChunks, digit, offset, count;
+	unsigned *hist;
+	uint64_t firstKey;
+	sortedDrawSurf_t *src, *dst, *tmp;
+
+	numChunks = std::min( numSurfs / R_SORT_PARALLEL_CHUNK_SIZE, (unsigned)R_SORT_MAX_CHUNKS );
+	if( numChunks > 1 ) {
+		jobarg_t arg;
+
+		arg.iarg = (int)numChunks;
+		arg.uarg = numSurfs;
+		arg.parg = surfs;
+		RJ_ScheduleJob( R_BuildDrawSurfHistogramJob, &arg, numChunks );
+		RJ_FinishJobs();
+
+		for( chunk = 1; chunk < numChunks; chunk++ ) {
+			for( pass = 0; pass < R_SORT_NUM_PASSES; pass++ ) {
+				for( digit = 0; digit < R_SORT_RADIX_SIZE; digit++ ) {
+					r_sortHistograms[0][pass][digit] += r_sortHistograms[chunk][pass][digit];
+				}
+			}
+		}
+	} else {
+		R_BuildDrawSurfHistogram( surfs, numSurfs, r_sortHistograms[0] );
 	}
-	if( sbs2->sortKey > sbs1->sortKey ) {
-		return -1;
+
+	src = surfs;
+	dst = scratch;
+	firstKey = R_DrawSurfKey( surfs );
+
+	for( pass = 0; pass < R_SORT_NUM_PASSES; pass++ ) {
+		const unsigned shift = pass * R_SORT_RADIX_BITS;
+
+		hist = r_sortHistograms[0][pass];
+
+		// skip the pass if all keys share the digit, which is common for upper bits of the distance
+		// and fog or portal bits of the sort key
+		if( hist[( firstKey >> shift ) & ( R_SORT_RADIX_SIZE - 1 )] == numSurfs ) {
+			continue;
+		}
+
+		// turn counts into offsets
+		for( digit = 0, offset = 0; digit < R_SORT_RADIX_SIZE; digit++ ) {
+			count = hist[digit];
+			hist[digit] = offset;
+			offset += count;
+		}
+
+		for( i = 0; i < numSurfs; i++ ) {
+			digit = ( R_DrawSurfKey( &src[i] ) >> shift ) & ( R_SORT_RADIX_SIZE - 1 );
+			dst[hist[digit]++] = src[i];
+		}
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
 	}
 
-	return 0;
+	return src;
 }
 
 /*
 * R_SortDrawList
 *
-* Regular quicksort. Note that for all kinds of transparent meshes
-* you probably want to set distance or draw order to prevent flickering
-* due to quicksort's unstable nature.
+* The sort is stable, so surfaces of equal keys are drawn in the order they were added.
+* Note that for all kinds of transparent meshes you probably want to set distance
+* or draw order anyway as the order of adding is not guaranteed to be persistent.
 */
 void R_SortDrawList( drawList_t *list ) {
+	uint64_t usec = 0;
+	sortedDrawSurf_t *sorted;
+
 	if( r_draworder->integer ) {
 		return;
 	}
-	qsort( list->drawSurfs, list->numDrawSurfs, sizeof( sortedDrawSurf_t ),
-		   ( int ( * )( const void *, const void * ) )R_DrawSurfCompare );
+
+	if( r_speeds->integer ) {
+		usec = Sys_Microseconds();
+	}
+
+	if( list->numDrawSurfs < R_SORT_MIN_RADIX_SURFS ) {
+		std::stable_sort( list->drawSurfs, list->drawSurfs + list->numDrawSurfs,
+			[]( const sortedDrawSurf_t &sds1, const sortedDrawSurf_t &sds2 ) {
+				return R_DrawSurfKey( &sds1 ) < R_DrawSurfKey( &sds2 );
+			} );
+	} else {
+		sorted = R_RadixSortDrawSurfs( list->drawSurfs, list->sortScratch, list->numDrawSurfs );
+
+		// the buffers are of the same size so just swap them instead of copying surfaces back
+		if( sorted != list->drawSurfs ) {
+			list->sortScratch = list->drawSurfs;
+			list->drawSurfs = sorted;
+		}
+	}
+
+	if( r_speeds->integer ) {
+		rf.stats.t_sort_draw_surfs += (unsigned)( Sys_Microseconds() - usec );
+	}
 }
 
 /*
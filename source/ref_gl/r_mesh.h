@@ -58,6 +58,7 @@ typedef struct {
 typedef struct {
 	unsigned int numDrawSurfs, maxDrawSurfs;
 	sortedDrawSurf_t    *drawSurfs;
+	sortedDrawSurf_t    *sortScratch;   // maxDrawSurfs entries, swapped with drawSurfs by sorting
 
 	unsigned int maxVboSlices;
 	vboSlice_t          *vboSlices;
@@ -263,6 +263,54 @@ static void Mod_FinishFaces( model_t *mod ) {
 	}
 }
 
+/*
+* Mod_AllocCullBounds
+*/
+static void Mod_AllocCullBounds( model_t *mod, mcullbounds_t *bounds, unsigned numBoxes ) {
+	int i;
+	float *data;
+	const size_t stride = numBoxes + MOD_CULLBOUNDS_PADDING;
+
+	data = (float *)Mod_Malloc( mod, 6 * stride * sizeof( float ) );
+	memset( data, 0, 6 * stride * sizeof( float ) );
+
+	bounds->numBoxes = numBoxes;
+	for( i = 0; i < 3; i++ ) {
+		bounds->mins[i] = data + i * stride;
+		bounds->maxs[i] = data + ( i + 3 ) * stride;
+	}
+}
+
+/*
+* Mod_CreateCullBounds
+*
+* Copies bounds of vis leafs and surfaces to arrays used by the world culling.
+* Must be called after surfaces are sorted for VBO's.
+*/
+static void Mod_CreateCullBounds( model_t *mod ) {
+	unsigned i;
+	int j;
+	mbrushmodel_t *loadbmodel = ( ( mbrushmodel_t * )mod->extradata );
+
+	Mod_AllocCullBounds( mod, &loadbmodel->visLeafBounds, loadbmodel->numvisleafs );
+	for( i = 0; i < loadbmodel->numvisleafs; i++ ) {
+		const mleaf_t *leaf = loadbmodel->visleafs[i];
+		for( j = 0; j < 3; j++ ) {
+			loadbmodel->visLeafBounds.mins[j][i] = leaf->mins[j];
+			loadbmodel->visLeafBounds.maxs[j][i] = leaf->maxs[j];
+		}
+	}
+
+	Mod_AllocCullBounds( mod, &loadbmodel->surfaceBounds, loadbmodel->numsurfaces );
+	for( i = 0; i < loadbmodel->numsurfaces; i++ ) {
+		const msurface_t *surf = loadbmodel->surfaces + i;
+		for( j = 0; j < 3; j++ ) {
+			loadbmodel->surfaceBounds.mins[j][i] = surf->mins[j];
+			loadbmodel->surfaceBounds.maxs[j][i] = surf->maxs[j];
+		}
+	}
+}
+
 /*
 * Mod_SetupSubmodels
 */
@@ -898,6 +946,8 @@ static void Mod_FinalizeBrushModel( model_t *model ) {
 
 	Mod_CreateVertexBufferObjects( model );
 
+	Mod_CreateCullBounds( model );
+
 	Mod_SetupSubmodels( model );
 
 	Mod_CreateSkydome( model );
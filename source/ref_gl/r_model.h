@@ -133,6 +133,16 @@ typedef struct {
 	float texMatrix[2][2];
 } mlightmapRect_t;
 
+// Box bounds stored as a structure of arrays, so the frustum culling tests several boxes at once.
+// Arrays are padded by MOD_CULLBOUNDS_PADDING zeroes as the culling code might read past the last box.
+#define MOD_CULLBOUNDS_PADDING  4
+
+typedef struct {
+	unsigned int numBoxes;
+	float           *mins[3];
+	float           *maxs[3];
+} mcullbounds_t;
+
 typedef struct mbrushmodel_s {
 	const bspFormatDesc_t *format;
 
@@ -164,6 +174,9 @@ typedef struct mbrushmodel_s {
 	unsigned int numsurfaces;
 	msurface_t      *surfaces;
 
+	mcullbounds_t visLeafBounds;        // in the order of visleafs
+	mcullbounds_t surfaceBounds;
+
 	unsigned int numlightgridelems;
 	mgridlight_t    *lightgrid;
 
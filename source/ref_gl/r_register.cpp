@@ -107,6 +107,8 @@ cvar_t *r_gamma;
 cvar_t *r_texturemode;
 cvar_t *r_texturefilter;
 cvar_t *r_texturecompression;
+cvar_t *r_imagecache;
+cvar_t *r_imagecache_maxsize;
 cvar_t *r_picmip;
 cvar_t *r_skymip;
 cvar_t *r_nobind;
@@ -1147,6 +1149,8 @@ static void R_Register( const char *screenshotsPrefix ) {
 	r_texturemode = Cvar_Get( "r_texturemode", "GL_LINEAR_MIPMAP_LINEAR", CVAR_ARCHIVE );
 	r_texturefilter = Cvar_Get( "r_texturefilter", "4", CVAR_ARCHIVE );
 	r_texturecompression = Cvar_Get( "r_texturecompression", "0", CVAR_ARCHIVE | CVAR_LATCH_VIDEO );
+	r_imagecache = Cvar_Get( "r_imagecache", "1", CVAR_ARCHIVE );
+	r_imagecache_maxsize = Cvar_Get( "r_imagecache_maxsize", "512", CVAR_ARCHIVE );
 	r_stencilbits = Cvar_Get( "r_stencilbits", "0", CVAR_ARCHIVE | CVAR_LATCH_VIDEO );
 
 	r_screenshot_jpeg = Cvar_Get( "r_screenshot_jpeg", "1", CVAR_ARCHIVE );
@@ -1197,6 +1201,9 @@ static void R_Register( const char *screenshotsPrefix ) {
 	Cmd_AddCommand( "gfxinfo", R_GfxInfo_f );
 	Cmd_AddCommand( "glslprogramlist", RP_ProgramList_f );
 	Cmd_AddCommand( "cinlist", R_CinList_f );
+#ifndef PUBLIC_BUILD
+	Cmd_AddCommand( "skmbench", R_SkeletalBench_f );
+#endif
 }
 
 /*
@@ -1525,6 +1532,8 @@ static void R_DestroyVolatileAssets( void ) {
 void R_BeginRegistration( void ) {
 	R_FinishLoadingImages();
 
+	R_ResetImageLoadStats();
+
 	R_DestroyVolatileAssets();
 
 	rsh.registrationSequence++;
@@ -1559,6 +1568,9 @@ void R_EndRegistration( void ) {
 	R_FreeUnusedCinematics();
 	R_FreeUnusedImages();
 
+	R_PrintImageLoadStats();
+	R_TrimImageCache();
+
 	R_RestartCinematics();
 
 	R_DeferDataSync();
@@ -1579,6 +1591,9 @@ void R_Shutdown( bool verbose ) {
 	Cmd_RemoveCommand( "shaderlist" );
 	Cmd_RemoveCommand( "glslprogramlist" );
 	Cmd_RemoveCommand( "cinlist" );
+#ifndef PUBLIC_BUILD
+	Cmd_RemoveCommand( "skmbench" );
+#endif
 
 	// free shaders, models, etc.
 
@@ -950,12 +950,16 @@ static skmcacheentry_t *r_skmcachekeys[MAX_REF_ENTITIES * ( MOD_MAX_LODS + 1 )];
 
 #define R_SKMCacheAlloc( size ) R_MallocExt( r_skmcachepool, ( size ), 16, 1 )
 
+static void R_InitSkeletalKernels( void );
+
 /*
 * R_InitSkeletalCache
 */
 void R_InitSkeletalCache( void ) {
 	r_skmcachepool = R_AllocPool( r_mempool, "SKM Cache" );
 
+	R_InitSkeletalKernels();
+
 	r_skmcache_head = NULL;
 	r_skmcache_free = NULL;
 }
@@ -1192,6 +1196,402 @@ static void R_SkeletalTransformNormalsAndSVecs( int numverts, const unsigned int
 # pragma fp_contract(off)   // this line is needed on Itanium processors
 #endif
 
+#ifdef QF_SSE2
+
+/*
+* SSE2 kernels
+*
+* A row of a bone matrix is processed as a single vector, so a vertex is transformed by 3 multiplications
+* and 3 additions of rows. Products are summed in the same order as the generic code does
+* and no fused multiply-add is used, so the results match the generic code.
+* The 4-th row elements are unused by the skinning, blending them as well is harmless.
+*/
+
+#define R_SKM_XYZ_MASK  _mm_castsi128_ps( _mm_set_epi32( 0, -1, -1, -1 ) )
+
+/*
+* R_SkeletalBlendPoses_SSE2
+*/
+static void R_SkeletalBlendPoses_SSE2( unsigned int numblends, mskblend_t *blends, unsigned int numbones, mat4_t *relbonepose ) {
+	unsigned int i, j, k;
+	float *pose;
+	const float *b;
+	mskblend_t *blend;
+	__m128 f, r0, r1, r2, r3;
+
+	for( i = 0, j = numbones, blend = blends; i < numblends; i++, j++, blend++ ) {
+		pose = relbonepose[j];
+
+		b = relbonepose[blend->indices[0]];
+		f = _mm_set1_ps( (float)( blend->weights[0] * ( 1.0 / 255.0 ) ) );
+
+		r0 = _mm_mul_ps( f, _mm_loadu_ps( b +  0 ) );
+		r1 = _mm_mul_ps( f, _mm_loadu_ps( b +  4 ) );
+		r2 = _mm_mul_ps( f, _mm_loadu_ps( b +  8 ) );
+		r3 = _mm_mul_ps( f, _mm_loadu_ps( b + 12 ) );
+
+		for( k = 1; k < SKM_MAX_WEIGHTS && blend->weights[k]; k++ ) {
+			b = relbonepose[blend->indices[k]];
+			f = _mm_set1_ps( (float)( blend->weights[k] * ( 1.0 / 255.0 ) ) );
+
+			r0 = _mm_add_ps( r0, _mm_mul_ps( f, _mm_loadu_ps( b +  0 ) ) );
+			r1 = _mm_add_ps( r1, _mm_mul_ps( f, _mm_loadu_ps( b +  4 ) ) );
+			r2 = _mm_add_ps( r2, _mm_mul_ps( f, _mm_loadu_ps( b +  8 ) ) );
+			r3 = _mm_add_ps( r3, _mm_mul_ps( f, _mm_loadu_ps( b + 12 ) ) );
+		}
+
+		_mm_storeu_ps( pose +  0, r0 );
+		_mm_storeu_ps( pose +  4, r1 );
+		_mm_storeu_ps( pose +  8, r2 );
+		_mm_storeu_ps( pose + 12, r3 );
+	}
+}
+
+/*
+* R_SkeletalRotate_SSE2
+*
+* Returns the vector rotated by the bone matrix, the 4-th element is undefined.
+*/
+static inline __m128 R_SkeletalRotate_SSE2( const float *pose, const float *v ) {
+	const __m128 xyzw = _mm_loadu_ps( v );
+	__m128 r;
+
+	r = _mm_mul_ps( _mm_shuffle_ps( xyzw, xyzw, _MM_SHUFFLE( 0, 0, 0, 0 ) ), _mm_loadu_ps( pose + 0 ) );
+	r = _mm_add_ps( r, _mm_mul_ps( _mm_shuffle_ps( xyzw, xyzw, _MM_SHUFFLE( 1, 1, 1, 1 ) ), _mm_loadu_ps( pose + 4 ) ) );
+	r = _mm_add_ps( r, _mm_mul_ps( _mm_shuffle_ps( xyzw, xyzw, _MM_SHUFFLE( 2, 2, 2, 2 ) ), _mm_loadu_ps( pose + 8 ) ) );
+	return r;
+}
+
+/*
+* R_SkeletalTransformVerts_SSE2
+*/
+static void R_SkeletalTransformVerts_SSE2( int numverts, const unsigned int *blends, mat4_t *relbonepose, const vec_t *v, vec_t *ov ) {
+	const __m128 xyzMask = R_SKM_XYZ_MASK;
+	const __m128 w = _mm_set_ps( 1, 0, 0, 0 );
+	const float *p0, *p1, *p2, *p3;
+	__m128 r0, r1, r2, r3;
+
+	for( ; numverts >= 4; numverts -= 4, v += 16, ov += 16, blends += 4 ) {
+		p0 = relbonepose[blends[0]];
+		p1 = relbonepose[blends[1]];
+		p2 = relbonepose[blends[2]];
+		p3 = relbonepose[blends[3]];
+
+		r0 = _mm_add_ps( R_SkeletalRotate_SSE2( p0, v +  0 ), _mm_loadu_ps( p0 + 12 ) );
+		r1 = _mm_add_ps( R_SkeletalRotate_SSE2( p1, v +  4 ), _mm_loadu_ps( p1 + 12 ) );
+		r2 = _mm_add_ps( R_SkeletalRotate_SSE2( p2, v +  8 ), _mm_loadu_ps( p2 + 12 ) );
+		r3 = _mm_add_ps( R_SkeletalRotate_SSE2( p3, v + 12 ), _mm_loadu_ps( p3 + 12 ) );
+
+		_mm_storeu_ps( ov +  0, _mm_or_ps( _mm_and_ps( r0, xyzMask ), w ) );
+		_mm_storeu_ps( ov +  4, _mm_or_ps( _mm_and_ps( r1, xyzMask ), w ) );
+		_mm_storeu_ps( ov +  8, _mm_or_ps( _mm_and_ps( r2, xyzMask ), w ) );
+		_mm_storeu_ps( ov + 12, _mm_or_ps( _mm_and_ps( r3, xyzMask ), w ) );
+	}
+
+	for( ; numverts; numverts--, v += 4, ov += 4, blends++ ) {
+		p0 = relbonepose[*blends];
+		r0 = _mm_add_ps( R_SkeletalRotate_SSE2( p0, v ), _mm_loadu_ps( p0 + 12 ) );
+		_mm_storeu_ps( ov, _mm_or_ps( _mm_and_ps( r0, xyzMask ), w ) );
+	}
+}
+
+/*
+* R_SkeletalTransformNormals_SSE2
+*/
+static void R_SkeletalTransformNormals_SSE2( int numverts, const unsigned int *blends, mat4_t *relbonepose, const vec_t *v, vec_t *ov ) {
+	const __m128 xyzMask = R_SKM_XYZ_MASK;
+
+	for( ; numverts >= 4; numverts -= 4, v += 16, ov += 16, blends += 4 ) {
+		const __m128 r0 = R_SkeletalRotate_SSE2( relbonepose[blends[0]], v +  0 );
+		const __m128 r1 = R_SkeletalRotate_SSE2( relbonepose[blends[1]], v +  4 );
+		const __m128 r2 = R_SkeletalRotate_SSE2( relbonepose[blends[2]], v +  8 );
+		const __m128 r3 = R_SkeletalRotate_SSE2( relbonepose[blends[3]], v + 12 );
+
+		_mm_storeu_ps( ov +  0, _mm_and_ps( r0, xyzMask ) );
+		_mm_storeu_ps( ov +  4, _mm_and_ps( r1, xyzMask ) );
+		_mm_storeu_ps( ov +  8, _mm_and_ps( r2, xyzMask ) );
+		_mm_storeu_ps( ov + 12, _mm_and_ps( r3, xyzMask ) );
+	}
+
+	for( ; numverts; numverts--, v += 4, ov += 4, blends++ ) {
+		_mm_storeu_ps( ov, _mm_and_ps( R_SkeletalRotate_SSE2( relbonepose[*blends], v ), xyzMask ) );
+	}
+}
+
+/*
+* R_SkeletalTransformNormalsAndSVecs_SSE2
+*/
+static void R_SkeletalTransformNormalsAndSVecs_SSE2( int numverts, const unsigned int *blends, mat4_t *relbonepose, const vec_t *v, vec_t *ov, const vec_t *sv, vec_t *osv ) {
+	const __m128 xyzMask = R_SKM_XYZ_MASK;
+	const float *pose;
+	__m128 n, s;
+
+	// the tangent direction sign is kept in the 4-th element of s-vectors
+	for( ; numverts; numverts--, v += 4, ov += 4, sv += 4, osv += 4, blends++ ) {
+		pose = relbonepose[*blends];
+
+		n = R_SkeletalRotate_SSE2( pose, v );
+		s = R_SkeletalRotate_SSE2( pose, sv );
+
+		_mm_storeu_ps( ov, _mm_and_ps( n, xyzMask ) );
+		_mm_storeu_ps( osv, _mm_or_ps( _mm_and_ps( s, xyzMask ), _mm_andnot_ps( xyzMask, _mm_loadu_ps( sv ) ) ) );
+	}
+}
+
+#endif // QF_SSE2
+
+typedef struct {
+	const char *name;
+	void ( *blendPoses )( unsigned int numblends, mskblend_t *blends, unsigned int numbones, mat4_t *relbonepose );
+	void ( *transformVerts )( int numverts, const unsigned int *blends, mat4_t *relbonepose, const vec_t *v, vec_t *ov );
+	void ( *transformNormals )( int numverts, const unsigned int *blends, mat4_t *relbonepose, const vec_t *v, vec_t *ov );
+	void ( *transformNormalsAndSVecs )( int numverts, const unsigned int *blends, mat4_t *relbonepose,
+										const vec_t *v, vec_t *ov, const vec_t *sv, vec_t *osv );
+} skmkernels_t;
+
+static const skmkernels_t r_skmGenericKernels = {
+	"generic",
+	R_SkeletalBlendPoses,
+	R_SkeletalTransformVerts,
+	R_SkeletalTransformNormals,
+	R_SkeletalTransformNormalsAndSVecs
+};
+
+#ifdef QF_SSE2
+static const skmkernels_t r_skmSSE2Kernels = {
+	"SSE2",
+	R_SkeletalBlendPoses_SSE2,
+	R_SkeletalTransformVerts_SSE2,
+	R_SkeletalTransformNormals_SSE2,
+	R_SkeletalTransformNormalsAndSVecs_SSE2
+};
+
+static const skmkernels_t r_skmAVXKernels = {
+	"AVX",
+	R_SkeletalBlendPoses_AVX,
+	R_SkeletalTransformVerts_AVX,
+	R_SkeletalTransformNormals_AVX,
+	R_SkeletalTransformNormalsAndSVecs_AVX
+};
+#endif
+
+static const skmkernels_t *r_skmkernels = &r_skmGenericKernels;
+
+/*
+* R_InitSkeletalKernels
+*
+* Selects the fastest skinning code supported by the CPU.
+*/
+static void R_InitSkeletalKernels( void ) {
+	r_skmkernels = &r_skmGenericKernels;
+
+#ifdef QF_SSE2
+	const unsigned features = Sys_GetProcessorFeatures();
+	if( features & Q_CPU_FEATURE_AVX ) {
+		r_skmkernels = &r_skmAVXKernels;
+	} else if( features & Q_CPU_FEATURE_SSE2 ) {
+		r_skmkernels = &r_skmSSE2Kernels;
+	}
+#endif
+
+	Com_DPrintf( "Using %s skeletal animation code\n", r_skmkernels->name );
+}
+
+#ifndef PUBLIC_BUILD
+
+#define SKM_BENCH_EPSILON   0.001f
+
+static const char *r_skmBenchModels[] = { "bigvic", "monada", "silverclaw", "padpork", "bobot" };
+
+/*
+* R_SkeletalBenchKernels
+*
+* Skins every mesh of the model with the given kernel set, returns the time spent in microseconds.
+*/
+static uint64_t R_SkeletalBenchKernels( const skmkernels_t *kernels, const mskmodel_t *skmodel, int iterations,
+										const mat4_t *basemats, mat4_t *mats, vec4_t *xyz, vec4_t *normals, vec4_t *svecs ) {
+	int i;
+	unsigned j, firstvert;
+	const mskmesh_t *mesh;
+	uint64_t start;
+
+	start = Sys_Microseconds();
+
+	for( i = 0; i < iterations; i++ ) {
+		memcpy( mats, basemats, sizeof( mat4_t ) * skmodel->numbones );
+		kernels->blendPoses( skmodel->numblends, skmodel->blends, skmodel->numbones, mats );
+
+		for( j = 0, firstvert = 0, mesh = skmodel->meshes; j < skmodel->nummeshes; j++, mesh++ ) {
+			kernels->transformVerts( mesh->numverts, mesh->vertexBlends, mats,
+									 mesh->xyzArray[0], xyz[firstvert] );
+			kernels->transformNormalsAndSVecs( mesh->numverts, mesh->vertexBlends, mats,
+											   mesh->normalsArray[0], normals[firstvert], mesh->sVectorsArray[0], svecs[firstvert] );
+			firstvert += mesh->numverts;
+		}
+	}
+
+	return Sys_Microseconds() - start;
+}
+
+/*
+* R_SkeletalBenchCompare
+*
+* Returns the number of components that differ from the reference by more than the epsilon.
+*/
+static int R_SkeletalBenchCompare( const float *ref, const float *test, size_t count, size_t stride, size_t numcomps, float *maxerror ) {
+	size_t i, j;
+	int mismatches = 0;
+
+	for( i = 0; i < count; i++, ref += stride, test += stride ) {
+		for( j = 0; j < numcomps; j++ ) {
+			float error = fabs( test[j] - ref[j] );
+
+			if( !( error <= SKM_BENCH_EPSILON * std::max( 1.0f, (float)fabs( ref[j] ) ) ) ) {
+				mismatches++;
+			}
+			if( error > *maxerror ) {
+				*maxerror = error;
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+/*
+* R_SkeletalBench_f
+*
+* Skins the stock player models with every skeletal kernel set supported by the CPU,
+* prints the timings and checks the results against the generic code.
+*/
+void R_SkeletalBench_f( void ) {
+	int iterations;
+	unsigned i, j, k, numverts;
+	const skmkernels_t *kernelSets[3];
+	int numKernelSets;
+	const model_t *mod;
+	const mskmodel_t *skmodel;
+	const mskframe_t *frame;
+	const mskmesh_t *mesh;
+	bonepose_t *bonepose;
+	dualquat_t dq;
+	mat4_t *basemats, *mats, *refmats;
+	vec4_t *xyz, *normals, *svecs;
+	vec4_t *refxyz, *refnormals, *refsvecs;
+	size_t numbonemats, size;
+	uint64_t time, refTime;
+	char name[MAX_QPATH];
+
+	if( Cmd_Argc() > 2 ) {
+		Com_Printf( "Usage: %s [iterations]\n", Cmd_Argv( 0 ) );
+		return;
+	}
+
+	iterations = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 1000;
+	if( iterations < 1 ) {
+		iterations = 1;
+	}
+
+	numKernelSets = 0;
+	kernelSets[numKernelSets++] = &r_skmGenericKernels;
+#ifdef QF_SSE2
+	{
+		const unsigned features = Sys_GetProcessorFeatures();
+		if( features & Q_CPU_FEATURE_SSE2 ) {
+			kernelSets[numKernelSets++] = &r_skmSSE2Kernels;
+		}
+		if( features & Q_CPU_FEATURE_AVX ) {
+			kernelSets[numKernelSets++] = &r_skmAVXKernels;
+		}
+	}
+#endif
+
+	for( i = 0; i < sizeof( r_skmBenchModels ) / sizeof( r_skmBenchModels[0] ); i++ ) {
+		Q_snprintfz( name, sizeof( name ), "models/players/%s/tris.iqm", r_skmBenchModels[i] );
+
+		mod = R_RegisterModel( name );
+		if( !mod || mod->type != mod_skeletal ) {
+			Com_Printf( "%s: skipping %s, not a skeletal model\n", Cmd_Argv( 0 ), name );
+			continue;
+		}
+
+		skmodel = ( const mskmodel_t * )mod->extradata;
+		if( !skmodel->numframes || !skmodel->nummeshes ) {
+			continue;
+		}
+
+		numverts = 0;
+		for( j = 0, mesh = skmodel->meshes; j < skmodel->nummeshes; j++, mesh++ ) {
+			numverts += mesh->numverts;
+		}
+
+		// the bone matrices are followed by the blended ones, the generic output is kept as reference
+		numbonemats = skmodel->numbones + skmodel->numblends;
+		size = sizeof( bonepose_t ) * skmodel->numbones + sizeof( mat4_t ) * numbonemats * 3 + sizeof( vec4_t ) * numverts * 6;
+		basemats = ( mat4_t * )R_MallocExt( r_mempool, size, 16, 1 );
+		mats = basemats + numbonemats;
+		refmats = mats + numbonemats;
+		xyz = ( vec4_t * )( refmats + numbonemats );
+		normals = xyz + numverts;
+		svecs = normals + numverts;
+		refxyz = svecs + numverts;
+		refnormals = refxyz + numverts;
+		refsvecs = refnormals + numverts;
+		bonepose = ( bonepose_t * )( refsvecs + numverts );
+
+		// pose the model in the middle of its animation
+		frame = skmodel->frames + skmodel->numframes / 2;
+		for( j = 0; j < skmodel->numbones; j++ ) {
+			if( skmodel->bones[j].parent >= 0 ) {
+				DualQuat_Multiply( bonepose[skmodel->bones[j].parent].dualquat, frame->boneposes[j].dualquat, bonepose[j].dualquat );
+			} else {
+				DualQuat_Copy( frame->boneposes[j].dualquat, bonepose[j].dualquat );
+			}
+		}
+		for( j = 0; j < skmodel->numbones; j++ ) {
+			DualQuat_Multiply( bonepose[j].dualquat, skmodel->invbaseposes[j].dualquat, dq );
+			DualQuat_Normalize( dq );
+			Matrix4_FromDualQuaternion( dq, basemats[j] );
+		}
+
+		Com_Printf( "%s: %s, %u meshes, %u verts, %u bones, %u blends\n", Cmd_Argv( 0 ), name,
+					skmodel->nummeshes, numverts, skmodel->numbones, skmodel->numblends );
+
+		// the first pass produces the reference output and warms up the caches
+		R_SkeletalBenchKernels( &r_skmGenericKernels, skmodel, 1, basemats, refmats, refxyz, refnormals, refsvecs );
+
+		refTime = 0;
+
+		for( k = 0; k < (unsigned)numKernelSets; k++ ) {
+			int mismatches = 0;
+			float maxerror = 0.0f;
+
+			memset( mats, 0, sizeof( mat4_t ) * numbonemats );
+			memset( xyz, 0, sizeof( vec4_t ) * numverts * 3 );
+
+			time = R_SkeletalBenchKernels( kernelSets[k], skmodel, iterations, basemats, mats, xyz, normals, svecs );
+			if( !k ) {
+				refTime = time;
+			}
+
+			// only the rotation and translation parts of the blended matrices are written
+			mismatches += R_SkeletalBenchCompare( refmats[skmodel->numbones], mats[skmodel->numbones],
+												  skmodel->numblends * 4, 4, 3, &maxerror );
+			mismatches += R_SkeletalBenchCompare( refxyz[0], xyz[0], numverts, 4, 3, &maxerror );
+			mismatches += R_SkeletalBenchCompare( refnormals[0], normals[0], numverts, 4, 3, &maxerror );
+			mismatches += R_SkeletalBenchCompare( refsvecs[0], svecs[0], numverts, 4, 4, &maxerror );
+
+			Com_Printf( "  %-8s %d iterations, %.3f ms (x%.2f), max error %f, %d mismatches\n",
+						kernelSets[k]->name, iterations, time * 0.001, time ? (double)refTime / time : 0.0,
+						maxerror, mismatches );
+		}
+
+		R_Free( basemats );
+	}
+}
+
+#endif
+
 /*
 * R_CacheBoneTransformsJob
 */
@@ -1283,7 +1683,7 @@ static void R_CacheBoneTransformsJob( unsigned first, unsigned items, jobarg_t *
 		}
 
 		// generate matrices for all blend combinations
-		R_SkeletalBlendPoses( skmodel->numblends, skmodel->blends, skmodel->numbones, bonePoseRelativeMat );
+		r_skmkernels->blendPoses( skmodel->numblends, skmodel->blends, skmodel->numbones, bonePoseRelativeMat );
 	}
 }
 
@@ -1351,15 +1751,15 @@ void R_DrawSkeletalSurf( const entity_t *e, const shader_t *shader, const mfog_t
 		 ( vattribs & VATTRIB_SVECTOR_BIT ) ? true : false );
 
 	if( bonePoseRelativeMat ) {
-		R_SkeletalTransformVerts( skmesh->numverts, skmesh->vertexBlends, bonePoseRelativeMat,
+		r_skmkernels->transformVerts( skmesh->numverts, skmesh->vertexBlends, bonePoseRelativeMat,
 			  ( vec_t * )skmesh->xyzArray[0], ( vec_t * )( dynamicMesh.xyzArray ) );
 
 		if( vattribs & VATTRIB_SVECTOR_BIT ) {
-			R_SkeletalTransformNormalsAndSVecs( skmesh->numverts, skmesh->vertexBlends, bonePoseRelativeMat,
+			r_skmkernels->transformNormalsAndSVecs( skmesh->numverts, skmesh->vertexBlends, bonePoseRelativeMat,
 					( vec_t * )skmesh->normalsArray[0], ( vec_t * )( dynamicMesh.normalsArray ),
 					( vec_t * )skmesh->sVectorsArray[0], ( vec_t * )( dynamicMesh.sVectorsArray ) );
 		} else if( vattribs & VATTRIB_NORMAL_BIT ) {
-			R_SkeletalTransformNormals( skmesh->numverts, skmesh->vertexBlends, bonePoseRelativeMat,
+			r_skmkernels->transformNormals( skmesh->numverts, skmesh->vertexBlends, bonePoseRelativeMat,
 					( vec_t * )skmesh->normalsArray[0], ( vec_t * )( dynamicMesh.normalsArray ) );
 		}
 	} else {
@@ -0,0 +1,209 @@
+/*
+Copyright (C) 2002-2011 Victor Luchits
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// r_skm_avx.c: AVX skinning kernels, this file must be compiled with AVX code generation enabled
+
+#include "r_local.h"
+
+#ifdef QF_AVX
+
+/*
+* Two vertices share a single 256-bit register, its lower half holds the first vertex
+* and the upper half holds the second one. Rows of both bone matrices are packed the same way.
+* The evaluation order matches the generic and SSE2 code, so all variants give equal results.
+*
+* The upper halves of registers are cleared on return to avoid penalties
+* of transition to the legacy SSE code the rest of the renderer consists of.
+*/
+
+#define R_SKM_XYZ_MASK_AVX  _mm256_castsi256_ps( _mm256_set_epi32( 0, -1, -1, -1, 0, -1, -1, -1 ) )
+
+/*
+* R_SkeletalRows_AVX
+*/
+static inline __m256 R_SkeletalRows_AVX( const float *p0, const float *p1, int offset ) {
+	return _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( p0 + offset ) ), _mm_loadu_ps( p1 + offset ), 1 );
+}
+
+/*
+* R_SkeletalRotate2_AVX
+*
+* Rotates two consecutive vectors by their bone matrices, 4-th elements of results are undefined.
+*/
+static inline __m256 R_SkeletalRotate2_AVX( const float *p0, const float *p1, const float *v ) {
+	const __m256 xyzw = _mm256_loadu_ps( v );
+	__m256 r;
+
+	r = _mm256_mul_ps( _mm256_permute_ps( xyzw, _MM_SHUFFLE( 0, 0, 0, 0 ) ), R_SkeletalRows_AVX( p0, p1, 0 ) );
+	r = _mm256_add_ps( r, _mm256_mul_ps( _mm256_permute_ps( xyzw, _MM_SHUFFLE( 1, 1, 1, 1 ) ), R_SkeletalRows_AVX( p0, p1, 4 ) ) );
+	r = _mm256_add_ps( r, _mm256_mul_ps( _mm256_permute_ps( xyzw, _MM_SHUFFLE( 2, 2, 2, 2 ) ), R_SkeletalRows_AVX( p0, p1, 8 ) ) );
+	return r;
+}
+
+/*
+* R_SkeletalRotate_AVX
+*/
+static inline __m128 R_SkeletalRotate_AVX( const float *pose, const float *v ) {
+	const __m128 xyzw = _mm_loadu_ps( v );
+	__m128 r;
+
+	r = _mm_mul_ps( _mm_permute_ps( xyzw, _MM_SHUFFLE( 0, 0, 0, 0 ) ), _mm_loadu_ps( pose + 0 ) );
+	r = _mm_add_ps( r, _mm_mul_ps( _mm_permute_ps( xyzw, _MM_SHUFFLE( 1, 1, 1, 1 ) ), _mm_loadu_ps( pose + 4 ) ) );
+	r = _mm_add_ps( r, _mm_mul_ps( _mm_permute_ps( xyzw, _MM_SHUFFLE( 2, 2, 2, 2 ) ), _mm_loadu_ps( pose + 8 ) ) );
+	return r;
+}
+
+/*
+* R_SkeletalBlendPoses_AVX
+*/
+void R_SkeletalBlendPoses_AVX( unsigned int numblends, mskblend_t *blends, unsigned int numbones, mat4_t *relbonepose ) {
+	unsigned int i, j, k;
+	float *pose;
+	const float *b;
+	mskblend_t *blend;
+	__m256 f, r01, r23;
+
+	for( i = 0, j = numbones, blend = blends; i < numblends; i++, j++, blend++ ) {
+		pose = relbonepose[j];
+
+		b = relbonepose[blend->indices[0]];
+		f = _mm256_set1_ps( (float)( blend->weights[0] * ( 1.0 / 255.0 ) ) );
+
+		r01 = _mm256_mul_ps( f, _mm256_loadu_ps( b + 0 ) );
+		r23 = _mm256_mul_ps( f, _mm256_loadu_ps( b + 8 ) );
+
+		for( k = 1; k < SKM_MAX_WEIGHTS && blend->weights[k]; k++ ) {
+			b = relbonepose[blend->indices[k]];
+			f = _mm256_set1_ps( (float)( blend->weights[k] * ( 1.0 / 255.0 ) ) );
+
+			r01 = _mm256_add_ps( r01, _mm256_mul_ps( f, _mm256_loadu_ps( b + 0 ) ) );
+			r23 = _mm256_add_ps( r23, _mm256_mul_ps( f, _mm256_loadu_ps( b + 8 ) ) );
+		}
+
+		_mm256_storeu_ps( pose + 0, r01 );
+		_mm256_storeu_ps( pose + 8, r23 );
+	}
+
+	_mm256_zeroupper();
+}
+
+/*
+* R_SkeletalTransformVerts_AVX
+*/
+void R_SkeletalTransformVerts_AVX( int numverts, const unsigned int *blends, mat4_t *relbonepose, const vec_t *v, vec_t *ov ) {
+	const __m256 xyzMask = R_SKM_XYZ_MASK_AVX;
+	const __m256 w = _mm256_set_ps( 1, 0, 0, 0, 1, 0, 0, 0 );
+	const float *p0, *p1, *p2, *p3, *p4, *p5, *p6, *p7;
+	__m256 r01, r23, r45, r67;
+	__m128 r;
+
+	for( ; numverts >= 8; numverts -= 8, v += 32, ov += 32, blends += 8 ) {
+		p0 = relbonepose[blends[0]]; p1 = relbonepose[blends[1]];
+		p2 = relbonepose[blends[2]]; p3 = relbonepose[blends[3]];
+		p4 = relbonepose[blends[4]]; p5 = relbonepose[blends[5]];
+		p6 = relbonepose[blends[6]]; p7 = relbonepose[blends[7]];
+
+		r01 = _mm256_add_ps( R_SkeletalRotate2_AVX( p0, p1, v +  0 ), R_SkeletalRows_AVX( p0, p1, 12 ) );
+		r23 = _mm256_add_ps( R_SkeletalRotate2_AVX( p2, p3, v +  8 ), R_SkeletalRows_AVX( p2, p3, 12 ) );
+		r45 = _mm256_add_ps( R_SkeletalRotate2_AVX( p4, p5, v + 16 ), R_SkeletalRows_AVX( p4, p5, 12 ) );
+		r67 = _mm256_add_ps( R_SkeletalRotate2_AVX( p6, p7, v + 24 ), R_SkeletalRows_AVX( p6, p7, 12 ) );
+
+		_mm256_storeu_ps( ov +  0, _mm256_or_ps( _mm256_and_ps( r01, xyzMask ), w ) );
+		_mm256_storeu_ps( ov +  8, _mm256_or_ps( _mm256_and_ps( r23, xyzMask ), w ) );
+		_mm256_storeu_ps( ov + 16, _mm256_or_ps( _mm256_and_ps( r45, xyzMask ), w ) );
+		_mm256_storeu_ps( ov + 24, _mm256_or_ps( _mm256_and_ps( r67, xyzMask ), w ) );
+	}
+
+	for( ; numverts; numverts--, v += 4, ov += 4, blends++ ) {
+		p0 = relbonepose[*blends];
+		r = _mm_add_ps( R_SkeletalRotate_AVX( p0, v ), _mm_loadu_ps( p0 + 12 ) );
+		_mm_storeu_ps( ov, _mm_or_ps( _mm_and_ps( r, _mm256_castps256_ps128( xyzMask ) ), _mm256_castps256_ps128( w ) ) );
+	}
+
+	_mm256_zeroupper();
+}
+
+/*
+* R_SkeletalTransformNormals_AVX
+*/
+void R_SkeletalTransformNormals_AVX( int numverts, const unsigned int *blends, mat4_t *relbonepose, const vec_t *v, vec_t *ov ) {
+	const __m256 xyzMask = R_SKM_XYZ_MASK_AVX;
+	__m256 r01, r23, r45, r67;
+
+	for( ; numverts >= 8; numverts -= 8, v += 32, ov += 32, blends += 8 ) {
+		r01 = R_SkeletalRotate2_AVX( relbonepose[blends[0]], relbonepose[blends[1]], v +  0 );
+		r23 = R_SkeletalRotate2_AVX( relbonepose[blends[2]], relbonepose[blends[3]], v +  8 );
+		r45 = R_SkeletalRotate2_AVX( relbonepose[blends[4]], relbonepose[blends[5]], v + 16 );
+		r67 = R_SkeletalRotate2_AVX( relbonepose[blends[6]], relbonepose[blends[7]], v + 24 );
+
+		_mm256_storeu_ps( ov +  0, _mm256_and_ps( r01, xyzMask ) );
+		_mm256_storeu_ps( ov +  8, _mm256_and_ps( r23, xyzMask ) );
+		_mm256_storeu_ps( ov + 16, _mm256_and_ps( r45, xyzMask ) );
+		_mm256_storeu_ps( ov + 24, _mm256_and_ps( r67, xyzMask ) );
+	}
+
+	for( ; numverts; numverts--, v += 4, ov += 4, blends++ ) {
+		_mm_storeu_ps( ov, _mm_and_ps( R_SkeletalRotate_AVX( relbonepose[*blends], v ), _mm256_castps256_ps128( xyzMask ) ) );
+	}
+
+	_mm256_zeroupper();
+}
+
+/*
+* R_SkeletalTransformNormalsAndSVecs_AVX
+*/
+void R_SkeletalTransformNormalsAndSVecs_AVX( int numverts, const unsigned int *blends, mat4_t *relbonepose,
+											 const vec_t *v, vec_t *ov, const vec_t *sv, vec_t *osv ) {
+	const __m256 xyzMask = R_SKM_XYZ_MASK_AVX;
+	const float *p0, *p1, *p2, *p3;
+	__m256 n01, n23, s01, s23;
+	__m128 n, s;
+
+	// the tangent direction sign is kept in the 4-th element of s-vectors
+	for( ; numverts >= 4; numverts -= 4, v += 16, ov += 16, sv += 16, osv += 16, blends += 4 ) {
+		p0 = relbonepose[blends[0]]; p1 = relbonepose[blends[1]];
+		p2 = relbonepose[blends[2]]; p3 = relbonepose[blends[3]];
+
+		n01 = R_SkeletalRotate2_AVX( p0, p1, v + 0 );
+		n23 = R_SkeletalRotate2_AVX( p2, p3, v + 8 );
+		s01 = R_SkeletalRotate2_AVX( p0, p1, sv + 0 );
+		s23 = R_SkeletalRotate2_AVX( p2, p3, sv + 8 );
+
+		_mm256_storeu_ps( ov + 0, _mm256_and_ps( n01, xyzMask ) );
+		_mm256_storeu_ps( ov + 8, _mm256_and_ps( n23, xyzMask ) );
+		_mm256_storeu_ps( osv + 0, _mm256_or_ps( _mm256_and_ps( s01, xyzMask ), _mm256_andnot_ps( xyzMask, _mm256_loadu_ps( sv + 0 ) ) ) );
+		_mm256_storeu_ps( osv + 8, _mm256_or_ps( _mm256_and_ps( s23, xyzMask ), _mm256_andnot_ps( xyzMask, _mm256_loadu_ps( sv + 8 ) ) ) );
+	}
+
+	for( ; numverts; numverts--, v += 4, ov += 4, sv += 4, osv += 4, blends++ ) {
+		p0 = relbonepose[*blends];
+
+		n = R_SkeletalRotate_AVX( p0, v );
+		s = R_SkeletalRotate_AVX( p0, sv );
+
+		_mm_storeu_ps( ov, _mm_and_ps( n, _mm256_castps256_ps128( xyzMask ) ) );
+		_mm_storeu_ps( osv, _mm_or_ps( _mm_and_ps( s, _mm256_castps256_ps128( xyzMask ) ),
+									   _mm_andnot_ps( _mm256_castps256_ps128( xyzMask ), _mm_loadu_ps( sv ) ) ) );
+	}
+
+	_mm256_zeroupper();
+}
+
+#endif // QF_AVX
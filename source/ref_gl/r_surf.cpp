@@ -705,59 +705,51 @@ static void R_CullVisLeaves( unsigned firstLeaf, unsigned numLeaves, unsigned cl
 		areabits = NULL;
 	}
 
-	for( i = 0; i < numLeaves; i++ ) {
-		int clipped;
-		unsigned bit, testFlags;
-		cplane_t *clipplane;
-		unsigned l = firstLeaf + i;
-
-		leaf = rsh.worldBrushModel->visleafs[l];
-		if( !novis ) {
-			// check for door connected areas
-			if( areabits ) {
-				if( leaf->area < 0 || !( areabits[leaf->area >> 3] & ( 1 << ( leaf->area & 7 ) ) ) ) {
-					continue; // not visible
-				}
-			}
+	for( i = 0; i < numLeaves; i += 32 ) {
+		unsigned culled, partial;
+		const unsigned count = std::min( numLeaves - i, 32u );
 
-			if( !( pvs[leaf->cluster >> 3] & ( 1 << ( leaf->cluster & 7 ) ) ) ) {
-				continue; // not visible
-			}
-		}
+		// frustum cull the whole block of leaves at once
+		culled = R_CullBounds( &rsh.worldBrushModel->visLeafBounds, firstLeaf + i, count, clipFlags, &partial );
 
-		// track leaves, which are entirely inside the frustum
-		clipped = 0;
-		testFlags = clipFlags;
-		for( j = sizeof( rn.frustum ) / sizeof( rn.frustum[0] ), bit = 1, clipplane = rn.frustum; j > 0; j--, bit <<= 1, clipplane++ ) {
-			if( testFlags & bit ) {
-				clipped = BoxOnPlaneSide( leaf->mins, leaf->maxs, clipplane );
-				if( clipped == 2 ) {
-					break;
-				} else if( clipped == 1 ) {
-					testFlags &= ~bit; // node is entirely on screen
-				}
+		for( j = 0; j < count; j++ ) {
+			unsigned k;
+			unsigned l = firstLeaf + i + j;
+
+			if( culled & ( 1u << j ) ) {
+				continue; // fully clipped
 			}
-		}
 
-		if( clipped == 2 ) {
-			continue; // fully clipped
-		}
+			leaf = rsh.worldBrushModel->visleafs[l];
+			if( !novis ) {
+				// check for door connected areas
+				if( areabits ) {
+					if( leaf->area < 0 || !( areabits[leaf->area >> 3] & ( 1 << ( leaf->area & 7 ) ) ) ) {
+						continue; // not visible
+					}
+				}
 
-		if( testFlags == 0 ) {
-			// fully visible
-			for( j = 0; j < leaf->numVisSurfaces; j++ ) {
-				assert( leaf->visSurfaces[j] < rf.numWorldSurfVis );
-				rf.worldSurfFullVis[leaf->visSurfaces[j]] = 1;
+				if( !( pvs[leaf->cluster >> 3] & ( 1 << ( leaf->cluster & 7 ) ) ) ) {
+					continue; // not visible
+				}
 			}
-		} else {
-			// partly visible
-			for( j = 0; j < leaf->numVisSurfaces; j++ ) {
-				assert( leaf->visSurfaces[j] < rf.numWorldSurfVis );
-				rf.worldSurfVis[leaf->visSurfaces[j]] = 1;
+
+			if( !( partial & ( 1u << j ) ) ) {
+				// fully visible
+				for( k = 0; k < leaf->numVisSurfaces; k++ ) {
+					assert( leaf->visSurfaces[k] < rf.numWorldSurfVis );
+					rf.worldSurfFullVis[leaf->visSurfaces[k]] = 1;
+				}
+			} else {
+				// partly visible
+				for( k = 0; k < leaf->numVisSurfaces; k++ ) {
+					assert( leaf->visSurfaces[k] < rf.numWorldSurfVis );
+					rf.worldSurfVis[leaf->visSurfaces[k]] = 1;
+				}
 			}
-		}
 
-		rf.worldLeafVis[l] = 1;
+			rf.worldLeafVis[l] = 1;
+		}
 	}
 }
 
@@ -767,15 +759,21 @@ static void R_CullVisLeaves( unsigned firstLeaf, unsigned numLeaves, unsigned cl
 static void R_CullVisSurfaces( unsigned firstSurf, unsigned numSurfs, unsigned clipFlags ) {
 	unsigned i;
 	unsigned end;
+	unsigned culled = 0;
 	msurface_t *surf;
 	
 	end = firstSurf + numSurfs;
 	surf = rsh.worldBrushModel->surfaces + firstSurf;
 
 	for( i = firstSurf; i < end; i++ ) {
+		if( !( ( i - firstSurf ) & 31 ) ) {
+			// frustum cull the next block of surfaces at once
+			culled = R_CullBounds( &rsh.worldBrushModel->surfaceBounds, i, std::min( end - i, 32u ), clipFlags, NULL );
+		}
+
 		if( rf.worldSurfVis[i] ) {
 			// the surface is at partly visible in at least one leaf, frustum cull it
-			if( R_CullSurface( rsc.worldent, surf, clipFlags ) ) {
+			if( culled & ( 1u << ( ( i - firstSurf ) & 31 ) ) ) {
 				rf.worldSurfVis[i] = 0;
 			}
 			rf.worldSurfFullVis[i] = 0;
@@ -220,6 +220,8 @@ typedef struct {
 	client_t client;                // special client for writing the messages
 	char meta_data[SNAP_MAX_DEMO_META_DATA_SIZE];
 	size_t meta_data_realsize;
+	snapDemoKeyframeIndex_t keyframes;
+	int64_t nextkeyframetime;
 } server_static_demo_t;
 
 typedef server_static_demo_t demorec_t;
@@ -369,6 +371,8 @@ extern cvar_t *sv_snap_raycast_players_culling;
 // "fov" sounds more clear than "view dir" though its not very accurate
 extern cvar_t *sv_snap_aggressive_fov_culling;
 extern cvar_t *sv_snap_shadow_events_data;
+// a number of extra threads used for building client snapshots, 0 disables parallel building
+extern cvar_t *sv_snap_threads;
 
 //===========================================================
 
@@ -452,6 +456,19 @@ typedef struct {
 
 void SV_FlushRedirect( int sv_redirected, const char *outputbuf, const void *extra );
 void SV_SendClientMessages( void );
+void SV_ShutdownSendWorkers( void );
+
+//
+// sv_snap_workers.c
+//
+#define SV_MAX_SNAP_WORKERS 16
+
+typedef void ( *svSnapWorkerJob_t )( int item, int workerNum );
+
+void SV_SnapWorkers_Init( int numThreads );
+void SV_SnapWorkers_Shutdown( void );
+int SV_SnapWorkers_NumThreads( void );
+void SV_SnapWorkers_Run( svSnapWorkerJob_t job, int numItems );
 
 /**
  * Just a workaround to prevent inclusion of tables headers in other parts of server code than {@code sv_main.cpp}.
@@ -459,6 +476,11 @@ void SV_SendClientMessages( void );
  */
 void SV_SetupSnapTables( cmodel_state_t *cms );
 
+/**
+ * Prints (or resets if the "reset" argument is supplied) hit rate counters of the snapshot entity delta cache.
+ */
+void SV_SnapCacheStats_f( void );
+
 #ifndef _MSC_VER
 void SV_BroadcastCommand( const char *format, ... ) __attribute__( ( format( printf, 1, 2 ) ) );
 #else
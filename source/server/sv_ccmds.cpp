@@ -371,6 +371,96 @@ static void SV_CvarCheck_f( void ) {
 	SV_SendServerCommand( client, "cvarinfo \"%s\"", Cmd_Argv( 2 ) );
 }
 
+/*
+* SV_TraceBench_f
+* Compares CM_TraceBatch() against tracing the same rays one by one on the current map
+*/
+static void SV_TraceBench_f( void ) {
+	static const vec3_t playerbox_mins = { -16, -16, -24 }, playerbox_maxs = { 16, 16, 40 };
+	int numOrigins, raysPerOrigin, numRays, numMismatches;
+	int i, j, pass, attempt;
+	vec3_t worldMins, worldMaxs, origin, dir;
+	vec3_t *starts, *ends;
+	trace_t *scalarTraces, *batchTraces;
+	uint64_t scalarTime, batchTime, timestamp;
+
+	if( !svs.initialized || sv.state != ss_game ) {
+		Com_Printf( "No map is loaded\n" );
+		return;
+	}
+
+	numOrigins = Cmd_Argc() > 1 ? atoi( Cmd_Argv( 1 ) ) : 1024;
+	raysPerOrigin = Cmd_Argc() > 2 ? atoi( Cmd_Argv( 2 ) ) : 16;
+	if( numOrigins <= 0 || raysPerOrigin <= 0 ) {
+		Com_Printf( "Usage: tracebench [numorigins] [raysperorigin]\n" );
+		return;
+	}
+
+	numRays = numOrigins * raysPerOrigin;
+	starts = (vec3_t *)Mem_TempMalloc( numRays * sizeof( vec3_t ) );
+	ends = (vec3_t *)Mem_TempMalloc( numRays * sizeof( vec3_t ) );
+	scalarTraces = (trace_t *)Mem_TempMalloc( numRays * sizeof( trace_t ) );
+	batchTraces = (trace_t *)Mem_TempMalloc( numRays * sizeof( trace_t ) );
+
+	CM_InlineModelBounds( svs.cms, CM_InlineModel( svs.cms, 0 ), worldMins, worldMaxs );
+
+	// cast rays in random directions from random non-solid points
+	for( i = 0; i < numOrigins; i++ ) {
+		for( attempt = 0; attempt < 64; attempt++ ) {
+			for( j = 0; j < 3; j++ ) {
+				origin[j] = worldMins[j] + random() * ( worldMaxs[j] - worldMins[j] );
+			}
+			if( !( CM_TransformedPointContents( svs.cms, origin, NULL, NULL, NULL ) & MASK_SOLID ) ) {
+				break;
+			}
+		}
+
+		for( j = 0; j < raysPerOrigin; j++ ) {
+			VectorSet( dir, crandom(), crandom(), crandom() );
+			if( VectorNormalize( dir ) == 0 ) {
+				VectorSet( dir, 0, 0, 1 );
+			}
+			VectorCopy( origin, starts[i * raysPerOrigin + j] );
+			VectorMA( origin, 2048.0f, dir, ends[i * raysPerOrigin + j] );
+		}
+	}
+
+	for( pass = 0; pass < 2; pass++ ) {
+		const float *mins = pass ? playerbox_mins : vec3_origin;
+		const float *maxs = pass ? playerbox_maxs : vec3_origin;
+
+		timestamp = Sys_Microseconds();
+		for( i = 0; i < numRays; i++ ) {
+			CM_TransformedBoxTrace( svs.cms, &scalarTraces[i], starts[i], ends[i], mins, maxs, NULL, MASK_SOLID, NULL, NULL );
+		}
+		scalarTime = Sys_Microseconds() - timestamp;
+
+		timestamp = Sys_Microseconds();
+		for( i = 0; i < numOrigins; i++ ) {
+			CM_TraceBatch( svs.cms, batchTraces + i * raysPerOrigin, starts + i * raysPerOrigin,
+						   ends + i * raysPerOrigin, raysPerOrigin, mins, maxs, MASK_SOLID );
+		}
+		batchTime = Sys_Microseconds() - timestamp;
+
+		numMismatches = 0;
+		for( i = 0; i < numRays; i++ ) {
+			if( fabsf( scalarTraces[i].fraction - batchTraces[i].fraction ) > 0.001f ||
+				scalarTraces[i].startsolid != batchTraces[i].startsolid ) {
+				numMismatches++;
+			}
+		}
+
+		Com_Printf( "%s traces: %d rays, scalar %.3f ms, batched %.3f ms (x%.2f), %d mismatches\n",
+					pass ? "Box" : "Point", numRays, scalarTime * 0.001, batchTime * 0.001,
+					batchTime ? (double)scalarTime / (double)batchTime : 0.0, numMismatches );
+	}
+
+	Mem_TempFree( batchTraces );
+	Mem_TempFree( scalarTraces );
+	Mem_TempFree( ends );
+	Mem_TempFree( starts );
+}
+
 //===========================================================
 
 /*
@@ -401,6 +491,9 @@ void SV_InitOperatorCommands( void ) {
 
 	Cmd_AddCommand( "cvarcheck", SV_CvarCheck_f );
 
+	Cmd_AddCommand( "snapcachestats", SV_SnapCacheStats_f );
+	Cmd_AddCommand( "tracebench", SV_TraceBench_f );
+
 	Cmd_SetCompletionFunc( "map", SV_MapComplete_f );
 	Cmd_SetCompletionFunc( "devmap", SV_MapComplete_f );
 	Cmd_SetCompletionFunc( "gamemap", SV_MapComplete_f );
@@ -433,4 +526,7 @@ void SV_ShutdownOperatorCommands( void ) {
 	}
 
 	Cmd_RemoveCommand( "cvarcheck" );
+
+	Cmd_RemoveCommand( "snapcachestats" );
+	Cmd_RemoveCommand( "tracebench" );
 }
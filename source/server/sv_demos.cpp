@@ -20,9 +20,198 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "server.h"
 #include "../qcommon/snap_tables.h"
+#include "../qcommon/qthreads.h"
+
+#include <atomic>
 
 #define SV_DEMO_DIR va( "demos/server%s%s", sv_demodir->string[0] ? "/" : "", sv_demodir->string[0] ? sv_demodir->string : "" )
 
+//================================================================
+//
+//	ASYNC WRITER
+//
+//	Demo messages are passed to a background thread through a ring buffer,
+//	so gzip compression and disk I/O never stall the server frame.
+//	If the writer falls behind and the buffer gets full, the server thread
+//	blocks until there's enough space, which is accounted as a stall.
+//
+//================================================================
+
+#define SV_DEMO_WRITER_QUEUE_SIZE   0x100000
+
+enum {
+	DEMO_WRITER_CMD_WRITE,
+	DEMO_WRITER_CMD_SHUTDOWN,
+
+	NUM_DEMO_WRITER_CMDS
+};
+
+typedef struct {
+	int id;
+	int len;
+	// followed by the message data
+} demoWriterWriteCmd_t;
+
+typedef unsigned (*demoWriterCmdHandler_t)( const void * );
+
+typedef struct {
+	qbufPipe_t *queue;
+	qthread_t *thread;
+	int file;
+
+	// uncompressed offset of the data that has been queued so far
+	int offset;
+
+	uint8_t cmdbuf[sizeof( demoWriterWriteCmd_t ) + MAX_MSGLEN + sizeof( int )];
+
+	// back-pressure metrics
+	unsigned numMessages;
+	size_t queuedBytes;
+	size_t maxPendingBytes;
+	unsigned numStalls;
+	uint64_t stallTime;
+	std::atomic<size_t> writtenBytes;
+} svDemoWriter_t;
+
+static svDemoWriter_t demoWriter;
+
+/*
+* SV_DemoWriter_HandleWriteCmd
+*/
+static unsigned SV_DemoWriter_HandleWriteCmd( const void *pcmd ) {
+	const auto *cmd = (const demoWriterWriteCmd_t *)pcmd;
+	const unsigned size = sizeof( *cmd ) + ( ( cmd->len + sizeof( int ) - 1 ) & ~( sizeof( int ) - 1 ) );
+	msg_t msg;
+
+	MSG_Init( &msg, (uint8_t *)( cmd + 1 ), cmd->len );
+	msg.cursize = cmd->len;
+	SNAP_RecordDemoMessage( demoWriter.file, &msg, 0 );
+
+	demoWriter.writtenBytes.fetch_add( size, std::memory_order_relaxed );
+	return size;
+}
+
+/*
+* SV_DemoWriter_HandleShutdownCmd
+*/
+static unsigned SV_DemoWriter_HandleShutdownCmd( const void *pcmd ) {
+	FS_Flush( demoWriter.file );
+	return 0;
+}
+
+/*
+* SV_DemoWriter_CmdsWaiter
+*/
+static int SV_DemoWriter_CmdsWaiter( qbufPipe_t *queue, demoWriterCmdHandler_t *cmdHandlers, bool timeout ) {
+	return QBufPipe_ReadCmds( queue, cmdHandlers );
+}
+
+/*
+* SV_DemoWriter_ThreadProc
+*/
+static void *SV_DemoWriter_ThreadProc( void *param ) {
+	auto *cmdQueue = (qbufPipe_t *)param;
+	demoWriterCmdHandler_t cmdHandlers[NUM_DEMO_WRITER_CMDS] =
+	{
+		SV_DemoWriter_HandleWriteCmd,
+		SV_DemoWriter_HandleShutdownCmd,
+	};
+
+	QBufPipe_Wait( cmdQueue, SV_DemoWriter_CmdsWaiter, cmdHandlers, Q_THREADS_WAIT_INFINITE );
+
+	return NULL;
+}
+
+/*
+* SV_DemoWriter_Start
+*
+* Starts writing to the file in background, the file must not be accessed directly until SV_DemoWriter_Stop
+*/
+static void SV_DemoWriter_Start( int file ) {
+	demoWriter.file = file;
+	demoWriter.offset = FS_Tell( file );
+	demoWriter.numMessages = 0;
+	demoWriter.queuedBytes = demoWriter.maxPendingBytes = 0;
+	demoWriter.numStalls = 0;
+	demoWriter.stallTime = 0;
+	demoWriter.writtenBytes = 0;
+
+	demoWriter.queue = QBufPipe_Create( SV_DEMO_WRITER_QUEUE_SIZE, 1 );
+	demoWriter.thread = QThread_Create( SV_DemoWriter_ThreadProc, demoWriter.queue );
+	if( !demoWriter.thread ) {
+		// write synchronously
+		QBufPipe_Destroy( &demoWriter.queue );
+	}
+}
+
+/*
+* SV_DemoWriter_Stop
+*
+* Waits for all queued messages to be written
+*/
+static void SV_DemoWriter_Stop( void ) {
+	int cmd;
+
+	if( demoWriter.thread ) {
+		cmd = DEMO_WRITER_CMD_SHUTDOWN;
+		QBufPipe_WriteCmd( demoWriter.queue, &cmd, sizeof( cmd ) );
+		QBufPipe_Finish( demoWriter.queue );
+
+		QThread_Join( demoWriter.thread );
+		demoWriter.thread = NULL;
+
+		QBufPipe_Destroy( &demoWriter.queue );
+	}
+
+	if( demoWriter.numStalls ) {
+		Com_Printf( "Server demo writer stalled %u times for %.1f ms total, consider a faster disk\n",
+					demoWriter.numStalls, demoWriter.stallTime / 1000.0 );
+	}
+	Com_DPrintf( "Server demo writer: %u messages, %" PRIu64 " KB, max %" PRIu64 " KB pending\n",
+				 demoWriter.numMessages, (uint64_t)( demoWriter.queuedBytes >> 10 ), (uint64_t)( demoWriter.maxPendingBytes >> 10 ) );
+
+	demoWriter.file = 0;
+}
+
+/*
+* SV_DemoWriter_WriteMessage
+*/
+static void SV_DemoWriter_WriteMessage( msg_t *msg ) {
+	auto *cmd = (demoWriterWriteCmd_t *)demoWriter.cmdbuf;
+	unsigned size;
+	size_t pending;
+
+	demoWriter.offset += sizeof( int ) + msg->cursize;
+
+	if( !demoWriter.thread ) {
+		SNAP_RecordDemoMessage( demoWriter.file, msg, 0 );
+		return;
+	}
+
+	cmd->id = DEMO_WRITER_CMD_WRITE;
+	cmd->len = msg->cursize;
+	memcpy( cmd + 1, msg->data, msg->cursize );
+	size = sizeof( *cmd ) + ( ( msg->cursize + sizeof( int ) - 1 ) & ~( sizeof( int ) - 1 ) );
+
+	demoWriter.numMessages++;
+	demoWriter.queuedBytes += size;
+
+	pending = demoWriter.queuedBytes - demoWriter.writtenBytes.load( std::memory_order_relaxed );
+	demoWriter.maxPendingBytes = std::max( demoWriter.maxPendingBytes, pending );
+
+	// the pipe may also need to skip the tail of the buffer, so this is a bit optimistic
+	if( pending > SV_DEMO_WRITER_QUEUE_SIZE ) {
+		uint64_t start = Sys_Microseconds();
+		QBufPipe_WriteCmd( demoWriter.queue, cmd, size );
+		demoWriter.stallTime += Sys_Microseconds() - start;
+		demoWriter.numStalls++;
+	} else {
+		QBufPipe_WriteCmd( demoWriter.queue, cmd, size );
+	}
+}
+
+//================================================================
+
 /*
 * SV_Demo_WriteMessage
 *
@@ -34,7 +223,7 @@ static void SV_Demo_WriteMessage( msg_t *msg ) {
 		return;
 	}
 
-	SNAP_RecordDemoMessage( svs.demo.file, msg, 0 );
+	SV_DemoWriter_WriteMessage( msg );
 }
 
 /*
@@ -72,6 +261,13 @@ void SV_Demo_WriteSnap( void ) {
 		return;
 	}
 
+	// periodically write a keyframe so the playback can seek without replaying the whole demo
+	if( svs.gametime >= svs.demo.nextkeyframetime ) {
+		SNAP_WriteDemoKeyframe( &svs.demo.keyframes, svs.gametime, demoWriter.offset, sv.configstrings[0], SV_Demo_WriteMessage );
+		svs.demo.client.nodelta = true;
+		svs.demo.nextkeyframetime = svs.gametime + SNAP_DEMO_KEYFRAME_INTERVAL;
+	}
+
 	MSG_Init( &msg, msg_buffer, sizeof( msg_buffer ) );
 
 	SV_BuildClientFrameSnap( &svs.demo.client, 0 );
@@ -183,11 +379,16 @@ void SV_Demo_Start_f( void ) {
 	svs.demo.duration = 0;
 	svs.demo.basetime = svs.gametime;
 	svs.demo.localtime = time( NULL );
+	svs.demo.nextkeyframetime = svs.gametime + SNAP_DEMO_KEYFRAME_INTERVAL;
 	SV_Demo_WriteStartMessages();
 
+	// everything past the start messages is written in background
+	SV_DemoWriter_Start( svs.demo.file );
+
 	// Clearing tables won't harm...
 	SnapVisTable::Instance()->Clear();
 	SnapShadowTable::Instance()->Clear();
+	SnapEntityDeltaCache::Instance()->Clear();
 
 	// write one nodelta frame
 	svs.demo.client.nodelta = true;
@@ -206,11 +407,21 @@ static void SV_Demo_Stop( bool cancel, bool silent ) {
 		return;
 	}
 
+	// flush pending messages, the file is ours again after this
+	SV_DemoWriter_Stop();
+
 	if( cancel ) {
 		Com_Printf( "Canceled server demo recording: %s\n", svs.demo.filename );
 	} else {
+		int keyframesofs;
+
 		SNAP_StopDemoRecording( svs.demo.file );
 
+		keyframesofs = SNAP_WriteDemoKeyframeIndex( svs.demo.file, &svs.demo.keyframes );
+		if( keyframesofs > 0 ) {
+			SV_SetDemoMetaKeyValue( SNAP_DEMO_KEYFRAMES_META_KEY, va( "%i", keyframesofs ) );
+		}
+
 		Com_Printf( "Stopped server demo recording: %s\n", svs.demo.filename );
 	}
 
@@ -243,7 +454,9 @@ static void SV_Demo_Stop( bool cancel, bool silent ) {
 
 	svs.demo.localtime = 0;
 	svs.demo.basetime = svs.demo.duration = 0;
+	svs.demo.nextkeyframetime = 0;
 
+	SNAP_FreeDemoKeyframeIndex( &svs.demo.keyframes );
 	SNAP_FreeClientFrames( &svs.demo.client );
 
 	Mem_ZoneFree( svs.demo.filename );
@@ -28,6 +28,7 @@ EXTERN_API_FUNC void *GetGameAPI( void * );
 
 mempool_t *sv_gameprogspool;
 static void *module_handle;
+static qjobgroup_t *sv_gameJobGroup;
 
 //======================================================================
 
@@ -423,6 +424,13 @@ static void PF_MemFree( void *data, const char *filename, int fileline ) {
 	_Mem_Free( data, MEMPOOL_GAMEPROGS, 0, filename, fileline );
 }
 
+/*
+* PF_MemFrameAlloc
+*/
+static void *PF_MemFrameAlloc( size_t size ) {
+	return _Mem_FrameAlloc( size, 0 );
+}
+
 //==============================================
 
 /*
@@ -442,9 +450,51 @@ void SV_ShutdownGameProgs( void ) {
 	// that's why it's called before releasing the pool.
 	Com_UnloadGameLibrary( &module_handle );
 	Mem_FreePool( &sv_gameprogspool );
+	QJobGroup_Destroy( &sv_gameJobGroup );
 	ge = NULL;
 }
 
+/*
+* PF_NumWorkerThreads
+*
+* Game jobs are executed by the engine job system, the waiting game thread executes them too.
+*/
+static int PF_NumWorkerThreads( void ) {
+	return QJobs_NumThreads();
+}
+
+typedef struct {
+	void ( *job )( int item );
+} svGameJobArg_t;
+
+/*
+* PF_GameJobTake
+*/
+static void PF_GameJobTake( unsigned first, unsigned items, void *parg ) {
+	const svGameJobArg_t *arg = ( const svGameJobArg_t * )parg;
+	unsigned i;
+
+	for( i = first; i < first + items; i++ ) {
+		arg->job( (int)i );
+	}
+}
+
+/*
+* PF_RunWorkerJobs
+*/
+static void PF_RunWorkerJobs( void ( *job )( int item ), int numItems ) {
+	svGameJobArg_t arg;
+
+	if( numItems <= 0 ) {
+		return;
+	}
+
+	// game jobs are usually few and expensive, so every item is scheduled as a separate job
+	arg.job = job;
+	QJobGroup_ParallelFor( sv_gameJobGroup, PF_GameJobTake, &arg, sizeof( arg ), (unsigned)numItems, 1 );
+	QJobGroup_Wait( sv_gameJobGroup );
+}
+
 /*
 * SV_LocateEntities
 */
@@ -482,6 +532,7 @@ void SV_InitGameProgs( void ) {
 	}
 
 	sv_gameprogspool = _Mem_AllocPool( NULL, "Game Progs", MEMPOOL_GAMEPROGS, __FILE__, __LINE__ );
+	sv_gameJobGroup = QJobGroup_Create();
 
 	// load a new game dll
 	import.Print = PF_dprint;
@@ -537,6 +588,9 @@ void SV_InitGameProgs( void ) {
 
 	import.Mem_Alloc = PF_MemAlloc;
 	import.Mem_Free = PF_MemFree;
+	import.Mem_FrameAlloc = PF_MemFrameAlloc;
+	import.Mem_FrameArenaMark = Mem_FrameArenaMark;
+	import.Mem_FrameArenaRelease = Mem_FrameArenaRelease;
 
 	import.Cvar_Get = Cvar_Get;
 	import.Cvar_Set = Cvar_Set;
@@ -566,6 +620,9 @@ void SV_InitGameProgs( void ) {
 
 	import.LocateEntities = SV_LocateEntities;
 
+	import.NumWorkerThreads = PF_NumWorkerThreads;
+	import.RunWorkerJobs = PF_RunWorkerJobs;
+
 	import.MM_NewGetQuery = SV_MM_NewGetQuery;
 	import.MM_NewPostQuery = SV_MM_NewPostQuery;
 	import.MM_DeleteQuery = SV_MM_DeleteQuery;
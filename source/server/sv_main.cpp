@@ -22,6 +22,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "sv_mm.h"
 #include "../qcommon/snap_tables.h"
 
+#define SV_MAX_PACKETS_BATCH    16 // datagrams read from a socket at once
+
 static bool sv_initialized = false;
 
 mempool_t *sv_mempool;
@@ -104,6 +106,7 @@ cvar_t *sv_snap_aggressive_sound_culling;
 cvar_t *sv_snap_raycast_players_culling;
 cvar_t *sv_snap_aggressive_fov_culling;
 cvar_t *sv_snap_shadow_events_data;
+cvar_t *sv_snap_threads;
 
 //============================================================================
 
@@ -170,7 +173,7 @@ static bool SV_ProcessPacket( netchan_t *netchan, msg_t *msg ) {
 	MSG_ReadInt32( msg ); // sequence_ack
 	MSG_ReadInt16( msg ); // game_port
 	if( msg->compressed ) {
-		zerror = Netchan_DecompressMessage( msg );
+		zerror = Netchan_DecompressMessage( msg, netchan->codec );
 		if( zerror < 0 ) {
 			// compression error. Drop the packet
 			Com_DPrintf( "SV_ProcessPacket: Compression error %i. Dropping packet\n", zerror );
@@ -181,6 +184,61 @@ static bool SV_ProcessPacket( netchan_t *netchan, msg_t *msg ) {
 	return true;
 }
 
+/*
+* SV_ReadSocketPacket
+*
+* Handles a datagram received on one of the shared server sockets
+*/
+static void SV_ReadSocketPacket( socket_t *socket, netadr_t *address, msg_t *msg ) {
+	int i;
+	client_t *cl;
+	int game_port;
+
+	// check for connectionless packet (0xffffffff) first
+	if( *(int *)msg->data == -1 ) {
+		SV_ConnectionlessPacket( socket, address, msg );
+		return;
+	}
+
+	// read the game port out of the message so we can fix up
+	// stupid address translating routers
+	MSG_BeginReading( msg );
+	MSG_ReadInt32( msg ); // sequence number
+	MSG_ReadInt32( msg ); // sequence number
+	game_port = MSG_ReadInt16( msg ) & 0xffff;
+	// data follows
+
+	// check for packets from connected clients
+	for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ ) {
+		unsigned short addr_port;
+
+		if( cl->state == CS_FREE || cl->state == CS_ZOMBIE ) {
+			continue;
+		}
+		if( cl->edict && ( cl->edict->r.svflags & SVF_FAKECLIENT ) ) {
+			continue;
+		}
+		if( !NET_CompareBaseAddress( address, &cl->netchan.remoteAddress ) ) {
+			continue;
+		}
+		if( cl->netchan.game_port != game_port ) {
+			continue;
+		}
+
+		addr_port = NET_GetAddressPort( address );
+		if( NET_GetAddressPort( &cl->netchan.remoteAddress ) != addr_port ) {
+			Com_Printf( "SV_ReadPackets: fixing up a translated port\n" );
+			NET_SetAddressPort( &cl->netchan.remoteAddress, addr_port );
+		}
+
+		if( SV_ProcessPacket( &cl->netchan, msg ) ) { // this is a valid, sequenced packet, so process it
+			cl->lastPacketReceivedTime = svs.realtime;
+			SV_ParseClientMessage( cl, msg );
+		}
+		break;
+	}
+}
+
 /*
 * SV_ReadPackets
 */
@@ -190,13 +248,17 @@ static void SV_ReadPackets( void ) {
 #ifdef TCP_ALLOW_CONNECT
 	socket_t newsocket;
 #endif
-	int game_port;
 	socket_t *socket;
 	netadr_t address;
 
 	static msg_t msg;
 	static uint8_t msgData[MAX_MSGLEN];
 
+	// datagrams of shared sockets are read in batches
+	static netadr_t batchAddresses[SV_MAX_PACKETS_BATCH];
+	static msg_t batchMsgs[SV_MAX_PACKETS_BATCH];
+	static uint8_t batchMsgData[SV_MAX_PACKETS_BATCH][MAX_MSGLEN];
+
 #ifdef TCP_ALLOW_CONNECT
 	socket_t* tcpsockets [] =
 	{
@@ -214,6 +276,11 @@ static void SV_ReadPackets( void ) {
 
 	MSG_Init( &msg, msgData, sizeof( msgData ) );
 
+	// NET_GetPackets() might have swapped buffers of messages, that does not matter
+	for( i = 0; i < SV_MAX_PACKETS_BATCH; i++ ) {
+		MSG_Init( &batchMsgs[i], batchMsgs[i].data ? batchMsgs[i].data : batchMsgData[i], MAX_MSGLEN );
+	}
+
 #ifdef TCP_ALLOW_CONNECT
 	for( socketind = 0; socketind < sizeof( tcpsockets ) / sizeof( tcpsockets[0] ); socketind++ ) {
 		socket = tcpsockets[socketind];
@@ -280,54 +347,14 @@ static void SV_ReadPackets( void ) {
 			continue;
 		}
 
-		while( ( ret = NET_GetPacket( socket, &address, &msg ) ) != 0 ) {
+		while( ( ret = NET_GetPackets( socket, batchAddresses, batchMsgs, SV_MAX_PACKETS_BATCH ) ) != 0 ) {
 			if( ret == -1 ) {
 				Com_Printf( "NET_GetPacket: Error: %s\n", NET_ErrorString() );
 				continue;
 			}
 
-			// check for connectionless packet (0xffffffff) first
-			if( *(int *)msg.data == -1 ) {
-				SV_ConnectionlessPacket( socket, &address, &msg );
-				continue;
-			}
-
-			// read the game port out of the message so we can fix up
-			// stupid address translating routers
-			MSG_BeginReading( &msg );
-			MSG_ReadInt32( &msg ); // sequence number
-			MSG_ReadInt32( &msg ); // sequence number
-			game_port = MSG_ReadInt16( &msg ) & 0xffff;
-			// data follows
-
-			// check for packets from connected clients
-			for( i = 0, cl = svs.clients; i < sv_maxclients->integer; i++, cl++ ) {
-				unsigned short addr_port;
-
-				if( cl->state == CS_FREE || cl->state == CS_ZOMBIE ) {
-					continue;
-				}
-				if( cl->edict && ( cl->edict->r.svflags & SVF_FAKECLIENT ) ) {
-					continue;
-				}
-				if( !NET_CompareBaseAddress( &address, &cl->netchan.remoteAddress ) ) {
-					continue;
-				}
-				if( cl->netchan.game_port != game_port ) {
-					continue;
-				}
-
-				addr_port = NET_GetAddressPort( &address );
-				if( NET_GetAddressPort( &cl->netchan.remoteAddress ) != addr_port ) {
-					Com_Printf( "SV_ReadPackets: fixing up a translated port\n" );
-					NET_SetAddressPort( &cl->netchan.remoteAddress, addr_port );
-				}
-
-				if( SV_ProcessPacket( &cl->netchan, &msg ) ) { // this is a valid, sequenced packet, so process it
-					cl->lastPacketReceivedTime = svs.realtime;
-					SV_ParseClientMessage( cl, &msg );
-				}
-				break;
+			for( i = 0; i < ret; i++ ) {
+				SV_ReadSocketPacket( socket, &batchAddresses[i], &batchMsgs[i] );
 			}
 		}
 	}
@@ -485,8 +512,16 @@ static bool SV_RunGameFrame( int msec ) {
 
 	// if there aren't pending packets to be sent, we can sleep
 	if( dedicated->integer && !sentFragments && !refreshSnapshot ) {
-		int sleeptime = std::min( (int)( WORLDFRAMETIME - ( accTime + 1 ) ), (int)( sv.nextSnapTime - ( svs.gametime + 1 ) ) );
+		const int64_t msecLeft = std::min( (int64_t)WORLDFRAMETIME - accTime, sv.nextSnapTime - svs.gametime );
 
+		// Frames are due at ticks of the millisecond clock, sleep till the tick using the time elapsed since the last one.
+		// If the clocks are not in sync, wake up a millisecond earlier as there is no way to tell.
+		int64_t usecSinceTick = (int64_t)Sys_Microseconds() - Sys_Milliseconds() * 1000;
+		if( usecSinceTick < 0 || usecSinceTick >= 1000 ) {
+			usecSinceTick = 1000;
+		}
+
+		const int64_t sleeptime = msecLeft * 1000 - usecSinceTick;
 		if( sleeptime > 0 ) {
 			socket_t *sockets [] = { &svs.socket_udp, &svs.socket_udp6 };
 			socket_t *opened_sockets [sizeof( sockets ) / sizeof( sockets[0] ) + 1 ];
@@ -503,7 +538,7 @@ static bool SV_RunGameFrame( int msec ) {
 			}
 			opened_sockets[open_ind] = NULL;
 
-			NET_Sleep( sleeptime, opened_sockets );
+			NET_SleepMicros( sleeptime, opened_sockets );
 		}
 	}
 
@@ -524,6 +559,9 @@ static bool SV_RunGameFrame( int msec ) {
 			accTime = 0;
 		}
 
+		// per-frame scratch memory of the previous game frame is not needed anymore
+		Mem_ResetFrameArenas();
+
 		if( host_speeds->integer ) {
 			time_before_game = Sys_Milliseconds();
 		}
@@ -727,6 +765,10 @@ void SV_Frame( unsigned realmsec, unsigned gamemsec ) {
 		// Clear tables once and then reuse cached results for sending client messages and writing demos.
 		SnapVisTable::Instance()->Clear();
 		SnapShadowTable::Instance()->Clear();
+		SnapEntityDeltaCache::Instance()->Clear();
+
+		// snapshot builders might run in parallel and must see consistent entity numbers
+		SNAP_FixEntityNumbers( &sv.gi );
 
 		// send messages back to the clients that had packets read this frame
 		SV_SendClientMessages();
@@ -996,6 +1038,7 @@ void SV_Init( void ) {
 	sv_snap_raycast_players_culling = Cvar_Get( SNAP_VAR_USE_RAYCAST_CULLING, "1", CVAR_SERVERINFO | CVAR_ARCHIVE );
 	sv_snap_aggressive_fov_culling = Cvar_Get( SNAP_VAR_USE_VIEWDIR_CULLING, "0", CVAR_SERVERINFO | CVAR_ARCHIVE );
 	sv_snap_shadow_events_data = Cvar_Get( SNAP_VAR_SHADOW_EVENTS_DATA, "1", CVAR_SERVERINFO | CVAR_ARCHIVE );
+	sv_snap_threads = Cvar_Get( "sv_snap_threads", "0", CVAR_ARCHIVE );
 
 	Com_Printf( "Game running at %i fps. Server transmit at %i pps\n", sv_fps->integer, sv_pps->integer );
 
@@ -1023,6 +1066,7 @@ void SV_Shutdown( const char *finalmsg ) {
 	sv_initialized = false;
 
 	// This is safe to call multiple times
+	SnapEntityDeltaCache::Shutdown();
 	SnapShadowTable::Shutdown();
 	SnapVisTable::Shutdown();
 
@@ -1031,6 +1075,8 @@ void SV_Shutdown( const char *finalmsg ) {
 
 	SV_ShutdownGame( finalmsg, false );
 
+	SV_ShutdownSendWorkers();
+
 	// Call this after the game has been shut down
 	// (SV_DropClient() gets called from the game module and expects an initialized SVStatsowFacade)
 	SVStatsowFacade::Shutdown();
@@ -1043,9 +1089,28 @@ void SV_Shutdown( const char *finalmsg ) {
 void SV_SetupSnapTables( cmodel_state_t *cms ) {
 	assert( cms );
 
+	SnapEntityDeltaCache::Shutdown();
 	SnapShadowTable::Shutdown();
 	SnapVisTable::Shutdown();
 
 	SnapVisTable::Init( cms );
 	SnapShadowTable::Init();
+	SnapEntityDeltaCache::Init();
+}
+
+/*
+* SV_SnapCacheStats_f
+*/
+void SV_SnapCacheStats_f( void ) {
+	if( !svs.initialized ) {
+		return;
+	}
+
+	SnapEntityDeltaCache *cache = SnapEntityDeltaCache::Instance();
+	if( Cmd_Argc() == 2 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		cache->ResetStats();
+		return;
+	}
+
+	cache->PrintStats();
 }
\ No newline at end of file
@@ -612,6 +612,7 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 	client_t *cl, *newcl;
 	int i, version, game_port, challenge;
 	int previousclients;
+	int codec;
 	mm_uuid_t session_id, ticket_id;
 	char *session_id_str;
 	int64_t time;
@@ -656,7 +657,7 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 		return;
 	}
 
-	if( Cmd_Argc() >= 7 ) {
+	if( Cmd_Argc() >= 7 && Cmd_Argv( 6 )[0] ) {
 		// we have extended information, ticket-id and session-id
 		Com_Printf( "Extended information %s\n", Cmd_Argv( 6 ) );
 		if( !Uuid_FromString( Cmd_Argv( 6 ), &ticket_id ) ) {
@@ -671,6 +672,12 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 		ticket_id = session_id = Uuid_ZeroUuid();
 	}
 
+	// pick the compression codec, clients that don't offer anything get zlib
+	codec = NETCHAN_CODEC_ZLIB;
+	if( Cmd_Argc() >= 9 ) {
+		codec = Netchan_NegotiateCodec( strtoul( Cmd_Argv( 7 ), NULL, 10 ), strtoul( Cmd_Argv( 8 ), NULL, 10 ) );
+	}
+
 #ifdef TCP_ALLOW_CONNECT
 	if( socket->type == SOCKET_TCP ) {
 		// find the connection
@@ -806,8 +813,11 @@ static void SVC_DirectConnect( const socket_t *socket, const netadr_t *address )
 		return;
 	}
 
+	newcl->netchan.codec = codec;
+	Com_DPrintf( "%s: using %s compression\n", NET_AddressToString( address ), Netchan_CodecName( codec ) );
+
 	// send the connect packet to the client
-	Netchan_OutOfBandPrint( socket, address, "client_connect\n%s", newcl->session );
+	Netchan_OutOfBandPrint( socket, address, "client_connect\n%s\n%i", newcl->session, codec );
 
 	// free the incoming entry
 #ifdef TCP_ALLOW_CONNECT
@@ -294,7 +294,7 @@ bool SV_Netchan_Transmit( netchan_t *netchan, msg_t *msg ) {
 	}
 
 	if( sv_compresspackets->integer ) {
-		zerror = Netchan_CompressMessage( msg );
+		zerror = Netchan_CompressMessage( msg, netchan->codec );
 		if( zerror < 0 ) { // it's compression error, just send uncompressed
 			Com_DPrintf( "SV_Netchan_Transmit (ignoring compression): Compression error %i\n", zerror );
 		}
@@ -367,42 +367,50 @@ void SV_WriteFrameSnapToClient( client_t *client, msg_t *msg ) {
 }
 
 /*
-* SV_BuildClientFrameSnap
+* SV_GetSkyPortalOrigin
+*
+* Returns NULL if there is no sky portal or the sky portal does not need entities
 */
-void SV_BuildClientFrameSnap( client_t *client, int snapHintFlags ) {
-	vec_t *skyorg = NULL, origin[3];
-
+static vec_t *SV_GetSkyPortalOrigin( vec3_t origin ) {
 	if( sv.configstrings[CS_SKYBOX][0] != '\0' ) {
 		int noents = 0;
 		float f1 = 0, f2 = 0;
 
 		if( sscanf( sv.configstrings[CS_SKYBOX], "%f %f %f %f %f %i", &origin[0], &origin[1], &origin[2], &f1, &f2, &noents ) >= 3 ) {
 			if( !noents ) {
-				skyorg = origin;
+				return origin;
 			}
 		}
 	}
 
-	svs.fatvis.skyorg = skyorg;     // HACK HACK HACK
+	return NULL;
+}
+
+/*
+* SV_BuildClientFrameSnapWithFatvis
+*/
+static void SV_BuildClientFrameSnapWithFatvis( client_t *client, fatvis_t *fatvis, int snapHintFlags ) {
 	SNAP_BuildClientFrameSnap( svs.cms, &sv.gi, sv.framenum, svs.gametime,
-							   &svs.fatvis, client, ge->GetGameState(),
+							   fatvis, client, ge->GetGameState(),
 							   &svs.client_entities,
 							   sv_mempool, snapHintFlags );
-	svs.fatvis.skyorg = NULL;
 }
 
 /*
-* SV_SendClientDatagram
+* SV_BuildClientFrameSnap
 */
-static bool SV_SendClientDatagram( client_t *client ) {
-	if( client->edict && ( client->edict->r.svflags & SVF_FAKECLIENT ) ) {
-		return true;
-	}
-
-	SV_InitClientMessage( client, &tmpMessage, NULL, 0 );
+void SV_BuildClientFrameSnap( client_t *client, int snapHintFlags ) {
+	vec3_t origin;
 
-	SV_AddReliableCommandsToMessage( client, &tmpMessage );
+	svs.fatvis.skyorg = SV_GetSkyPortalOrigin( origin );     // HACK HACK HACK
+	SV_BuildClientFrameSnapWithFatvis( client, &svs.fatvis, snapHintFlags );
+	svs.fatvis.skyorg = NULL;
+}
 
+/*
+* SV_GetClientSnapHintFlags
+*/
+static int SV_GetClientSnapHintFlags( const client_t *client ) {
 	// Set snap hint flags to client-specific flags set by the game module
 	int snapHintFlags = client->edict->r.client->r.snapHintFlags;
 	// Add server global snap hint flags
@@ -418,22 +426,205 @@ static bool SV_SendClientDatagram( client_t *client ) {
 	if( sv_snap_shadow_events_data->integer ) {
 		snapHintFlags |= SNAP_HINT_SHADOW_EVENTS_DATA;
 	}
+	return snapHintFlags;
+}
+
+/*
+* SV_SendClientDatagram
+*/
+static bool SV_SendClientDatagram( client_t *client ) {
+	if( client->edict && ( client->edict->r.svflags & SVF_FAKECLIENT ) ) {
+		return true;
+	}
+
+	SV_InitClientMessage( client, &tmpMessage, NULL, 0 );
+
+	SV_AddReliableCommandsToMessage( client, &tmpMessage );
 
 	// send over all the relevant entity_state_t
 	// and the player_state_t
-	SV_BuildClientFrameSnap( client, snapHintFlags );
+	SV_BuildClientFrameSnap( client, SV_GetClientSnapHintFlags( client ) );
 
 	SV_WriteFrameSnapToClient( client, &tmpMessage );
 
 	return SV_SendMessageToClient( client, &tmpMessage );
 }
 
+//===============================================================================
+//
+//PARALLEL SNAPSHOTS BUILDING
+//
+//===============================================================================
+
+// a thread-local data of every snapshot worker (including the main thread)
+typedef struct {
+	fatvis_t fatvis;
+	msg_t msg;
+	uint8_t msgData[MAX_MSGLEN];
+} sv_sendworker_t;
+
+static sv_sendworker_t *sv_sendworkers;
+static int sv_numsendworkers;
+// netchan transmission is not thread-safe and stays serialized
+static qmutex_t *sv_transmitMutex;
+
+// parameters and results of the current batch
+static client_t *sv_snapclients[MAX_CLIENTS];
+static vec_t *sv_snapskyorg;
+static bool sv_snapfailed[MAX_CLIENTS];
+static char sv_snaperrors[MAX_CLIENTS][MAX_STRING_CHARS];
+
+/*
+* SV_ShutdownSendWorkers
+*/
+void SV_ShutdownSendWorkers( void ) {
+	SV_SnapWorkers_Shutdown();
+
+	if( sv_sendworkers ) {
+		Mem_Free( sv_sendworkers );
+		sv_sendworkers = NULL;
+	}
+	sv_numsendworkers = 0;
+
+	if( sv_transmitMutex ) {
+		QMutex_Destroy( &sv_transmitMutex );
+	}
+}
+
+/*
+* SV_CheckSendWorkers
+*
+* Returns true if snapshots should be built in parallel
+*/
+static bool SV_CheckSendWorkers( void ) {
+	// workers might have been shut down along with the server without modifying the var
+	if( sv_snap_threads->modified || ( sv_snap_threads->integer > 0 && !sv_sendworkers ) ) {
+		SV_ShutdownSendWorkers();
+		sv_snap_threads->modified = false;
+
+		if( sv_snap_threads->integer > 0 ) {
+			SV_SnapWorkers_Init( sv_snap_threads->integer );
+
+			sv_numsendworkers = SV_SnapWorkers_NumThreads() + 1;
+			sv_sendworkers = ( sv_sendworker_t * )Mem_Alloc( sv_mempool, sv_numsendworkers * sizeof( sv_sendworker_t ) );
+			for( int i = 0; i < sv_numsendworkers; i++ ) {
+				MSG_Init( &sv_sendworkers[i].msg, sv_sendworkers[i].msgData, sizeof( sv_sendworkers[i].msgData ) );
+			}
+
+			sv_transmitMutex = QMutex_Create();
+		}
+	}
+
+	return sv_numsendworkers > 1;
+}
+
+/*
+* SV_SendClientDatagramJob
+*
+* Builds and writes a snapshot of a single client using a thread-local message buffer
+*/
+static void SV_SendClientDatagramJob( int item, int workerNum ) {
+	client_t *client = sv_snapclients[item];
+	sv_sendworker_t *worker = &sv_sendworkers[workerNum];
+	msg_t *msg = &worker->msg;
+
+	SV_InitClientMessage( client, msg, NULL, 0 );
+
+	SV_AddReliableCommandsToMessage( client, msg );
+
+	worker->fatvis.skyorg = sv_snapskyorg;
+	SV_BuildClientFrameSnapWithFatvis( client, &worker->fatvis, SV_GetClientSnapHintFlags( client ) );
+	worker->fatvis.skyorg = NULL;
+
+	SV_WriteFrameSnapToClient( client, msg );
+
+	QMutex_Lock( sv_transmitMutex );
+	sv_snapfailed[item] = !SV_SendMessageToClient( client, msg );
+	if( sv_snapfailed[item] ) {
+		Q_strncpyz( sv_snaperrors[item], NET_ErrorString(), sizeof( sv_snaperrors[item] ) );
+	}
+	QMutex_Unlock( sv_transmitMutex );
+}
+
+/*
+* SV_SendClientDatagramsInParallel
+*/
+static void SV_SendClientDatagramsInParallel( void ) {
+	int i, numclients = 0;
+	client_t *client;
+	vec3_t skyorg;
+
+	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ ) {
+		if( client->state != CS_SPAWNED ) {
+			continue;
+		}
+		if( client->edict && ( client->edict->r.svflags & SVF_FAKECLIENT ) ) {
+			continue;
+		}
+		sv_snapclients[numclients++] = client;
+	}
+
+	sv_snapskyorg = SV_GetSkyPortalOrigin( skyorg );
+
+	SV_SnapWorkers_Run( SV_SendClientDatagramJob, numclients );
+
+	sv_snapskyorg = NULL;
+
+	// dropping clients is not thread-safe, do that after all workers are done
+	for( i = 0; i < numclients; i++ ) {
+		if( !sv_snapfailed[i] ) {
+			continue;
+		}
+
+		client = sv_snapclients[i];
+		Com_Printf( "Error sending message to %s: %s\n", client->name, sv_snaperrors[i] );
+		if( client->reliable ) {
+			SV_DropClient( client, DROP_TYPE_GENERAL, "Error sending message: %s\n", sv_snaperrors[i] );
+		}
+	}
+}
+
+/*
+* SV_SendBatchErrorCb
+*
+* Queued datagrams are sent when the batch is flushed, so send errors are reported only then.
+* The net layer only records errors, this is the single place they are printed.
+*/
+static void SV_SendBatchErrorCb( const socket_t *socket, const netadr_t *address, const char *error ) {
+	int i;
+	client_t *client;
+	bool found = false;
+
+	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ ) {
+		if( client->state == CS_FREE || client->state == CS_ZOMBIE ) {
+			continue;
+		}
+		if( client->netchan.socket != socket || !NET_CompareAddress( &client->netchan.remoteAddress, address ) ) {
+			continue;
+		}
+
+		found = true;
+		Com_Printf( "Error sending message to %s: %s\n", client->name, error );
+		if( client->reliable ) {
+			SV_DropClient( client, DROP_TYPE_GENERAL, "Error sending message: %s\n", error );
+		}
+	}
+
+	if( !found ) {
+		Com_Printf( "Error sending message to %s: %s\n", NET_AddressToString( address ), error );
+	}
+}
+
 /*
 * SV_SendClientMessages
 */
 void SV_SendClientMessages( void ) {
 	int i;
 	client_t *client;
+	const bool parallel = SV_CheckSendWorkers();
+
+	// datagrams of all clients are flushed at once at the end of the frame
+	NET_BeginSendBatch();
 
 	// send a message to each connected client
 	for( i = 0, client = svs.clients; i < sv_maxclients->integer; i++, client++ ) {
@@ -449,6 +640,10 @@ void SV_SendClientMessages( void ) {
 		SV_UpdateActivity();
 
 		if( client->state == CS_SPAWNED ) {
+			// datagrams of spawned clients are sent by workers below
+			if( parallel ) {
+				continue;
+			}
 			if( !SV_SendClientDatagram( client ) ) {
 				Com_Printf( "Error sending message to %s: %s\n", client->name, NET_ErrorString() );
 				if( client->reliable ) {
@@ -470,4 +665,10 @@ void SV_SendClientMessages( void ) {
 			}
 		}
 	}
+
+	if( parallel ) {
+		SV_SendClientDatagramsInParallel();
+	}
+
+	NET_FlushSendBatch( SV_SendBatchErrorCb );
 }
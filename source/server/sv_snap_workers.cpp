@@ -0,0 +1,190 @@
+#include "server.h"
+#include "../qcommon/qthreads.h"
+
+#include <atomic>
+
+/*
+* A tiny persistent pool of threads for building client snapshots.
+*
+* Items of a batch are fetched by workers from a shared atomic counter,
+* so the workload is balanced even if snapshots of some clients are much more expensive.
+* The caller thread is treated as the worker #0 and helps executing the batch.
+*/
+
+typedef struct {
+	int numThreads;
+	qthread_t *threads[SV_MAX_SNAP_WORKERS];
+
+	qmutex_t *mutex;
+	qcondvar_t *wakeCondVar;
+
+	// these are guarded by the mutex
+	unsigned generation;
+	bool terminate;
+	svSnapWorkerJob_t job;
+	int numItems;
+
+	std::atomic_int nextItem;
+	std::atomic_int numActiveThreads;
+} svSnapWorkers_t;
+
+static svSnapWorkers_t snapWorkers;
+
+/*
+* SV_SnapWorkers_ExecItems
+*/
+static void SV_SnapWorkers_ExecItems( svSnapWorkerJob_t job, int numItems, int workerNum ) {
+	for(;; ) {
+		const int item = snapWorkers.nextItem.fetch_add( 1, std::memory_order_relaxed );
+		if( item >= numItems ) {
+			break;
+		}
+		job( item, workerNum );
+	}
+}
+
+/*
+* SV_SnapWorkerThreadProc
+*/
+static void *SV_SnapWorkerThreadProc( void *param ) {
+	const int workerNum = (int)(intptr_t)param;
+	unsigned seenGeneration = 0;
+
+	for(;; ) {
+		QMutex_Lock( snapWorkers.mutex );
+		while( snapWorkers.generation == seenGeneration && !snapWorkers.terminate ) {
+			QCondVar_Wait( snapWorkers.wakeCondVar, snapWorkers.mutex, Q_THREADS_WAIT_INFINITE );
+		}
+
+		if( snapWorkers.terminate ) {
+			QMutex_Unlock( snapWorkers.mutex );
+			break;
+		}
+
+		seenGeneration = snapWorkers.generation;
+		svSnapWorkerJob_t job = snapWorkers.job;
+		const int numItems = snapWorkers.numItems;
+		// Must be done while holding the lock (see SV_SnapWorkers_Run())
+		snapWorkers.numActiveThreads.fetch_add( 1, std::memory_order_relaxed );
+		QMutex_Unlock( snapWorkers.mutex );
+
+		SV_SnapWorkers_ExecItems( job, numItems, workerNum );
+
+		// Publish results of executed jobs
+		snapWorkers.numActiveThreads.fetch_sub( 1, std::memory_order_release );
+	}
+
+	return NULL;
+}
+
+/*
+* SV_SnapWorkers_Init
+*/
+void SV_SnapWorkers_Init( int numThreads ) {
+	int i;
+
+	SV_SnapWorkers_Shutdown();
+
+	Q_clamp( numThreads, 0, SV_MAX_SNAP_WORKERS );
+	if( !numThreads ) {
+		return;
+	}
+
+	snapWorkers.mutex = QMutex_Create();
+	snapWorkers.wakeCondVar = QCondVar_Create();
+	snapWorkers.generation = 0;
+	snapWorkers.terminate = false;
+	snapWorkers.job = NULL;
+	snapWorkers.numItems = 0;
+	snapWorkers.nextItem = 0;
+	snapWorkers.numActiveThreads = 0;
+
+	for( i = 0; i < numThreads; i++ ) {
+		snapWorkers.threads[i] = QThread_Create( SV_SnapWorkerThreadProc, (void *)(intptr_t)( i + 1 ) );
+	}
+	snapWorkers.numThreads = numThreads;
+
+	Com_Printf( "Using %d extra threads for building client snapshots\n", numThreads );
+}
+
+/*
+* SV_SnapWorkers_Shutdown
+*/
+void SV_SnapWorkers_Shutdown( void ) {
+	int i;
+
+	if( !snapWorkers.numThreads ) {
+		return;
+	}
+
+	QMutex_Lock( snapWorkers.mutex );
+	snapWorkers.terminate = true;
+	for( i = 0; i < snapWorkers.numThreads; i++ ) {
+		QCondVar_Wake( snapWorkers.wakeCondVar );
+	}
+	QMutex_Unlock( snapWorkers.mutex );
+
+	for( i = 0; i < snapWorkers.numThreads; i++ ) {
+		QThread_Join( snapWorkers.threads[i] );
+		snapWorkers.threads[i] = NULL;
+	}
+	snapWorkers.numThreads = 0;
+
+	QCondVar_Destroy( &snapWorkers.wakeCondVar );
+	QMutex_Destroy( &snapWorkers.mutex );
+}
+
+/*
+* SV_SnapWorkers_NumThreads
+*/
+int SV_SnapWorkers_NumThreads( void ) {
+	return snapWorkers.numThreads;
+}
+
+/*
+* SV_SnapWorkers_Run
+*
+* Executes the job for every item in [0, numItems) and returns once all items are processed.
+* The job gets a worker number in [0, SV_SnapWorkers_NumThreads()] to address its thread-local data.
+*/
+void SV_SnapWorkers_Run( svSnapWorkerJob_t job, int numItems ) {
+	int i;
+
+	if( numItems <= 0 ) {
+		return;
+	}
+
+	// Don't bother waking threads for a single item
+	if( !snapWorkers.numThreads || numItems == 1 ) {
+		for( i = 0; i < numItems; i++ ) {
+			job( i, 0 );
+		}
+		return;
+	}
+
+	QMutex_Lock( snapWorkers.mutex );
+	// A thread that has woken up too late for the previous batch might still be checking for items.
+	// Threads register themselves as active only while holding the lock,
+	// so once there are no active threads nobody can see a partially set up batch.
+	while( snapWorkers.numActiveThreads.load( std::memory_order_acquire ) ) {
+		QMutex_Unlock( snapWorkers.mutex );
+		QThread_Yield();
+		QMutex_Lock( snapWorkers.mutex );
+	}
+	snapWorkers.job = job;
+	snapWorkers.numItems = numItems;
+	snapWorkers.nextItem.store( 0, std::memory_order_relaxed );
+	snapWorkers.generation++;
+	for( i = 0; i < snapWorkers.numThreads && i < numItems - 1; i++ ) {
+		QCondVar_Wake( snapWorkers.wakeCondVar );
+	}
+	QMutex_Unlock( snapWorkers.mutex );
+
+	SV_SnapWorkers_ExecItems( job, numItems, 0 );
+
+	// All items have been fetched at this moment, wait for threads that are still executing their items.
+	// A thread registers itself as active before fetching an item so no executed item can be missed.
+	while( snapWorkers.numActiveThreads.load( std::memory_order_acquire ) ) {
+		QThread_Yield();
+	}
+}